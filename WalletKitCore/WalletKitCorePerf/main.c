@@ -90,6 +90,17 @@ int main(int argc, const char * argv[]) {
     BREthereumTimestamp timestamp = 1539330275; // ETHEREUM_TIMESTAMP_UNKNOWN;
     const char *path = "core";
 
+    // The benchmarks are long running; build with -DPERF_BENCHMARKS to run them
+#if defined (PERF_BENCHMARKS)
+    BRRunPerfTestsWallet (20000);
+    BRRunPerfTestsWalletDiscovery (10000);
+    BRRunPerfTestsTransactionSign (2000);
+    BRRunPerfTestsHeaders (200000);
+    runPerfTestsCryptoWallet (100000);
+    runPerfTestsRlpDecode (10, 2000);
+    runPerfTestsKeccak (10, 100000);
+#endif
+
 #if defined (NEVER_EWM)
     runSyncTest (ethNetworkMainnet,  account, mode, timestamp,  5 * 60, path);
 //    runSyncMany(ethereumMainnet, mode, 10 * 60, 1000);
@@ -208,7 +208,7 @@ final class WalletKitCoreTests: XCTestCase {
     }
 
     func testBitcoin () {
-        XCTAssert(1 == BRRunTests())
+        XCTAssert(1 == BRRunTests(storagePath))
 //        XCTAssert(1 == BRRunTestsBWM (paperKey, storagePath, bitcoinChain, (isMainnet ? 1 : 0)));
     }
 
@@ -41,6 +41,7 @@
 
 #include "bitcoin/BRBloomFilter.h"
 #include "bitcoin/BRMerkleBlock.h"
+#include "bitcoin/BRHeaderStore.h"
 #include "bitcoin/BRWallet.h"
 #include "bitcoin/BRBIP38Key.h"
 #include "bitcoin/BRPeer.h"
@@ -59,6 +60,9 @@
 #include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
 #include <pthread.h>
 
 #define SKIP_BIP38 1
@@ -876,6 +880,86 @@ int BRMacTests()
                "\x27\x0c\xd7\xea\x25\x05\x54\x97\x58\xbf\x75\xc0\x5a\x99\x4a\x6d\x03\x4f\x65\xf8\xf0\xe6\xfd\xca\xea"
                "\xb1\xa3\x4d\x4a\x6b\x4b\x63\x6e\x07\x0a\x38\xbc\xe7\x37", mac, 64) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRHMAC() sha512 test 2\n", __func__);
+
+    // test incremental hmac, with the keyed state reused
+    
+    BRHMACState ctx, ctx2;
+    
+    BRHMACInit(&ctx, BRSHA512, 512/8, k1, sizeof(k1) - 1);
+    ctx2 = ctx;
+    BRHMACUpdate(&ctx2, d1, 3);
+    BRHMACUpdate(&ctx2, &d1[3], sizeof(d1) - 4);
+    BRHMACFinal(&ctx2, mac);
+    if (memcmp("\x87\xaa\x7c\xde\xa5\xef\x61\x9d\x4f\xf0\xb4\x24\x1a\x1d\x6c\xb0\x23\x79\xf4\xe2\xce\x4e\xc2\x78\x7a"
+               "\xd0\xb3\x05\x45\xe1\x7c\xde\xda\xa8\x33\xb7\xd6\xb8\xa7\x02\x03\x8b\x27\x4e\xae\xa3\xf4\xe4\xbe\x9d"
+               "\x91\x4e\xeb\x61\xf1\x70\x2e\x69\x6c\x20\x3a\x12\x68\x54", mac, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACFinal() sha512 test 1\n", __func__);
+
+    BRHMACUpdate(&ctx, d1, sizeof(d1) - 1);
+    BRHMACFinal(&ctx, mac);
+    if (memcmp("\x87\xaa\x7c\xde\xa5\xef\x61\x9d\x4f\xf0\xb4\x24\x1a\x1d\x6c\xb0\x23\x79\xf4\xe2\xce\x4e\xc2\x78\x7a"
+               "\xd0\xb3\x05\x45\xe1\x7c\xde\xda\xa8\x33\xb7\xd6\xb8\xa7\x02\x03\x8b\x27\x4e\xae\xa3\xf4\xe4\xbe\x9d"
+               "\x91\x4e\xeb\x61\xf1\x70\x2e\x69\x6c\x20\x3a\x12\x68\x54", mac, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACFinal() sha512 test 2\n", __func__);
+
+    BRHMACInit(&ctx, BRSHA256, 256/8, k2, sizeof(k2) - 1);
+    BRHMACUpdate(&ctx, d2, sizeof(d2) - 1);
+    BRHMACFinal(&ctx, mac);
+    if (memcmp("\x5b\xdc\xc1\x46\xbf\x60\x75\x4e\x6a\x04\x24\x26\x08\x95\x75\xc7\x5a\x00\x3f\x08\x9d\x27\x39\x83\x9d"
+               "\xec\x58\xb9\x64\xec\x38\x43", mac, 32) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHMACFinal() sha256 test 3\n", __func__);
+
+    // test pbkdf2: https://tools.ietf.org/html/rfc7914#section-11
+
+    uint8_t dk[64], dks[64*9];
+
+    BRPBKDF2(dk, sizeof(dk), BRSHA256, 256/8, "passwd", 6, "salt", 4, 1);
+    if (memcmp("\x55\xac\x04\x6e\x56\xe3\x08\x9f\xec\x16\x91\xc2\x25\x44\xb6\x05\xf9\x41\x85\x21\x6d\xde\x04\x65\xe6"
+               "\x8b\x9d\x57\xc2\x0d\xac\xbc\x49\xca\x9c\xcc\xf1\x79\xb6\x45\x99\x16\x64\xb3\x9d\x77\xef\x31\x7c\x71"
+               "\xb8\x45\xb1\xe3\x0b\xd5\x09\x11\x20\x41\xd3\xa1\x97\x83", dk, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPBKDF2() test 1\n", __func__);
+
+    BRPBKDF2(dk, sizeof(dk), BRSHA256, 256/8, "Password", 8, "NaCl", 4, 80000);
+    if (memcmp("\x4d\xdc\xd8\xf6\x0b\x98\xbe\x21\x83\x0c\xee\x5e\xf2\x27\x01\xf9\x64\x1a\x44\x18\xd0\x4c\x04\x14\xae"
+               "\xff\x08\x87\x6b\x34\xab\x56\xa1\xd4\x25\xa1\x22\x58\x33\x54\x9a\xdb\x84\x1b\x51\xc9\xb3\x17\x6a\x27"
+               "\x2b\xde\xbb\xa1\xd0\x78\x47\x8f\x62\xb3\x97\xf3\x3c\x8d", dk, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPBKDF2() test 2\n", __func__);
+
+    // test batched pbkdf2 against single derivations, for every combination of sha-256 and of sha-512 backends
+
+    const void *pws[9];
+    size_t pwLens[9];
+    int backends = BRSHA256Backends(), backends512 = BRSHA512Backends();
+
+    for (size_t i = 0; i < 9; i++) pws[i] = d2, pwLens[i] = i*3;
+
+    for (int b = 0; b <= backends; b++) {
+        if (b & ~backends) continue;
+        BRSHA256SetBackends(b);
+        BRPBKDF2Batch(dks, 40, BRSHA256, 256/8, pws, pwLens, "NaCl", 4, 3, 9);
+
+        for (size_t i = 0; i < 9; i++) {
+            BRPBKDF2(dk, 40, BRSHA256, 256/8, pws[i], pwLens[i], "NaCl", 4, 3);
+            if (memcmp(&dks[i*40], dk, 40) != 0)
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRPBKDF2Batch() sha256 %x test %zu\n", __func__, b, i);
+        }
+    }
+
+    BRSHA256SetBackends(backends);
+
+    for (int b = 0; b <= backends512; b++) {
+        if (b & ~backends512) continue;
+        BRSHA512SetBackends(b);
+        BRPBKDF2Batch(dks, 64, BRSHA512, 512/8, pws, pwLens, "NaCl", 4, 3, 9);
+
+        for (size_t i = 0; i < 9; i++) {
+            BRPBKDF2(dk, 64, BRSHA512, 512/8, pws[i], pwLens[i], "NaCl", 4, 3);
+            if (memcmp(&dks[i*64], dk, 64) != 0)
+                r = 0, fprintf(stderr, "***FAILED*** %s: BRPBKDF2Batch() sha512 %x test %zu\n", __func__, b, i);
+        }
+    }
+
+    BRSHA512SetBackends(backends512);
     
     // test poly1305
 
@@ -1769,6 +1853,45 @@ int BRKeyTests()
     if (pkLen5 != pkLen || memcmp(pubKey, pubKey5, pkLen) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRPubKeyRecover() test 3\n", __func__);
     
+    // batch verification and pubkey recovery
+    BRKey bkeys[4], *bkeyRefs[6], rkeys[6];
+    UInt256 bmds[6];
+    uint8_t bsigs[6][72], csigs[6][65];
+    const void *bsigRefs[6], *csigRefs[6];
+    size_t bsigLens[6];
+    int bresults[6];
+
+    for (size_t i = 0; i < 4; i++) {
+        UInt256 secret = UINT256_ZERO;
+
+        secret.u8[31] = (uint8_t) (i + 1);
+        BRKeySetSecret(&bkeys[i], &secret, (i % 2 == 0));
+    }
+
+    for (size_t i = 0; i < 6; i++) {
+        bkeyRefs[i] = &bkeys[i / 2 + i % 2]; // consecutive signatures share keys
+        BRSHA256(&bmds[i], &i, sizeof(i));
+        bsigLens[i] = BRKeySign(bkeyRefs[i], bsigs[i], sizeof(bsigs[i]), bmds[i]);
+        bsigRefs[i] = bsigs[i];
+        BRKeyCompactSign(bkeyRefs[i], csigs[i], sizeof(csigs[i]), bmds[i]);
+        csigRefs[i] = csigs[i];
+    }
+
+    bsigs[3][bsigLens[3] - 1] ^= 0x01; // corrupt a signature
+    bsigLens[5] = 0; // and an empty one
+
+    if (BRKeyVerifyBatch(bkeyRefs, bmds, bsigRefs, bsigLens, 6, bresults, 3) != 4 ||
+        ! bresults[0] || ! bresults[1] || ! bresults[2] || bresults[3] || ! bresults[4] || bresults[5])
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyVerifyBatch() test 1\n", __func__);
+
+    if (BRKeyRecoverPubKeyBatch(rkeys, bmds, csigRefs, 6, bresults, 2) != 6)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyBatch() test 1\n", __func__);
+
+    for (size_t i = 0; i < 6; i++) {
+        if (! bresults[i] || ! BRKeyPubKeyMatch(&rkeys[i], bkeyRefs[i]) || rkeys[i].compressed != bkeyRefs[i]->compressed)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRKeyRecoverPubKeyBatch() test 2\n", __func__);
+    }
+
     // paper wallet key pair
     BRKeyGenerateRandom (&key, 1);
     
@@ -1789,9 +1912,37 @@ int BRBIP38KeyTests()
     int r = 1;
     BRKey key;
     char privKey[55], bip38Key[61];
+    uint8_t dk[64], dks[64*5];
     
     printf("\n");
 
+    // test scrypt: https://tools.ietf.org/html/rfc7914#section-12
+    BRScrypt(dk, sizeof(dk), "", 0, "", 0, 16, 1, 1);
+    if (memcmp("\x77\xd6\x57\x62\x38\x65\x7b\x20\x3b\x19\xca\x42\xc1\x8a\x04\x97\xf1\x6b\x48\x44\xe3\x07\x4a\xe8\xdf"
+               "\xdf\xfa\x3f\xed\xe2\x14\x42\xfc\xd0\x06\x9d\xed\x09\x48\xf8\x32\x6a\x75\x3a\x0f\xc8\x1f\x17\xe8\xd3"
+               "\xe0\xfb\x2e\x0d\x36\x28\xcf\x35\xe2\x0c\x38\xd1\x89\x06", dk, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRScrypt() test 1\n", __func__);
+
+    BRScrypt(dk, sizeof(dk), "password", 8, "NaCl", 4, 1024, 8, 16);
+    if (memcmp("\xfd\xba\xbe\x1c\x9d\x34\x72\x00\x78\x56\xe7\x19\x0d\x01\xe9\xfe\x7c\x6a\xd7\xcb\xc8\x23\x78\x30\xe7"
+               "\x73\x76\x63\x4b\x37\x31\x62\x2e\xaf\x30\xd9\x2e\x22\xa3\x88\x6f\xf1\x09\x27\x9d\x98\x30\xda\xc7\x27"
+               "\xaf\xb9\x4a\x83\xee\x6d\x83\x60\xcb\xdf\xa2\xcc\x06\x40", dk, 64) != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRScrypt() test 2\n", __func__);
+
+    // test batched scrypt, with the mixes split unevenly across threads, against single derivations
+    const char *pws[] = { "", "password", "pleaseletmein", "TestingOneTwoThree", "Satoshi" };
+    const void *pwPtrs[5], *salts[5];
+    size_t pwLens[5], saltLens[5];
+
+    for (size_t i = 0; i < 5; i++) pwPtrs[i] = pws[i], pwLens[i] = strlen(pws[i]), salts[i] = "NaCl", saltLens[i] = i;
+    BRScryptBatch(dks, 64, pwPtrs, pwLens, salts, saltLens, 64, 2, 3, 5, 4);
+
+    for (size_t i = 0; i < 5; i++) {
+        BRScrypt(dk, sizeof(dk), pwPtrs[i], pwLens[i], salts[i], saltLens[i], 64, 2, 3);
+        if (memcmp(&dks[i*64], dk, 64) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRScryptBatch() test %zu\n", __func__, i);
+    }
+
     // non EC multiplied, uncompressed
     if (! BRKeySetPrivKey(&key, BRMainNetParams->addrParams, "5KN7MzqK5wt2TP1fQCYyHBtDrXdJuXbUzm4A9rKAteGu3Qi5CVR") ||
         ! BRKeyBIP38Key(&key, bip38Key, sizeof(bip38Key), "TestingOneTwoThree", BRMainNetParams->addrParams) ||
@@ -2134,6 +2285,17 @@ int BRBIP39MnemonicTests()
                     "\xf4\x76\xc4\x5c\x88\x25\x32\x76\xd9\xfd\x0d\xf6\xef\x48\x60\x9e\x8b\xb7\xdc\xa8"))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39DeriveKey() test 8\n", __func__);
 
+    const char *phrases[] = { phrase, phrase2, phrase3, phrase4, phrase5, phrase6, phrase7, phrase8 };
+    UInt512 keys[8];
+
+    BRBIP39DeriveKeys(keys, phrases, "TREZOR", 8);
+
+    for (size_t i = 0; i < 8; i++) {
+        BRBIP39DeriveKey(key.u8, phrases[i], "TREZOR");
+        if (! UInt512Eq(key, keys[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP39DeriveKeys() test %zu\n", __func__, i + 1);
+    }
+
     return r;
 }
 
@@ -2177,6 +2339,17 @@ int BRBIP32SequenceTests()
                     uint256("7b6a7dd645507d775215a9035be06700e1ed8c541da9351b4bd14bd50ab61428")))
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKey() test\n", __func__);
 
+    BRECPoint pubKeys[8];
+
+    if (BRBIP32PubKeyRange(pubKeys, mpk, SEQUENCE_INTERNAL_CHAIN, 3, 8) != 8)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() test 1\n", __func__);
+
+    for (uint32_t i = 0; i < 8; i++) {
+        BRBIP32PubKey(pubKey, sizeof(pubKey), mpk, SEQUENCE_INTERNAL_CHAIN, 3 + i);
+        if (memcmp(pubKey, &pubKeys[i], sizeof(pubKey)) != 0)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRBIP32PubKeyRange() test 2\n", __func__);
+    }
+
     UInt512 dk;
     BRAddress addr;
 
@@ -2253,6 +2426,94 @@ static int BRTransactionEqual (BRTransaction *tx1, BRTransaction *tx2) {
     return 1;
 }
 
+#define TX_TEST_SIGHASH_ALL    0x01
+#define TX_TEST_SIGHASH_FORKID 0x40
+
+// the hash signed for the tx input at index, built from scratch as specified, to check BRTransactionSign() against: by
+// BIP143 for segwit inputs and fork id signatures, otherwise by serializing tx with only that input's scriptSig set
+static UInt256 _txTestSigHash(const BRTransaction *tx, size_t index, int hashType)
+{
+    const BRTxInput *input = &tx->inputs[index];
+    uint8_t prevouts[(sizeof(UInt256) + sizeof(uint32_t))*tx->inCount], sequences[sizeof(uint32_t)*tx->inCount],
+            outputs[0x10000], data[0x200], *buf;
+    size_t off = 0, outputsLen = 0, bufLen;
+    UInt256 md;
+
+    assert(input->scriptLen < 0x100);
+
+    int witness = (input->scriptLen == 22 && input->script[0] == OP_0 && input->script[1] == 20);
+
+    if (witness || (hashType & TX_TEST_SIGHASH_FORKID)) {
+        for (size_t i = 0; i < tx->inCount; i++) {
+            memcpy(&prevouts[(sizeof(UInt256) + sizeof(uint32_t))*i], &tx->inputs[i].txHash, sizeof(UInt256));
+            UInt32SetLE(&prevouts[(sizeof(UInt256) + sizeof(uint32_t))*i + sizeof(UInt256)], tx->inputs[i].index);
+            UInt32SetLE(&sequences[sizeof(uint32_t)*i], tx->inputs[i].sequence);
+        }
+
+        for (size_t i = 0; i < tx->outCount; i++) {
+            UInt64SetLE(&outputs[outputsLen], tx->outputs[i].amount);
+            outputsLen += sizeof(uint64_t);
+            outputsLen += BRVarIntSet(&outputs[outputsLen], sizeof(outputs) - outputsLen, tx->outputs[i].scriptLen);
+            memcpy(&outputs[outputsLen], tx->outputs[i].script, tx->outputs[i].scriptLen);
+            outputsLen += tx->outputs[i].scriptLen;
+        }
+
+        UInt32SetLE(&data[off], tx->version);
+        off += sizeof(uint32_t);
+        BRSHA256_2(&data[off], prevouts, sizeof(prevouts));
+        off += sizeof(UInt256);
+        BRSHA256_2(&data[off], sequences, sizeof(sequences));
+        off += sizeof(UInt256);
+        memcpy(&data[off], &input->txHash, sizeof(UInt256));
+        off += sizeof(UInt256);
+        UInt32SetLE(&data[off], input->index);
+        off += sizeof(uint32_t);
+
+        if (witness) { // P2WPKH scriptCode is the P2PKH script of its hash
+            memcpy(&data[off], "\x19\x76\xa9\x14", 4);
+            memcpy(&data[off + 4], &input->script[2], 20);
+            memcpy(&data[off + 24], "\x88\xac", 2);
+            off += 26;
+        }
+        else {
+            data[off++] = (uint8_t)input->scriptLen;
+            memcpy(&data[off], input->script, input->scriptLen);
+            off += input->scriptLen;
+        }
+
+        UInt64SetLE(&data[off], input->amount);
+        off += sizeof(uint64_t);
+        UInt32SetLE(&data[off], input->sequence);
+        off += sizeof(uint32_t);
+        BRSHA256_2(&data[off], outputs, outputsLen);
+        off += sizeof(UInt256);
+        UInt32SetLE(&data[off], tx->lockTime);
+        off += sizeof(uint32_t);
+        UInt32SetLE(&data[off], (uint32_t)hashType);
+        off += sizeof(uint32_t);
+        BRSHA256_2(&md, data, off);
+    }
+    else {
+        BRTransaction *t = BRTransactionCopy(tx);
+
+        for (size_t i = 0; i < t->inCount; i++) {
+            if (i == index) BRTxInputSetSignature(&t->inputs[i], input->script, input->scriptLen);
+            else BRTxInputSetSignature(&t->inputs[i], data, 0); // empty, rather than NULL for the unsigned script
+            BRTxInputSetWitness(&t->inputs[i], NULL, 0);
+        }
+
+        bufLen = BRTransactionSerialize(t, NULL, 0) + sizeof(uint32_t);
+        buf = malloc(bufLen);
+        BRTransactionSerialize(t, buf, bufLen);
+        UInt32SetLE(&buf[bufLen - sizeof(uint32_t)], (uint32_t)hashType);
+        BRSHA256_2(&md, buf, bufLen);
+        free(buf);
+        BRTransactionFree(t);
+    }
+
+    return md;
+}
+
 int BRTransactionTests()
 {
     int r = 1;
@@ -2397,6 +2658,31 @@ int BRTransactionTests()
     if (len6 != len7 || memcmp(buf6, buf7, len6) != 0)
         r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSerialize() test 3", __func__);
     BRTransactionFree(tx);
+
+    tx = BRTransactionNew(); // parallel signing must match serial signing exactly
+    for (size_t i = 0; i < 64; i++) {
+        UInt256 h = inHash;
+        
+        h.u8[0] = (uint8_t)i;
+        if (i % 3 == 1) BRTransactionAddInput(tx, h, 0, 1, wscript, wscriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        else BRTransactionAddInput(tx, h, (uint32_t)i, 1, script, scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    }
+    BRTransactionAddOutput(tx, 1000000, script, scriptLen);
+    BRTransactionAddOutput(tx, 1000000, wscript, wscriptLen);
+    
+    BRTransaction *ptx = BRTransactionCopy(tx);
+    
+    BRTransactionSign(tx, 0, k, 2);
+    BRTransactionSignParallel(ptx, 0, k, 2, 4);
+    
+    uint8_t sbuf[BRTransactionSerialize(tx, NULL, 0)], pbuf[BRTransactionSerialize(ptx, NULL, 0)];
+    size_t slen = BRTransactionSerialize(tx, sbuf, sizeof(sbuf)), plen = BRTransactionSerialize(ptx, pbuf, sizeof(pbuf));
+    
+    if (! BRTransactionIsSigned(ptx) || slen != plen || memcmp(sbuf, pbuf, slen) != 0 ||
+        ! UInt256Eq(tx->txHash, ptx->txHash) || ! UInt256Eq(tx->wtxHash, ptx->wtxHash))
+        r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSignParallel() test", __func__);
+    BRTransactionFree(ptx);
+    BRTransactionFree(tx);
     
     tx = BRTransactionNew();
     BRTransactionAddInput(tx, uint256("fff7f7881a8099afa6940d42d1e7f6362bec38171ea3edf433541db4e4ad969f"), 0, 625000000,
@@ -2513,6 +2799,96 @@ int BRTransactionTests()
     BRTransactionFree(txCoinbase);
     BRTransactionFree(txCoinbaseCopy);
 
+    // signatures, txHash and wtxHash against ones made from scratch, for random mixes of P2PKH, P2WPKH and P2PK signed
+    // inputs, with and without a fork id - signatures are deterministic, so each must match one of the scratch hash
+    UInt256 secrets[3] = { uint256("0000000000000000000000000000000000000000000000000000000000000001"),
+                           uint256("fffffffffffffffffffffffffffffffebaaedce6af48a03bbfd25e8cd0364140"),
+                           uint256("619c335025c7f4012e556c2a58b2506e30b8511b53ade95ea316fd8c3286feb9") };
+    BRKey keys[3];
+    uint32_t seed = 1;
+
+    for (size_t i = 0; i < 3; i++) BRKeySetSecret(&keys[i], &secrets[i], 1);
+
+    for (int forkId = 0; forkId <= 0x40; forkId += 0x40) {
+        for (int n = 0; n < 8; n++) {
+            size_t inCount = 1 + n*3, types[inCount], keyIdx[inCount];
+
+            tx = BRTransactionNew();
+
+            for (size_t i = 0; i < inCount; i++) {
+                uint8_t s[25];
+                size_t sLen = 0;
+
+                seed = seed*1103515245 + 12345; // the same pseudo-random mix on every run
+                types[i] = (seed >> 16) % 3, keyIdx[i] = (seed >> 20) % 3;
+
+                if (types[i] == 2) { // a script hash matching the key, which is signed with a pay-to-pubkey scriptSig
+                    UInt160 hash = BRKeyHash160(&keys[keyIdx[i]]);
+
+                    s[sLen++] = OP_HASH160, s[sLen++] = 20;
+                    memcpy(&s[sLen], hash.u8, sizeof(hash));
+                    sLen += sizeof(hash);
+                    s[sLen++] = OP_EQUAL;
+                }
+                else {
+                    BRKey *key = &keys[keyIdx[i]];
+
+                    if (types[i] == 1) BRKeyAddress(key, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+                    else BRKeyLegacyAddr(key, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+                    sLen = BRAddressScriptPubKey(s, sizeof(s), BRMainNetParams->addrParams, addr.s);
+                }
+
+                UInt32SetLE(inHash.u8, seed);
+                BRTransactionAddInput(tx, inHash, (uint32_t)i, 1000 + seed % 100000, s, sLen, NULL, 0, NULL, 0,
+                                      TXIN_SEQUENCE - (seed & 1));
+            }
+
+            BRTransactionAddOutput(tx, 100000 + seed % 1000, script, scriptLen);
+            if (n & 1) BRTransactionAddOutput(tx, 200000, tx->inputs[0].script, tx->inputs[0].scriptLen);
+            tx->lockTime = (uint32_t)n;
+
+            BRTransaction *ref = BRTransactionCopy(tx);
+
+            if (! BRTransactionSign(tx, forkId, keys, 3))
+                r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSign() equivalence test %x %d", __func__,
+                               forkId, n);
+
+            for (size_t i = 0; i < inCount && i < tx->inCount; i++) {
+                const BRTxInput *in = &tx->inputs[i];
+                const uint8_t *elems[2], *sig = NULL;
+                uint8_t expected[73];
+                size_t sigLen = 0, expectedLen;
+                UInt256 md = _txTestSigHash(ref, i, forkId | TX_TEST_SIGHASH_ALL);
+
+                // the signature is the first push of the witness for P2WPKH, and of the scriptSig otherwise
+                if (types[i] == 1 && BRScriptElements(elems, 2, in->witness, in->witLen) == 2)
+                    sig = BRScriptData(elems[0], &sigLen);
+                else if (types[i] != 1 && BRScriptElements(elems, 2, in->signature, in->sigLen) >= 1)
+                    sig = BRScriptData(elems[0], &sigLen);
+
+                expectedLen = BRKeySign(&keys[keyIdx[i]], expected, sizeof(expected) - 1, md);
+                expected[expectedLen++] = forkId | TX_TEST_SIGHASH_ALL;
+
+                if (! sig || sigLen != expectedLen || memcmp(sig, expected, sigLen) != 0)
+                    r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSign() equivalence test %x %d %zu",
+                                   __func__, forkId, n, i);
+            }
+
+            // txHash and wtxHash as the parser computes them from the serialization
+            uint8_t buf[BRTransactionSerialize(tx, NULL, 0)];
+            size_t len = BRTransactionSerialize(tx, buf, sizeof(buf));
+            BRTransaction *parsed = BRTransactionParse(buf, len);
+
+            if (! parsed || ! UInt256Eq(parsed->txHash, tx->txHash) || ! UInt256Eq(parsed->wtxHash, tx->wtxHash))
+                r = 0, fprintf(stderr, "\n***FAILED*** %s: BRTransactionSign() equivalence hash test %x %d", __func__,
+                               forkId, n);
+
+            if (parsed) BRTransactionFree(parsed);
+            BRTransactionFree(ref);
+            BRTransactionFree(tx);
+        }
+    }
+
     if (! r) fprintf(stderr, "\n                                    ");
     return r;
 }
@@ -2723,6 +3099,590 @@ int BRWalletTests()
     return r;
 }
 
+// compares the balance state of two wallets holding the same transactions
+// wallet transactions must be sorted by blockHeight, with each tx after any tx in the same block that it spends
+static int _BRWalletTxOrderValid(BRWallet *wallet)
+{
+    size_t txCount = BRWalletTransactions(wallet, NULL, 0);
+    BRTransaction *txs[txCount];
+
+    BRWalletTransactions(wallet, txs, txCount);
+
+    for (size_t i = 1; i < txCount; i++) {
+        if (txs[i - 1]->blockHeight > txs[i]->blockHeight) return 0;
+    }
+
+    for (size_t i = 0; i < txCount; i++) {
+        for (size_t j = i + 1; j < txCount && txs[j]->blockHeight == txs[i]->blockHeight; j++) {
+            for (size_t k = 0; k < txs[i]->inCount; k++) {
+                if (UInt256Eq(txs[i]->inputs[k].txHash, txs[j]->txHash)) return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+static int _BRWalletBalanceStateEqual(BRWallet *w1, BRWallet *w2)
+{
+    size_t txCount = BRWalletTransactions(w1, NULL, 0), utxoCount = BRWalletUTXOs(w1, NULL, 0);
+    BRTransaction *txs1[txCount], *txs2[txCount];
+    BRUTXO utxos1[utxoCount], utxos2[utxoCount];
+
+    if (BRWalletBalance(w1) != BRWalletBalance(w2) ||
+        BRWalletTotalSent(w1) != BRWalletTotalSent(w2) ||
+        BRWalletTotalReceived(w1) != BRWalletTotalReceived(w2) ||
+        BRWalletTransactions(w2, NULL, 0) != txCount ||
+        BRWalletUTXOs(w2, NULL, 0) != utxoCount ||
+        ! _BRWalletTxOrderValid(w1)) return 0;
+
+    BRWalletTransactions(w1, txs1, txCount);
+    BRWalletTransactions(w2, txs2, txCount);
+    BRWalletUTXOs(w1, utxos1, utxoCount);
+    BRWalletUTXOs(w2, utxos2, utxoCount);
+
+    for (size_t i = 0; i < utxoCount; i++) {
+        if (! BRUTXOEq(&utxos1[i], &utxos2[i])) return 0;
+    }
+
+    for (size_t i = 0; i < txCount; i++) {
+        if (! UInt256Eq(txs1[i]->txHash, txs2[i]->txHash) ||
+            BRWalletBalanceAfterTx(w1, txs1[i]) != BRWalletBalanceAfterTx(w2, txs2[i]) ||
+            BRWalletTransactionIsValid(w1, txs1[i]) != BRWalletTransactionIsValid(w2, txs2[i])) return 0;
+    }
+
+    return 1;
+}
+
+// differential test: a wallet using incremental balance updates must always match one that recomputes from scratch
+int BRWalletIncrementalBalanceTests()
+{
+    int r = 1;
+    const char *phrase = "a random seed";
+    const size_t fundCount = 40, spendCount = 40;
+    UInt512 seed;
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    uint32_t lcg = 1234567;
+    BRKey k;
+    BRAddress addr, extAddrs[10], intAddrs[10];
+    BRTransaction *txs[fundCount + spendCount + 2], *tx;
+    size_t txCount = 0;
+
+    BRBIP39DeriveKey(&seed, phrase, NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRWallet *w = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRKeyAddress(&k, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+    BRWalletUnusedAddrs(w, extAddrs, 10, SEQUENCE_EXTERNAL_CHAIN);
+    BRWalletUnusedAddrs(w, intAddrs, 10, SEQUENCE_INTERNAL_CHAIN);
+
+    uint8_t inScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, addr.s)];
+    size_t inScriptLen = BRAddressScriptPubKey(inScript, sizeof(inScript), BRMainNetParams->addrParams, addr.s);
+
+    // funding transactions from a foreign address to the wallet's receive addresses
+    for (size_t i = 0; i < fundCount; i++) {
+        UInt256 inHash = UINT256_ZERO;
+        BRAddress *to = &extAddrs[i % 10];
+        uint8_t outScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, to->s)];
+        size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), BRMainNetParams->addrParams, to->s);
+
+        inHash.u32[0] = (uint32_t)i + 1;
+        tx = BRTransactionNew();
+        BRTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0,
+                              (i == 4) ? TXIN_SEQUENCE - 1 : TXIN_SEQUENCE);
+        BRTransactionAddOutput(tx, SATOSHIS/100*(1 + i % 7), outScript, outScriptLen);
+        if (i == 4) tx->lockTime = 120; // pending until the wallet reaches block 119
+        BRTransactionSign(tx, 0, &k, 1);
+        tx->blockHeight = (i % 5 == 4) ? TX_UNCONFIRMED : (uint32_t)(100 + i/2);
+        tx->timestamp = (tx->blockHeight == TX_UNCONFIRMED) ? 0 : 1;
+        txs[txCount++] = tx;
+    }
+
+    // spends of earlier wallet outputs, to a foreign address with change back to the wallet
+    for (size_t i = 0; i < spendCount; i++) {
+        BRTransaction *prev = txs[i];
+        BRAddress *change = &intAddrs[i % 10];
+        uint8_t outScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, change->s)];
+        size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), BRMainNetParams->addrParams,
+                                                    change->s);
+
+        tx = BRTransactionNew();
+        BRTransactionAddInput(tx, prev->txHash, 0, prev->outputs[0].amount, prev->outputs[0].script,
+                              prev->outputs[0].scriptLen, NULL, 0, NULL, 0,
+                              (i % 9 == 8) ? TXIN_SEQUENCE - 2 : TXIN_SEQUENCE); // some replace-by-fee (pending)
+        BRTransactionAddOutput(tx, prev->outputs[0].amount/2, inScript, inScriptLen);
+        if (i % 3 != 0) BRTransactionAddOutput(tx, prev->outputs[0].amount/4, outScript, outScriptLen);
+        BRWalletSignTransaction(w, tx, 0x00, &seed, sizeof(seed));
+        tx->blockHeight = (prev->blockHeight == TX_UNCONFIRMED || i % 4 == 3) ? TX_UNCONFIRMED :
+                          prev->blockHeight + (uint32_t)(i % 3);
+        tx->timestamp = (tx->blockHeight == TX_UNCONFIRMED) ? 0 : 1;
+        txs[txCount++] = tx;
+    }
+
+    // an unconfirmed double spend of an already spent output (invalid), and one that spends the invalid tx
+    tx = BRTransactionNew();
+    BRTransactionAddInput(tx, txs[0]->txHash, 0, txs[0]->outputs[0].amount, txs[0]->outputs[0].script,
+                          txs[0]->outputs[0].scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, txs[0]->outputs[0].amount/3, txs[fundCount + 1]->outputs[1].script,
+                           txs[fundCount + 1]->outputs[1].scriptLen);
+    BRWalletSignTransaction(w, tx, 0x00, &seed, sizeof(seed));
+    txs[txCount++] = tx;
+
+    tx = BRTransactionNew();
+    BRTransactionAddInput(tx, txs[txCount - 1]->txHash, 0, txs[txCount - 1]->outputs[0].amount,
+                          txs[txCount - 1]->outputs[0].script, txs[txCount - 1]->outputs[0].scriptLen,
+                          NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, txs[txCount - 1]->outputs[0].amount/2, inScript, inScriptLen);
+    BRWalletSignTransaction(w, tx, 0x00, &seed, sizeof(seed));
+    txs[txCount++] = tx;
+    BRWalletFree(w);
+
+    BRWallet *wi = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk),
+             *wf = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    BRWalletSetIncrementalBalance(wf, 0);
+
+    for (size_t i = txCount; i > 1; i--) { // shuffle registration order
+        size_t j = (lcg = lcg*1103515245 + 12345) % i;
+
+        tx = txs[i - 1], txs[i - 1] = txs[j], txs[j] = tx;
+    }
+
+    for (size_t i = 0; i < txCount; i++) {
+        BRWalletRegisterTransaction(wi, txs[i]);
+        BRWalletRegisterTransaction(wf, BRTransactionCopy(txs[i]));
+
+        if (! _BRWalletBalanceStateEqual(wi, wf))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test %zu\n", __func__, i);
+    }
+
+    BRTransaction *copies[txCount];
+    BRWallet *wb = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    for (size_t i = 0; i < txCount; i++) copies[i] = BRTransactionCopy(txs[i]);
+
+    if (BRWalletRegisterTransactions(wb, copies, txCount) != txCount || ! _BRWalletBalanceStateEqual(wb, wf))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransactions() test\n", __func__);
+
+    BRWalletFree(wb);
+
+    for (size_t i = 0; i < txCount; i += 3) { // confirm, re-confirm at a different height, and unconfirm
+        uint32_t blockHeight = (txs[i]->blockHeight == TX_UNCONFIRMED) ? 150 : TX_UNCONFIRMED;
+
+        BRWalletUpdateTransactions(wi, &txs[i]->txHash, 1, blockHeight, 1);
+        BRWalletUpdateTransactions(wf, &txs[i]->txHash, 1, blockHeight, 1);
+
+        if (! _BRWalletBalanceStateEqual(wi, wf))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUpdateTransactions() test %zu\n", __func__, i);
+    }
+
+    BRWalletSetTxUnconfirmedAfter(wi, 110);
+    BRWalletSetTxUnconfirmedAfter(wf, 110);
+    if (! _BRWalletBalanceStateEqual(wi, wf))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletSetTxUnconfirmedAfter() test\n", __func__);
+
+    for (size_t i = 0; i < txCount; i += 7) {
+        BRWalletRemoveTransaction(wi, txs[i]->txHash);
+        BRWalletRemoveTransaction(wf, txs[i]->txHash);
+
+        if (! _BRWalletBalanceStateEqual(wi, wf))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRemoveTransaction() test %zu\n", __func__, i);
+    }
+
+    BRWalletFree(wi);
+    BRWalletFree(wf);
+    return r;
+}
+
+static int _BRAddressesEqual(const BRAddress addrs[], const BRAddress otherAddrs[], size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        if (! BRAddressEq(&addrs[i], &otherAddrs[i])) return 0;
+    }
+
+    return 1;
+}
+
+static int _BRWalletAllAddrsEqual(BRWallet *wallet, BRWallet *otherWallet)
+{
+    size_t count = BRWalletAllAddrs(wallet, NULL, 0);
+    BRAddress *addrs = calloc(count, sizeof(*addrs)), *otherAddrs = calloc(count, sizeof(*otherAddrs));
+    int r = (BRWalletAllAddrs(otherWallet, NULL, 0) == count);
+
+    BRWalletAllAddrs(wallet, addrs, count);
+    BRWalletAllAddrs(otherWallet, otherAddrs, count);
+    if (r) r = _BRAddressesEqual(addrs, otherAddrs, count);
+    free(addrs);
+    free(otherAddrs);
+    return r;
+}
+
+// returns a signed transaction from key's address to each of the given addresses
+static BRTransaction *_BRWalletDiscoveryTx(BRKey *key, uint32_t n, const BRAddress *extAddr, const BRAddress *intAddr)
+{
+    BRAddress addr;
+    UInt256 inHash = UINT256_ZERO;
+    BRTransaction *tx = BRTransactionNew();
+
+    BRKeyAddress(key, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+
+    uint8_t inScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, addr.s)];
+    size_t inScriptLen = BRAddressScriptPubKey(inScript, sizeof(inScript), BRMainNetParams->addrParams, addr.s);
+    uint8_t extScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, extAddr->s)];
+    size_t extScriptLen = BRAddressScriptPubKey(extScript, sizeof(extScript), BRMainNetParams->addrParams, extAddr->s);
+    uint8_t intScript[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, intAddr->s)];
+    size_t intScriptLen = BRAddressScriptPubKey(intScript, sizeof(intScript), BRMainNetParams->addrParams, intAddr->s);
+
+    inHash.u32[0] = n;
+    BRTransactionAddInput(tx, inHash, 0, 1, inScript, inScriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, SATOSHIS/100, extScript, extScriptLen);
+    BRTransactionAddOutput(tx, SATOSHIS/100, intScript, intScriptLen);
+    BRTransactionSign(tx, 0, key, 1);
+    tx->blockHeight = 100 + n;
+    tx->timestamp = 1;
+    return tx;
+}
+
+// addresses derived on several threads, directly or for account discovery, must match those derived serially
+int BRWalletDiscoveryTests()
+{
+    int r = 1;
+    const char *phrase = "a random seed";
+    const uint32_t extUsed[] = { 100, 200 }, intUsed[] = { 100, 200 }, gapLimit = 250;
+    UInt512 seed;
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRKey k;
+    BRAddress extAddrs[201], intAddrs[201], serialAddrs[gapLimit], parallelAddrs[gapLimit];
+    BRTransaction *tx;
+
+    BRBIP39DeriveKey(&seed, phrase, NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRWallet *w = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    BRKeySetSecret(&k, &secret, 1);
+    BRWalletUnusedAddrs(w, extAddrs, 201, SEQUENCE_EXTERNAL_CHAIN);
+    BRWalletUnusedAddrs(w, intAddrs, 201, SEQUENCE_INTERNAL_CHAIN);
+    BRWalletFree(w);
+
+    BRWallet *ws = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk),
+             *wp = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk),
+             *wd = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    // a transaction to a receive and a change address deep in the initial chains
+    tx = _BRWalletDiscoveryTx(&k, 1, &extAddrs[extUsed[0]], &intAddrs[intUsed[0]]);
+    BRWalletRegisterTransaction(ws, BRTransactionCopy(tx));
+    BRWalletRegisterTransaction(wp, BRTransactionCopy(tx));
+    BRWalletRegisterTransaction(wd, tx);
+
+    if (BRWalletBalance(ws) != 2*SATOSHIS/100 || BRWalletBalance(wp) != 2*SATOSHIS/100 ||
+        BRWalletBalance(wd) != 2*SATOSHIS/100)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test\n", __func__);
+
+    if (BRWalletUnusedAddrs(ws, serialAddrs, gapLimit, SEQUENCE_EXTERNAL_CHAIN) != gapLimit ||
+        BRWalletUnusedAddrsParallel(wp, parallelAddrs, gapLimit, SEQUENCE_EXTERNAL_CHAIN, 4) != gapLimit ||
+        ! _BRAddressesEqual(serialAddrs, parallelAddrs, gapLimit))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedAddrsParallel() external test\n", __func__);
+
+    if (BRWalletUnusedAddrs(ws, serialAddrs, gapLimit, SEQUENCE_INTERNAL_CHAIN) != gapLimit ||
+        BRWalletUnusedAddrsParallel(wp, parallelAddrs, gapLimit, SEQUENCE_INTERNAL_CHAIN, 4) != gapLimit ||
+        ! _BRAddressesEqual(serialAddrs, parallelAddrs, gapLimit))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedAddrsParallel() internal test\n", __func__);
+
+    if (! _BRWalletAllAddrsEqual(ws, wp))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletUnusedAddrsParallel() all addresses test\n", __func__);
+
+    // recovery rounds: each discovers a window past the last used addresses, which the next round's transaction uses
+    for (size_t i = 0; i < sizeof(extUsed)/sizeof(*extUsed); i++) {
+        if (i > 0) {
+            tx = _BRWalletDiscoveryTx(&k, (uint32_t)i + 1, &extAddrs[extUsed[i]], &intAddrs[intUsed[i]]);
+            BRWalletRegisterTransaction(ws, BRTransactionCopy(tx));
+            BRWalletRegisterTransaction(wd, tx);
+        }
+
+        // the window is the number of addresses up to and including the last used one
+        uint32_t extWindow = BRWalletDiscoverAddrs(wd, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN, 4),
+                 intWindow = BRWalletDiscoverAddrs(wd, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN, 4);
+
+        if (extWindow != extUsed[i] + 1 || intWindow != intUsed[i] + 1)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletDiscoverAddrs() window test %zu\n", __func__, i);
+
+        if (BRWalletUnusedAddrs(ws, serialAddrs, extWindow, SEQUENCE_EXTERNAL_CHAIN) != extWindow ||
+            BRWalletUnusedAddrs(wd, parallelAddrs, extWindow, SEQUENCE_EXTERNAL_CHAIN) != extWindow ||
+            ! _BRAddressesEqual(serialAddrs, parallelAddrs, extWindow))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletDiscoverAddrs() external test %zu\n", __func__, i);
+
+        if (BRWalletUnusedAddrs(ws, serialAddrs, intWindow, SEQUENCE_INTERNAL_CHAIN) != intWindow ||
+            BRWalletUnusedAddrs(wd, parallelAddrs, intWindow, SEQUENCE_INTERNAL_CHAIN) != intWindow ||
+            ! _BRAddressesEqual(serialAddrs, parallelAddrs, intWindow))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletDiscoverAddrs() internal test %zu\n", __func__, i);
+    }
+
+    // the last window reaches past the serial wallet's earlier chains, so both wallets have the same chains
+    if (! _BRWalletAllAddrsEqual(ws, wd))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletDiscoverAddrs() all addresses test\n", __func__);
+
+    BRWalletFree(ws);
+    BRWalletFree(wp);
+    BRWalletFree(wd);
+    return r;
+}
+
+// times sorting a wallet of txCount transactions forming a single chain, each spending both outputs of the last, with
+// 16 chained transactions per block and the last 64 unconfirmed: loaded all at once in random order (as from storage),
+// and then registered one by one in chain order (as during a sync)
+void BRRunPerfTestsWallet(size_t txCount)
+{
+    const char *phrase = "a random seed";
+    uint8_t sig[] = { 0x01, 0x00 }; // registration only checks that inputs are signed
+    UInt512 seed;
+    BRAddress addr;
+    BRTransaction **txs = calloc(txCount, sizeof(*txs)), **copies = calloc(txCount, sizeof(*copies)), *tx;
+    uint32_t lcg = 1234567;
+    clock_t start;
+
+    BRBIP39DeriveKey(&seed, phrase, NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRWallet *w = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+
+    BRWalletUnusedAddrs(w, &addr, 1, SEQUENCE_EXTERNAL_CHAIN);
+    BRWalletFree(w);
+
+    uint8_t script[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, addr.s)];
+    size_t scriptLen = BRAddressScriptPubKey(script, sizeof(script), BRMainNetParams->addrParams, addr.s);
+
+    for (size_t i = 0; i < txCount; i++) {
+        tx = BRTransactionNew();
+        BRTransactionAddInput(tx, (i > 0) ? txs[i - 1]->txHash : UINT256_ZERO, 0, SATOSHIS, script, scriptLen,
+                              sig, sizeof(sig), sig, 0, TXIN_SEQUENCE);
+        BRTransactionAddInput(tx, (i > 0) ? txs[i - 1]->txHash : UINT256_ZERO, 1, SATOSHIS, script, scriptLen,
+                              sig, sizeof(sig), sig, 0, TXIN_SEQUENCE);
+        BRTransactionAddOutput(tx, SATOSHIS, script, scriptLen);
+        BRTransactionAddOutput(tx, SATOSHIS, script, scriptLen);
+        tx->blockHeight = (i + 64 < txCount) ? 100 + (uint32_t)(i/16) : TX_UNCONFIRMED;
+        tx->timestamp = (tx->blockHeight == TX_UNCONFIRMED) ? 0 : 1;
+        BRTransactionSign(tx, 0, NULL, 0); // only computes txHash, since no keys are given
+        txs[i] = tx;
+        copies[i] = BRTransactionCopy(tx);
+    }
+
+    for (size_t i = txCount; i > 1; i--) { // shuffle storage order
+        size_t j = (lcg = lcg*1103515245 + 12345) % i;
+
+        tx = copies[i - 1], copies[i - 1] = copies[j], copies[j] = tx;
+    }
+
+    start = clock();
+    w = BRWalletNew(BRMainNetParams->addrParams, copies, txCount, mpk);
+    printf("BRWalletNew() x %zu: %.3fs\n", txCount, (double)(clock() - start)/CLOCKS_PER_SEC);
+    BRWalletFree(w);
+
+    w = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+    start = clock();
+    for (size_t i = 0; i < txCount; i++) BRWalletRegisterTransaction(w, txs[i]);
+    printf("BRWalletRegisterTransaction() x %zu: %.3fs\n", txCount, (double)(clock() - start)/CLOCKS_PER_SEC);
+
+    start = clock();
+    BRWalletSetTxUnconfirmedAfter(w, 100 + (uint32_t)(txCount/32));
+    printf("BRWalletSetTxUnconfirmedAfter(): %.3fs\n", (double)(clock() - start)/CLOCKS_PER_SEC);
+
+    BRWalletFree(w);
+    free(copies);
+    free(txs);
+}
+
+// a mock of the client's transactions query: returns in txs the transaction paying each queried address that is one
+// of the server's used addresses, and the number of them
+static size_t _BRMockGetTransactions(BRSet *used, const BRAddress usedAddrs[], BRTransaction *usedTxs[],
+                                     const BRAddress addrs[], size_t addrsCount, BRTransaction *txs[])
+{
+    size_t txsCount = 0;
+
+    for (size_t i = 0; i < addrsCount; i++) {
+        const BRAddress *addr = BRSetGet(used, &addrs[i]);
+        if (addr) txs[txsCount++] = BRTransactionCopy(usedTxs[addr - usedAddrs]);
+    }
+
+    return txsCount;
+}
+
+// restores a wallet with usedCount used receive addresses from a mock client, querying the wallet's not yet queried
+// addresses in each round, without and then with account discovery windows
+void BRRunPerfTestsWalletDiscovery(size_t usedCount)
+{
+    const char *phrase = "a random seed";
+    uint8_t sig[] = { 0x01, 0x00 }; // registration only checks that inputs are signed
+    UInt512 seed;
+    BRAddress *usedAddrs = calloc(usedCount, sizeof(*usedAddrs));
+    BRTransaction **usedTxs = calloc(usedCount, sizeof(*usedTxs));
+    BRECPoint *pubKeys = calloc(usedCount, sizeof(*pubKeys));
+    BRSet *used = BRSetNew(BRAddressHash, BRAddressEq, usedCount);
+    clock_t start;
+
+    BRBIP39DeriveKey(&seed, phrase, NULL);
+    BRMasterPubKey mpk = BRBIP32MasterPubKey(&seed, sizeof(seed));
+    BRBIP32PubKeyRange(pubKeys, mpk, SEQUENCE_EXTERNAL_CHAIN, 0, usedCount);
+
+    for (size_t i = 0; i < usedCount; i++) { // the server's history: one transaction paying each used address
+        UInt160 pkh;
+        UInt256 inHash = UINT256_ZERO;
+        BRTransaction *tx = BRTransactionNew();
+
+        BRHash160(&pkh, &pubKeys[i], sizeof(pubKeys[i]));
+        BRAddressFromHash160(usedAddrs[i].s, sizeof(usedAddrs[i]), BRMainNetParams->addrParams, &pkh);
+        BRSetAdd(used, &usedAddrs[i]);
+
+        uint8_t script[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, usedAddrs[i].s)];
+        size_t scriptLen = BRAddressScriptPubKey(script, sizeof(script), BRMainNetParams->addrParams, usedAddrs[i].s);
+
+        UInt32SetLE(inHash.u8, (uint32_t)i + 1);
+        BRTransactionAddInput(tx, inHash, 0, SATOSHIS, NULL, 0, sig, sizeof(sig), sig, 0, TXIN_SEQUENCE);
+        BRTransactionAddOutput(tx, SATOSHIS, script, scriptLen);
+        tx->blockHeight = 100 + (uint32_t)i;
+        tx->timestamp = 1;
+        BRTransactionSign(tx, 0, NULL, 0); // only computes txHash, since no keys are given
+        usedTxs[i] = tx;
+    }
+
+    for (int discover = 0; discover < 2; discover++) {
+        BRWallet *w = BRWalletNew(BRMainNetParams->addrParams, NULL, 0, mpk);
+        BRSet *queried = BRSetNew(BRAddressHash, BRAddressEq, 2*usedCount + 1000);
+        BRAddress **rounds = NULL;
+        size_t roundsCount = 0, queriedCount = 0;
+
+        start = clock();
+
+        while (1) {
+            if (discover) {
+                BRWalletDiscoverAddrs(w, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN, 4);
+                BRWalletDiscoverAddrs(w, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN, 4);
+            }
+
+            size_t addrsCount = BRWalletAllAddrs(w, NULL, 0), newCount = 0;
+            BRAddress *addrs = calloc(addrsCount, sizeof(*addrs));
+
+            BRWalletAllAddrs(w, addrs, addrsCount);
+
+            for (size_t i = 0; i < addrsCount; i++) { // query only the addresses not queried before
+                if (! BRSetContains(queried, &addrs[i])) addrs[newCount++] = addrs[i];
+            }
+
+            if (newCount == 0) {
+                free(addrs);
+                break;
+            }
+
+            rounds = realloc(rounds, (roundsCount + 1)*sizeof(*rounds));
+            rounds[roundsCount++] = addrs;
+            for (size_t i = 0; i < newCount; i++) BRSetAdd(queried, &addrs[i]);
+            queriedCount += newCount;
+
+            BRTransaction **txs = calloc(newCount, sizeof(*txs));
+            size_t txsCount = _BRMockGetTransactions(used, usedAddrs, usedTxs, addrs, newCount, txs);
+
+            BRWalletRegisterTransactions(w, txs, txsCount);
+            free(txs);
+        }
+
+        printf("%s x %zu used addresses: %zu queries, %zu addresses, %.3fs\n",
+               (discover ? "BRWalletDiscoverAddrs()" : "BRWalletUnusedAddrs()"), usedCount, roundsCount, queriedCount,
+               (double)(clock() - start)/CLOCKS_PER_SEC);
+        assert(BRWalletBalance(w) == usedCount*SATOSHIS);
+
+        while (roundsCount > 0) free(rounds[--roundsCount]);
+        free(rounds);
+        BRSetFree(queried);
+        BRWalletFree(w);
+    }
+
+    for (size_t i = 0; i < usedCount; i++) BRTransactionFree(usedTxs[i]);
+    BRSetFree(used);
+    free(pubKeys);
+    free(usedTxs);
+    free(usedAddrs);
+}
+
+void BRRunPerfTestsTransactionSign(size_t inCount)
+{
+    UInt256 secret = uint256("0000000000000000000000000000000000000000000000000000000000000001");
+    BRKey k;
+    BRAddress addr;
+    BRTransaction *tx;
+    clock_t start;
+
+    BRKeySetSecret(&k, &secret, 1);
+
+    for (int witness = 0; witness < 2; witness++) { // sweep legacy then segwit inputs into a single output
+        if (witness) BRKeyAddress(&k, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+        else BRKeyLegacyAddr(&k, addr.s, sizeof(addr), BRMainNetParams->addrParams);
+
+        uint8_t script[BRAddressScriptPubKey(NULL, 0, BRMainNetParams->addrParams, addr.s)];
+        size_t scriptLen = BRAddressScriptPubKey(script, sizeof(script), BRMainNetParams->addrParams, addr.s);
+        UInt256 inHash = UINT256_ZERO;
+
+        tx = BRTransactionNew();
+
+        for (size_t i = 0; i < inCount; i++) {
+            UInt32SetLE(inHash.u8, (uint32_t)i + 1);
+            BRTransactionAddInput(tx, inHash, 0, SATOSHIS, script, scriptLen, NULL, 0, NULL, 0, TXIN_SEQUENCE);
+        }
+
+        BRTransactionAddOutput(tx, SATOSHIS*inCount - SATOSHIS/10, script, scriptLen);
+        start = clock();
+        BRTransactionSign(tx, 0, &k, 1);
+        printf("BRTransactionSign() %s x %zu inputs: %.3fs\n", (witness ? "P2WPKH" : "P2PKH"), inCount,
+               (double)(clock() - start)/CLOCKS_PER_SEC);
+        if (! BRTransactionIsSigned(tx)) fprintf(stderr, "***FAILED*** %s: BRTransactionSign()\n", __func__);
+        BRTransactionFree(tx);
+    }
+}
+
+void BRRunPerfTestsHeaders(size_t count)
+{
+    char headers[] = // main chain blocks 0 and 1 as serialized in a headers message
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x3b\xa3\xed\xfd\x7a\x7b\x12\xb2\x7a\xc7\x2c\x3e\x67\x76"
+    "\x8f\x61\x7f\xc8\x1b\xc3\x88\x8a\x51\x32\x3a\x9f\xb8\xaa\x4b\x1e\x5e\x4a\x29\xab\x5f\x49\xff\xff\x00"
+    "\x1d\x1d\xac\x2b\x7c\x00"
+    "\x01\x00\x00\x00\x6f\xe2\x8c\x0a\xb6\xf1\xb3\x72\xc1\xa6\xa2\x46\xae\x63\xf7\x4f\x93\x1e\x83\x65\xe1"
+    "\x5a\x08\x9c\x68\xd6\x19\x00\x00\x00\x00\x00\x98\x20\x51\xfd\x1e\x4b\xa7\x44\xbb\xbe\x68\x0e\x1f\xee"
+    "\x14\x67\x7b\xa1\xa3\xc3\x54\x0b\xf7\xb1\xcd\xb6\x06\xe8\x57\x23\x3e\x0e\x61\xbc\x66\x49\xff\xff\x00"
+    "\x1d\x01\xe3\x62\x99\x00";
+    uint8_t *stream = malloc(81*count);
+    BRMerkleBlock **blocks = malloc(count*sizeof(*blocks));
+    int *valid = malloc(count*sizeof(*valid));
+    uint32_t now = (uint32_t)time(NULL);
+    struct timeval start, end;
+    size_t i, n, validCount;
+    double elapsed;
+
+    for (i = 0; i < count; i++) memcpy(&stream[81*i], &headers[81*(i % 2)], 81);
+
+    for (size_t threadCount = 1; threadCount <= 4; threadCount *= 2) {
+        validCount = 0;
+        gettimeofday(&start, NULL);
+
+        for (i = 0; i < count; i += n) { // replay the stream as headers messages of up to 2000 headers each
+            n = (count - i < 2000) ? count - i : 2000;
+            validCount += BRMerkleBlockParseBatch(&blocks[i], &valid[i], &stream[81*i], 81, n, now, threadCount);
+        }
+
+        gettimeofday(&end, NULL);
+        elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec)/1000000.0;
+        printf("BRMerkleBlockParseBatch() x %zu headers, %zu thread(s): %.3fs, %.0f headers/s\n", count, threadCount,
+               elapsed, (elapsed > 0) ? count/elapsed : 0.0);
+        if (validCount != count) fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseBatch()\n", __func__);
+
+        for (i = 0; i < count; i++) {
+            if (blocks[i]) BRMerkleBlockFree(blocks[i]);
+        }
+    }
+
+    free(valid);
+    free(blocks);
+    free(stream);
+}
+
 int BRBloomFilterTests()
 {
     int r = 1;
@@ -2794,6 +3754,31 @@ int BRBloomFilterTests()
     if (len2 != sizeof(d2) - 1 || memcmp(buf2, d2, len2) != 0)
         r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterSerialize() test 2\n", __func__);
     
+    BRBloomFilterFree(f);
+    f = BRBloomFilterNew(0.001, 1000, 0, BLOOM_UPDATE_ALL);
+
+    if (BRBloomFilterFalsePositiveRate(f) != 0.0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterFalsePositiveRate() test 1\n", __func__);
+
+    uint32_t n, fpCount = 0;
+    double fpRate;
+
+    for (n = 0; n < 1000; n++) BRBloomFilterInsertData(f, (uint8_t *)&n, sizeof(n));
+    fpRate = BRBloomFilterFalsePositiveRate(f);
+    
+    if (fpRate < 0.0005 || fpRate > 0.002)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterFalsePositiveRate() test 2\n", __func__);
+
+    for (n = 1000; n < 101000; n++) if (BRBloomFilterContainsData(f, (uint8_t *)&n, sizeof(n))) fpCount++;
+    
+    if (fpCount < fpRate*100000/3 || fpCount > fpRate*100000*3) // observed rate should be close to expected
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterFalsePositiveRate() test 3\n", __func__);
+    
+    for (n = 101000; n < 102000; n++) BRBloomFilterInsertData(f, (uint8_t *)&n, sizeof(n));
+
+    if (BRBloomFilterFalsePositiveRate(f) <= fpRate) // more elements than the filter was sized for
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRBloomFilterFalsePositiveRate() test 4\n", __func__);
+
     BRBloomFilterFree(f);
     return r;
 }
@@ -2887,6 +3872,39 @@ int BRMerkleBlockTests()
 
     if (c) BRMerkleBlockFree(c);
 
+    char headers[] = // main chain blocks 0 and 1 as serialized in a headers message
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x3b\xa3\xed\xfd\x7a\x7b\x12\xb2\x7a\xc7\x2c\x3e\x67\x76"
+    "\x8f\x61\x7f\xc8\x1b\xc3\x88\x8a\x51\x32\x3a\x9f\xb8\xaa\x4b\x1e\x5e\x4a\x29\xab\x5f\x49\xff\xff\x00"
+    "\x1d\x1d\xac\x2b\x7c\x00"
+    "\x01\x00\x00\x00\x6f\xe2\x8c\x0a\xb6\xf1\xb3\x72\xc1\xa6\xa2\x46\xae\x63\xf7\x4f\x93\x1e\x83\x65\xe1"
+    "\x5a\x08\x9c\x68\xd6\x19\x00\x00\x00\x00\x00\x98\x20\x51\xfd\x1e\x4b\xa7\x44\xbb\xbe\x68\x0e\x1f\xee"
+    "\x14\x67\x7b\xa1\xa3\xc3\x54\x0b\xf7\xb1\xcd\xb6\x06\xe8\x57\x23\x3e\x0e\x61\xbc\x66\x49\xff\xff\x00"
+    "\x1d\x01\xe3\x62\x99\x00";
+    uint8_t stream[81*1000];
+    BRMerkleBlock *blocks[1000];
+    int valid[1000], batchCount = 0;
+    uint32_t now = (uint32_t)time(NULL);
+
+    for (size_t i = 0; i < 1000; i++) {
+        memcpy(&stream[81*i], &headers[81*(i % 2)], 81);
+        if (i % 7 == 0) stream[81*i + 76]++; // change the nonce so the proof-of-work fails
+    }
+
+    if (BRMerkleBlockParseBatch(blocks, valid, stream, 81, 1000, now, 4) != 1000 - 143)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseBatch() test 1\n", __func__);
+
+    for (size_t i = 0; i < 1000; i++) { // results must match parsing each header in order on a single thread
+        c = BRMerkleBlockParse(&stream[81*i], 81);
+        if (! blocks[i] || ! BRMerkleBlockEqual(c, blocks[i]) || valid[i] != BRMerkleBlockIsValid(c, now) ||
+            valid[i] != (i % 7 != 0)) batchCount++;
+        BRMerkleBlockFree(c);
+        if (blocks[i]) BRMerkleBlockFree(blocks[i]);
+    }
+
+    if (batchCount != 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRMerkleBlockParseBatch() test 2\n", __func__);
+
 
     if (b) BRMerkleBlockFree(b);
     
@@ -2903,6 +3921,105 @@ int BRMerkleBlockTests()
     return r;
 }
 
+int BRHeaderStoreTests(const char *storagePath)
+{
+    int r = 1;
+    char path[strlen(storagePath) + sizeof("/BRHeaderStoreTests")];
+    BRHeaderStore *store = NULL;
+    BRMerkleBlock *blocks[10], *b;
+    uint8_t header[80];
+    UInt256 hash, work;
+    FILE *f;
+
+    snprintf(path, sizeof(path), "%s/BRHeaderStoreTests", storagePath);
+    unlink(path); // start with an empty store, even if a previous run didn't get to remove it
+    if (mkdir(storagePath, 0700) == 0 || errno == EEXIST) store = BRHeaderStoreNew(path);
+    if (! store) return fprintf(stderr, "***FAILED*** %s: BRHeaderStoreNew() test 1\n", __func__), 0;
+
+    for (uint32_t i = 0; i < 10; i++) { // a chain of difficulty 1 headers starting at height 2016
+        blocks[i] = BRMerkleBlockNew();
+        blocks[i]->version = 1;
+        blocks[i]->prevBlock = (i > 0) ? blocks[i - 1]->blockHash : UINT256_ZERO;
+        UInt32SetLE(blocks[i]->merkleRoot.u8, i);
+        blocks[i]->timestamp = 1231006505 + i*600;
+        blocks[i]->target = 0x1d00ffff;
+        blocks[i]->nonce = i;
+        blocks[i]->height = 2016 + i;
+        BRMerkleBlockSerialize(blocks[i], header, sizeof(header));
+        BRSHA256_2(&blocks[i]->blockHash, header, sizeof(header));
+    }
+
+    if (BRHeaderStoreCount(store) != 0 || BRHeaderStoreStartHeight(store) != BLOCK_UNKNOWN_HEIGHT)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreCount() test 1\n", __func__);
+
+    for (size_t i = 0; i < 8; i++) {
+        if (! BRHeaderStoreAppend(store, blocks[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreAppend() test 1\n", __func__);
+    }
+
+    if (BRHeaderStoreAppend(store, blocks[9])) // doesn't follow the last header
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreAppend() test 2\n", __func__);
+
+    BRHeaderStoreFree(store);
+    f = fopen(path, "ab"); // a record partially written before a crash is dropped when the store is reopened
+    if (f) fwrite(header, 1, 10, f), fclose(f);
+    store = BRHeaderStoreNew(path);
+
+    if (! store || BRHeaderStoreCount(store) != 8 || BRHeaderStoreStartHeight(store) != 2016 ||
+        BRHeaderStoreLastHeight(store) != 2023)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreNew() test 2\n", __func__);
+
+    for (uint32_t i = 0; store && i < 8; i++) {
+        if (! BRHeaderStoreHash(store, 2016 + i, &hash) || ! UInt256Eq(hash, blocks[i]->blockHash))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreHash() test %"PRIu32"\n", __func__, i);
+
+        // the work of a difficulty 1 block is 0x100010001
+        if (! BRHeaderStoreChainWork(store, 2016 + i, &work) || UInt64GetLE(work.u8) != 0x100010001*(i + 1))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreChainWork() test %"PRIu32"\n", __func__, i);
+    }
+
+    if (store && BRHeaderStoreHash(store, 2015, &hash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreHash() test 8\n", __func__);
+
+    b = (store) ? BRHeaderStoreBlock(store, 2020) : NULL;
+
+    if (! b || b->height != 2020 || ! BRMerkleBlockEq(b, blocks[4]) || b->timestamp != blocks[4]->timestamp ||
+        ! UInt256Eq(b->prevBlock, blocks[3]->blockHash))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreBlock() test 1\n", __func__);
+
+    if (b) BRMerkleBlockFree(b);
+
+    if (store && (! BRHeaderStoreTruncate(store, 2020) || BRHeaderStoreLastHeight(store) != 2019 ||
+                  BRHeaderStoreHash(store, 2020, &hash) || ! BRHeaderStoreAppend(store, blocks[4])))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreTruncate() test 1\n", __func__);
+
+    // a complete record that was zeroed, as a file system may leave one after a crash, is dropped on reopening
+    if (store) BRHeaderStoreFree(store);
+    memset(header, 0, sizeof(header));
+    f = fopen(path, "r+b");
+    if (f) fseek(f, 4*HEADER_STORE_RECORD_SIZE, SEEK_SET), fwrite(header, 1, sizeof(header), f), fclose(f);
+    store = BRHeaderStoreNew(path);
+
+    if (! store || BRHeaderStoreCount(store) != 4 || BRHeaderStoreLastHeight(store) != 2019)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreNew() test 3\n", __func__);
+
+    // so is every record from the first that doesn't link to the one before it
+    if (store) BRHeaderStoreFree(store);
+    header[0] = blocks[1]->blockHash.u8[0] ^ 0xff; // the first byte of the third record's prevBlock
+    f = fopen(path, "r+b");
+    if (f) fseek(f, 2*HEADER_STORE_RECORD_SIZE + 4, SEEK_SET), fwrite(header, 1, 1, f), fclose(f);
+    store = BRHeaderStoreNew(path);
+
+    if (! store || BRHeaderStoreCount(store) != 2 || BRHeaderStoreLastHeight(store) != 2017 ||
+        ! BRHeaderStoreAppend(store, blocks[2]) || ! BRHeaderStoreSync(store))
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreNew() test 4\n", __func__);
+
+    if (store) BRHeaderStoreFree(store);
+    for (size_t i = 0; i < 10; i++) BRMerkleBlockFree(blocks[i]);
+    unlink(path);
+    return r;
+}
+
 int BRPaymentProtocolTests()
 {
     int r = 1;
@@ -3351,7 +4468,936 @@ int BRPeerTests()
     return r;
 }
 
-int BRRunTests()
+// a loopback peer that answers version with version and verack, and ping with pong, until the connection is closed
+typedef struct {
+    int socket;
+    uint32_t magicNumber;
+    size_t count; // connections to accept
+    uint64_t services; // services and lastblock to report in version
+    uint32_t lastblock;
+    void (*getblocks)(const uint8_t *msg, size_t msgLen); // called with each getblocks or getheaders message, if set
+    void (*filterload)(const uint8_t *msg, size_t msgLen); // called with each filterload message, if set
+    volatile int *stall; // while set, stops reading after each message, if set
+} BRMockPeerInfo;
+
+static void _BRMockPeerSend(int socket, uint32_t magicNumber, const char *type, const uint8_t *msg, size_t msgLen)
+{
+    uint8_t buf[24 + msgLen];
+    UInt256 hash;
+    
+    memset(buf, 0, sizeof(buf));
+    UInt32SetLE(&buf[0], magicNumber);
+    strncpy((char *)&buf[4], type, 12);
+    UInt32SetLE(&buf[16], (uint32_t)msgLen);
+    BRSHA256_2(&hash, msg, msgLen);
+    memcpy(&buf[20], &hash, sizeof(uint32_t));
+    memcpy(&buf[24], msg, msgLen);
+    if (send(socket, buf, sizeof(buf), 0) < 0) fprintf(stderr, "mock peer send: %s\n", strerror(errno));
+}
+
+static int _BRMockPeerRead(int socket, uint8_t *buf, size_t len)
+{
+    ssize_t n = 0;
+    
+    for (size_t off = 0; off < len; off += (size_t)n) {
+        n = read(socket, &buf[off], len - off);
+        if (n <= 0) return 0;
+    }
+    
+    return 1;
+}
+
+static void *_BRMockPeerConnectionRoutine(void *arg)
+{
+    BRMockPeerInfo *info = arg;
+    uint8_t header[24], payload[BLOOM_MAX_FILTER_LENGTH + 16], version[85];
+    uint32_t msgLen;
+
+    memset(version, 0, sizeof(version));
+    UInt32SetLE(&version[0], 70013); // protocol version
+    UInt64SetLE(&version[4], info->services);
+    UInt64SetLE(&version[12], (uint64_t)time(NULL)); // timestamp; the addresses, nonce and empty useragent are zeros
+    UInt32SetLE(&version[81], info->lastblock);
+
+    while (_BRMockPeerRead(info->socket, header, sizeof(header))) {
+        msgLen = UInt32GetLE(&header[16]);
+        if (msgLen > sizeof(payload) || ! _BRMockPeerRead(info->socket, payload, msgLen)) break;
+        
+        if (strncmp((const char *)&header[4], MSG_VERSION, 12) == 0) {
+            _BRMockPeerSend(info->socket, info->magicNumber, MSG_VERSION, version, sizeof(version));
+            _BRMockPeerSend(info->socket, info->magicNumber, MSG_VERACK, NULL, 0);
+        }
+        else if (strncmp((const char *)&header[4], MSG_PING, 12) == 0) {
+            _BRMockPeerSend(info->socket, info->magicNumber, MSG_PONG, payload, msgLen);
+        }
+        else if (info->getblocks && (strncmp((const char *)&header[4], MSG_GETBLOCKS, 12) == 0 ||
+                                     strncmp((const char *)&header[4], MSG_GETHEADERS, 12) == 0)) {
+            info->getblocks(payload, msgLen);
+        }
+        else if (info->filterload && strncmp((const char *)&header[4], MSG_FILTERLOAD, 12) == 0) {
+            info->filterload(payload, msgLen);
+        }
+
+        while (info->stall && *info->stall) usleep(10000);
+    }
+    
+    close(info->socket);
+    free(info);
+    return NULL;
+}
+
+static void *_BRMockPeerListenRoutine(void *arg)
+{
+    BRMockPeerInfo *info = arg;
+    pthread_t thread;
+    
+    for (size_t i = 0; i < info->count; i++) {
+        BRMockPeerInfo *connection = calloc(1, sizeof(*connection));
+        
+        assert(connection != NULL);
+        *connection = *info;
+        connection->socket = accept(info->socket, NULL, NULL);
+        
+        if (connection->socket < 0 ||
+            pthread_create(&thread, NULL, _BRMockPeerConnectionRoutine, connection) != 0) {
+            if (connection->socket >= 0) close(connection->socket);
+            free(connection);
+            break;
+        }
+        
+        pthread_detach(thread);
+    }
+    
+    return NULL;
+}
+
+#define REACTOR_TEST_PEER_COUNT    8
+#define REACTOR_TEST_STALL_COUNT   1024  // messages queued for a peer that stops reading, far more than socket buffers
+#define REACTOR_TEST_STALL_LENGTH  32000 // small enough for the mock peer to read once it reads again
+
+static struct {
+    pthread_mutex_t lock;
+    pthread_t thread;
+    int threadCount, connectedCount, pongCount, disconnectedCount, cleanupCount, stalledCount;
+} _reactorTest = { PTHREAD_MUTEX_INITIALIZER };
+
+static void _reactorTestNoteThread(void)
+{
+    if (_reactorTest.threadCount == 0 || ! pthread_equal(_reactorTest.thread, pthread_self())) {
+        _reactorTest.thread = pthread_self();
+        _reactorTest.threadCount++;
+    }
+}
+
+static void _reactorTestPong(void *info, int success)
+{
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTestNoteThread();
+    if (success) _reactorTest.pongCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+}
+
+static void _reactorTestConnected(void *info)
+{
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTestNoteThread();
+    _reactorTest.connectedCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+    BRPeerSendPing(info, info, _reactorTestPong);
+}
+
+static void _reactorTestDisconnected(void *info, int error)
+{
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTestNoteThread();
+    _reactorTest.disconnectedCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+}
+
+// queues far more for the peer than it reads, from the reactor thread, which must go on serving the other peers
+static void _reactorTestStalledConnected(void *info)
+{
+    uint8_t *msg = calloc(1, REACTOR_TEST_STALL_LENGTH);
+
+    assert(msg != NULL);
+    for (int i = 0; i < REACTOR_TEST_STALL_COUNT; i++) BRPeerSendMessage(info, msg, REACTOR_TEST_STALL_LENGTH, MSG_INV);
+    free(msg);
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTestNoteThread();
+    _reactorTest.stalledCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+}
+
+static void _reactorTestStalledDisconnected(void *info, int error)
+{
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTest.stalledCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+}
+
+static void _reactorTestThreadCleanup(void *info)
+{
+    pthread_mutex_lock(&_reactorTest.lock);
+    _reactorTest.cleanupCount++;
+    pthread_mutex_unlock(&_reactorTest.lock);
+}
+
+static int _reactorTestWait(int *count, int expected)
+{
+    int value = 0;
+    
+    for (int i = 0; i < 1000 && value < expected; i++) { // wait up to 10s
+        pthread_mutex_lock(&_reactorTest.lock);
+        value = *count;
+        pthread_mutex_unlock(&_reactorTest.lock);
+        if (value < expected) usleep(10000);
+    }
+    
+    return value == expected;
+}
+
+// starts accepting connections for listener on a loopback port, which is written to addr, returns false on failure
+static int _BRMockPeerListen(BRMockPeerInfo *listener, struct sockaddr_in *addr, pthread_t *thread)
+{
+    int on = 1;
+    socklen_t addrLen = sizeof(*addr);
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr->sin_port = 0; // any available port
+    listener->socket = socket(PF_INET, SOCK_STREAM, 0);
+    setsockopt(listener->socket, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    return (listener->socket >= 0 && bind(listener->socket, (struct sockaddr *)addr, sizeof(*addr)) == 0 &&
+            listen(listener->socket, (int)listener->count) == 0 &&
+            getsockname(listener->socket, (struct sockaddr *)addr, &addrLen) == 0 &&
+            pthread_create(thread, NULL, _BRMockPeerListenRoutine, listener) == 0);
+}
+
+int BRPeerReactorTests()
+{
+    int r = 1, superseded;
+    volatile int stall = 1;
+    BRMockPeerInfo listener = { -1, BRMainNetParams->magicNumber, REACTOR_TEST_PEER_COUNT + 1 }, // one reconnect
+                   stallListener = { -1, BRMainNetParams->magicNumber, 1 };
+    struct sockaddr_in addr, stallAddr;
+    BRPeerReactor *reactor;
+    BRPeer *peers[REACTOR_TEST_PEER_COUNT], *stalled;
+    pthread_t thread, stallThread;
+
+    stallListener.stall = &stall;
+
+    if (! _BRMockPeerListen(&listener, &addr, &thread)) {
+        fprintf(stderr, "***FAILED*** %s: mock peer listen: %s\n", __func__, strerror(errno));
+        if (listener.socket >= 0) close(listener.socket);
+        return 0;
+    }
+
+    if (! _BRMockPeerListen(&stallListener, &stallAddr, &stallThread)) {
+        fprintf(stderr, "***FAILED*** %s: mock peer listen: %s\n", __func__, strerror(errno));
+        if (stallListener.socket >= 0) close(stallListener.socket);
+        shutdown(listener.socket, SHUT_RDWR);
+        pthread_join(thread, NULL);
+        close(listener.socket);
+        return 0;
+    }
+    
+    reactor = BRPeerReactorNew(1);
+
+    for (size_t i = 0; i < REACTOR_TEST_PEER_COUNT; i++) {
+        peers[i] = BRPeerNew(BRMainNetParams->magicNumber);
+        peers[i]->address = ((UInt128) { .u16 = { 0, 0, 0, 0, 0, 0xffff } }); // IPv4-mapped address
+        memcpy(&peers[i]->address.u32[3], &addr.sin_addr, sizeof(uint32_t));
+        peers[i]->port = ntohs(addr.sin_port);
+        BRPeerSetCallbacks(peers[i], peers[i], _reactorTestConnected, _reactorTestDisconnected, NULL, NULL, NULL,
+                           NULL, NULL, NULL, NULL, NULL, NULL, _reactorTestThreadCleanup);
+        BRPeerSetReactor(peers[i], reactor);
+        BRPeerConnect(peers[i]);
+    }
+    
+    if (! _reactorTestWait(&_reactorTest.pongCount, REACTOR_TEST_PEER_COUNT))
+        r = 0, fprintf(stderr, "***FAILED*** %s: ping test, %d of %d pongs\n", __func__, _reactorTest.pongCount,
+                       REACTOR_TEST_PEER_COUNT);
+    
+    BRPeerDisconnect(peers[0]);
+    BRPeerConnect(peers[0]); // most likely before the reactor completes the disconnect, so the connection is superseded
+    
+    if (! _reactorTestWait(&_reactorTest.pongCount, REACTOR_TEST_PEER_COUNT + 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: reconnect test\n", __func__);
+    
+    pthread_mutex_lock(&_reactorTest.lock);
+    superseded = (_reactorTest.disconnectedCount == 0); // a superseded connection gets no disconnected callback
+    pthread_mutex_unlock(&_reactorTest.lock);
+
+    // a peer that stops reading, with far more queued than the socket takes, must not hold up the other peers
+    stalled = BRPeerNew(BRMainNetParams->magicNumber);
+    stalled->address = ((UInt128) { .u16 = { 0, 0, 0, 0, 0, 0xffff } });
+    memcpy(&stalled->address.u32[3], &stallAddr.sin_addr, sizeof(uint32_t));
+    stalled->port = ntohs(stallAddr.sin_port);
+    BRPeerSetCallbacks(stalled, stalled, _reactorTestStalledConnected, _reactorTestStalledDisconnected, NULL, NULL,
+                       NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL);
+    BRPeerSetReactor(stalled, reactor);
+    BRPeerConnect(stalled);
+
+    if (! _reactorTestWait(&_reactorTest.stalledCount, 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: stalled peer connect test\n", __func__);
+
+    for (size_t i = 0; i < REACTOR_TEST_PEER_COUNT; i++) BRPeerSendPing(peers[i], peers[i], _reactorTestPong);
+
+    if (! _reactorTestWait(&_reactorTest.pongCount, 2*REACTOR_TEST_PEER_COUNT + 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: stalled peer ping test, %d of %d pongs\n", __func__,
+                       _reactorTest.pongCount, 2*REACTOR_TEST_PEER_COUNT + 1);
+
+    if (BRPeerConnectStatus(stalled) != BRPeerStatusConnected)
+        r = 0, fprintf(stderr, "***FAILED*** %s: stalled peer BRPeerConnectStatus() test\n", __func__);
+
+    stall = 0;
+    BRPeerDisconnect(stalled);
+
+    if (! _reactorTestWait(&_reactorTest.stalledCount, 2))
+        r = 0, fprintf(stderr, "***FAILED*** %s: stalled peer disconnect test\n", __func__);
+
+    for (size_t i = 0; i < REACTOR_TEST_PEER_COUNT; i++) {
+        if (BRPeerConnectStatus(peers[i]) != BRPeerStatusConnected)
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerConnectStatus() test %zu\n", __func__, i);
+        BRPeerDisconnect(peers[i]);
+    }
+
+    if (! _reactorTestWait(&_reactorTest.cleanupCount, REACTOR_TEST_PEER_COUNT + ! superseded))
+        r = 0, fprintf(stderr, "***FAILED*** %s: threadCleanup test\n", __func__);
+    
+    if (_reactorTest.connectedCount != REACTOR_TEST_PEER_COUNT + 1 ||
+        _reactorTest.disconnectedCount != REACTOR_TEST_PEER_COUNT + ! superseded)
+        r = 0, fprintf(stderr, "***FAILED*** %s: callback count test\n", __func__);
+    
+    if (_reactorTest.threadCount != 1 || pthread_equal(_reactorTest.thread, pthread_self()))
+        r = 0, fprintf(stderr, "***FAILED*** %s: callback thread test\n", __func__);
+
+    if (r) BRPeerReactorFree(reactor); // a peer left on the reactor would fail BRPeerReactorFree()
+    for (size_t i = 0; r && i < REACTOR_TEST_PEER_COUNT; i++) BRPeerFree(peers[i]);
+    if (r) BRPeerFree(stalled);
+    shutdown(listener.socket, SHUT_RDWR); // stops accept() if a peer failed to connect
+    shutdown(stallListener.socket, SHUT_RDWR);
+    pthread_join(thread, NULL);
+    pthread_join(stallThread, NULL);
+    close(listener.socket);
+    close(stallListener.socket);
+    return r;
+}
+
+#define CHAIN_TEST_START_HEIGHT 2016000 // a difficulty transition after the last testnet checkpoint
+#define CHAIN_TEST_MAIN_COUNT   30
+#define CHAIN_TEST_FORK_OFFSET  20      // the fork replaces main chain blocks from this offset from the start height
+#define CHAIN_TEST_FORK_COUNT   15
+
+static struct {
+    pthread_mutex_t lock;
+    int requestCount; // getblocks and getheaders messages received by the mock peer
+    size_t locatorsCount;
+    UInt256 locators[64], mainHashes[CHAIN_TEST_MAIN_COUNT], forkHashes[CHAIN_TEST_FORK_COUNT];
+} _chainTest = { PTHREAD_MUTEX_INITIALIZER };
+
+static void _chainTestGetblocks(const uint8_t *msg, size_t msgLen)
+{
+    size_t off = sizeof(uint32_t), len = 0, i;
+    uint64_t count = BRVarInt(&msg[off], (off <= msgLen) ? msgLen - off : 0, &len);
+
+    pthread_mutex_lock(&_chainTest.lock);
+    off += len;
+
+    for (i = 0; i < count && i < sizeof(_chainTest.locators)/sizeof(UInt256) && off + sizeof(UInt256) <= msgLen; i++) {
+        _chainTest.locators[i] = UInt256Get(&msg[off]);
+        off += sizeof(UInt256);
+    }
+
+    _chainTest.locatorsCount = i;
+    _chainTest.requestCount++;
+    pthread_mutex_unlock(&_chainTest.lock);
+}
+
+static int _chainTestWait(int expected)
+{
+    int value = 0;
+
+    for (int i = 0; i < 1000 && value < expected; i++) { // wait up to 10s
+        pthread_mutex_lock(&_chainTest.lock);
+        value = _chainTest.requestCount;
+        pthread_mutex_unlock(&_chainTest.lock);
+        if (value < expected) usleep(10000);
+    }
+
+    return value >= expected;
+}
+
+// returns a header-only block following prev, with nonce to tell it apart from other blocks at the same height
+static BRMerkleBlock *_chainTestBlock(const BRMerkleBlock *prev, uint32_t height, uint32_t nonce)
+{
+    BRMerkleBlock *block = BRMerkleBlockNew();
+    uint8_t header[80];
+
+    block->version = 1;
+    block->prevBlock = (prev) ? prev->blockHash : UINT256_ZERO;
+    block->timestamp = 1620000000 + (height - CHAIN_TEST_START_HEIGHT)*600;
+    block->target = 0x1d00ffff;
+    block->nonce = nonce;
+    block->height = height;
+    BRMerkleBlockSerialize(block, header, sizeof(header));
+    BRSHA256_2(&block->blockHash, header, sizeof(header));
+    return block;
+}
+
+// the main chain block hash at the given offset from the start height, before or after the fork replaced its tip
+static UInt256 _chainTestHash(uint32_t offset, int forked)
+{
+    return (forked && offset >= CHAIN_TEST_FORK_OFFSET) ? _chainTest.forkHashes[offset - CHAIN_TEST_FORK_OFFSET] :
+           _chainTest.mainHashes[offset];
+}
+
+// checks that the locators last sent to the mock peer are the given block hashes, followed by the hashes of the
+// checkpoints older than the last of those blocks
+static int _chainTestLocatorsEqual(const UInt256 hashes[], size_t hashesCount, uint32_t lastHeight)
+{
+    const BRChainParams *params = BRTestNetParams;
+    size_t i = hashesCount;
+    int r;
+
+    pthread_mutex_lock(&_chainTest.lock);
+    r = (_chainTest.locatorsCount >= hashesCount &&
+         memcmp(_chainTest.locators, hashes, hashesCount*sizeof(*hashes)) == 0);
+
+    for (size_t j = params->checkpointsCount; r && j > 0; j--) {
+        if (params->checkpoints[j - 1].height >= lastHeight) continue;
+        r = (i < _chainTest.locatorsCount && UInt256Eq(_chainTest.locators[i], params->checkpoints[j - 1].hash));
+        i++;
+    }
+
+    if (i != _chainTest.locatorsCount) r = 0;
+    pthread_mutex_unlock(&_chainTest.lock);
+    return r;
+}
+
+// checks the locators against the main chain blocks at the given offsets from the start height
+static int _chainTestChainLocatorsEqual(const uint32_t offsets[], size_t count, int forked)
+{
+    UInt256 hashes[count];
+
+    for (size_t i = 0; i < count; i++) hashes[i] = _chainTestHash(offsets[i], forked);
+    return _chainTestLocatorsEqual(hashes, count, CHAIN_TEST_START_HEIGHT + offsets[count - 1]);
+}
+
+int BRPeerManagerChainTests()
+{
+    int r = 1, requestCount = 0;
+    const BRChainParams *params = BRTestNetParams;
+    const BRCheckPoint *checkpoint = &params->checkpoints[params->checkpointsCount - 1];
+    // locators step back one block at a time for the ten most recent blocks, then double the step each time
+    const uint32_t mainOffsets[] = { 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 18, 14, 6 },
+                   forkOffsets[] = { 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 23, 19, 11 },
+                   rescanOffsets[] = { 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 4, 0 };
+    BRMockPeerInfo listener = { -1, params->magicNumber, 8, SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM |
+                                params->services, CHAIN_TEST_START_HEIGHT + 100, _chainTestGetblocks };
+    struct sockaddr_in addr;
+    pthread_t thread;
+    UInt128 address = { .u16 = { 0, 0, 0, 0, 0, 0xffff } }; // IPv4-mapped address
+    UInt256 hash;
+    UInt512 seed;
+    BRMerkleBlock *blocks[CHAIN_TEST_MAIN_COUNT], *forked[CHAIN_TEST_FORK_OFFSET + CHAIN_TEST_FORK_COUNT];
+    BRWallet *wallet;
+    BRPeerManager *manager;
+
+    if (! _BRMockPeerListen(&listener, &addr, &thread)) {
+        fprintf(stderr, "***FAILED*** %s: mock peer listen: %s\n", __func__, strerror(errno));
+        if (listener.socket >= 0) close(listener.socket);
+        return 0;
+    }
+
+    memcpy(&address.u32[3], &addr.sin_addr, sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < CHAIN_TEST_MAIN_COUNT; i++) {
+        blocks[i] = _chainTestBlock((i > 0) ? blocks[i - 1] : NULL, CHAIN_TEST_START_HEIGHT + i, 0);
+        _chainTest.mainHashes[i] = blocks[i]->blockHash;
+    }
+
+    // the forked chain shares the main chain's blocks up to the fork offset, then follows the fork
+    for (uint32_t i = 0; i < CHAIN_TEST_FORK_OFFSET + CHAIN_TEST_FORK_COUNT; i++) {
+        forked[i] = (i < CHAIN_TEST_FORK_OFFSET) ? BRMerkleBlockCopy(blocks[i]) :
+                    _chainTestBlock(forked[i - 1], CHAIN_TEST_START_HEIGHT + i, 1);
+        if (i >= CHAIN_TEST_FORK_OFFSET) _chainTest.forkHashes[i - CHAIN_TEST_FORK_OFFSET] = forked[i]->blockHash;
+    }
+
+    BRBIP39DeriveKey(&seed, "a random seed", NULL);
+    wallet = BRWalletNew(params->addrParams, NULL, 0, BRBIP32MasterPubKey(&seed, sizeof(seed)));
+    manager = BRPeerManagerNew(params, wallet, blocks[0]->timestamp, blocks, CHAIN_TEST_MAIN_COUNT, NULL, 0);
+    BRPeerManagerSetFixedPeer(manager, address, ntohs(addr.sin_port));
+
+    if (BRPeerManagerLastBlockHeight(manager) != CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT - 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerNew() test 1\n", __func__);
+
+    // the manager is behind the mock peer's lastblock, so it requests blocks from its last block on connecting
+    BRPeerManagerConnect(manager);
+
+    if (! _chainTestWait(++requestCount) ||
+        ! _chainTestChainLocatorsEqual(mainOffsets, sizeof(mainOffsets)/sizeof(*mainOffsets), 0))
+        r = 0, fprintf(stderr, "***FAILED*** %s: locators test 1\n", __func__);
+
+    BRPeerManagerDisconnect(manager);
+    BRPeerManagerFree(manager);
+
+    // blocks relayed by a peer would need real proof-of-work, so the longer fork is loaded into a new manager, whose
+    // height index is built along the forked chain rather than the main one
+    manager = BRPeerManagerNew(params, wallet, forked[0]->timestamp, forked,
+                               CHAIN_TEST_FORK_OFFSET + CHAIN_TEST_FORK_COUNT, NULL, 0);
+    BRPeerManagerSetFixedPeer(manager, address, ntohs(addr.sin_port));
+
+    if (BRPeerManagerLastBlockHeight(manager) !=
+        CHAIN_TEST_START_HEIGHT + CHAIN_TEST_FORK_OFFSET + CHAIN_TEST_FORK_COUNT - 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerNew() test 2\n", __func__);
+
+    BRPeerManagerConnect(manager);
+
+    if (! _chainTestWait(++requestCount) ||
+        ! _chainTestChainLocatorsEqual(forkOffsets, sizeof(forkOffsets)/sizeof(*forkOffsets), 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: locators test 2\n", __func__);
+
+    // rescanning reconnects, so the manager requests blocks again from the rescan block
+    BRPeerManagerRescanFromBlockNumber(manager, CHAIN_TEST_START_HEIGHT + 15);
+
+    if (BRPeerManagerLastBlockHeight(manager) != CHAIN_TEST_START_HEIGHT + 15)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerRescanFromBlockNumber() test 1\n", __func__);
+
+    if (! _chainTestWait(++requestCount) ||
+        ! _chainTestChainLocatorsEqual(rescanOffsets, sizeof(rescanOffsets)/sizeof(*rescanOffsets), 1))
+        r = 0, fprintf(stderr, "***FAILED*** %s: locators test 3\n", __func__);
+
+    // a block number before the chain in memory rescans from the checkpoint before it
+    BRPeerManagerRescanFromBlockNumber(manager, CHAIN_TEST_START_HEIGHT - 1);
+    hash = UInt256Reverse(checkpoint->hash);
+
+    if (BRPeerManagerLastBlockHeight(manager) != checkpoint->height)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerRescanFromBlockNumber() test 2\n", __func__);
+
+    if (! _chainTestWait(++requestCount) || ! _chainTestLocatorsEqual(&hash, 1, checkpoint->height))
+        r = 0, fprintf(stderr, "***FAILED*** %s: locators test 4\n", __func__);
+
+    BRPeerManagerDisconnect(manager);
+    BRPeerManagerFree(manager);
+    BRWalletFree(wallet);
+    shutdown(listener.socket, SHUT_RDWR); // stops accept()
+    pthread_join(thread, NULL);
+    close(listener.socket);
+    return r;
+}
+
+#define HEADER_STORE_TEST_PRE_COUNT 64 // headers in store before the manager's chain
+
+int BRPeerManagerHeaderStoreTests(const char *storagePath)
+{
+    int r = 1, requestCount;
+    const BRChainParams *params = BRTestNetParams;
+    // the locators that don't fit in the manager's chain, 16 and 48 blocks before the tenth, come from the store
+    const uint32_t mainOffsets[] = { 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 18, 14, 6 },
+                   preOffsets[] = { HEADER_STORE_TEST_PRE_COUNT - 10, HEADER_STORE_TEST_PRE_COUNT - 42 };
+    // the merkle root, timestamp and nonce of main net blocks 0 to 5, which have real proof-of-work
+    const struct { const char *merkleRoot; uint32_t timestamp, nonce; } mined[] = {
+        { "4a5e1e4baab89f3a32518a88c31bc87f618f76673e2cc77ab2127b7afdeda33b", 1231006505, 2083236893 },
+        { "0e3e2357e806b6cdb1f70b54c3a3a17b6714ee1f0e68bebb44a74b1efd512098", 1231469665, 2573394689 },
+        { "9b0fc92260312ce44e74ef369f5c66bbb85848f2eddd5a7a1cde251e54ccfdd5", 1231469744, 1639830024 },
+        { "999e1c837c76a1b7fbb7e57baf87b309960f5ffefbf2a9b95dd890602272f644", 1231470173, 1844305925 },
+        { "df2b060fa2e5e9c8ed5eaf6a45c13753ec8c63282b2688322eba40cd98ea067a", 1231470988, 2850094635 },
+        { "63522845d294ee9b0188ae5cac91bf389a0c3723f084ca1025e7d9cdfe481ce1", 1231471428, 2011431709 }
+    };
+    BRMockPeerInfo listener = { -1, params->magicNumber, 8, SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM |
+                                params->services, CHAIN_TEST_START_HEIGHT + 100, _chainTestGetblocks };
+    char path[strlen(storagePath) + sizeof("/BRPeerManagerHeaderStoreTests")];
+    struct sockaddr_in addr;
+    pthread_t thread;
+    UInt128 address = { .u16 = { 0, 0, 0, 0, 0, 0xffff } }; // IPv4-mapped address
+    UInt256 hash, hashes[sizeof(mainOffsets)/sizeof(*mainOffsets) + sizeof(preOffsets)/sizeof(*preOffsets)];
+    UInt512 seed;
+    BRMerkleBlock *pre[HEADER_STORE_TEST_PRE_COUNT], *blocks[CHAIN_TEST_MAIN_COUNT], *copies[CHAIN_TEST_MAIN_COUNT],
+                  *b, *prev;
+    uint8_t header[80];
+    BRHeaderStore *store = NULL;
+    BRWallet *wallet;
+    BRPeerManager *manager;
+
+    snprintf(path, sizeof(path), "%s/BRPeerManagerHeaderStoreTests", storagePath);
+    unlink(path);
+    if (mkdir(storagePath, 0700) == 0 || errno == EEXIST) store = BRHeaderStoreNew(path);
+    if (! store) return fprintf(stderr, "***FAILED*** %s: BRHeaderStoreNew() test\n", __func__), 0;
+
+    if (! _BRMockPeerListen(&listener, &addr, &thread)) {
+        fprintf(stderr, "***FAILED*** %s: mock peer listen: %s\n", __func__, strerror(errno));
+        if (listener.socket >= 0) close(listener.socket);
+        BRHeaderStoreFree(store);
+        return 0;
+    }
+
+    memcpy(&address.u32[3], &addr.sin_addr, sizeof(uint32_t));
+    pthread_mutex_lock(&_chainTest.lock);
+    requestCount = _chainTest.requestCount; // the mock peer's request count carries over from earlier tests
+    pthread_mutex_unlock(&_chainTest.lock);
+
+    for (uint32_t i = 0; i < HEADER_STORE_TEST_PRE_COUNT; i++) {
+        pre[i] = _chainTestBlock((i > 0) ? pre[i - 1] : NULL,
+                                 CHAIN_TEST_START_HEIGHT - HEADER_STORE_TEST_PRE_COUNT + i, 0);
+        if (! BRHeaderStoreAppend(store, pre[i]))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreAppend() test %"PRIu32"\n", __func__, i);
+    }
+
+    for (uint32_t i = 0; i < CHAIN_TEST_MAIN_COUNT; i++) {
+        blocks[i] = _chainTestBlock((i > 0) ? blocks[i - 1] : pre[HEADER_STORE_TEST_PRE_COUNT - 1],
+                                    CHAIN_TEST_START_HEIGHT + i, 0);
+        copies[i] = BRMerkleBlockCopy(blocks[i]);
+        _chainTest.mainHashes[i] = blocks[i]->blockHash;
+    }
+
+    // a fork that the store has and the manager doesn't is replaced with the manager's chain when seeding the store
+    prev = pre[HEADER_STORE_TEST_PRE_COUNT - 1];
+
+    for (uint32_t i = 0; i < 5; i++) {
+        b = _chainTestBlock(prev, CHAIN_TEST_START_HEIGHT + i, 1);
+        BRHeaderStoreAppend(store, b);
+        if (i > 0) BRMerkleBlockFree(prev);
+        prev = b;
+    }
+
+    BRMerkleBlockFree(prev);
+    BRBIP39DeriveKey(&seed, "a random seed", NULL);
+    wallet = BRWalletNew(params->addrParams, NULL, 0, BRBIP32MasterPubKey(&seed, sizeof(seed)));
+    manager = BRPeerManagerNew(params, wallet, blocks[0]->timestamp, blocks, CHAIN_TEST_MAIN_COUNT, NULL, 0);
+    BRPeerManagerSetFixedPeer(manager, address, ntohs(addr.sin_port));
+    BRPeerManagerSetHeaderStore(manager, store);
+
+    if (BRPeerManagerLastBlockHeight(manager) != CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT - 1 ||
+        BRHeaderStoreLastHeight(store) != CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT - 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerSetHeaderStore() test 1\n", __func__);
+
+    for (uint32_t i = 0; i < CHAIN_TEST_MAIN_COUNT; i++) {
+        if (! BRHeaderStoreHash(store, CHAIN_TEST_START_HEIGHT + i, &hash) || ! UInt256Eq(hash, _chainTestHash(i, 0)))
+            r = 0, fprintf(stderr, "***FAILED*** %s: seed test %"PRIu32"\n", __func__, i);
+    }
+
+    // locators continue back through the store's headers past the start of the manager's chain
+    BRPeerManagerConnect(manager);
+
+    for (size_t i = 0; i < sizeof(mainOffsets)/sizeof(*mainOffsets); i++) hashes[i] = _chainTestHash(mainOffsets[i], 0);
+
+    for (size_t i = 0; i < sizeof(preOffsets)/sizeof(*preOffsets); i++) {
+        hashes[sizeof(mainOffsets)/sizeof(*mainOffsets) + i] = pre[preOffsets[i]]->blockHash;
+    }
+
+    if (! _chainTestWait(++requestCount) ||
+        ! _chainTestLocatorsEqual(hashes, sizeof(hashes)/sizeof(*hashes),
+                                  CHAIN_TEST_START_HEIGHT - HEADER_STORE_TEST_PRE_COUNT + preOffsets[1]))
+        r = 0, fprintf(stderr, "***FAILED*** %s: locators test\n", __func__);
+
+    BRPeerManagerDisconnect(manager);
+    BRPeerManagerSetHeaderStore(manager, NULL);
+    BRPeerManagerFree(manager);
+
+    // headers past the manager's chain without proof-of-work aren't restored, and are dropped from the store
+    prev = copies[CHAIN_TEST_MAIN_COUNT - 1];
+
+    for (uint32_t i = 0; i < 5; i++) {
+        b = _chainTestBlock(prev, CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT + i, 0);
+        BRHeaderStoreAppend(store, b);
+        if (i > 0) BRMerkleBlockFree(prev);
+        prev = b;
+    }
+
+    BRMerkleBlockFree(prev);
+    manager = BRPeerManagerNew(params, wallet, copies[0]->timestamp, copies, CHAIN_TEST_MAIN_COUNT, NULL, 0);
+    BRPeerManagerSetHeaderStore(manager, store);
+
+    if (BRPeerManagerLastBlockHeight(manager) != CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT - 1 ||
+        BRHeaderStoreLastHeight(store) != CHAIN_TEST_START_HEIGHT + CHAIN_TEST_MAIN_COUNT - 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerSetHeaderStore() test 2\n", __func__);
+
+    BRPeerManagerSetHeaderStore(manager, NULL);
+    BRPeerManagerFree(manager);
+    BRWalletFree(wallet);
+    BRHeaderStoreFree(store);
+    for (size_t i = 0; i < HEADER_STORE_TEST_PRE_COUNT; i++) BRMerkleBlockFree(pre[i]);
+    shutdown(listener.socket, SHUT_RDWR); // stops accept()
+    pthread_join(thread, NULL);
+    close(listener.socket);
+
+    // headers with real proof-of-work are restored past the manager's last block, here the genesis checkpoint
+    params = BRMainNetParams;
+    unlink(path);
+    store = BRHeaderStoreNew(path);
+    prev = NULL;
+
+    for (uint32_t i = 0; store && i < sizeof(mined)/sizeof(*mined); i++) {
+        b = BRMerkleBlockNew();
+        b->version = 1;
+        b->prevBlock = (prev) ? prev->blockHash : UINT256_ZERO;
+        b->merkleRoot = UInt256Reverse(uint256(mined[i].merkleRoot));
+        b->timestamp = mined[i].timestamp;
+        b->target = 0x1d00ffff;
+        b->nonce = mined[i].nonce;
+        b->height = i;
+        BRMerkleBlockSerialize(b, header, sizeof(header));
+        BRSHA256_2(&b->blockHash, header, sizeof(header));
+        if (! BRHeaderStoreAppend(store, b) ||
+            (i == 0 && ! UInt256Eq(b->blockHash, UInt256Reverse(params->checkpoints[0].hash))))
+            r = 0, fprintf(stderr, "***FAILED*** %s: BRHeaderStoreAppend() test %"PRIu32"\n", __func__, i);
+        if (prev) BRMerkleBlockFree(prev);
+        prev = b;
+    }
+
+    if (prev) BRMerkleBlockFree(prev);
+    wallet = BRWalletNew(params->addrParams, NULL, 0, BRBIP32MasterPubKey(&seed, sizeof(seed)));
+    manager = BRPeerManagerNew(params, wallet, mined[0].timestamp, NULL, 0, NULL, 0);
+    if (store) BRPeerManagerSetHeaderStore(manager, store);
+
+    if (! store || BRPeerManagerLastBlockHeight(manager) != sizeof(mined)/sizeof(*mined) - 1)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerSetHeaderStore() test 3\n", __func__);
+
+    BRPeerManagerSetHeaderStore(manager, NULL);
+    BRPeerManagerFree(manager);
+    BRWalletFree(wallet);
+    if (store) BRHeaderStoreFree(store);
+    unlink(path);
+    return r;
+}
+
+static struct {
+    pthread_mutex_t lock;
+    int loadCount;
+    uint8_t *filter; // the last filterload payload
+    size_t filterLen;
+} _filterTest = { PTHREAD_MUTEX_INITIALIZER };
+
+static void _filterTestFilterload(const uint8_t *msg, size_t msgLen)
+{
+    pthread_mutex_lock(&_filterTest.lock);
+    if (_filterTest.filter) free(_filterTest.filter);
+    _filterTest.filter = malloc(msgLen);
+    assert(_filterTest.filter != NULL);
+    memcpy(_filterTest.filter, msg, msgLen);
+    _filterTest.filterLen = msgLen;
+    _filterTest.loadCount++;
+    pthread_mutex_unlock(&_filterTest.lock);
+}
+
+// waits for the expected number of filterloads, and returns the last filter loaded, or NULL on timeout
+static BRBloomFilter *_filterTestWait(int expected)
+{
+    BRBloomFilter *filter = NULL;
+    int value = 0;
+
+    for (int i = 0; i < 1000 && value < expected; i++) { // wait up to 10s
+        pthread_mutex_lock(&_filterTest.lock);
+        value = _filterTest.loadCount;
+        if (value >= expected) filter = BRBloomFilterParse(_filterTest.filter, _filterTest.filterLen);
+        pthread_mutex_unlock(&_filterTest.lock);
+        if (value < expected) usleep(10000);
+    }
+
+    return filter;
+}
+
+// returns true if filter contains every element a filter built from scratch for the manager's wallet would: the
+// pubkey hashes of both chains, the UTXOs, and the outputs spent by transactions within the last 100 blocks
+static int _filterTestContainsWallet(BRBloomFilter *filter, BRPeerManager *manager, BRWallet *wallet)
+{
+    uint32_t lastHeight = BRPeerManagerLastBlockHeight(manager), height = (lastHeight > 100) ? lastHeight - 100 : 0;
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+    int r = (filter != NULL);
+
+    for (uint32_t internal = SEQUENCE_EXTERNAL_CHAIN; r && internal <= SEQUENCE_INTERNAL_CHAIN; internal++) {
+        size_t pkhsCount = BRWalletChainPKHs(wallet, NULL, 0, internal, 0);
+        UInt160 *pkhs = calloc(pkhsCount, sizeof(*pkhs));
+
+        pkhsCount = BRWalletChainPKHs(wallet, pkhs, pkhsCount, internal, 0);
+        for (size_t i = 0; r && i < pkhsCount; i++) r = BRBloomFilterContainsData(filter, pkhs[i].u8, sizeof(*pkhs));
+        free(pkhs);
+    }
+
+    size_t utxosCount = BRWalletUTXOs(wallet, NULL, 0), txCount = BRWalletTxUnconfirmedBefore(wallet, NULL, 0, height);
+    BRUTXO *utxos = calloc(utxosCount + 1, sizeof(*utxos));
+    BRTransaction **transactions = calloc(txCount + 1, sizeof(*transactions));
+
+    utxosCount = BRWalletUTXOs(wallet, utxos, utxosCount);
+    txCount = BRWalletTxUnconfirmedBefore(wallet, transactions, txCount, height);
+
+    for (size_t i = 0; r && i < utxosCount; i++) {
+        UInt256Set(o, utxos[i].hash);
+        UInt32SetLE(&o[sizeof(UInt256)], utxos[i].n);
+        r = BRBloomFilterContainsData(filter, o, sizeof(o));
+    }
+
+    for (size_t i = 0; r && i < txCount; i++) {
+        if (BRWalletAmountSentByTx(wallet, transactions[i]) == 0) continue;
+
+        for (size_t j = 0; r && j < transactions[i]->inCount; j++) {
+            UInt256Set(o, transactions[i]->inputs[j].txHash);
+            UInt32SetLE(&o[sizeof(UInt256)], transactions[i]->inputs[j].index);
+            r = BRBloomFilterContainsData(filter, o, sizeof(o));
+        }
+    }
+
+    free(utxos);
+    free(transactions);
+    return r;
+}
+
+// an unconfirmed transaction paying amount to address from the given output, with script as the output's script
+static BRTransaction *_filterTestTx(UInt256 inHash, const uint8_t *script, size_t scriptLen, const char *address,
+                                    uint64_t amount)
+{
+    const BRChainParams *params = BRTestNetParams;
+    uint8_t outScript[BRAddressScriptPubKey(NULL, 0, params->addrParams, address)];
+    size_t outScriptLen = BRAddressScriptPubKey(outScript, sizeof(outScript), params->addrParams, address);
+    uint8_t sig[] = { 0x01, 0x00 }; // registration only checks that inputs are signed
+    BRTransaction *tx = BRTransactionNew();
+
+    BRTransactionAddInput(tx, inHash, 0, amount*2, script, scriptLen, sig, sizeof(sig), sig, 0, TXIN_SEQUENCE);
+    BRTransactionAddOutput(tx, amount, outScript, outScriptLen);
+    tx->blockHeight = TX_UNCONFIRMED;
+    BRTransactionSign(tx, 0, NULL, 0); // only computes txHash, since no keys are given
+    return tx;
+}
+
+// the bloom filter shared by peers is built from scratch on the first connect, extended in place with the wallet's
+// new addresses and outputs on later connects, and rebuilt once extending it pushes its false positive rate past the
+// max; each time it must hold the same wallet elements as a filter freshly built by another manager
+int BRPeerManagerFilterTests()
+{
+    int r = 1, loadCount = 0;
+    const BRChainParams *params = BRTestNetParams;
+    BRMockPeerInfo listener = { -1, params->magicNumber, 8, SERVICES_NODE_NETWORK | SERVICES_NODE_BLOOM |
+                                params->services, 0, NULL, _filterTestFilterload };
+    struct sockaddr_in addr;
+    pthread_t thread;
+    UInt128 address = { .u16 = { 0, 0, 0, 0, 0, 0xffff } }; // IPv4-mapped address
+    UInt512 seed;
+    UInt256 inHash = UINT256_ZERO;
+    BRAddress extAddrs[200], intAddr;
+    BRTransaction *tx;
+    BRPeerManagerFilterStats stats, freshStats;
+    BRBloomFilter *filter, *freshFilter;
+    BRPeerManager *manager, *freshManager;
+    size_t elemCount;
+
+    BRBIP39DeriveKey(&seed, "a random seed", NULL);
+    BRWallet *wallet = BRWalletNew(params->addrParams, NULL, 0, BRBIP32MasterPubKey(&seed, sizeof(seed)));
+
+    BRWalletUnusedAddrs(wallet, extAddrs, 1, SEQUENCE_EXTERNAL_CHAIN);
+    BRWalletUnusedAddrs(wallet, &intAddr, 1, SEQUENCE_INTERNAL_CHAIN);
+
+    uint8_t extScript[BRAddressScriptPubKey(NULL, 0, params->addrParams, extAddrs[0].s)];
+    size_t extScriptLen = BRAddressScriptPubKey(extScript, sizeof(extScript), params->addrParams, extAddrs[0].s);
+
+    // a receive from outside the wallet, and a spend of it to a change address, both unconfirmed
+    inHash.u32[0] = 1;
+    tx = _filterTestTx(inHash, NULL, 0, extAddrs[0].s, SATOSHIS);
+    BRWalletRegisterTransaction(wallet, tx);
+    tx = _filterTestTx(tx->txHash, extScript, extScriptLen, intAddr.s, SATOSHIS/2);
+    BRWalletRegisterTransaction(wallet, tx);
+
+    if (BRWalletUTXOs(wallet, NULL, 0) != 1 || BRWalletAmountSentByTx(wallet, tx) == 0)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test\n", __func__);
+
+    manager = BRPeerManagerNew(params, wallet, (uint32_t)time(NULL), NULL, 0, NULL, 0);
+    listener.lastblock = BRPeerManagerLastBlockHeight(manager) + 100;
+
+    if (! _BRMockPeerListen(&listener, &addr, &thread)) {
+        fprintf(stderr, "***FAILED*** %s: mock peer listen: %s\n", __func__, strerror(errno));
+        if (listener.socket >= 0) close(listener.socket);
+        BRPeerManagerFree(manager);
+        BRWalletFree(wallet);
+        return 0;
+    }
+
+    memcpy(&address.u32[3], &addr.sin_addr, sizeof(uint32_t));
+    BRPeerManagerSetFixedPeer(manager, address, ntohs(addr.sin_port));
+
+    // the first connect builds the filter from scratch
+    BRPeerManagerConnect(manager);
+    filter = _filterTestWait(++loadCount);
+    BRPeerManagerGetFilterStats(manager, &stats);
+
+    if (! _filterTestContainsWallet(filter, manager, wallet))
+        r = 0, fprintf(stderr, "***FAILED*** %s: filterload test 1\n", __func__);
+
+    if (stats.rebuilds != 1 || stats.updates != 0 || stats.elemCount == 0 || stats.fpRate > stats.maxFpRate)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerGetFilterStats() test 1\n", __func__);
+
+    if (filter) BRBloomFilterFree(filter);
+    elemCount = stats.elemCount;
+    BRPeerManagerDisconnect(manager);
+
+    // new wallet addresses, and a receive to one of them, are added to the cached filter on the next connect
+    BRWalletUnusedAddrs(wallet, extAddrs, 200, SEQUENCE_EXTERNAL_CHAIN);
+    inHash.u32[0] = 2;
+    tx = _filterTestTx(inHash, NULL, 0, extAddrs[150].s, SATOSHIS);
+    BRWalletRegisterTransaction(wallet, tx);
+
+    if (BRWalletUTXOs(wallet, NULL, 0) != 2)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRWalletRegisterTransaction() test 2\n", __func__);
+
+    BRPeerManagerConnect(manager);
+    filter = _filterTestWait(++loadCount);
+    BRPeerManagerGetFilterStats(manager, &stats);
+
+    if (! _filterTestContainsWallet(filter, manager, wallet))
+        r = 0, fprintf(stderr, "***FAILED*** %s: filterload test 2\n", __func__);
+
+    if (stats.rebuilds != 1 || stats.updates != 1 || stats.elemCount <= elemCount || stats.fpRate > stats.maxFpRate)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerGetFilterStats() test 2\n", __func__);
+
+    if (filter) BRBloomFilterFree(filter);
+    BRPeerManagerDisconnect(manager);
+
+    // another manager for the same wallet builds its filter from scratch, with the same wallet elements
+    freshManager = BRPeerManagerNew(params, wallet, (uint32_t)time(NULL), NULL, 0, NULL, 0);
+    BRPeerManagerSetFixedPeer(freshManager, address, ntohs(addr.sin_port));
+    BRPeerManagerConnect(freshManager);
+    freshFilter = _filterTestWait(++loadCount);
+    BRPeerManagerGetFilterStats(freshManager, &freshStats);
+
+    if (! _filterTestContainsWallet(freshFilter, freshManager, wallet))
+        r = 0, fprintf(stderr, "***FAILED*** %s: filterload test 3\n", __func__);
+
+    if (freshStats.rebuilds != 1 || freshStats.updates != 0 || freshStats.elemCount < stats.elemCount)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerGetFilterStats() test 3\n", __func__);
+
+    if (freshFilter) BRBloomFilterFree(freshFilter);
+    BRPeerManagerDisconnect(freshManager);
+    BRPeerManagerFree(freshManager);
+
+    // extending the filter with many more addresses than it was sized for would push its false positive rate past
+    // the max, so it's rebuilt instead
+    BRWalletUnusedAddrs(wallet, NULL, 2000, SEQUENCE_EXTERNAL_CHAIN);
+    BRPeerManagerConnect(manager);
+    filter = _filterTestWait(++loadCount);
+    BRPeerManagerGetFilterStats(manager, &stats);
+
+    if (! _filterTestContainsWallet(filter, manager, wallet))
+        r = 0, fprintf(stderr, "***FAILED*** %s: filterload test 4\n", __func__);
+
+    if (stats.rebuilds != 2 || stats.updates != 1 || stats.elemCount < 2000 || stats.fpRate > stats.maxFpRate)
+        r = 0, fprintf(stderr, "***FAILED*** %s: BRPeerManagerGetFilterStats() test 4\n", __func__);
+
+    if (filter) BRBloomFilterFree(filter);
+    BRPeerManagerDisconnect(manager);
+    BRPeerManagerFree(manager);
+    BRWalletFree(wallet);
+    pthread_mutex_lock(&_filterTest.lock);
+    if (_filterTest.filter) free(_filterTest.filter);
+    _filterTest.filter = NULL;
+    pthread_mutex_unlock(&_filterTest.lock);
+    shutdown(listener.socket, SHUT_RDWR); // stops accept()
+    pthread_join(thread, NULL);
+    close(listener.socket);
+    return r;
+}
+
+int BRRunTests(const char *storagePath)
 {
     int fail = 0;
     
@@ -3401,10 +5447,24 @@ int BRRunTests()
     printf("%s\n", (BRTransactionTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRWalletTests...                    ");
     printf("%s\n", (BRWalletTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRWalletIncrementalBalanceTests...  ");
+    printf("%s\n", (BRWalletIncrementalBalanceTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRWalletDiscoveryTests...           ");
+    printf("%s\n", (BRWalletDiscoveryTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRBloomFilterTests...               ");
     printf("%s\n", (BRBloomFilterTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRMerkleBlockTests...               ");
     printf("%s\n", (BRMerkleBlockTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRHeaderStoreTests...               ");
+    printf("%s\n", (BRHeaderStoreTests(storagePath)) ? "success" : (fail++, "***FAIL***"));
+    printf("BRPeerReactorTests...               ");
+    printf("%s\n", (BRPeerReactorTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRPeerManagerChainTests...          ");
+    printf("%s\n", (BRPeerManagerChainTests()) ? "success" : (fail++, "***FAIL***"));
+    printf("BRPeerManagerHeaderStoreTests...    ");
+    printf("%s\n", (BRPeerManagerHeaderStoreTests(storagePath)) ? "success" : (fail++, "***FAIL***"));
+    printf("BRPeerManagerFilterTests...         ");
+    printf("%s\n", (BRPeerManagerFilterTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRPaymentProtocolTests...           ");
     printf("%s\n", (BRPaymentProtocolTests()) ? "success" : (fail++, "***FAIL***"));
     printf("BRPaymentProtocolEncryptionTests... ");
@@ -3531,6 +5591,14 @@ extern int BRRunTestsSync (const char *paperKey,
 
     printf ("***\n*** PaperKey (Done): \"%s\"\n***\n***\n", paperKey);
     BRPeerManagerDisconnect(pm);
+
+    BRPeerManagerLockStats lockStats[4];
+    const char *lockNames[4] = { "peers", "chain", "filter", "tx" };
+    BRPeerManagerGetLockStats(pm, &lockStats[0], &lockStats[1], &lockStats[2], &lockStats[3]);
+    for (size_t i = 0; i < 4; i++)
+        printf ("*** Lock %-6s: %" PRIu64 " acquired, %" PRIu64 " contended\n", lockNames[i],
+                lockStats[i].acquired, lockStats[i].contended);
+
     BRPeerManagerFree(pm);
     BRWalletFree(wallet);
     if (needPaperKey) free ((char *) paperKey);
@@ -3555,7 +5623,7 @@ void txStatusUpdate(void *info)
 
 int main(int argc, const char *argv[])
 {
-    int r = BRRunTests();
+    int r = BRRunTests((argc > 1) ? argv[1] : ".");
     
 //    int err = 0;
 //    UInt512 seed = UINT512_ZERO;
@@ -14,6 +14,7 @@
 #include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "BRCryptoAmount.h"
@@ -309,6 +310,102 @@ runCryptoTransferTests (void) {
     transferTestsAddress();
 }
 
+///
+/// Mark: BRCryptoWallet Perf Tests
+///
+
+extern void
+runPerfTestsCryptoWallet (size_t transfersCount) {
+    BRCryptoCurrency btc =
+    cryptoCurrencyCreate ("BitcoinPerf",
+                          "Bitcoin",
+                          "BTC",
+                          "native",
+                          NULL);
+
+    BRCryptoUnit sat =
+    cryptoUnitCreateAsBase (btc,
+                            "SatoshiPerf",
+                            "Satoshi",
+                            "SAT");
+
+    BRMasterPubKey mpk = transferTestsGetMPK();
+    BRWallet *wid = BRWalletNew (BRMainNetParams->addrParams, NULL, 0, mpk);
+    BRWalletSetCallbacks (wid, NULL, NULL, NULL, NULL, NULL);
+
+    BRCryptoWallet wallet = cryptoWalletCreateAsBTC (CRYPTO_NETWORK_TYPE_BTC, CRYPTO_WALLET_LISTENER_EMPTY, sat, sat, wid);
+
+    uint8_t sig[] = { 0x01, 0x00 };
+    uint8_t script[] = { 0x76, 0xa9, 0x14, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+                         0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x88, 0xac };
+    UInt256 prevHash = UINT256_ZERO;
+
+    // Transfers as restored from storage: one per transaction, in block order
+    BRArrayOf(BRCryptoTransfer) transfers;
+    array_new (transfers, transfersCount);
+
+    for (size_t index = 0; index < transfersCount; index++) {
+        BRTransaction *tid = BRTransactionNew();
+        BRTransactionAddInput (tid, prevHash, 0, 10000, script, sizeof (script), sig, sizeof (sig), sig, 0, TXIN_SEQUENCE); // empty, non-NULL witness
+        BRTransactionAddOutput (tid, 9000, script, sizeof (script));
+        tid->blockHeight = 500000 + (uint32_t) (index / 8);
+        tid->timestamp   = 1500000000 + (uint32_t) index;
+        BRTransactionSign (tid, 0, NULL, 0); // only computes txHash, since no keys are given
+        assert (! UInt256IsZero (tid->txHash));
+        prevHash = tid->txHash;
+
+        array_add (transfers, cryptoTransferCreateAsBTC (wallet->listenerTransfer, sat, sat, wid, tid, CRYPTO_NETWORK_TYPE_BTC));
+    }
+
+    BRCryptoTransfer *lookups = calloc (transfersCount, sizeof (BRCryptoTransfer));
+    for (size_t index = 0; index < transfersCount; index++)
+        lookups[index] = cryptoTransferTake (transfers[index]);
+
+    clock_t start = clock();
+    cryptoWalletAddTransfers (wallet, transfers); // OwnershipGiven transfers
+    printf ("cryptoWalletAddTransfers() x %zu: %.3fs\n", transfersCount, (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (size_t index = 0; index < transfersCount; index++)
+        assert (CRYPTO_TRUE == cryptoWalletHasTransfer (wallet, lookups[index]));
+    printf ("cryptoWalletHasTransfer() x %zu: %.3fs\n", transfersCount, (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    start = clock();
+    for (size_t index = 0; index < transfersCount; index++) {
+        BRCryptoHash hash = cryptoTransferGetHash (lookups[index]);
+        BRCryptoTransfer transfer = cryptoWalletGetTransferByHash (wallet, hash);
+        assert (transfer == lookups[index]);
+        cryptoTransferGive (transfer);
+        cryptoHashGive (hash);
+    }
+    printf ("cryptoWalletGetTransferByHash() x %zu: %.3fs\n", transfersCount, (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    // The last ten blocks' worth of transfers; eight per block
+    assert (transfersCount >= 80);
+    size_t recentCount;
+    BRCryptoTransfer *recent = cryptoWalletGetTransfersFromBlockNumber (wallet, 500000 + (transfersCount / 8) - 10, &recentCount);
+    assert (recentCount == transfersCount - 8 * (transfersCount / 8 - 10));
+    for (size_t index = 0; index < recentCount; index++) cryptoTransferGive (recent[index]);
+    free (recent);
+
+    start = clock();
+    for (size_t index = 0; index < transfersCount; index += 10)
+        cryptoWalletRemTransfer (wallet, lookups[index]);
+    printf ("cryptoWalletRemTransfer() x %zu: %.3fs\n", (transfersCount + 9) / 10, (double) (clock() - start) / CLOCKS_PER_SEC);
+
+    for (size_t index = 0; index < transfersCount; index++)
+        assert ((0 == index % 10 ? CRYPTO_FALSE : CRYPTO_TRUE) == cryptoWalletHasTransfer (wallet, lookups[index]));
+
+    for (size_t index = 0; index < transfersCount; index++)
+        cryptoTransferGive (lookups[index]);
+    free (lookups);
+
+    cryptoWalletGive (wallet);
+    BRWalletFree (wid);
+    cryptoUnitGive (sat);
+    cryptoCurrencyGive (btc);
+}
+
 ///
 /// Mark: BRCryptoWalletManager Tests
 ///
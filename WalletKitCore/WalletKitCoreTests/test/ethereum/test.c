@@ -27,6 +27,9 @@
 #include "support/event/BREventAlarm.h"
 #include "ethereum/blockchain/BREthereumBlockChain.h"
 #include "ethereum/blockchain/BREthereumAccount.h"
+#include "crypto/BRCryptoTransferP.h"
+#include "crypto/BRCryptoWalletP.h"
+#include "crypto/handlers/eth/BRCryptoETH.h"
 
 #include "test.h"
 
@@ -534,6 +537,293 @@ runPerfTestsCoder (int repeat, int many) {
     rlpCoderRelease(coderSaved);
 }
 
+static double
+runPerfTestsRlpDecodeBlock (BRRlpCoder coder, BRRlpData data, int repeat) {
+    clock_t start = clock();
+    for (int i = 0; i < repeat; i++) {
+        BRRlpItem item = rlpDataGetItem (coder, data);
+        blockRelease (blockRlpDecode (item, ethNetworkMainnet, RLP_TYPE_NETWORK, coder));
+        rlpItemRelease (coder, item);
+    }
+    return (double)(clock() - start)/CLOCKS_PER_SEC;
+}
+
+static double
+runPerfTestsRlpDecodeTransaction (BRRlpCoder coder, BRRlpData data, int repeat) {
+    clock_t start = clock();
+    for (int i = 0; i < repeat; i++) {
+        BRRlpItem item = rlpDataGetItem (coder, data);
+        transactionRelease (transactionRlpDecode (item, ethNetworkMainnet, RLP_TYPE_TRANSACTION_SIGNED, coder));
+        rlpItemRelease (coder, item);
+    }
+    return (double)(clock() - start)/CLOCKS_PER_SEC;
+}
+
+extern void
+runPerfTestsRlpDecode (int repeat, size_t transactionsCount) {
+    BRRlpCoder coder   = rlpCoderCreate();
+    BRRlpCoder compact = rlpCoderCreateCompact();
+
+    BRRlpData transactionData;
+    transactionData.bytes = hexDecodeCreate(&transactionData.bytesCount, TEST_CODER_SIGNED_TX, strlen (TEST_CODER_SIGNED_TX));
+
+    // A block body of `transactionsCount` copies of one transaction, with the genesis header.
+    BRRlpItem item = rlpDataGetItem(coder, transactionData);
+    BREthereumTransaction transaction = transactionRlpDecode(item, ethNetworkMainnet, RLP_TYPE_TRANSACTION_SIGNED, coder);
+    rlpItemRelease (coder, item);
+
+    BRRlpItem *transactionItems = calloc (transactionsCount, sizeof (BRRlpItem));
+    for (size_t i = 0; i < transactionsCount; i++)
+        transactionItems[i] = transactionRlpEncode(transaction, ethNetworkMainnet, RLP_TYPE_TRANSACTION_SIGNED, coder);
+
+    BREthereumBlockHeader genesis = networkGetGenesisBlockHeader (ethNetworkMainnet);
+    item = rlpEncodeList (coder, 3,
+                          blockHeaderRlpEncode (genesis, ETHEREUM_BOOLEAN_TRUE, RLP_TYPE_NETWORK, coder),
+                          rlpEncodeListItems (coder, transactionItems, transactionsCount),
+                          rlpEncodeList (coder, 0));
+    BRRlpData blockData = rlpItemGetData (coder, item);
+    rlpItemRelease (coder, item);
+
+    printf ("blockRlpDecode() x %d, %zu transactions: %.3fs, compact: %.3fs\n", repeat, transactionsCount,
+            runPerfTestsRlpDecodeBlock (coder,   blockData, repeat),
+            runPerfTestsRlpDecodeBlock (compact, blockData, repeat));
+
+    printf ("transactionRlpDecode() x %zu: %.3fs, compact: %.3fs\n", repeat * transactionsCount,
+            runPerfTestsRlpDecodeTransaction (coder,   transactionData, (int) (repeat * transactionsCount)),
+            runPerfTestsRlpDecodeTransaction (compact, transactionData, (int) (repeat * transactionsCount)));
+
+    free (transactionItems);
+    blockHeaderRelease (genesis);
+    transactionRelease (transaction);
+    rlpDataRelease (blockData);
+    rlpDataRelease (transactionData);
+    rlpCoderRelease (compact);
+    rlpCoderRelease (coder);
+}
+
+extern void
+runPerfTestsKeccak (int repeat, size_t headersCount) {
+    BRRlpCoder coder = rlpCoderCreate();
+
+    // `headersCount` copies of the encoded genesis header, back to back, as hashed when a header announcement arrives
+    BREthereumBlockHeader genesis = networkGetGenesisBlockHeader (ethNetworkMainnet);
+    BRRlpItem item = blockHeaderRlpEncode (genesis, ETHEREUM_BOOLEAN_TRUE, RLP_TYPE_NETWORK, coder);
+    BRRlpData headerData = rlpItemGetData (coder, item);
+    rlpItemRelease (coder, item);
+
+    uint8_t *headersBytes = malloc (headersCount * headerData.bytesCount);
+    UInt256 *hashes = calloc (headersCount, sizeof (UInt256));
+    for (size_t i = 0; i < headersCount; i++)
+        memcpy (&headersBytes[i * headerData.bytesCount], headerData.bytes, headerData.bytesCount);
+
+    BREthereumAddress address = ethAddressCreate ("0xb0F225defEc7625C6B5E43126bdDE398bD90eF62");
+    BREthereumBloomFilter filter = bloomFilterCreateAddress (address);
+    size_t matches = 0;
+    clock_t start;
+
+    start = clock();
+    for (int r = 0; r < repeat; r++)
+        for (size_t i = 0; i < headersCount; i++)
+            ethHashCreateFromData ((BRRlpData) { headerData.bytesCount, &headersBytes[i * headerData.bytesCount] });
+    printf ("ethHashCreateFromData() x %zu headers: %.3fs\n", repeat * headersCount,
+            (double)(clock() - start)/CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int r = 0; r < repeat; r++)
+        BRKeccak256Batch (hashes, headersBytes, headerData.bytesCount, headerData.bytesCount, headersCount);
+    printf ("BRKeccak256Batch() x %zu headers: %.3fs\n", repeat * headersCount,
+            (double)(clock() - start)/CLOCKS_PER_SEC);
+
+    // A bloom check against a filter made once, as BCS does, and one that makes the address and topic filters each time
+    start = clock();
+    for (int r = 0; r < repeat; r++)
+        for (size_t i = 0; i < headersCount; i++)
+            matches += ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatch (genesis, filter));
+    printf ("blockHeaderMatch() x %zu: %.3fs\n", repeat * headersCount, (double)(clock() - start)/CLOCKS_PER_SEC);
+
+    start = clock();
+    for (int r = 0; r < repeat; r++)
+        for (size_t i = 0; i < headersCount; i++)
+            matches += ETHEREUM_BOOLEAN_IS_TRUE (blockHeaderMatchAddress (genesis, address));
+    printf ("blockHeaderMatchAddress() x %zu: %.3fs (%zu matches)\n", repeat * headersCount,
+            (double)(clock() - start)/CLOCKS_PER_SEC, matches);
+
+    free (hashes);
+    free (headersBytes);
+    blockHeaderRelease (genesis);
+    rlpDataRelease (headerData);
+    rlpCoderRelease (coder);
+}
+
+//
+// Wallet Nonce Tests
+//
+#define TEST_NONCE_TARGET_ADDR  "0x9595f373a4eae74511561a52998cc6fb4f9c2bdd"   // m/44'/60'/0'/0/1
+#define TEST_NONCE_MANY_COUNT   64
+
+static BRCryptoTransfer
+walletNonceTestsCreateTransfer (BRCryptoWallet wallet,
+                                BREthereumAccount account,
+                                uint8_t tag,
+                                uint64_t nonce,
+                                BRCryptoTransferState state) {
+    // Transfers with the same `tag` share a hash and thus are 'equal' but distinct objects.
+    BREthereumHash ethHash = EMPTY_HASH_INIT;
+    ethHash.bytes[0] = tag;
+
+    BRCryptoHash    hash   = cryptoHashCreateAsETH (ethHash);
+    BRCryptoAmount  amount = cryptoAmountCreateInteger (1, wallet->unit);
+    BRCryptoAddress source = cryptoAddressCreateAsETH (ethAccountGetPrimaryAddress (account));
+    BRCryptoAddress target = cryptoAddressCreateAsETH (ethAddressCreate (TEST_NONCE_TARGET_ADDR));
+
+    BRCryptoTransfer transfer = cryptoTransferCreateAsETH (wallet->listenerTransfer,
+                                                           NULL,
+                                                           hash,
+                                                           wallet->unit,
+                                                           wallet->unitForFee,
+                                                           NULL,
+                                                           amount,
+                                                           source,
+                                                           target,
+                                                           state,
+                                                           account,
+                                                           nonce,
+                                                           NULL);
+    cryptoTransferStateGive (state);
+    cryptoAddressGive (target);
+    cryptoAddressGive (source);
+    cryptoAmountGive (amount);
+    cryptoHashGive (hash);
+
+    return transfer;
+}
+
+static void
+walletNonceTestsCheck (BRCryptoWallet wallet,
+                       BREthereumAccount account,
+                       uint64_t accountNonce,
+                       size_t gapsTotal,
+                       size_t gapsCount,
+                       const uint64_t *gapsExpected) {
+    uint64_t gaps[8];
+    assert (gapsCount <= 8);
+
+    assert (accountNonce == ethAccountGetAddressNonce (account, ethAccountGetPrimaryAddress (account)));
+    assert (gapsTotal == cryptoWalletGetNonceGapsETH (wallet, NULL, 0));
+    assert (gapsTotal == cryptoWalletGetNonceGapsETH (wallet, gaps, gapsCount));
+    for (size_t index = 0; index < gapsCount && index < gapsTotal; index++)
+        assert (gapsExpected[index] == gaps[index]);
+}
+
+static void
+runWalletNonceTests (void) {
+    printf ("==== Wallet Nonce\n");
+
+    BRCryptoCurrency eth  = cryptoCurrencyCreate ("ethereum-mainnet:__native__", "Ethereum", "ETH", "native", NULL);
+    BRCryptoUnit     wei  = cryptoUnitCreateAsBase (eth, "ETH-WEI", "WEI", "wei");
+    BREthereumAccount account = ethAccountCreate (TEST_PAPER_KEY);
+
+    BRCryptoWallet wallet = cryptoWalletCreateAsETH (CRYPTO_WALLET_LISTENER_EMPTY, wei, wei, NULL, account);
+    BRCryptoTransfer transfers[4];
+
+    // Add: nonces { 0, 1, 2 } and then 6, leaving gaps { 3, 4, 5 }
+    for (uint8_t index = 0; index < 3; index++) {
+        transfers[index] = walletNonceTestsCreateTransfer (wallet, account, 1 + index, index,
+                                                           cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+        cryptoWalletAddTransfer (wallet, transfers[index]);
+    }
+    walletNonceTestsCheck (wallet, account, 3, 0, 0, NULL);
+
+    transfers[3] = walletNonceTestsCreateTransfer (wallet, account, 4, 6,
+                                                   cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+    cryptoWalletAddTransfer (wallet, transfers[3]);
+    walletNonceTestsCheck (wallet, account, 7, 3, 3, (uint64_t[]) { 3, 4, 5 });
+    walletNonceTestsCheck (wallet, account, 7, 3, 2, (uint64_t[]) { 3, 4 });   // count past `gapsCount`
+
+    // Remove: the nonce 1 transfer, by way of an equal, but distinct, transfer
+    BRCryptoTransfer other = walletNonceTestsCreateTransfer (wallet, account, 2, 1,
+                                                             cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+    cryptoWalletRemTransfer (wallet, other);
+    cryptoTransferGive (other);
+    walletNonceTestsCheck (wallet, account, 7, 4, 4, (uint64_t[]) { 1, 3, 4, 5 });
+    walletNonceTestsCheck (wallet, account, 7, 4, 1, (uint64_t[]) { 1 });
+
+    // Replace: the nonce 6 transfer, again by way of a distinct transfer, with one at nonce 3
+    other = walletNonceTestsCreateTransfer (wallet, account, 4, 6,
+                                            cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+    BRCryptoTransfer replacement = walletNonceTestsCreateTransfer (wallet, account, 5, 3,
+                                                                   cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+    cryptoWalletReplaceTransfer (wallet, other, cryptoTransferTake (replacement));
+    cryptoTransferGive (other);
+    walletNonceTestsCheck (wallet, account, 4, 1, 1, (uint64_t[]) { 1 });
+
+    // Errored: the nonce 3 transfer no longer holds its nonce; nor does the nonce 0 transfer
+    cryptoTransferSetState (replacement, cryptoTransferStateErroredInit (cryptoTransferSubmitErrorUnknown()));
+    walletNonceTestsCheck (wallet, account, 3, 1, 1, (uint64_t[]) { 1 });
+
+    cryptoTransferSetState (transfers[0], cryptoTransferStateErroredInit (cryptoTransferSubmitErrorUnknown()));
+    walletNonceTestsCheck (wallet, account, 3, 2, 2, (uint64_t[]) { 0, 1 });
+
+    // Remove the rest: no nonces
+    cryptoWalletRemTransfer (wallet, transfers[0]);
+    cryptoWalletRemTransfer (wallet, transfers[2]);
+    cryptoWalletRemTransfer (wallet, replacement);
+    walletNonceTestsCheck (wallet, account, 0, 0, 0, NULL);
+
+    cryptoTransferGive (replacement);
+    for (size_t index = 0; index < 4; index++)
+        cryptoTransferGive (transfers[index]);
+
+    // Many: nonces { 0 ... TEST_NONCE_MANY_COUNT - 1 } added in a shuffled order and then removed
+    // in that same order, which isn't nonce order; the largest remaining nonce must stay on top.
+    BRCryptoTransfer many[TEST_NONCE_MANY_COUNT];
+    uint64_t order[TEST_NONCE_MANY_COUNT], largest = 0;
+    uint32_t seed = 1;
+
+    for (size_t index = 0; index < TEST_NONCE_MANY_COUNT; index++)
+        order[index] = index;
+
+    for (size_t index = TEST_NONCE_MANY_COUNT - 1; index > 0; index--) {
+        seed = seed * 1103515245 + 12345;   // the same shuffle on every run
+        size_t other = (seed >> 16) % (index + 1);
+        uint64_t nonce = order[index];
+        order[index] = order[other];
+        order[other] = nonce;
+    }
+
+    for (size_t index = 0; index < TEST_NONCE_MANY_COUNT; index++) {
+        many[index] = walletNonceTestsCreateTransfer (wallet, account, (uint8_t) (16 + index), order[index],
+                                                      cryptoTransferStateInit (CRYPTO_TRANSFER_STATE_SUBMITTED));
+        cryptoWalletAddTransfer (wallet, many[index]);
+
+        if (order[index] > largest) largest = order[index];
+        walletNonceTestsCheck (wallet, account, largest + 1, (size_t) (largest - index), 0, NULL);
+    }
+
+    for (size_t index = 0; index < TEST_NONCE_MANY_COUNT; index++) {
+        cryptoWalletRemTransfer (wallet, many[index]);
+
+        size_t remaining = TEST_NONCE_MANY_COUNT - index - 1;
+        largest = 0;
+        for (size_t later = index + 1; later < TEST_NONCE_MANY_COUNT; later++)
+            if (order[later] > largest) largest = order[later];
+
+        walletNonceTestsCheck (wallet, account,
+                               (0 == remaining ? 0 : largest + 1),
+                               (0 == remaining ? 0 : (size_t) (largest + 1) - remaining),
+                               0, NULL);
+    }
+
+    for (size_t index = 0; index < TEST_NONCE_MANY_COUNT; index++)
+        cryptoTransferGive (many[index]);
+
+    cryptoWalletGive (wallet);
+    ethAccountRelease (account);
+    cryptoUnitGive (wei);
+    cryptoCurrencyGive (eth);
+    printf ("\n\n");
+}
+
 #if REFACTOR
 extern void
 installTokensForTest (void);
@@ -546,6 +836,7 @@ runTests (int reallySend) {
 
     // Initialize tokens
     runAccountTests();
+    runWalletNonceTests();
 //    testTransactionCodingEther ();
 //    testTransactionCodingToken ();
 
@@ -80,11 +80,9 @@ void rlpCheckInt (BRRlpCoder coder, uint64_t value, uint8_t *result, size_t resu
     rlpItemRelease(coder, item);
 }
 
-void runRlpEncodeTest () {
+void runRlpEncodeTest (BRRlpCoder coder) {
     printf ("         Encode\n");
 
-    BRRlpCoder coder = rlpCoderCreate();
-
     uint8_t s1r[] = RLP_S1_RES;
     rlpCheckString(coder, RLP_S1, s1r, sizeof(s1r));
 
@@ -122,14 +120,13 @@ void runRlpEncodeTest () {
     printf ("    => %s\n", dataHex);
     assert (0 == strcasecmp (dataHex, "8a01439152d319e84d0000"));
     free (dataHex);
+    rlpDataRelease (data);
 
-    rlpCoderRelease(coder);
     printf ("\n");
 }
 
-void runRlpDecodeTest () {
+void runRlpDecodeTest (BRRlpCoder coder) {
     printf ("         Decode\n");
-    BRRlpCoder coder = rlpCoderCreate();
     size_t c;
 
     // cat & dog
@@ -171,12 +168,139 @@ void runRlpDecodeTest () {
     uint64_t v3v = rlpDecodeUInt64(coder, v3i, 0);
     assert (1024 == v3v);
     rlpItemRelease(coder, v3i);
+}
 
-    rlpCoderRelease(coder);
+void runRlpViewTest (BRRlpCoder coder) {
+    printf ("         View\n");
+    size_t c;
+
+    // [ "cat", "dog", [ 1024, "Lorem ..." ] ]
+    BRRlpItem item = rlpEncodeList (coder, 3,
+                                    rlpEncodeString (coder, "cat"),
+                                    rlpEncodeString (coder, "dog"),
+                                    rlpEncodeList2 (coder,
+                                                    rlpEncodeUInt64 (coder, RLP_V3, 0),
+                                                    rlpEncodeString (coder, RLP_S3)));
+    BRRlpData data = rlpItemGetData (coder, item);
+    rlpItemRelease (coder, item);
+
+    item = rlpDataGetItemView (coder, data);
+
+    // The item and its subitems reference `data` directly
+    BRRlpData itemData = rlpItemGetDataSharedDontRelease (coder, item);
+    assert (itemData.bytes == data.bytes && itemData.bytesCount == data.bytesCount);
+
+    const BRRlpItem *items = rlpDecodeList (coder, item, &c);
+    assert (3 == c);
+
+    BRRlpData dogData = rlpDecodeBytesSharedDontRelease (coder, items[1]);
+    assert (dogData.bytes >= data.bytes && dogData.bytes + dogData.bytesCount <= data.bytes + data.bytesCount);
+    assert (3 == dogData.bytesCount && 0 == memcmp (dogData.bytes, "dog", 3));
+
+    char *cat = rlpDecodeString (coder, items[0]);
+    assert (0 == strcmp (cat, "cat"));
+    free (cat);
+
+    const BRRlpItem *subItems = rlpDecodeList (coder, items[2], &c);
+    assert (2 == c);
+    assert (RLP_V3 == rlpDecodeUInt64 (coder, subItems[0], 0));
+    assert (UInt256Eq (uint256Create (RLP_V3), rlpDecodeUInt256 (coder, subItems[0], 0)));
+
+    char *lorem = rlpDecodeString (coder, subItems[1]);
+    assert (0 == strcmp (lorem, RLP_S3));
+    free (lorem);
+
+    // Releasing the view leaves `data` intact
+    rlpItemRelease (coder, item);
+    item = rlpDataGetItem (coder, data);
+    BRRlpData copyData = rlpItemGetData (coder, item);
+    assert (equalBytes (data.bytes, data.bytesCount, copyData.bytes, copyData.bytesCount));
+    rlpDataRelease (copyData);
+    rlpItemRelease (coder, item);
+
+    rlpDataRelease (data);
+}
+
+#define RLP_COMPACT_LIST_COUNT      (5000)
+
+void runRlpCompactTest (void) {
+    printf ("         Compact\n");
+
+    BRRlpCoder coder   = rlpCoderCreate();
+    BRRlpCoder compact = rlpCoderCreateCompact();
+
+    // A list of many lists, with items both smaller and larger than the inline bytes; large
+    // enough to span several arena chunks.
+    BRRlpItem items[RLP_COMPACT_LIST_COUNT];
+    for (size_t index = 0; index < RLP_COMPACT_LIST_COUNT; index++)
+        items[index] = rlpEncodeList (coder, 3,
+                                      rlpEncodeUInt64 (coder, index, 0),
+                                      rlpEncodeString (coder, RLP_S1),
+                                      rlpEncodeString (coder, RLP_S3));
+    BRRlpItem item = rlpEncodeListItems (coder, items, RLP_COMPACT_LIST_COUNT);
+    BRRlpData data = rlpItemGetData (coder, item);
+    rlpItemRelease (coder, item);
+
+    // Decode twice; the second decode reuses the arena reset by the first release.
+    for (size_t repeat = 0; repeat < 2; repeat++) {
+        BRRlpItem compactItem = rlpDataGetItem (compact, data);
+
+        size_t compactItemsCount;
+        const BRRlpItem *compactItems = rlpDecodeList (compact, compactItem, &compactItemsCount);
+        assert (RLP_COMPACT_LIST_COUNT == compactItemsCount);
+
+        for (size_t index = 0; index < compactItemsCount; index++) {
+            size_t c;
+            const BRRlpItem *fields = rlpDecodeList (compact, compactItems[index], &c);
+            assert (3 == c);
+            assert (index == rlpDecodeUInt64 (compact, fields[0], 0));
+
+            char *s1 = rlpDecodeString (compact, fields[1]);
+            char *s3 = rlpDecodeString (compact, fields[2]);
+            assert (0 == strcmp (s1, RLP_S1));
+            assert (0 == strcmp (s3, RLP_S3));
+            free (s1);
+            free (s3);
+        }
+
+        BRRlpData compactData = rlpItemGetData (compact, compactItem);
+        assert (equalBytes (data.bytes, data.bytesCount, compactData.bytes, compactData.bytesCount));
+        rlpDataRelease (compactData);
+
+        rlpItemRelease (compact, compactItem);
+    }
+
+    // Encoding with the compact coder produces the same bytes
+    for (size_t index = 0; index < RLP_COMPACT_LIST_COUNT; index++)
+        items[index] = rlpEncodeList (compact, 3,
+                                      rlpEncodeUInt64 (compact, index, 0),
+                                      rlpEncodeString (compact, RLP_S1),
+                                      rlpEncodeString (compact, RLP_S3));
+    item = rlpEncodeListItems (compact, items, RLP_COMPACT_LIST_COUNT);
+    BRRlpData compactData = rlpItemGetData (compact, item);
+    assert (equalBytes (data.bytes, data.bytesCount, compactData.bytes, compactData.bytesCount));
+    rlpDataRelease (compactData);
+    rlpItemRelease (compact, item);
+
+    rlpDataRelease (data);
+    rlpCoderRelease (compact);
+    rlpCoderRelease (coder);
 }
 
 void runRlpTests (void) {
     printf ("==== RLP\n");
-    runRlpEncodeTest ();
-    runRlpDecodeTest ();
+
+    BRRlpCoder coder = rlpCoderCreate();
+    runRlpEncodeTest (coder);
+    runRlpDecodeTest (coder);
+    runRlpViewTest (coder);
+    rlpCoderRelease(coder);
+
+    coder = rlpCoderCreateCompact();
+    runRlpEncodeTest (coder);
+    runRlpDecodeTest (coder);
+    runRlpViewTest (coder);
+    rlpCoderRelease(coder);
+
+    runRlpCompactTest ();
 }
@@ -70,6 +70,12 @@ runTests (int reallySend);
 extern void
 runPerfTestsCoder (int repeat, int many);
 
+extern void
+runPerfTestsRlpDecode (int repeat, size_t transactionsCount);
+
+extern void
+runPerfTestsKeccak (int repeat, size_t headersCount);
+
 // Bitcoin
 typedef enum {
     BITCOIN_CHAIN_BTC,
@@ -85,7 +91,15 @@ getChainName (BRBitcoinChain chain);
 
 extern int BRRunSupTests (void);
 
-extern int BRRunTests();
+extern int BRRunTests(const char *storagePath);
+
+extern void BRRunPerfTestsWallet (size_t txCount);
+
+extern void BRRunPerfTestsWalletDiscovery (size_t usedCount);
+
+extern void BRRunPerfTestsTransactionSign (size_t inCount);
+
+extern void BRRunPerfTestsHeaders (size_t count);
 
 extern int BRRunTestsSync (const char *paperKey,
                            BRBitcoinChain bitcoinChain,
@@ -115,6 +129,8 @@ extern void BRRandInit (void);
 // testCrypto.c
 extern void runCryptoTests (void);
 
+extern void runPerfTestsCryptoWallet (size_t transfersCount);
+
 extern BRCryptoBoolean
 runCryptoTestsWithAccountAndNetwork (BRCryptoAccount account,
                                      BRCryptoNetwork network,
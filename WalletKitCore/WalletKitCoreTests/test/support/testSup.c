@@ -18,6 +18,9 @@
 #include <string.h>
 
 #include "support/BRFileService.h"
+#include "support/BRSet.h"
+#include "support/BRCrypto.h"
+#include "vendor/sqlite3/sqlite3.h"
 #include "support/BRAssert.h"
 #include "support/BROSCompat.h"
 
@@ -228,6 +231,264 @@ static int runSupFileServiceMultiTests (void) {
     return fileServiceTestDone(path, success);
 }
 
+/// MARK: - File Service Batch Tests
+
+typedef struct {
+    UInt256 hash;
+    uint32_t value;
+} BRFileServiceTestEntity;
+
+static size_t
+fileServiceTestEntityHash (const void *entity) {
+    return (size_t) ((const BRFileServiceTestEntity *) entity)->hash.u32[0];
+}
+
+static int
+fileServiceTestEntityEq (const void *entity1, const void *entity2) {
+    return UInt256Eq (((const BRFileServiceTestEntity *) entity1)->hash,
+                      ((const BRFileServiceTestEntity *) entity2)->hash);
+}
+
+static UInt256
+fileServiceTestEntityIdentifier (BRFileServiceContext context,
+                                 BRFileService fs,
+                                 const void *entity) {
+    return ((const BRFileServiceTestEntity *) entity)->hash;
+}
+
+static uint8_t *
+fileServiceTestEntityWriter (BRFileServiceContext context,
+                             BRFileService fs,
+                             const void* entity,
+                             uint32_t *bytesCount) {
+    const BRFileServiceTestEntity *testEntity = entity;
+    uint8_t *bytes = malloc (sizeof (UInt256) + sizeof (uint32_t));
+
+    memcpy (bytes, testEntity->hash.u8, sizeof (UInt256));
+    UInt32SetBE (&bytes[sizeof (UInt256)], testEntity->value);
+
+    *bytesCount = sizeof (UInt256) + sizeof (uint32_t);
+    return bytes;
+}
+
+static void *
+fileServiceTestEntityReader (BRFileServiceContext context,
+                             BRFileService fs,
+                             uint8_t *bytes,
+                             uint32_t bytesCount) {
+    if (sizeof (UInt256) + sizeof (uint32_t) != bytesCount) return NULL;
+
+    BRFileServiceTestEntity *testEntity = malloc (sizeof (BRFileServiceTestEntity));
+    memcpy (testEntity->hash.u8, bytes, sizeof (UInt256));
+    testEntity->value = UInt32GetBE (&bytes[sizeof (UInt256)]);
+    return testEntity;
+}
+
+static BRFileServiceTestEntity
+fileServiceTestEntityCreate (uint32_t value) {
+    BRFileServiceTestEntity entity = { UINT256_ZERO, value };
+    for (size_t index = 0; index < sizeof (UInt256) / sizeof (uint32_t); index++)
+        entity.hash.u32[index] = value * 31 + (uint32_t) index;
+    return entity;
+}
+
+// Load `type` and check that it holds `count` entities, each with a value matching its hash.
+static int
+fileServiceTestLoad (BRFileService fs, const char *type, size_t count) {
+    BRSet *entities = BRSetNew (fileServiceTestEntityHash, fileServiceTestEntityEq, 100);
+    int success = fileServiceLoad (fs, entities, type, 1);
+
+    success &= (count == BRSetCount (entities));
+
+    FOR_SET (BRFileServiceTestEntity*, entity, entities) {
+        BRFileServiceTestEntity expected = fileServiceTestEntityCreate (entity->value);
+        success &= UInt256Eq (expected.hash, entity->hash);
+    }
+
+    BRSetFreeAll (entities, free);
+    return success;
+}
+
+// Sort in decreasing `value` order; unlike the insertion order.
+static uint64_t
+fileServiceTestEntitySortKey (BRFileServiceContext context,
+                              BRFileService fs,
+                              const void *entity) {
+    return UINT32_MAX - ((const BRFileServiceTestEntity *) entity)->value;
+}
+
+typedef struct {
+    size_t count;
+    size_t limit;
+    int ordered;
+    uint32_t lastValue;
+} BRFileServiceTestIterate;
+
+static int
+fileServiceTestIterateCallback (BRFileServiceContext context,
+                                BRFileService fs,
+                                void *entity) {
+    BRFileServiceTestIterate *iterate = context;
+    BRFileServiceTestEntity *testEntity = entity;
+
+    if (iterate->count > 0 && testEntity->value >= iterate->lastValue)
+        iterate->ordered = 0;
+
+    iterate->lastValue = testEntity->value;
+    iterate->count    += 1;
+    free (testEntity);
+
+    return iterate->count < iterate->limit;
+}
+
+// Create the pre-BLOB 'Entity' table, with hex-encoded `Hash` and `Data`, holding `count` entities.
+static int
+fileServiceTestCreateHexDatabase (const char *dbpath, const char *type, uint32_t count) {
+    sqlite3 *sdb;
+    if (SQLITE_OK != sqlite3_open (dbpath, &sdb)) return 0;
+
+    int success = (SQLITE_OK == sqlite3_exec (sdb,
+                                              "CREATE TABLE Entity("
+                                              " Type CHAR(64) NOT NULL,"
+                                              " Hash CHAR(64) NOT NULL,"
+                                              " Data TEXT NOT NULL,"
+                                              " PRIMARY KEY (Type, Hash));",
+                                              NULL, NULL, NULL));
+
+    for (uint32_t value = 0; success && value < count; value++) {
+        BRFileServiceTestEntity entity = fileServiceTestEntityCreate (value);
+
+        // {HeaderFormatVersion, TypeVersion, EntityBytesCount, EntityBytes}
+        uint8_t data[1 + 1 + 4 + sizeof (UInt256) + 4] = { 0, 0 };
+        UInt32SetBE (&data[2], sizeof (UInt256) + 4);
+        memcpy (&data[6], entity.hash.u8, sizeof (UInt256));
+        UInt32SetBE (&data[6 + sizeof (UInt256)], entity.value);
+
+        char dataHex[2 * sizeof (data) + 1];
+        for (size_t index = 0; index < sizeof (data); index++)
+            sprintf (&dataHex[2 * index], "%02x", data[index]);
+
+        char sql[1024];
+        sprintf (sql, "INSERT INTO Entity (Type, Hash, Data) VALUES ('%s', '%s', '%s');",
+                 type, u256hex (entity.hash), dataHex);
+        success &= (SQLITE_OK == sqlite3_exec (sdb, sql, NULL, NULL, NULL));
+    }
+
+    sqlite3_close (sdb);
+    return success;
+}
+
+static int runSupFileServiceBatchTests (void) {
+    printf ("==== SUP:FileServiceBatch\n");
+
+    struct stat dirStat;
+
+    BRFileService fs;
+    char *path = "private";
+    char *currency = "btc", *network = "mainnet";
+    char *type1 = "foo";
+
+    if (0 == stat  (path, &dirStat)) _rmdir (path);
+    if (0 != mkdir (path, 0700)) return 0;
+
+    // An existing hex-encoded database is migrated on create
+    char dbpath[1024];
+    sprintf (dbpath, "%s/%s-%s-entities.db", path,  currency, network);
+    if (!fileServiceTestCreateHexDatabase (dbpath, type1, 10))
+        return fileServiceTestDone (path, 0);
+
+    fs = fileServiceCreate (path, currency, network, NULL, fileServiceErrorHandler);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    if (1 != fileServiceDefineType (fs, type1, 0, NULL,
+                                    fileServiceTestEntityIdentifier,
+                                    fileServiceTestEntityReader,
+                                    fileServiceTestEntityWriter) ||
+        1 != fileServiceDefineCurrentVersion (fs, type1, 0)) {
+        fileServiceRelease (fs);
+        return fileServiceTestDone (path, 0);
+    }
+
+    int success = 1;
+
+    if (!fileServiceTestLoad (fs, type1, 10)) {
+        fprintf (stderr, "***FAILED*** %s: migrate test\n", __func__);
+        success = 0;
+    }
+
+    // Batch save, including the 10 existing entities
+    size_t count = 1000;
+    BRFileServiceTestEntity entities[count];
+    const void *entityRefs[count];
+    for (size_t index = 0; index < count; index++) {
+        entities[index] = fileServiceTestEntityCreate ((uint32_t) index);
+        entityRefs[index] = &entities[index];
+    }
+
+    if (!fileServiceSaveBatch (fs, type1, entityRefs, count) || !fileServiceTestLoad (fs, type1, count)) {
+        fprintf (stderr, "***FAILED*** %s: save batch test\n", __func__);
+        success = 0;
+    }
+
+    // Remove by (BLOB) identifier
+    if (!fileServiceRemoveByIdentifier (fs, type1, entities[0].hash) || !fileServiceTestLoad (fs, type1, count - 1)) {
+        fprintf (stderr, "***FAILED*** %s: remove test\n", __func__);
+        success = 0;
+    }
+
+    if (!fileServiceReplace (fs, type1, entityRefs, 3) || !fileServiceTestLoad (fs, type1, 3)) {
+        fprintf (stderr, "***FAILED*** %s: replace test\n", __func__);
+        success = 0;
+    }
+
+    fileServiceRelease (fs);
+
+    // Reopen; nothing more to migrate
+    fs = fileServiceCreate (path, currency, network, NULL, fileServiceErrorHandler);
+    if (NULL == fs) return fileServiceTestDone (path, 0);
+
+    fileServiceDefineType (fs, type1, 0, NULL,
+                           fileServiceTestEntityIdentifier,
+                           fileServiceTestEntityReader,
+                           fileServiceTestEntityWriter);
+    fileServiceDefineCurrentVersion (fs, type1, 0);
+
+    if (!fileServiceTestLoad (fs, type1, 3)) {
+        fprintf (stderr, "***FAILED*** %s: reopen test\n", __func__);
+        success = 0;
+    }
+
+    // Iterate; the 3 entities were saved without a sort key and are updated with one
+    fileServiceDefineSortKey (fs, type1, NULL, fileServiceTestEntitySortKey);
+
+    BRFileServiceTestIterate iterate = { 0, SIZE_MAX, 1, 0 };
+    if (fileServiceIsSorted (fs, type1) ||
+        !fileServiceLoadIterate (fs, type1, 1, &iterate, fileServiceTestIterateCallback) || 3 != iterate.count ||
+        !fileServiceIsSorted (fs, type1)) {
+        fprintf (stderr, "***FAILED*** %s: iterate test\n", __func__);
+        success = 0;
+    }
+
+    // Iterate in sort key order, all the way and stopping early
+    iterate = (BRFileServiceTestIterate) { 0, SIZE_MAX, 1, 0 };
+    if (!fileServiceSaveBatch (fs, type1, &entityRefs[3], 100) ||
+        !fileServiceLoadIterate (fs, type1, 1, &iterate, fileServiceTestIterateCallback) ||
+        103 != iterate.count || !iterate.ordered || 0 != iterate.lastValue) {
+        fprintf (stderr, "***FAILED*** %s: iterate sorted test\n", __func__);
+        success = 0;
+    }
+
+    iterate = (BRFileServiceTestIterate) { 0, 10, 1, 0 };
+    if (!fileServiceLoadIterate (fs, type1, 1, &iterate, fileServiceTestIterateCallback) ||
+        10 != iterate.count || !iterate.ordered || 93 != iterate.lastValue) {
+        fprintf (stderr, "***FAILED*** %s: iterate stop test\n", __func__);
+        success = 0;
+    }
+
+    fileServiceRelease (fs);
+    return fileServiceTestDone (path, success);
+}
+
 /// MARK: - Assert Tests
 
 #define DEFAULT_WORKERS     (5)
@@ -517,6 +778,213 @@ runSupAssertTests (void) {
     return success;
 }
 
+/// MARK: - SHA-256 Backend Tests
+
+static void
+supSHA256Hex (char *hex, const uint8_t *md, size_t mdLen) {
+    for (size_t i = 0; i < mdLen; i++) sprintf (&hex[2*i], "%02x", md[i]);
+}
+
+/// Known answers for every combination of the backends the cpu supports, then each combination against the portable
+/// implementation (backends 0) for every message length through several blocks.
+static int runSupSHA256Tests (void) {
+    printf ("==== SUP:SHA256\n");
+
+    struct { const char *data, *md; } kats[] = { // FIPS 180-2
+        { "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+        { "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1" },
+        { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+          "cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1" }
+    };
+    char genesis[] = // the bitcoin genesis block header, whose double-sha-256 is the block hash
+    "\x01\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00"
+    "\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x3b\xa3\xed\xfd\x7a\x7b\x12\xb2\x7a\xc7\x2c\x3e\x67\x76"
+    "\x8f\x61\x7f\xc8\x1b\xc3\x88\x8a\x51\x32\x3a\x9f\xb8\xaa\x4b\x1e\x5e\x4a\x29\xab\x5f\x49\xff\xff\x00"
+    "\x1d\x1d\xac\x2b\x7c";
+    const char *genesisHash = "6fe28c0ab6f1b372c1a6a246ae63f74f931e8365e15a089c68d6190000000000";
+    uint8_t headers[81*9], data[37*303], md[32], ref[32*37], mds[32*37], md28[28], ref28[28];
+    char hex[65];
+    int supported = BRSHA256Backends(), success = 1;
+    size_t i, len;
+
+    printf ("==== SUP:SHA256: backends: %x\n", supported);
+
+    for (i = 0; i < 9; i++) memcpy (&headers[81*i], genesis, 80);
+    for (i = 0; i < sizeof (data); i++) data[i] = (uint8_t) (i*7 + 3);
+
+    for (int backends = 0; backends <= supported; backends++) {
+        if (backends & ~supported) continue;
+        BRSHA256SetBackends (backends);
+
+        for (i = 0; i < sizeof (kats)/sizeof (kats[0]); i++) {
+            BRSHA256 (md, kats[i].data, strlen (kats[i].data));
+            supSHA256Hex (hex, md, sizeof (md));
+            if (0 != strcmp (hex, kats[i].md)) success = 0, printf ("==== SUP:SHA256: %x: KAT %zu failed\n", backends, i);
+        }
+
+        BRSHA256_2Batch (mds, headers, 80, 81, 9); // enough for a run of vector lanes, and some left over
+
+        for (i = 0; i < 9; i++) {
+            supSHA256Hex (hex, &mds[32*i], 32);
+            if (0 != strcmp (hex, genesisHash)) success = 0, printf ("==== SUP:SHA256: %x: genesis %zu failed\n", backends, i);
+        }
+    }
+
+    for (len = 0; len < 300; len++) {
+        BRSHA256SetBackends (0);
+        BRSHA224 (ref28, data, len);
+        BRSHA256_2Batch (ref, data, len, len + 3, 37);
+
+        for (int backends = 1; backends <= supported; backends++) {
+            if (backends & ~supported) continue;
+            BRSHA256SetBackends (backends);
+            BRSHA224 (md28, data, len);
+            BRSHA256_2Batch (mds, data, len, len + 3, 37);
+
+            if (0 != memcmp (md28, ref28, sizeof (md28)) || 0 != memcmp (mds, ref, sizeof (mds)))
+                success = 0, printf ("==== SUP:SHA256: %x: length %zu differs\n", backends, len);
+        }
+    }
+
+    BRSHA256SetBackends (supported);
+    return success;
+}
+
+/// MARK: - Keccak Tests
+
+/// Known answers, batches for every combination of the backends against one message at a time, and the incremental
+/// sponge, finalizing a copy after every update as the LES frame coder MACs do, against one-shot hashes.
+static int runSupKeccakTests (void) {
+    printf ("==== SUP:Keccak\n");
+
+    struct { const char *data, *md; } kats[] = { // keccak-256, as used by ethereum
+        { "", "c5d2460186f7233c927e7db2dcc703c0e500b653ca82273b7bfad8045d85a470" },
+        { "abc", "4e03657aea45a94fc7d47ba826c8d667c0d1e6e33a64a036ec44f58fa12d6c45" },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          "45d3b367a6904e6e8d502ee04999a7c27647f91fa845d456525fd352ae3d7371" },
+        { "abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+          "f519747ed599024f3882238e5ab43960132572b7345fbeb9a90769dafd21ad67" }
+    };
+    uint8_t data[37*403], md[32], ref[32*37], mds[32*37];
+    char hex[65];
+    int supported = BRKeccakBackends(), success = 1;
+    BRKeccakState ctx, copy;
+    size_t i, n, len;
+
+    for (i = 0; i < sizeof (data); i++) data[i] = (uint8_t) (i*7 + 3);
+
+    for (i = 0; i < sizeof (kats)/sizeof (kats[0]); i++) {
+        BRKeccak256 (md, kats[i].data, strlen (kats[i].data));
+        supSHA256Hex (hex, md, sizeof (md));
+        if (0 != strcmp (hex, kats[i].md)) success = 0, printf ("==== SUP:Keccak: KAT %zu failed\n", i);
+    }
+
+    for (len = 0; len < 400; len++) {
+        for (i = 0; i < 37; i++) BRKeccak256 (&ref[32*i], &data[(len + 3)*i], len);
+
+        for (int backends = 0; backends <= supported; backends++) {
+            if (backends & ~supported) continue;
+            BRKeccakSetBackends (backends);
+            BRKeccak256Batch (mds, data, len, len + 3, 37);
+            if (0 != memcmp (mds, ref, sizeof (mds)))
+                success = 0, printf ("==== SUP:Keccak: %x: batch length %zu differs\n", backends, len);
+        }
+    }
+
+    BRKeccakInit (&ctx, 32);
+
+    for (i = 0, n = 1; i < 1000; i += n, n = (n*5 + 3) % 67) { // odd sized updates, crossing word and block bounds
+        BRKeccakUpdate (&ctx, &data[i], n);
+        copy = ctx;
+        BRKeccakFinal (&copy, md);
+        BRKeccak256 (ref, data, i + n);
+        if (0 != memcmp (md, ref, sizeof (md))) success = 0, printf ("==== SUP:Keccak: update to %zu differs\n", i + n);
+    }
+
+    BRKeccakSetBackends (supported);
+    return success;
+}
+
+/// Known answers, then the context, multi-block and chained counter paths against the one-shot functions, for every
+/// combination of the aes backends the cpu supports.
+static int runSupAESTests (void) {
+    printf ("==== SUP:AES\n");
+
+    struct { size_t keyLen; const char *md; } kats[] = { // fips-197 appendix c, key 000102..., plaintext 00112233...
+        { 16, "69c4e0d86a7b0430d8cdb78070b4c55a" },
+        { 24, "dda97ca4864cdfe06eaf70a0ec0d7191" },
+        { 32, "8ea2b7ca516745bfeafc49904b496089" }
+    };
+    uint8_t key[32], plain[16], buf[16], data[1031], ref[1031], out[1031], iv[16], iv2[16], blocks[16*37];
+    char hex[65];
+    int supported = BRAESBackends(), success = 1;
+    BRAESContext ctx;
+    size_t i, n, len;
+
+    for (i = 0; i < sizeof (key); i++) key[i] = (uint8_t) i;
+    for (i = 0; i < sizeof (plain); i++) plain[i] = (uint8_t) (i*0x11);
+    for (i = 0; i < sizeof (data); i++) data[i] = (uint8_t) (i*7 + 3);
+    for (i = 0; i < sizeof (iv); i++) iv[i] = (uint8_t) (0xf0 + i);
+    iv[15] = 0xfe; // the counter carries across bytes within the first few blocks
+
+    for (int backends = 0; backends <= supported; backends++) {
+        if (backends & ~supported) continue;
+        BRAESSetBackends (backends);
+
+        for (i = 0; i < sizeof (kats)/sizeof (kats[0]); i++) {
+            memcpy (buf, plain, sizeof (buf));
+            BRAESECBEncrypt (buf, key, kats[i].keyLen);
+            supSHA256Hex (hex, buf, sizeof (buf));
+            if (0 != strcmp (hex, kats[i].md))
+                success = 0, printf ("==== SUP:AES: %x: KAT %zu encrypt failed\n", backends, i);
+            BRAESECBDecrypt (buf, key, kats[i].keyLen);
+            if (0 != memcmp (buf, plain, sizeof (buf)))
+                success = 0, printf ("==== SUP:AES: %x: KAT %zu decrypt failed\n", backends, i);
+        }
+
+        BRAESContextInit (&ctx, key, 32);
+        memcpy (blocks, data, sizeof (blocks));
+        BRAESContextECBEncrypt (&ctx, blocks, sizeof (blocks));
+
+        for (i = 0; i < sizeof (blocks); i += 16) {
+            memcpy (buf, &data[i], sizeof (buf));
+            BRAESECBEncrypt (buf, key, 32);
+            if (0 != memcmp (buf, &blocks[i], sizeof (buf)))
+                success = 0, printf ("==== SUP:AES: %x: ecb block %zu differs\n", backends, i/16);
+        }
+
+        BRAESContextECBDecrypt (&ctx, blocks, sizeof (blocks));
+        if (0 != memcmp (blocks, data, sizeof (blocks)))
+            success = 0, printf ("==== SUP:AES: %x: ecb decrypt differs\n", backends);
+
+        for (len = 0; len < 200; len++) {
+            BRAESCTR (ref, key, 32, iv, data, len);
+            memcpy (iv2, iv, sizeof (iv2));
+            BRAESContextCTR (&ctx, out, iv2, data, len);
+            if (0 != memcmp (out, ref, len))
+                success = 0, printf ("==== SUP:AES: %x: ctr length %zu differs\n", backends, len);
+        }
+
+        // whole blocks at a time continue the same keystream, as in rlpx frame coding
+        BRAESCTR (ref, key, 32, iv, data, sizeof (data));
+        memcpy (iv2, iv, sizeof (iv2));
+
+        for (i = 0, n = 16; i < sizeof (data); i += n, n = (n*5 + 16) % 112 + 16) {
+            if (n > sizeof (data) - i) n = sizeof (data) - i;
+            BRAESContextCTR (&ctx, &out[i], iv2, &data[i], n);
+        }
+
+        if (0 != memcmp (out, ref, sizeof (out)))
+            success = 0, printf ("==== SUP:AES: %x: chained ctr differs\n", backends);
+        mem_clean (&ctx, sizeof (ctx));
+    }
+
+    BRAESSetBackends (supported);
+    return success;
+}
+
 ///
 /// Support Tests
 ///
@@ -524,8 +992,12 @@ int BRRunSupTests (void) {
     printf ("==== SUP\n");
     int success = 1;
 
+    success &= runSupSHA256Tests ();
+    success &= runSupKeccakTests ();
+    success &= runSupAESTests ();
     success &= runSupFileServiceTests();
     success &= runSupFileServiceMultiTests ();
+    success &= runSupFileServiceBatchTests ();
     success &= runSupAssertTests();
 
     return success;
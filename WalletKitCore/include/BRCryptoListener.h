@@ -76,7 +76,8 @@ cryptoListenerGenerateNetworkEvent (const BRCryptoNetworkListener *listener,
 
 // MARK: - Transfer Listener
 
-// A Hack: Instead Wallet should listen for CRYPTO_TRANSFER_EVENT_CHANGED
+// A Hack: Instead Wallet should listen for CRYPTO_TRANSFER_EVENT_CHANGED.  `newState` is NULL when
+// only the transfer's uids has been assigned.
 typedef void
 (*BRCryptoTransferStateChangedCallback) (BRCryptoWallet wallet,
                                          BRCryptoTransfer transfer,
@@ -27,6 +27,7 @@
 #include "support/BRCrypto.h"
 #include "support/BRBase58.h"
 #include "support/BRInt.h"
+#include "support/BROSCompat.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -44,16 +45,36 @@
 #define BIP38_SCRYPT_EC_R      1
 #define BIP38_SCRYPT_EC_P      1
 
+#if defined(__APPLE__)
+#include <TargetConditionals.h>
+#endif
+
+// the most threads used for the BIP38_SCRYPT_P independent scrypt mixes, each thread needing 128*r*n = 16MB of
+// scratch, so mobile targets default to one thread and 16MB at peak - fewer are used when fewer processors are online
+#if !defined (BIP38_SCRYPT_THREAD_COUNT)
+#if defined(__ANDROID__) || (defined(TARGET_OS_IPHONE) && TARGET_OS_IPHONE)
+#define BIP38_SCRYPT_THREAD_COUNT 1
+#else
+#define BIP38_SCRYPT_THREAD_COUNT 4
+#endif
+#endif
+
 // BIP38 is a method for encrypting private keys with a passphrase
 // https://github.com/bitcoin/bips/blob/master/bip-0038.mediawiki
 
+// scrypt with the BIP38_SCRYPT_* parameters, see BRScryptBatch()
+static void _BRBIP38Scrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen)
+{
+    BRScryptBatch(dk, dkLen, &pw, &pwLen, &salt, &saltLen, BIP38_SCRYPT_N, BIP38_SCRYPT_R, BIP38_SCRYPT_P, 1,
+                  thread_count_brd(BIP38_SCRYPT_THREAD_COUNT));
+}
+
 static UInt256 _BRBIP38DerivePassfactor(uint8_t flag, const uint8_t *entropy, const char *passphrase)
 {
     size_t len = strlen(passphrase);
     UInt256 prefactor, passfactor;
     
-    BRScrypt(&prefactor, sizeof(prefactor), passphrase, len, entropy, (flag & BIP38_LOTSEQUENCE_FLAG) ? 4 : 8,
-             BIP38_SCRYPT_N, BIP38_SCRYPT_R, BIP38_SCRYPT_P);
+    _BRBIP38Scrypt(&prefactor, sizeof(prefactor), passphrase, len, entropy, (flag & BIP38_LOTSEQUENCE_FLAG) ? 4 : 8);
     
     if (flag & BIP38_LOTSEQUENCE_FLAG) { // passfactor = SHA256(SHA256(prefactor + entropy))
         uint8_t d[sizeof(prefactor) + sizeof(uint64_t)];
@@ -129,8 +150,7 @@ int BRKeySetBIP38Key(BRKey *key, const char *bip38Key, const char *passphrase, B
         // data = prefix + flag + addresshash + encrypted1 + encrypted2
         UInt128 encrypted1 = UInt128Get(&data[7]), encrypted2 = UInt128Get(&data[23]);
 
-        BRScrypt(&derived, sizeof(derived), passphrase, pwLen, addresshash, sizeof(uint32_t),
-                 BIP38_SCRYPT_N, BIP38_SCRYPT_R, BIP38_SCRYPT_P);
+        _BRBIP38Scrypt(&derived, sizeof(derived), passphrase, pwLen, addresshash, sizeof(uint32_t));
         derived1 = *(UInt256 *)&derived, derived2 = *(UInt256 *)&derived.u8[sizeof(UInt256)];
         var_clean(&derived);
         
@@ -238,8 +258,7 @@ size_t BRKeyBIP38Key(BRKey *key, char *bip38Key, size_t bip38KeyLen, const char
     BRSHA256_2(&hash, address.s, strlen(address.s));
     salt = hash.u32[0];
 
-    BRScrypt(&derived, sizeof(derived), passphrase, strlen(passphrase), &salt, sizeof(salt),
-             BIP38_SCRYPT_N, BIP38_SCRYPT_R, BIP38_SCRYPT_P);
+    _BRBIP38Scrypt(&derived, sizeof(derived), passphrase, strlen(passphrase), &salt, sizeof(salt));
     derived1 = *(UInt256 *)&derived, derived2 = *(UInt256 *)&derived.u8[sizeof(UInt256)];
     var_clean(&derived);
     
@@ -154,6 +154,15 @@ void BRBloomFilterInsertData(BRBloomFilter *filter, const uint8_t *data, size_t
     if (data) filter->elemCount++;
 }
 
+// the expected false positive rate of filter given the number of elements inserted so far
+double BRBloomFilterFalsePositiveRate(const BRBloomFilter *filter)
+{
+    assert(filter != NULL);
+    
+    // (1 - e^(-k*n/m))^k, for k hash functions, n elements and m bits
+    return pow(1.0 - exp(-(double)filter->hashFuncs*filter->elemCount/(filter->length*8.0)), filter->hashFuncs);
+}
+
 // frees memory allocated for filter
 void BRBloomFilterFree(BRBloomFilter *filter)
 {
@@ -72,6 +72,9 @@ int BRBloomFilterContainsData(const BRBloomFilter *filter, const uint8_t *data,
 // add data to filter
 void BRBloomFilterInsertData(BRBloomFilter *filter, const uint8_t *data, size_t dataLen);
 
+// the expected false positive rate of filter given the number of elements inserted so far
+double BRBloomFilterFalsePositiveRate(const BRBloomFilter *filter);
+
 // frees memory allocated for filter
 void BRBloomFilterFree(BRBloomFilter *filter);
 
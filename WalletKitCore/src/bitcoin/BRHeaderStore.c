@@ -0,0 +1,292 @@
+//
+//  BRHeaderStore.c
+//  Core
+//
+//  Copyright © 2020 Breadwallet AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#include "BRHeaderStore.h"
+#include "support/BRCrypto.h"
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HEADER_STORE_HEIGHT_OFFSET 80
+#define HEADER_STORE_WORK_OFFSET   (HEADER_STORE_HEIGHT_OFFSET + sizeof(uint32_t))
+#define HEADER_STORE_MAP_RECORDS   4096 // the mapping grows by this many records at a time
+#define HEADER_STORE_CHECK_RECORDS 1024 // records hashed in one batch when checking the file on opening
+
+// not thread-safe, callers must serialize access to a store
+struct BRHeaderStoreStruct {
+    int fd;
+    uint8_t *map; // mapping of mapCount records, of which the first count are in the file
+    size_t mapCount;
+    size_t count;
+};
+
+// maps enough of the file for at least count records, returns false on failure
+static int _BRHeaderStoreMap(BRHeaderStore *store, size_t count)
+{
+    size_t mapCount = (count/HEADER_STORE_MAP_RECORDS + 1)*HEADER_STORE_MAP_RECORDS;
+    void *map;
+
+    if (store->map && mapCount <= store->mapCount) return 1;
+    // mapping past the end of the file is fine, as only records already written are ever read
+    map = mmap(NULL, mapCount*HEADER_STORE_RECORD_SIZE, PROT_READ, MAP_SHARED, store->fd, 0);
+    if (map == MAP_FAILED) return 0;
+    if (store->map) munmap(store->map, store->mapCount*HEADER_STORE_RECORD_SIZE);
+    store->map = map;
+    store->mapCount = mapCount;
+    return 1;
+}
+
+// returns the record for the given height, or NULL if it isn't in store
+static const uint8_t *_BRHeaderStoreRecord(const BRHeaderStore *store, uint32_t height)
+{
+    uint32_t start;
+
+    if (store->count == 0) return NULL;
+    start = UInt32GetLE(&store->map[HEADER_STORE_HEIGHT_OFFSET]);
+    if (height < start || height - start >= store->count) return NULL;
+    return &store->map[(height - start)*HEADER_STORE_RECORD_SIZE];
+}
+
+// the proof-of-work represented by a block with the given compact target, 2^256/target, which is within one of
+// 2^256/(target + 1) for any target above 2^128
+static UInt256 _BRHeaderStoreWork(uint32_t target)
+{
+    uint32_t size = target >> 24, mantissa = target & 0x007fffff;
+    int shift = 256 - 8*((int)size - 3); // 2^256/target == 2^shift/mantissa
+    uint32_t n[8] = { 0 };
+    uint64_t r = 0;
+    UInt256 work = UINT256_ZERO;
+
+    if (mantissa == 0 || shift < 0) return work;
+    if (shift > 255) shift = 255;
+    n[shift/32] = (uint32_t)1 << (shift % 32);
+
+    for (int i = 7; i >= 0; i--) { // long division, most significant word first
+        r = (r << 32) | n[i];
+        UInt32SetLE(&work.u8[i*sizeof(uint32_t)], (uint32_t)(r/mantissa));
+        r %= mantissa;
+    }
+
+    return work;
+}
+
+// returns a + b, as little endian 256bit integers
+static UInt256 _BRHeaderStoreWorkAdd(UInt256 a, UInt256 b)
+{
+    uint64_t carry = 0;
+    UInt256 sum;
+
+    for (size_t i = 0; i < sizeof(sum)/sizeof(uint32_t); i++) {
+        carry += (uint64_t)UInt32GetLE(&a.u8[i*sizeof(uint32_t)]) + UInt32GetLE(&b.u8[i*sizeof(uint32_t)]);
+        UInt32SetLE(&sum.u8[i*sizeof(uint32_t)], (uint32_t)carry);
+        carry >>= 32;
+    }
+
+    return sum;
+}
+
+// returns the number of records from the start of store that form an unbroken chain, where each record has a valid
+// target and follows the one before it by height, block hash and chain work - records are checked walking back from
+// the end of the file a batch at a time, so the result is the lowest break found anywhere in the file
+static size_t _BRHeaderStoreCheck(const BRHeaderStore *store)
+{
+    UInt256 hashes[HEADER_STORE_CHECK_RECORDS + 1], work, prevWork;
+    size_t count = store->count, first, start, end, i;
+    const uint8_t *record, *prev;
+
+    for (end = store->count; end > 0; end = first) {
+        first = (end > HEADER_STORE_CHECK_RECORDS) ? end - HEADER_STORE_CHECK_RECORDS : 0;
+        start = (first > 0) ? first - 1 : 0; // the record before the batch is hashed to check the link to it
+        BRSHA256_2Batch(hashes, &store->map[start*HEADER_STORE_RECORD_SIZE], 80, HEADER_STORE_RECORD_SIZE,
+                        end - start);
+
+        for (i = end; i > first; i--) {
+            record = &store->map[(i - 1)*HEADER_STORE_RECORD_SIZE];
+            prev = (i - 1 > 0) ? record - HEADER_STORE_RECORD_SIZE : NULL;
+            work = _BRHeaderStoreWork(UInt32GetLE(&record[72]));
+            prevWork = (prev) ? UInt256Get(&prev[HEADER_STORE_WORK_OFFSET]) : UINT256_ZERO;
+
+            if (UInt256IsZero(work) || // a zeroed record, or one with no valid target
+                ! UInt256Eq(UInt256Get(&record[HEADER_STORE_WORK_OFFSET]), _BRHeaderStoreWorkAdd(prevWork, work)) ||
+                (prev && (UInt32GetLE(&prev[HEADER_STORE_HEIGHT_OFFSET]) + 1 !=
+                          UInt32GetLE(&record[HEADER_STORE_HEIGHT_OFFSET]) ||
+                          ! UInt256Eq(UInt256Get(&record[4]), hashes[i - 2 - start])))) count = i - 1;
+        }
+    }
+
+    return count;
+}
+
+// opens or creates the header store at path, dropping any partially written record at the end of the file, and any
+// records from the first one that doesn't follow the chain before it
+// returns a newly allocated header store that must be freed by calling BRHeaderStoreFree(), or NULL on failure
+BRHeaderStore *BRHeaderStoreNew(const char *path)
+{
+    BRHeaderStore *store = calloc(1, sizeof(*store));
+    struct stat st;
+    size_t count;
+
+    assert(store != NULL);
+    assert(path != NULL);
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if (store->fd >= 0 && fstat(store->fd, &st) == 0) {
+        store->count = (size_t)st.st_size/HEADER_STORE_RECORD_SIZE;
+
+        if ((size_t)st.st_size != store->count*HEADER_STORE_RECORD_SIZE &&
+            ftruncate(store->fd, (off_t)(store->count*HEADER_STORE_RECORD_SIZE)) != 0) store->count = 0;
+    }
+
+    if (store->fd < 0 || ! _BRHeaderStoreMap(store, store->count)) {
+        if (store->fd >= 0) close(store->fd);
+        free(store);
+        store = NULL;
+    }
+    else if ((count = _BRHeaderStoreCheck(store)) < store->count) { // a torn write, or a damaged file
+        store->count = (ftruncate(store->fd, (off_t)(count*HEADER_STORE_RECORD_SIZE)) == 0) ? count : 0;
+    }
+
+    return store;
+}
+
+// number of headers in store
+size_t BRHeaderStoreCount(const BRHeaderStore *store)
+{
+    assert(store != NULL);
+    return store->count;
+}
+
+// height of the first header in store, or BLOCK_UNKNOWN_HEIGHT if store is empty
+uint32_t BRHeaderStoreStartHeight(const BRHeaderStore *store)
+{
+    assert(store != NULL);
+    return (store->count > 0) ? UInt32GetLE(&store->map[HEADER_STORE_HEIGHT_OFFSET]) : BLOCK_UNKNOWN_HEIGHT;
+}
+
+// height of the last header in store, or BLOCK_UNKNOWN_HEIGHT if store is empty
+uint32_t BRHeaderStoreLastHeight(const BRHeaderStore *store)
+{
+    assert(store != NULL);
+    return (store->count > 0) ? BRHeaderStoreStartHeight(store) + (uint32_t)store->count - 1 : BLOCK_UNKNOWN_HEIGHT;
+}
+
+// writes the block hash of the header at the given height to hash, returns false if it isn't in store
+int BRHeaderStoreHash(const BRHeaderStore *store, uint32_t height, UInt256 *hash)
+{
+    const uint8_t *record;
+
+    assert(store != NULL);
+    assert(hash != NULL);
+    record = _BRHeaderStoreRecord(store, height);
+    if (record) BRSHA256_2(hash, record, 80);
+    return (record != NULL);
+}
+
+// writes the chain work from the first header in store through the one at the given height to work, returns false if
+// it isn't in store
+int BRHeaderStoreChainWork(const BRHeaderStore *store, uint32_t height, UInt256 *work)
+{
+    const uint8_t *record;
+
+    assert(store != NULL);
+    assert(work != NULL);
+    record = _BRHeaderStoreRecord(store, height);
+    if (record) *work = UInt256Get(&record[HEADER_STORE_WORK_OFFSET]);
+    return (record != NULL);
+}
+
+// returns a newly allocated header-only block for the given height that must be freed by calling BRMerkleBlockFree(),
+// or NULL if it isn't in store
+BRMerkleBlock *BRHeaderStoreBlock(const BRHeaderStore *store, uint32_t height)
+{
+    const uint8_t *record;
+    BRMerkleBlock *block = NULL;
+
+    assert(store != NULL);
+    record = _BRHeaderStoreRecord(store, height);
+    if (record) block = BRMerkleBlockParse(record, 80);
+    if (block) block->height = height;
+    return block;
+}
+
+// appends the header of block to store, block must either be the first of an empty store, or directly follow the last
+// header in store - returns false if it doesn't, or if writing to the file failed
+int BRHeaderStoreAppend(BRHeaderStore *store, const BRMerkleBlock *block)
+{
+    uint8_t record[HEADER_STORE_RECORD_SIZE];
+    const uint8_t *last;
+    UInt256 hash, work;
+
+    assert(store != NULL);
+    assert(block != NULL);
+    if (block->height == BLOCK_UNKNOWN_HEIGHT) return 0;
+    last = (store->count > 0) ? &store->map[(store->count - 1)*HEADER_STORE_RECORD_SIZE] : NULL;
+
+    if (last) {
+        BRSHA256_2(&hash, last, 80);
+        if (UInt32GetLE(&last[HEADER_STORE_HEIGHT_OFFSET]) + 1 != block->height ||
+            ! UInt256Eq(hash, block->prevBlock)) return 0;
+    }
+
+    UInt32SetLE(&record[0], block->version);
+    UInt256Set(&record[4], block->prevBlock);
+    UInt256Set(&record[36], block->merkleRoot);
+    UInt32SetLE(&record[68], block->timestamp);
+    UInt32SetLE(&record[72], block->target);
+    UInt32SetLE(&record[76], block->nonce);
+    BRSHA256_2(&hash, record, 80);
+    if (! UInt256Eq(hash, block->blockHash)) return 0; // checkpoint blocks don't carry a complete header
+    UInt32SetLE(&record[HEADER_STORE_HEIGHT_OFFSET], block->height);
+    work = _BRHeaderStoreWork(block->target);
+    if (last) work = _BRHeaderStoreWorkAdd(UInt256Get(&last[HEADER_STORE_WORK_OFFSET]), work);
+    UInt256Set(&record[HEADER_STORE_WORK_OFFSET], work);
+
+    // on failure, anything written is overwritten by the next append, or dropped when the store is reopened
+    if (pwrite(store->fd, record, sizeof(record), (off_t)(store->count*sizeof(record))) != sizeof(record) ||
+        ! _BRHeaderStoreMap(store, store->count + 1)) return 0;
+    store->count++;
+    return 1;
+}
+
+// removes the headers at and above the given height from store, returns false if writing to the file failed
+int BRHeaderStoreTruncate(BRHeaderStore *store, uint32_t height)
+{
+    uint32_t start;
+    size_t count;
+
+    assert(store != NULL);
+    if (store->count == 0) return 1;
+    start = BRHeaderStoreStartHeight(store);
+    count = (height <= start) ? 0 : height - start;
+    if (count >= store->count) return 1;
+    if (ftruncate(store->fd, (off_t)(count*HEADER_STORE_RECORD_SIZE)) != 0) return 0;
+    store->count = count;
+    return 1;
+}
+
+// flushes headers appended to or truncated from store to disk, returns false on failure
+int BRHeaderStoreSync(BRHeaderStore *store)
+{
+    assert(store != NULL);
+    return (fsync(store->fd) == 0);
+}
+
+// unmaps and closes store, and frees memory allocated for it
+void BRHeaderStoreFree(BRHeaderStore *store)
+{
+    assert(store != NULL);
+    if (store->map) munmap(store->map, store->mapCount*HEADER_STORE_RECORD_SIZE);
+    close(store->fd);
+    free(store);
+}
@@ -0,0 +1,73 @@
+//
+//  BRHeaderStore.h
+//  Core
+//
+//  Copyright © 2020 Breadwallet AG. All rights reserved.
+//
+//  See the LICENSE file at the project root for license information.
+//  See the CONTRIBUTORS file at the project root for a list of contributors.
+//
+
+#ifndef BRHeaderStore_h
+#define BRHeaderStore_h
+
+#include "BRMerkleBlock.h"
+#include "support/BRInt.h"
+#include <stddef.h>
+#include <inttypes.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// a header store is a file of fixed size records, one per block of a contiguous run of the main chain, each holding
+// the 80 byte block header, the block height, and the chain work from the first record through that block - the file
+// is memory mapped, so looking up a header by height needs no parsing or allocation beyond the record being read
+#define HEADER_STORE_RECORD_SIZE (80 + sizeof(uint32_t) + sizeof(UInt256))
+
+typedef struct BRHeaderStoreStruct BRHeaderStore;
+
+// opens or creates the header store at path, dropping any partially written record at the end of the file, and any
+// records from the first one that doesn't follow the chain before it
+// returns a newly allocated header store that must be freed by calling BRHeaderStoreFree(), or NULL on failure
+BRHeaderStore *BRHeaderStoreNew(const char *path);
+
+// number of headers in store
+size_t BRHeaderStoreCount(const BRHeaderStore *store);
+
+// height of the first header in store, or BLOCK_UNKNOWN_HEIGHT if store is empty
+uint32_t BRHeaderStoreStartHeight(const BRHeaderStore *store);
+
+// height of the last header in store, or BLOCK_UNKNOWN_HEIGHT if store is empty
+uint32_t BRHeaderStoreLastHeight(const BRHeaderStore *store);
+
+// writes the block hash of the header at the given height to hash, returns false if it isn't in store
+int BRHeaderStoreHash(const BRHeaderStore *store, uint32_t height, UInt256 *hash);
+
+// writes the chain work from the first header in store through the one at the given height to work (as a little
+// endian 256bit integer), returns false if it isn't in store
+int BRHeaderStoreChainWork(const BRHeaderStore *store, uint32_t height, UInt256 *work);
+
+// returns a newly allocated header-only block for the given height that must be freed by calling BRMerkleBlockFree(),
+// or NULL if it isn't in store
+BRMerkleBlock *BRHeaderStoreBlock(const BRHeaderStore *store, uint32_t height);
+
+// appends the header of block to store, block must either be the first of an empty store, or directly follow the last
+// header in store - returns false if it doesn't, or if writing to the file failed
+int BRHeaderStoreAppend(BRHeaderStore *store, const BRMerkleBlock *block);
+
+// removes the headers at and above the given height from store, returns false if writing to the file failed
+int BRHeaderStoreTruncate(BRHeaderStore *store, uint32_t height);
+
+// flushes headers appended to or truncated from store to disk, returns false on failure - appending and truncating
+// don't, so that callers can flush once for a batch of headers
+int BRHeaderStoreSync(BRHeaderStore *store);
+
+// unmaps and closes store, and frees memory allocated for it
+void BRHeaderStoreFree(BRHeaderStore *store);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // BRHeaderStore_h
@@ -26,6 +26,7 @@
 #include "support/BRBase.h"
 #include "support/BRCrypto.h"
 #include "support/BRAddress.h"
+#include "support/BROSCompat.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -34,6 +35,7 @@
 
 #define MAX_PROOF_OF_WORK 0x1d00ffff    // highest value for difficulty target (higher values are less difficult)
 #define TARGET_TIMESPAN   (14*24*60*60) // the targeted timespan between difficulty target adjustments
+#define PARSE_MIN_PER_THREAD 250        // the fewest blocks worth parsing on a thread of their own
 
 inline static int _ceil_log2(int x)
 {
@@ -97,9 +99,8 @@ BRMerkleBlock *BRMerkleBlockCopy(const BRMerkleBlock *block)
     return cpy;
 }
 
-// buf must contain either a serialized merkleblock or header
-// returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
-BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen)
+// parses a block whose hash, if already known, is given in blockHash
+static BRMerkleBlock *_BRMerkleBlockParse(const uint8_t *buf, size_t bufLen, const UInt256 *blockHash)
 {
     BRMerkleBlock *block = (buf && 80 <= bufLen) ? BRMerkleBlockNew() : NULL;
     size_t off = 0, len = 0;
@@ -137,7 +138,8 @@ BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen)
             off += len;
         }
         
-        BRSHA256_2(&block->blockHash, buf, 80);
+        if (blockHash) block->blockHash = *blockHash;
+        else BRSHA256_2(&block->blockHash, buf, 80);
 
         if (off > bufLen) {
             BRMerkleBlockFree(block);
@@ -148,6 +150,13 @@ BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen)
     return block;
 }
 
+// buf must contain either a serialized merkleblock or header
+// returns a merkle block struct that must be freed by calling BRMerkleBlockFree()
+BRMerkleBlock *BRMerkleBlockParse(const uint8_t *buf, size_t bufLen)
+{
+    return _BRMerkleBlockParse(buf, bufLen, NULL);
+}
+
 // returns number of bytes written to buf, or total bufLen needed if buf is NULL (block->height is not serialized)
 size_t BRMerkleBlockSerialize(const BRMerkleBlock *block, uint8_t *buf, size_t bufLen)
 {
@@ -304,6 +313,66 @@ int BRMerkleBlockIsValid(const BRMerkleBlock *block, uint32_t currentTime)
     return r;
 }
 
+typedef struct {
+    BRMerkleBlock **blocks;
+    int *results;
+    const uint8_t *buf;
+    size_t bufLen;
+    uint32_t currentTime;
+    size_t first, last; // the blocks for a worker are first through last - 1
+} _BRMerkleBlockParseWork;
+
+static void *_BRMerkleBlockParseWorker(void *info)
+{
+    _BRMerkleBlockParseWork *work = info;
+    size_t count = work->last - work->first;
+    UInt256 *hashes = (count > 0 && work->bufLen >= 80) ? malloc(count*sizeof(*hashes)) : NULL;
+
+    // block hashes are the double-sha-256 of the 80 byte headers, which are hashed several at once where supported
+    if (hashes) BRSHA256_2Batch(hashes, &work->buf[work->first*work->bufLen], 80, work->bufLen, count);
+
+    for (size_t i = work->first; i < work->last; i++) {
+        work->blocks[i] = _BRMerkleBlockParse(&work->buf[i*work->bufLen], work->bufLen,
+                                              (hashes) ? &hashes[i - work->first] : NULL);
+        work->results[i] = (work->blocks[i] && BRMerkleBlockIsValid(work->blocks[i], work->currentTime));
+    }
+
+    if (hashes) free(hashes);
+    return NULL;
+}
+
+// parses count consecutive serialized merkleblocks or headers of bufLen bytes each from buf, setting blocks[i] to the
+// parsed block, or NULL if malformed, and results[i] to BRMerkleBlockIsValid(blocks[i], currentTime)
+// parsing and validation run on up to threadCount threads, including the caller's, and blocks keep the order of buf
+// returns the number of valid blocks, all non-NULL blocks must be freed by calling BRMerkleBlockFree()
+size_t BRMerkleBlockParseBatch(BRMerkleBlock *blocks[], int results[], const uint8_t *buf, size_t bufLen, size_t count,
+                               uint32_t currentTime, size_t threadCount)
+{
+    size_t i, r = 0;
+
+    assert(blocks != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    assert(buf != NULL || count == 0);
+    if (threadCount > (count + PARSE_MIN_PER_THREAD - 1)/PARSE_MIN_PER_THREAD)
+        threadCount = (count + PARSE_MIN_PER_THREAD - 1)/PARSE_MIN_PER_THREAD;
+    if (threadCount < 1) threadCount = 1;
+
+    _BRMerkleBlockParseWork work[threadCount];
+
+    for (i = 0; i < threadCount; i++) { // each thread gets a contiguous run of blocks, for batch hashing
+        work[i] = (_BRMerkleBlockParseWork) { blocks, results, buf, bufLen, currentTime, count*i/threadCount,
+                                              count*(i + 1)/threadCount };
+    }
+
+    run_parallel_brd(_BRMerkleBlockParseWorker, work, sizeof(*work), threadCount);
+
+    for (i = 0; i < count; i++) {
+        if (results[i]) r++;
+    }
+
+    return r;
+}
+
 // true if the given tx hash is known to be included in the block
 int BRMerkleBlockContainsTxHash(const BRMerkleBlock *block, UInt256 txHash)
 {
@@ -82,6 +82,13 @@ void BRMerkleBlockSetTxHashes(BRMerkleBlock *block, const UInt256 hashes[], size
 // target is correct for the block's height in the chain - use BRMerkleBlockVerifyDifficulty() for that
 int BRMerkleBlockIsValid(const BRMerkleBlock *block, uint32_t currentTime);
 
+// parses count consecutive serialized merkleblocks or headers of bufLen bytes each from buf, setting blocks[i] to the
+// parsed block, or NULL if malformed, and results[i] to BRMerkleBlockIsValid(blocks[i], currentTime)
+// parsing and validation run on up to threadCount threads, including the caller's, and blocks keep the order of buf
+// returns the number of valid blocks, all non-NULL blocks must be freed by calling BRMerkleBlockFree()
+size_t BRMerkleBlockParseBatch(BRMerkleBlock *blocks[], int results[], const uint8_t *buf, size_t bufLen, size_t count,
+                               uint32_t currentTime, size_t threadCount);
+
 // true if the given tx hash is known to be included in the block
 int BRMerkleBlockContainsTxHash(const BRMerkleBlock *block, UInt256 txHash);
 
@@ -30,6 +30,7 @@
 #include "support/BRArray.h"
 #include "support/BRCrypto.h"
 #include "support/BRInt.h"
+#include "support/BROSCompat.h"
 #include <stdlib.h>
 #include <float.h>
 #include <inttypes.h>
@@ -39,6 +40,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <netdb.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <sys/time.h>
 #include <netinet/in.h>	
@@ -57,6 +59,12 @@
 
 #define PTHREAD_STACK_SIZE  (512 * 1024)
 
+// the most threads used to parse and validate the headers in a headers message, see BRMerkleBlockParseBatch()
+// fewer are used when fewer processors are online
+#if !defined (PEER_HEADERS_THREAD_COUNT)
+#define PEER_HEADERS_THREAD_COUNT 4
+#endif
+
 // the standard blockchain download protocol works as follows (for SPV mode):
 // - local peer sends getblocks
 // - remote peer reponds with inv containing up to 500 block hashes
@@ -95,6 +103,8 @@ typedef enum {
     inv_filtered_witness_block = inv_filtered_block | WITNESS_FLAG
 } inv_type;
 
+typedef struct BRPeerReactorLoopStruct BRPeerReactorLoop;
+
 typedef struct {
     BRPeer peer; // superstruct on top of BRPeer
     uint32_t magicNumber;
@@ -131,6 +141,16 @@ typedef struct {
     void (**volatile pongCallback)(void *info, int success);
     void *volatile mempoolInfo;
     void (*volatile mempoolCallback)(void *info, int success);
+    BRPeerReactor *reactor;
+    BRPeerReactorLoop *volatile reactorLoop; // set while the peer is handled by reactor
+    int reactorState;
+    volatile int reactorDisconnect;
+    int reactorReconnect; // set when BRPeerConnect() is called while a reactor disconnect is pending
+    uint8_t header[HEADER_LENGTH], *payload; // partially read message, when handled by reactor
+    size_t headerLen, payloadLen, payloadCapacity;
+    uint8_t *sendBuf; // queued outgoing bytes, from sendOff on, when handled by reactor; guarded by lock
+    size_t sendOff;
+    double msgTimeout, sendTimeout;
     pthread_t thread;
     pthread_mutex_t lock;
 } BRPeerContext;
@@ -495,14 +515,26 @@ static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t
             }
             else BRPeerSendGetheaders(peer, locators, 2, UINT256_ZERO);
 
-            for (size_t i = 0; r && i < count; i++) {
-                BRMerkleBlock *block = BRMerkleBlockParse(&msg[off + 81*i], 81);
+            // headers are parsed and their proof-of-work checked in parallel, then relayed in order
+            BRMerkleBlock **blocks = malloc(count*sizeof(*blocks));
+            int *valid = malloc(count*sizeof(*valid));
+
+            assert(blocks != NULL);
+            assert(valid != NULL);
+            BRMerkleBlockParseBatch(blocks, valid, &msg[off], 81, count, (uint32_t)now,
+                                    thread_count_brd(PEER_HEADERS_THREAD_COUNT));
+
+            for (size_t i = 0; i < count; i++) {
+                BRMerkleBlock *block = blocks[i];
                 
-                if (! block) {
+                if (! r) { // headers after a bad one aren't relayed
+                    if (block) BRMerkleBlockFree(block);
+                }
+                else if (! block) {
                     peer_log(peer, "malformed headers message with length: %zu", msgLen);
                     r = 0;
                 }
-                else if (! BRMerkleBlockIsValid(block, (uint32_t)now)) {
+                else if (! valid[i]) {
                     peer_log(peer, "invalid block header: %s", u256hex(block->blockHash));
                     BRMerkleBlockFree(block);
                     r = 0;
@@ -512,6 +544,9 @@ static int _BRPeerAcceptHeadersMessage(BRPeer *peer, const uint8_t *msg, size_t
                 }
                 else BRMerkleBlockFree(block);
             }
+
+            free(valid);
+            free(blocks);
         }
         else {
             peer_log(peer, "non-standard headers message, %zu is fewer header(s) than expected", count);
@@ -865,20 +900,23 @@ static int _BRPeerAcceptMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen,
     return r;
 }
 
-static int _BRPeerOpenSocket(BRPeer *peer, int domain, double timeout, int *error)
+// creates a socket in ctx->socket and starts a non-blocking connect, setting inProgress if the connect has not yet
+// completed - in which case the socket becomes writable once it has
+static int _BRPeerStartConnect(BRPeer *peer, int domain, int *inProgress, int *error)
 {
     BRPeerContext *ctx = (BRPeerContext *)peer;
     struct sockaddr_storage addr;
     struct timeval tv;
-    fd_set fds;
-    socklen_t addrLen, optLen;
-    int count, arg = 0, err = 0, on = 1, r = 1;
+    socklen_t addrLen;
+    int arg = 0, err = 0, on = 1, r = 1;
     int sock;
 
     pthread_mutex_lock(&ctx->lock);
     sock = ctx->socket = socket(domain, SOCK_STREAM, 0);
     pthread_mutex_unlock(&ctx->lock);
 
+    *inProgress = 0;
+
     if (sock < 0) {
         err = errno;
         r = 0;
@@ -917,33 +955,72 @@ static int _BRPeerOpenSocket(BRPeer *peer, int domain, double timeout, int *erro
         
         if (err == EINPROGRESS) {
             err = 0;
-            optLen = sizeof(err);
-            tv.tv_sec  = (long)  timeout;
-            tv.tv_usec = (long) (timeout*1000000) % 1000000;
-            FD_ZERO(&fds);
-            FD_SET(sock, &fds);
-            count = select(sock + 1, NULL, &fds, NULL, &tv);
-
-            if (count <= 0 || getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &optLen) < 0 || err) {
-                if (count == 0) err = ETIMEDOUT;
-                if (count < 0 || ! err) err = errno;
-                r = 0;
-            }
+            *inProgress = 1;
         }
         else if (err && domain == PF_INET6 && _BRPeerIsIPv4(peer)) {
-            return _BRPeerOpenSocket(peer, PF_INET, timeout, error); // fallback to IPv4
+            close(sock);
+            return _BRPeerStartConnect(peer, PF_INET, inProgress, error); // fallback to IPv4
         }
         else if (err) r = 0;
+    }
+
+    if (! r && err) peer_log(peer, "connect error: %s", strerror(err));
+    if (error && err) *error = err;
+    return r;
+}
 
-        if (r) peer_log(peer, "socket connected");
-        fcntl(sock, F_SETFL, arg); // restore socket non-blocking status
+// completes a connect started by _BRPeerStartConnect() once the socket is writable, leaving it non-blocking
+static int _BRPeerFinishConnect(BRPeer *peer, int sock, int *error)
+{
+    socklen_t optLen = sizeof(int);
+    int err = 0, r = 1;
+
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &err, &optLen) < 0 || err) {
+        if (! err) err = errno;
+        r = 0;
     }
 
+    if (r) peer_log(peer, "socket connected");
     if (! r && err) peer_log(peer, "connect error: %s", strerror(err));
     if (error && err) *error = err;
     return r;
 }
 
+static int _BRPeerOpenSocket(BRPeer *peer, int domain, double timeout, int *error)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    struct timeval tv;
+    fd_set fds;
+    int count, inProgress = 0, err = 0, r;
+    int sock;
+
+    r = _BRPeerStartConnect(peer, domain, &inProgress, error);
+
+    pthread_mutex_lock(&ctx->lock);
+    sock = ctx->socket;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (r && inProgress) {
+        tv.tv_sec  = (long)  timeout;
+        tv.tv_usec = (long) (timeout*1000000) % 1000000;
+        FD_ZERO(&fds);
+        FD_SET(sock, &fds);
+        count = select(sock + 1, NULL, &fds, NULL, &tv);
+
+        if (count <= 0) {
+            err = (count == 0) ? ETIMEDOUT : errno;
+            peer_log(peer, "connect error: %s", strerror(err));
+            if (error) *error = err;
+            r = 0;
+        }
+        else r = _BRPeerFinishConnect(peer, sock, error);
+    }
+    else if (r) r = _BRPeerFinishConnect(peer, sock, error);
+
+    if (r) fcntl(sock, F_SETFL, fcntl(sock, F_GETFL, NULL) & ~O_NONBLOCK); // restore socket blocking mode
+    return r;
+}
+
 static int _peerCheckAndGetSocket (BRPeerContext *ctx, int *socket) {
     int exists;
 
@@ -986,6 +1063,75 @@ static double _peerGetMempoolTime (BRPeerContext *ctx) {
 }
 
 
+// sends a ping, completing the mempool request, once the wait for a mempool response has passed
+static void _BRPeerCheckMempoolTime(BRPeer *peer, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+
+    if (time >= _peerGetMempoolTime(ctx)) {
+        peer_log(peer, "done waiting for mempool response");
+        BRPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
+        ctx->mempoolCallback = NULL;
+
+        pthread_mutex_lock(&ctx->lock);
+        ctx->mempoolTime = DBL_MAX;
+        pthread_mutex_unlock(&ctx->lock);
+    }
+}
+
+// verifies the checksum of a received message and handles it, returns an errno.h code, or 0 on success
+static int _BRPeerAcceptPayload(BRPeer *peer, const uint8_t *header, const uint8_t *payload)
+{
+    const char *type = (const char *)(&header[4]);
+    uint32_t msgLen = UInt32GetLE(&header[16]);
+    uint32_t checksum = UInt32GetLE(&header[20]);
+    UInt256 hash;
+
+    BRSHA256_2(&hash, payload, msgLen);
+    
+    if (UInt32GetLE(&hash) != checksum) { // verify checksum
+        peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
+                 ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
+        return EPROTO;
+    }
+
+    return (_BRPeerAcceptMessage(peer, payload, msgLen, type)) ? 0 : EPROTO;
+}
+
+// fails any pong and mempool callbacks still waiting on the connection
+static void _BRPeerFailCallbacks(BRPeerContext *ctx)
+{
+    while (array_count(ctx->pongCallback) > 0) {
+        void (*pongCallback)(void *, int) = ctx->pongCallback[0];
+        void *pongInfo = ctx->pongInfo[0];
+        
+        array_rm(ctx->pongCallback, 0);
+        array_rm(ctx->pongInfo, 0);
+        if (pongCallback) pongCallback(pongInfo, 0);
+    }
+
+    if (ctx->mempoolCallback) ctx->mempoolCallback(ctx->mempoolInfo, 0);
+    ctx->mempoolCallback = NULL;
+}
+
+// closes the socket and notifies any pending callbacks, and then the disconnected callback, which may free peer
+static void _BRPeerDidDisconnect(BRPeer *peer, int error)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int socket;
+
+    pthread_mutex_lock(&ctx->lock);
+    socket = ctx->socket;
+    ctx->socket = -1;
+    ctx->status = BRPeerStatusDisconnected;
+    pthread_mutex_unlock(&ctx->lock);
+
+    if (socket >= 0) close(socket);
+    peer_log(peer, "disconnected");
+    _BRPeerFailCallbacks(ctx);
+    if (ctx->disconnected) ctx->disconnected(ctx->info, error);
+}
+
 static void *_peerThreadRoutine(void *arg)
 {
     BRPeer *peer = arg;
@@ -1021,16 +1167,7 @@ static void *_peerThreadRoutine(void *arg)
                 gettimeofday(&tv, NULL);
                 time = tv.tv_sec + (double)tv.tv_usec/1000000;
                 if (! error && time >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
-
-                if (! error && time >= _peerGetMempoolTime(ctx)) {
-                    peer_log(peer, "done waiting for mempool response");
-                    BRPeerSendPing(peer, ctx->mempoolInfo, ctx->mempoolCallback);
-                    ctx->mempoolCallback = NULL;
-
-                    pthread_mutex_lock(&ctx->lock);
-                    ctx->mempoolTime = DBL_MAX;
-                    pthread_mutex_unlock(&ctx->lock);
-                }
+                if (! error) _BRPeerCheckMempoolTime(peer, time);
 
                 while (sizeof(uint32_t) <= len && UInt32GetLE(header) != ctx->magicNumber) {
                     memmove(header, &header[1], --len); // consume one byte at a time until we find the magic number
@@ -1049,8 +1186,6 @@ static void *_peerThreadRoutine(void *arg)
             else if (len == HEADER_LENGTH) {
                 const char *type = (const char *)(&header[4]);
                 uint32_t msgLen = UInt32GetLE(&header[16]);
-                uint32_t checksum = UInt32GetLE(&header[20]);
-                UInt256 hash;
                 
                 if (msgLen > MAX_MSG_LENGTH) { // check message length
                     peer_log(peer, "error reading %s, message length %"PRIu32" is too long", type, msgLen);
@@ -1079,14 +1214,7 @@ static void *_peerThreadRoutine(void *arg)
                         peer_log(peer, "%s", strerror(error));
                     }
                     else if (len == msgLen) {
-                        BRSHA256_2(&hash, payload, msgLen);
-                        
-                        if (UInt32GetLE(&hash) != checksum) { // verify checksum
-                            peer_log(peer, "error reading %s, invalid checksum %x, expected %x, payload length:%"PRIu32
-                                     ", SHA256_2:%s", type, UInt32GetLE(&hash), checksum, msgLen, u256hex(hash));
-                            error = EPROTO;
-                        }
-                        else if (! _BRPeerAcceptMessage(peer, payload, msgLen, type)) error = EPROTO;
+                        error = _BRPeerAcceptPayload(peer, header, payload);
                     }
                 }
             }
@@ -1095,28 +1223,401 @@ static void *_peerThreadRoutine(void *arg)
         free(payload);
     }
 
+    _BRPeerDidDisconnect(peer, error);
+    pthread_cleanup_pop(1);
+    return NULL; // detached threads don't need to return a value
+}
+
+// MARK: - Reactor
+
+#define REACTOR_POLL_TIMEOUT  1000 // milliseconds; as with the socket timeouts, bounds how late a deadline is noticed
+
+typedef enum {
+    BRPeerReactorStateNew = 0,   // waiting for the reactor to start connecting
+    BRPeerReactorStateConnecting,
+    BRPeerReactorStateConnected
+} BRPeerReactorState;
+
+struct BRPeerReactorLoopStruct {
+    BRPeerReactor *reactor;
+    BRPeerContext **peers; // peers handled by this loop, guarded by reactor->lock
+    int wakeup[2]; // a pipe used to interrupt poll() when peers are added or disconnected
+    pthread_t thread;
+};
+
+struct BRPeerReactorStruct {
+    BRPeerReactorLoop *loops;
+    size_t loopsCount;
+    volatile int stop;
+    pthread_mutex_t lock;
+};
+
+static void _BRPeerReactorWake(BRPeerReactorLoop *loop)
+{
+    uint8_t byte = 0;
+    
+    if (write(loop->wakeup[1], &byte, sizeof(byte)) < 0 && errno != EWOULDBLOCK) {
+        _peer_log("reactor wakeup failed: %s\n", strerror(errno));
+    }
+}
+
+// adds peer to the reactor loop with the fewest peers, starting a new connection with its own handshake; ctx->lock
+// must be held
+static void _BRPeerReactorAddPeer(BRPeerReactor *reactor, BRPeerContext *ctx)
+{
+    BRPeerReactorLoop *loop = &reactor->loops[0];
+
+    ctx->reactorState = BRPeerReactorStateNew;
+    ctx->reactorDisconnect = 0;
+    ctx->headerLen = 0;
+    ctx->payloadLen = 0;
+    ctx->sentVerack = ctx->gotVerack = ctx->sentGetaddr = ctx->sentFilter = ctx->sentGetdata = 0;
+    ctx->sentMempool = ctx->sentGetblocks = 0;
+    array_clear(ctx->currentBlockTxHashes);
+    ctx->currentBlock = NULL;
+
+    pthread_mutex_lock(&reactor->lock);
+    
+    for (size_t i = 1; i < reactor->loopsCount; i++) {
+        if (array_count(reactor->loops[i].peers) < array_count(loop->peers)) loop = &reactor->loops[i];
+    }
+    
+    array_add(loop->peers, ctx);
+    ctx->reactorLoop = loop;
+    pthread_mutex_unlock(&reactor->lock);
+    _BRPeerReactorWake(loop);
+}
+
+// removes peer from its reactor loop and completes the disconnect, or if BRPeerConnect() was called while the
+// disconnect was pending, closes the old socket and adds the peer back to reconnect; unless reconnecting, peer may be
+// freed by the disconnected callback
+static void _BRPeerReactorDidDisconnect(BRPeerContext *ctx, int error)
+{
+    BRPeerReactorLoop *loop = ctx->reactorLoop;
+    void (*threadCleanup)(void *) = ctx->threadCleanup;
+    void *info = ctx->info;
+    int socket, reconnect;
+
+    pthread_mutex_lock(&loop->reactor->lock);
+    
+    for (size_t i = array_count(loop->peers); i > 0; i--) {
+        if (loop->peers[i - 1] == ctx) array_rm(loop->peers, i - 1);
+    }
+    
+    pthread_mutex_unlock(&loop->reactor->lock);
+    if (ctx->payload) free(ctx->payload); // nothing reads the payload until the peer is added to a loop again
+    ctx->payload = NULL;
+    ctx->payloadCapacity = 0;
+
+    // the socket and status are settled along with reactorLoop, so BRPeerConnect() either finds the disconnect still
+    // pending, or the peer completely disconnected
     pthread_mutex_lock(&ctx->lock);
+    ctx->reactorLoop = NULL;
+    reconnect = ctx->reactorReconnect;
+    ctx->reactorReconnect = 0;
     socket = ctx->socket;
-    ctx->status = BRPeerStatusDisconnected;
+    ctx->socket = -1;
+    array_clear(ctx->sendBuf); // anything still queued was for the old connection
+    ctx->sendOff = 0;
+    
+    if (reconnect) _BRPeerReactorAddPeer(loop->reactor, ctx); // the superseded connection gets no disconnected callback
+    else ctx->status = BRPeerStatusDisconnected;
+    
     pthread_mutex_unlock(&ctx->lock);
-
     if (socket >= 0) close(socket);
-    peer_log(peer, "disconnected");
-    
-    while (array_count(ctx->pongCallback) > 0) {
-        void (*pongCallback)(void *, int) = ctx->pongCallback[0];
-        void *pongInfo = ctx->pongInfo[0];
-        
-        array_rm(ctx->pongCallback, 0);
-        array_rm(ctx->pongInfo, 0);
-        if (pongCallback) pongCallback(pongInfo, 0);
+
+    if (reconnect) {
+        peer_log(&ctx->peer, "reconnecting");
+        _BRPeerFailCallbacks(ctx);
+        return;
     }
 
-    if (ctx->mempoolCallback) ctx->mempoolCallback(ctx->mempoolInfo, 0);
-    ctx->mempoolCallback = NULL;
-    if (ctx->disconnected) ctx->disconnected(ctx->info, error);
-    pthread_cleanup_pop(1);
-    return NULL; // detached threads don't need to return a value
+    peer_log(&ctx->peer, "disconnected");
+    _BRPeerFailCallbacks(ctx);
+    if (ctx->disconnected) ctx->disconnected(info, error);
+    threadCleanup(info); // as with a peer thread, called once the connection is done
+}
+
+// reads whatever is available on a readable socket, handling each message as it is completed, returns an errno.h
+// code, or 0 on success
+static int _BRPeerReactorRead(BRPeer *peer, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int socket = _peerGetSocket(ctx), error = 0;
+    ssize_t n = 0;
+
+    if (ctx->headerLen < HEADER_LENGTH) {
+        n = read(socket, &ctx->header[ctx->headerLen], HEADER_LENGTH - ctx->headerLen);
+        if (n > 0) ctx->headerLen += (size_t) n;
+
+        while (sizeof(uint32_t) <= ctx->headerLen && UInt32GetLE(ctx->header) != ctx->magicNumber) {
+            memmove(ctx->header, &ctx->header[1], --ctx->headerLen); // consume one byte at a time until we find the magic number
+        }
+
+        if (n > 0 && ctx->headerLen == HEADER_LENGTH) {
+            const char *type = (const char *)(&ctx->header[4]);
+            uint32_t msgLen = UInt32GetLE(&ctx->header[16]);
+
+            if (ctx->header[15] != 0) { // verify header type field is NULL terminated
+                peer_log(peer, "malformed message header: type not NULL terminated");
+                error = EPROTO;
+            }
+            else if (msgLen > MAX_MSG_LENGTH) { // check message length
+                peer_log(peer, "error reading %s, message length %"PRIu32" is too long", type, msgLen);
+                error = EPROTO;
+            }
+            else {
+                if (msgLen > ctx->payloadCapacity) {
+                    ctx->payload = realloc(ctx->payload, (ctx->payloadCapacity = msgLen));
+                    assert(ctx->payload != NULL);
+                }
+
+                ctx->payloadLen = 0;
+                ctx->msgTimeout = time + MESSAGE_TIMEOUT;
+            }
+        }
+    }
+    else {
+        n = read(socket, &ctx->payload[ctx->payloadLen], UInt32GetLE(&ctx->header[16]) - ctx->payloadLen);
+        if (n > 0) ctx->payloadLen += (size_t) n, ctx->msgTimeout = time + MESSAGE_TIMEOUT;
+    }
+
+    if (n == 0) error = ECONNRESET;
+    if (n < 0 && errno != EWOULDBLOCK && errno != EINTR) error = errno;
+    if (error && error != EPROTO) peer_log(peer, "%s", strerror(error));
+
+    if (! error && ctx->headerLen == HEADER_LENGTH && ctx->payloadLen == UInt32GetLE(&ctx->header[16])) {
+        ctx->headerLen = 0; // the header and payload remain intact until the next read
+        error = _BRPeerAcceptPayload(peer, ctx->header, ctx->payload);
+    }
+
+    return error;
+}
+
+// writes as much of the queued outgoing bytes as the socket takes without blocking, returns an errno.h code, or 0 on
+// success
+static int _BRPeerReactorWrite(BRPeer *peer, double time)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+    int error = 0;
+    ssize_t n;
+
+    pthread_mutex_lock(&ctx->lock);
+    n = send(ctx->socket, &ctx->sendBuf[ctx->sendOff], array_count(ctx->sendBuf) - ctx->sendOff, MSG_NOSIGNAL);
+
+    if (n > 0) {
+        ctx->sendOff += (size_t) n;
+        ctx->sendTimeout = time + MESSAGE_TIMEOUT;
+    }
+    else if (n < 0 && errno != EWOULDBLOCK && errno != EINTR) error = errno;
+
+    if (ctx->sendOff == array_count(ctx->sendBuf)) {
+        array_clear(ctx->sendBuf);
+        ctx->sendOff = 0;
+    }
+    else if (ctx->sendOff > array_count(ctx->sendBuf)/2) { // compact, so a peer that keeps up doesn't grow the queue
+        memmove(ctx->sendBuf, &ctx->sendBuf[ctx->sendOff], array_count(ctx->sendBuf) - ctx->sendOff);
+        array_count(ctx->sendBuf) -= ctx->sendOff;
+        ctx->sendOff = 0;
+    }
+
+    pthread_mutex_unlock(&ctx->lock);
+    if (error) peer_log(peer, "%s", strerror(error));
+    return error;
+}
+
+static void *_peerReactorRoutine(void *arg)
+{
+    BRPeerReactorLoop *loop = arg;
+    BRPeerReactor *reactor = loop->reactor;
+    BRPeerContext **peers, **polled;
+    struct pollfd *fds;
+    struct timeval tv;
+    uint8_t drain[64];
+    double time;
+
+    pthread_setname_brd (pthread_self(), "Core BTX, Reactor");
+    array_new(peers, 10);
+    array_new(polled, 10);
+    array_new(fds, 10);
+
+    while (! reactor->stop) {
+        array_clear(peers);
+        array_clear(polled);
+        array_clear(fds);
+
+        pthread_mutex_lock(&reactor->lock);
+        array_add_array(peers, loop->peers, array_count(loop->peers));
+        pthread_mutex_unlock(&reactor->lock);
+
+        array_add(fds, ((struct pollfd) { loop->wakeup[0], POLLIN, 0 }));
+        gettimeofday(&tv, NULL);
+        time = tv.tv_sec + (double)tv.tv_usec/1000000;
+
+        for (size_t i = 0; i < array_count(peers); i++) {
+            BRPeerContext *ctx = peers[i];
+            BRPeer *peer = &ctx->peer;
+            int inProgress = 0, sending, error = 0;
+            double sendTimeout;
+
+            if (ctx->reactorDisconnect) error = ECONNRESET;
+            else if (ctx->reactorState == BRPeerReactorStateNew) {
+                if (_BRPeerStartConnect(peer, PF_INET6, &inProgress, &error)) {
+                    ctx->reactorState = BRPeerReactorStateConnecting;
+                }
+                else if (! error) error = ECONNREFUSED;
+            }
+
+            pthread_mutex_lock(&ctx->lock);
+            sending = (array_count(ctx->sendBuf) > 0);
+            sendTimeout = ctx->sendTimeout;
+            pthread_mutex_unlock(&ctx->lock);
+
+            if (! error && time >= _peerGetDisconnectTime(ctx)) error = ETIMEDOUT;
+            if (! error && ctx->headerLen == HEADER_LENGTH && time >= ctx->msgTimeout) error = ETIMEDOUT;
+            if (! error && sending && ctx->reactorState == BRPeerReactorStateConnected && time >= sendTimeout) {
+                error = ETIMEDOUT; // the peer stopped reading
+            }
+
+            if (! error && ctx->reactorState == BRPeerReactorStateConnected) _BRPeerCheckMempoolTime(peer, time);
+
+            if (error) {
+                if (error == ETIMEDOUT) peer_log(peer, "%s", strerror(error));
+                _BRPeerReactorDidDisconnect(ctx, error);
+            }
+            else {
+                array_add(polled, ctx);
+                array_add(fds, ((struct pollfd) { _peerGetSocket(ctx),
+                    (ctx->reactorState == BRPeerReactorStateConnecting) ? POLLOUT : (POLLIN | (sending ? POLLOUT : 0)),
+                    0 }));
+            }
+        }
+
+        if (poll(fds, (nfds_t)array_count(fds), REACTOR_POLL_TIMEOUT) < 0 && errno != EINTR) {
+            _peer_log("reactor poll failed: %s\n", strerror(errno));
+        }
+
+        if (fds[0].revents & POLLIN) {
+            while (read(loop->wakeup[0], drain, sizeof(drain)) > 0);
+        }
+
+        gettimeofday(&tv, NULL);
+        time = tv.tv_sec + (double)tv.tv_usec/1000000;
+
+        for (size_t i = 0; i < array_count(polled); i++) {
+            BRPeerContext *ctx = polled[i];
+            BRPeer *peer = &ctx->peer;
+            short revents = fds[i + 1].revents;
+            int sending, error = 0;
+
+            if (revents == 0 || ctx->reactorDisconnect) continue; // a disconnect is handled on the next pass
+            
+            if (revents & POLLNVAL) error = EBADF;
+            else if (ctx->reactorState == BRPeerReactorStateConnecting) {
+                if (_BRPeerFinishConnect(peer, fds[i + 1].fd, &error)) {
+                    ctx->reactorState = BRPeerReactorStateConnected;
+                    ctx->startTime = time;
+                    BRPeerSendVersionMessage(peer);
+                }
+                else if (! error) error = ECONNREFUSED;
+            }
+            else {
+                if (revents & POLLOUT) error = _BRPeerReactorWrite(peer, time);
+                if (! error && (revents & ~POLLOUT)) error = _BRPeerReactorRead(peer, time);
+            }
+
+            pthread_mutex_lock(&ctx->lock);
+            sending = (array_count(ctx->sendBuf) > 0);
+            pthread_mutex_unlock(&ctx->lock);
+
+            // write what handling the connect or the messages read queued, rather than waiting for the next poll()
+            if (! error && sending && ctx->reactorState == BRPeerReactorStateConnected) {
+                error = _BRPeerReactorWrite(peer, time);
+            }
+
+            if (error) _BRPeerReactorDidDisconnect(ctx, error);
+        }
+    }
+
+    array_free(fds);
+    array_free(polled);
+    array_free(peers);
+    return NULL;
+}
+
+// returns a newly allocated BRPeerReactor that handles peer sockets on threadCount threads, must be freed by calling
+// BRPeerReactorFree()
+BRPeerReactor *BRPeerReactorNew(size_t threadCount)
+{
+    BRPeerReactor *reactor = calloc(1, sizeof(*reactor));
+    pthread_attr_t attr;
+
+    assert(reactor != NULL);
+    if (threadCount == 0) threadCount = 1;
+    reactor->loopsCount = threadCount;
+    reactor->loops = calloc(threadCount, sizeof(*reactor->loops));
+    assert(reactor->loops != NULL);
+
+    {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_NORMAL);
+        pthread_mutex_init(&reactor->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PTHREAD_STACK_SIZE);
+
+    for (size_t i = 0; i < threadCount; i++) {
+        BRPeerReactorLoop *loop = &reactor->loops[i];
+
+        loop->reactor = reactor;
+        array_new(loop->peers, 10);
+        if (pipe(loop->wakeup) != 0) assert(0);
+        fcntl(loop->wakeup[0], F_SETFL, fcntl(loop->wakeup[0], F_GETFL, NULL) | O_NONBLOCK);
+        fcntl(loop->wakeup[1], F_SETFL, fcntl(loop->wakeup[1], F_GETFL, NULL) | O_NONBLOCK);
+        if (pthread_create(&loop->thread, &attr, _peerReactorRoutine, loop) != 0) assert(0);
+    }
+
+    pthread_attr_destroy(&attr);
+    return reactor;
+}
+
+// stops the reactor threads; all peers using reactor must have disconnected
+void BRPeerReactorFree(BRPeerReactor *reactor)
+{
+    assert(reactor != NULL);
+    reactor->stop = 1;
+
+    for (size_t i = 0; i < reactor->loopsCount; i++) {
+        _BRPeerReactorWake(&reactor->loops[i]);
+    }
+
+    for (size_t i = 0; i < reactor->loopsCount; i++) {
+        BRPeerReactorLoop *loop = &reactor->loops[i];
+
+        pthread_join(loop->thread, NULL);
+        assert(array_count(loop->peers) == 0);
+        array_free(loop->peers);
+        close(loop->wakeup[0]);
+        close(loop->wakeup[1]);
+    }
+
+    pthread_mutex_destroy(&reactor->lock);
+    free(reactor->loops);
+    free(reactor);
+}
+
+// handle peer's connection on reactor, rather than on a thread of its own; set while peer is disconnected
+void BRPeerSetReactor(BRPeer *peer, BRPeerReactor *reactor)
+{
+    BRPeerContext *ctx = (BRPeerContext *)peer;
+
+    pthread_mutex_lock(&ctx->lock);
+    assert(ctx->status == BRPeerStatusDisconnected);
+    ctx->reactor = reactor;
+    pthread_mutex_unlock(&ctx->lock);
 }
 
 static void _dummyThreadCleanup(void *info)
@@ -1142,6 +1643,7 @@ BRPeer *BRPeerNew(uint32_t magicNumber)
     ctx->disconnectTime = DBL_MAX;
     ctx->socket = -1;
     ctx->threadCleanup = _dummyThreadCleanup;
+    array_new(ctx->sendBuf, HEADER_LENGTH);
 
     {
         pthread_mutexattr_t attr;
@@ -1165,7 +1667,8 @@ BRPeer *BRPeerNew(uint32_t magicNumber)
 // void notfound(void *, const UInt256[], size_t, const UInt256[], size_t) - called when "notfound" message is received
 // BRTransaction *requestedTx(void *, UInt256) - called when "getdata" message with a tx hash is received from peer
 // int networkIsReachable(void *) - must return true when networking is available, false otherwise
-// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup
+// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup, or when a reactor
+//                              is done with the connection
 void BRPeerSetCallbacks(BRPeer *peer, void *info,
                         void (*connected)(void *info),
                         void (*disconnected)(void *info, int error),
@@ -1246,7 +1749,13 @@ void BRPeerConnect(BRPeer *peer)
             // No race - set before the thread starts.
             ctx->disconnectTime = tv.tv_sec + (double)tv.tv_usec/1000000 + CONNECT_TIMEOUT;
 
-            if (pthread_attr_init(&attr) != 0) {
+            if (ctx->reactor && ctx->reactorLoop) { // adding it now would poll the peer twice and leak the old socket
+                ctx->reactorReconnect = 1; // _BRPeerReactorDidDisconnect() adds it back once the disconnect completes
+            }
+            else if (ctx->reactor) { // the reactor opens the socket and reads from it, rather than a thread of its own
+                _BRPeerReactorAddPeer(ctx->reactor, ctx);
+            }
+            else if (pthread_attr_init(&attr) != 0) {
                 // error = ENOMEM;
                 peer_log(peer, "error creating thread");
                 ctx->status = BRPeerStatusDisconnected;
@@ -1272,6 +1781,19 @@ void BRPeerDisconnect(BRPeer *peer)
     BRPeerContext *ctx = (BRPeerContext *)peer;
     int socket = -1;
 
+    pthread_mutex_lock(&ctx->lock);
+    
+    if (ctx->reactorLoop) { // the socket is closed by the reactor, so it isn't reused while being polled
+        ctx->reactorDisconnect = 1;
+        ctx->reactorReconnect = 0;
+        ctx->status = BRPeerStatusDisconnected;
+        _BRPeerReactorWake(ctx->reactorLoop);
+        pthread_mutex_unlock(&ctx->lock);
+        return;
+    }
+    
+    pthread_mutex_unlock(&ctx->lock);
+
     if (_peerCheckAndGetSocket(ctx, &socket)) {
         pthread_mutex_lock(&ctx->lock);
         ctx->status = BRPeerStatusDisconnected;
@@ -1382,6 +1904,21 @@ void BRPeerSendMessage(BRPeer *peer, const uint8_t *msg, size_t msgLen, const ch
         memcpy(&buf[off], msg, msgLen);
         peer_log(peer, "sending %s", type);
         msgLen = 0;
+        pthread_mutex_lock(&ctx->lock);
+
+        if (ctx->reactorLoop) { // queued for the reactor to write once the socket is writable, so it never blocks
+            if (array_count(ctx->sendBuf) == 0) { // the loop doesn't poll for writable until it has something to write
+                gettimeofday(&tv, NULL);
+                ctx->sendTimeout = tv.tv_sec + (double)tv.tv_usec/1000000 + MESSAGE_TIMEOUT;
+                _BRPeerReactorWake(ctx->reactorLoop);
+            }
+
+            array_add_array(ctx->sendBuf, buf, sizeof(buf));
+            pthread_mutex_unlock(&ctx->lock);
+            return;
+        }
+
+        pthread_mutex_unlock(&ctx->lock);
         socket = _peerGetSocket(ctx);
         if (socket < 0) error = ENOTCONN;
         
@@ -1644,6 +2181,7 @@ void BRPeerFree(BRPeer *peer)
     if (ctx->knownTxHashSet) BRSetFree(ctx->knownTxHashSet);
     if (ctx->pongCallback) array_free(ctx->pongCallback);
     if (ctx->pongInfo) array_free(ctx->pongInfo);
+    if (ctx->sendBuf) array_free(ctx->sendBuf);
     
     pthread_mutex_destroy(&ctx->lock);
     free(ctx);
@@ -122,7 +122,8 @@ BRPeer *BRPeerNew(uint32_t magicNumber);
 // void notfound(void *, const UInt256[], size_t, const UInt256[], size_t) - called when "notfound" message is received
 // BRTransaction *requestedTx(void *, UInt256) - called when "getdata" message with a tx hash is received from peer
 // int networkIsReachable(void *) - must return true when networking is available, false otherwise
-// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup    
+// void threadCleanup(void *) - called before a thread terminates to faciliate any needed cleanup, or when a reactor
+//                              is done with the connection
 void BRPeerSetCallbacks(BRPeer *peer, void *info,
                         void (*connected)(void *info),
                         void (*disconnected)(void *info, int error),
@@ -144,6 +145,20 @@ void BRPeerSetEarliestKeyTime(BRPeer *peer, uint32_t earliestKeyTime);
 // call this when local best block height changes (helps detect tarpit nodes)
 void BRPeerSetCurrentBlockHeight(BRPeer *peer, uint32_t currentBlockHeight);
 
+// a reactor handles the sockets of many peers on a few threads, rather than on one thread per peer - with a reactor,
+// the peer callbacks are called from a reactor thread
+typedef struct BRPeerReactorStruct BRPeerReactor;
+
+// returns a newly allocated BRPeerReactor that polls peer sockets on threadCount threads (at least one), must be freed
+// by calling BRPeerReactorFree()
+BRPeerReactor *BRPeerReactorNew(size_t threadCount);
+
+// stops the reactor threads; all peers using reactor must be disconnected, with their disconnected callbacks completed
+void BRPeerReactorFree(BRPeerReactor *reactor);
+
+// handle the connection to peer on reactor, or NULL for a thread per connection; call while peer is disconnected
+void BRPeerSetReactor(BRPeer *peer, BRPeerReactor *reactor);
+
 // current connection status
 BRPeerStatus BRPeerConnectStatus(BRPeer *peer);
 
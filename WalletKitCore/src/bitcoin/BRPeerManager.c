@@ -44,6 +44,9 @@
 #define PEER_FLAG_SYNCED      0x01
 #define PEER_FLAG_NEEDSUPDATE 0x02
 
+// the expected false positive rate above which the cached bloom filter is rebuilt rather than extended
+#define BLOOM_CACHE_MAX_FALSEPOSITIVE_RATE (BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0)
+
 #define genesis_block_hash(params) UInt256Reverse((params)->checkpoints[0].hash)
 
 typedef struct {
@@ -166,6 +169,11 @@ inline static int _BRBlockHeightEq(const void *block, const void *otherBlock)
     return (((const BRMerkleBlock *)block)->height == ((const BRMerkleBlock *)otherBlock)->height);
 }
 
+typedef struct {
+    pthread_mutex_t mutex;
+    uint64_t acquired, contended;
+} BRPeerManagerLock;
+
 struct BRPeerManagerStruct {
     const BRChainParams *params;
     BRWallet *wallet;
@@ -173,10 +181,16 @@ struct BRPeerManagerStruct {
     BRPeer *peers, *downloadPeer, fixedPeer, **connectedPeers;
     char downloadPeerName[INET6_ADDRSTRLEN + 6];
     uint32_t earliestKeyTime, syncStartHeight, filterUpdateHeight, estimatedHeight;
-    BRBloomFilter *bloomFilter;
-    double fpRate, averageTxPerBlock;
+    BRBloomFilter *bloomFilter, *filterCache;
+    double fpRate, averageTxPerBlock, filterCacheMaxFpRate;
+    size_t filterInternalCount, filterExternalCount;
+    uint64_t filterRebuilds, filterUpdates;
+    int filterNeedsRebuild;
     BRSet *blocks, *orphans, *checkpoints;
     BRMerkleBlock *lastBlock, *lastOrphan;
+    BRMerkleBlock **chain; // main chain blocks in memory, indexed by height - chainStart, ending with lastBlock
+    uint32_t chainStart;
+    BRHeaderStore *headerStore; // persisted main chain headers, going back further than chain
     BRTxPeerList *txRelays, *txRequests;
     BRPublishedTx *publishedTx;
     UInt256 *publishedTxHashes;
@@ -188,9 +202,38 @@ struct BRPeerManagerStruct {
     void (*savePeers)(void *info, int replace, const BRPeer peers[], size_t peersCount);
     int (*networkIsReachable)(void *info);
     void (*threadCleanup)(void *info);
-    pthread_mutex_t lock;
+    BRPeerReactor *reactor;
+    // locks are taken in this order: peerLock, chainLock, filterLock, txLock - never an earlier one while holding a
+    // later one
+    BRPeerManagerLock peerLock; // peers, connectedPeers, downloadPeer, isConnected, syncStartHeight, connect counts,
+                                // and filterCache along with its chain counts, max rate and rebuild/update counts
+    BRPeerManagerLock chainLock; // blocks, orphans, checkpoints, lastBlock, lastOrphan, chain, chainStart,
+                                 // headerStore, estimatedHeight and filterUpdateHeight
+    BRPeerManagerLock filterLock; // bloomFilter, fpRate, averageTxPerBlock and filterNeedsRebuild
+    BRPeerManagerLock txLock; // txRelays, txRequests, publishedTx and publishedTxHashes
 };
 
+static void _BRPeerManagerLockInit(BRPeerManagerLock *lock)
+{
+    pthread_mutex_init(&lock->mutex, NULL);
+    lock->acquired = lock->contended = 0;
+}
+
+static void _BRPeerManagerLock(BRPeerManagerLock *lock)
+{
+    int contended = (pthread_mutex_trylock(&lock->mutex) != 0);
+
+    if (contended) pthread_mutex_lock(&lock->mutex);
+    lock->acquired++; // counters are guarded by the lock itself
+    if (contended) lock->contended++;
+}
+
+static void _BRPeerManagerUnlock(BRPeerManagerLock *lock)
+{
+    pthread_mutex_unlock(&lock->mutex);
+}
+
+// called with peerLock held
 static void _BRPeerManagerPeerMisbehavin(BRPeerManager *manager, BRPeer *peer)
 {
     for (size_t i = array_count(manager->peers); i > 0; i--) {
@@ -205,21 +248,27 @@ static void _BRPeerManagerPeerMisbehavin(BRPeerManager *manager, BRPeer *peer)
     BRPeerDisconnect(peer);
 }
 
+// called with peerLock held
 static void _BRPeerManagerSyncStopped(BRPeerManager *manager)
 {
+    int hasPendingCallbacks = 0;
+
     manager->syncStartHeight = 0;
 
     if (manager->downloadPeer) {
         // don't cancel timeout if there's a pending tx publish callback
-        for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
-            if (manager->publishedTx[i - 1].callback != NULL) return;
+        _BRPeerManagerLock(&manager->txLock);
+
+        for (size_t i = array_count(manager->publishedTx); ! hasPendingCallbacks && i > 0; i--) {
+            if (manager->publishedTx[i - 1].callback != NULL) hasPendingCallbacks = 1;
         }
-    
-        BRPeerScheduleDisconnect(manager->downloadPeer, -1); // cancel sync timeout
+
+        _BRPeerManagerUnlock(&manager->txLock);
+        if (! hasPendingCallbacks) BRPeerScheduleDisconnect(manager->downloadPeer, -1); // cancel sync timeout
     }
 }
 
-// adds transaction to list of tx to be published, along with any unconfirmed inputs
+// adds transaction to list of tx to be published, along with any unconfirmed inputs; called with txLock held
 static void _BRPeerManagerAddTxToPublishList(BRPeerManager *manager, BRTransaction *tx, void *info,
                                              void (*callback)(void *, int))
 {
@@ -238,20 +287,110 @@ static void _BRPeerManagerAddTxToPublishList(BRPeerManager *manager, BRTransacti
     }
 }
 
+// returns the main chain block at the given height, or NULL if it isn't in memory (called with chainLock held)
+static BRMerkleBlock *_BRPeerManagerChainBlock(BRPeerManager *manager, uint32_t height)
+{
+    if (height < manager->chainStart || height - manager->chainStart >= array_count(manager->chain)) return NULL;
+    return manager->chain[height - manager->chainStart];
+}
+
+// returns the block before the given one, using the height index for main chain blocks (called with chainLock held)
+static BRMerkleBlock *_BRPeerManagerPrevBlock(BRPeerManager *manager, BRMerkleBlock *block)
+{
+    if (block->height > 0 && _BRPeerManagerChainBlock(manager, block->height) == block) {
+        return _BRPeerManagerChainBlock(manager, block->height - 1);
+    }
+
+    return BRSetGet(manager->blocks, &block->prevBlock);
+}
+
+// appends the main chain blocks from the given height on to the header store, replacing any headers it has from a fork,
+// and starting it over if they don't connect to its last header (called with chainLock held)
+static void _BRPeerManagerStoreHeaders(BRPeerManager *manager, uint32_t height)
+{
+    BRHeaderStore *store = manager->headerStore;
+    BRMerkleBlock *b;
+    UInt256 hash;
+
+    for (; store && (b = _BRPeerManagerChainBlock(manager, height)) != NULL; height++) {
+        if (BRHeaderStoreHash(store, height, &hash) && UInt256Eq(hash, b->blockHash)) continue; // already stored
+        BRHeaderStoreTruncate(store, height);
+        if (! BRHeaderStoreHash(store, height - 1, &hash) || ! UInt256Eq(hash, b->prevBlock)) {
+            BRHeaderStoreTruncate(store, 0);
+        }
+
+        BRHeaderStoreAppend(store, b); // fails for checkpoint blocks, which don't have a complete header
+    }
+}
+
+// sets lastBlock, and updates the height index to end with it, walking back only as far as the point where the new
+// chain joins the indexed one (called with chainLock held)
+static void _BRPeerManagerSetLastBlock(BRPeerManager *manager, BRMerkleBlock *block)
+{
+    BRMerkleBlock *b = block, *prev;
+    size_t count = 0, n;
+
+    while (b && _BRPeerManagerChainBlock(manager, b->height) != b) {
+        prev = BRSetGet(manager->blocks, &b->prevBlock);
+        if (prev && prev->height + 1 != b->height) prev = NULL;
+        b = prev;
+        count++;
+    }
+
+    if (b) array_set_count(manager->chain, b->height + 1 - manager->chainStart);
+    else { // block doesn't join the indexed chain, so start over from the end of block's chain
+        array_clear(manager->chain);
+        manager->chainStart = block->height + 1 - (uint32_t)count;
+    }
+
+    n = array_count(manager->chain);
+    if (n + count > array_capacity(manager->chain)) array_set_capacity(manager->chain, (n + count)*3/2);
+    array_set_count(manager->chain, n + count);
+
+    for (b = block; count > 0; count--) {
+        manager->chain[n + count - 1] = b;
+        b = BRSetGet(manager->blocks, &b->prevBlock);
+    }
+
+    manager->lastBlock = block;
+    _BRPeerManagerStoreHeaders(manager, manager->chainStart + (uint32_t)n);
+}
+
+// drops block and all main chain blocks before it from the height index, before block is freed (called with
+// chainLock held)
+static void _BRPeerManagerForgetBlock(BRPeerManager *manager, BRMerkleBlock *block)
+{
+    if (_BRPeerManagerChainBlock(manager, block->height) != block) return;
+    array_rm_range(manager->chain, 0, block->height + 1 - manager->chainStart);
+    manager->chainStart = block->height + 1;
+}
+
+// called with chainLock held
 static size_t _BRPeerManagerBlockLocators(BRPeerManager *manager, UInt256 locators[], size_t locatorsCount)
 {
     // append 10 most recent block hashes, decending, then continue appending, doubling the step back each time,
     // finishing with the genesis block (top, -1, -2, -3, -4, -5, -6, -7, -8, -9, -11, -15, -23, -39, -71, -135, ..., 0)
     BRMerkleBlock *block = manager->lastBlock;
     size_t step = 1, height = 0, i = 0, j;
+    uint32_t next = 0;
+    UInt256 hash;
     
+    // height is tracked whether or not locators are written, so that counting them gives the same result as filling
     while (block && block->height > 0) {
-        if (locators && i < locatorsCount) locators[i] = block->blockHash, height = block->height;
+        if (locators && i < locatorsCount) locators[i] = block->blockHash;
+        height = block->height;
         if (++i >= 10) step *= 2;
-        
-        for (j = 0; block && j < step; j++) {
-            block = BRSetGet(manager->blocks, &block->prevBlock);
-        }
+        next = (block->height > step) ? block->height - (uint32_t)step : 0;
+        block = (next >= manager->chainStart) ? _BRPeerManagerChainBlock(manager, next) : NULL;
+    }
+
+    // continue back through the headers older than the in-memory chain from the header store
+    while (manager->headerStore && next > 0 && next < manager->chainStart &&
+           BRHeaderStoreHash(manager->headerStore, next, &hash)) {
+        if (locators && i < locatorsCount) locators[i] = hash;
+        height = next;
+        if (++i >= 10) step *= 2;
+        next = (next > step) ? next - (uint32_t)step : 0;
     }
     
     for (j = manager->params->checkpointsCount; j > 0; j--) { // add checkpoint hashes older than oldest saved block
@@ -268,75 +407,130 @@ static void _setApplyFreeBlock(void *info, void *block)
     BRMerkleBlockFree(block);
 }
 
+// inserts the wallet's pubkey hashes of the given chain from *count on into filter, and advances *count past them
+static void _BRPeerManagerFilterAddChain(BRPeerManager *manager, BRBloomFilter *filter, uint32_t internal,
+                                         size_t *count)
+{
+    size_t pkhsCount = BRWalletChainPKHs(manager->wallet, NULL, 0, internal, *count);
+    UInt160 *pkhs;
+
+    if (pkhsCount == 0) return;
+    pkhs = malloc(pkhsCount*sizeof(*pkhs));
+    assert(pkhs != NULL);
+    pkhsCount = BRWalletChainPKHs(manager->wallet, pkhs, pkhsCount, internal, *count);
+
+    for (size_t i = 0; i < pkhsCount; i++) { // add addresses to watch for tx receiveing money to the wallet
+        if (! BRBloomFilterContainsData(filter, pkhs[i].u8, sizeof(*pkhs))) {
+            BRBloomFilterInsertData(filter, pkhs[i].u8, sizeof(*pkhs));
+        }
+    }
+
+    *count += pkhsCount;
+    free(pkhs);
+}
+
+// inserts the wallet addresses not yet in filter, along with the given UTXOs and the TXOs spent by transactions
+static void _BRPeerManagerFilterAddWallet(BRPeerManager *manager, BRBloomFilter *filter, const BRUTXO utxos[],
+                                          size_t utxosCount, BRTransaction *transactions[], size_t txCount)
+{
+    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
+
+    _BRPeerManagerFilterAddChain(manager, filter, SEQUENCE_INTERNAL_CHAIN, &manager->filterInternalCount);
+    _BRPeerManagerFilterAddChain(manager, filter, SEQUENCE_EXTERNAL_CHAIN, &manager->filterExternalCount);
+
+    for (size_t i = 0; i < utxosCount; i++) { // add UTXOs to watch for tx sending money from the wallet
+        UInt256Set(o, utxos[i].hash);
+        UInt32SetLE(&o[sizeof(UInt256)], utxos[i].n);
+        if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o, sizeof(o));
+    }
+
+    for (size_t i = 0; i < txCount; i++) { // also add TXOs spent within the last 100 blocks
+        if (BRWalletAmountSentByTx(manager->wallet, transactions[i]) > 0) {
+            for (size_t j = 0; j < transactions[i]->inCount; j++) {
+                UInt256Set(o, transactions[i]->inputs[j].txHash);
+                UInt32SetLE(&o[sizeof(UInt256)], transactions[i]->inputs[j].index);
+                if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o, sizeof(o));
+            }
+        }
+    }
+}
+
+// called with peerLock held; the filter is built without holding chainLock or filterLock
+// all peers share one cached filter, that's extended in place with new wallet addresses and outputs, and only rebuilt
+// once its expected false positive rate passes filterCacheMaxFpRate, or the observed rate shows it has degraded
 static void _BRPeerManagerLoadBloomFilter(BRPeerManager *manager, BRPeer *peer)
 {
-    // every time a new wallet address is added, the bloom filter has to be rebuilt, and each address is only used
-    // for one transaction, so here we generate some spare addresses to avoid rebuilding the filter each time a
+    uint32_t blockHeight;
+    int needsRebuild;
+
+    // every time a new wallet address is added, the bloom filter has to be updated, and each address is only used
+    // for one transaction, so here we generate some spare addresses to avoid updating the filter each time a
     // wallet transaction is encountered during the chain sync
     BRWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN);
     BRWalletUnusedAddrs(manager->wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN);
 
+    _BRPeerManagerLock(&manager->chainLock);
     BRSetApply(manager->orphans, NULL, _setApplyFreeBlock);
     BRSetClear(manager->orphans); // clear out orphans that may have been received on an old filter
     manager->lastOrphan = NULL;
     manager->filterUpdateHeight = manager->lastBlock->height;
-    manager->fpRate = BLOOM_REDUCED_FALSEPOSITIVE_RATE;
-    
-    size_t addrsCount = BRWalletAllAddrs(manager->wallet, NULL, 0);
-    BRAddress *addrs = malloc(addrsCount*sizeof(*addrs));
+    blockHeight = (manager->lastBlock->height > 100) ? manager->lastBlock->height - 100 : 0;
+    _BRPeerManagerUnlock(&manager->chainLock);
+
+    _BRPeerManagerLock(&manager->filterLock);
+    needsRebuild = manager->filterNeedsRebuild;
+    manager->filterNeedsRebuild = 0;
+    _BRPeerManagerUnlock(&manager->filterLock);
+
     size_t utxosCount = BRWalletUTXOs(manager->wallet, NULL, 0);
     BRUTXO *utxos = malloc(utxosCount*sizeof(*utxos));
-    UInt160 hash;
-    uint32_t blockHeight = (manager->lastBlock->height > 100) ? manager->lastBlock->height - 100 : 0;
-    uint8_t o[sizeof(UInt256) + sizeof(uint32_t)];
     size_t txCount = BRWalletTxUnconfirmedBefore(manager->wallet, NULL, 0, blockHeight);
     BRTransaction **transactions = malloc(txCount*sizeof(*transactions));
-    BRBloomFilter *filter;
+    BRBloomFilter *filter = manager->filterCache;
     
-    assert(addrs != NULL);
     assert(utxos != NULL);
     assert(transactions != NULL);
-    addrsCount = BRWalletAllAddrs(manager->wallet, addrs, addrsCount);
     utxosCount = BRWalletUTXOs(manager->wallet, utxos, utxosCount);
     txCount = BRWalletTxUnconfirmedBefore(manager->wallet, transactions, txCount, blockHeight);
-    filter = BRBloomFilterNew(manager->fpRate, addrsCount + utxosCount + txCount + 100, (uint32_t)BRPeerHash(peer),
-                              BLOOM_UPDATE_ALL); // BUG: XXX txCount not the same as number of spent wallet outputs
-    
-    for (size_t i = 0; i < addrsCount; i++) { // add addresses to watch for tx receiveing money to the wallet
-        if (BRAddressHash160(&hash, manager->params->addrParams, addrs[i].s) &&
-            ! BRBloomFilterContainsData(filter, hash.u8, sizeof(hash))) {
-            BRBloomFilterInsertData(filter, hash.u8, sizeof(hash));
-        }
-    }
 
-    free(addrs);
-        
-    for (size_t i = 0; i < utxosCount; i++) { // add UTXOs to watch for tx sending money from the wallet
-        UInt256Set(o, utxos[i].hash);
-        UInt32SetLE(&o[sizeof(UInt256)], utxos[i].n);
-        if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o, sizeof(o));
+    if (filter && ! needsRebuild) {
+        _BRPeerManagerFilterAddWallet(manager, filter, utxos, utxosCount, transactions, txCount);
+        needsRebuild = (BRBloomFilterFalsePositiveRate(filter) > manager->filterCacheMaxFpRate);
+        if (! needsRebuild) manager->filterUpdates++;
     }
-    
-    free(utxos);
-        
-    for (size_t i = 0; i < txCount; i++) { // also add TXOs spent within the last 100 blocks
-        if (BRWalletAmountSentByTx(manager->wallet, transactions[i]) > 0) {
-            for (size_t j = 0; j < transactions[i]->inCount; j++) {
-                UInt256Set(o, transactions[i]->inputs[j].txHash);
-                UInt32SetLE(&o[sizeof(UInt256)], transactions[i]->inputs[j].index);
-                if (! BRBloomFilterContainsData(filter, o, sizeof(o))) BRBloomFilterInsertData(filter, o, sizeof(o));
-            }
+
+    if (! filter || needsRebuild) {
+        size_t elemCount = BRWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_INTERNAL_CHAIN, 0) +
+                           BRWalletChainPKHs(manager->wallet, NULL, 0, SEQUENCE_EXTERNAL_CHAIN, 0) + utxosCount +
+                           txCount; // BUG: XXX txCount not the same as number of spent wallet outputs
+
+        if (filter) BRBloomFilterFree(filter);
+        manager->filterInternalCount = manager->filterExternalCount = 0;
+        // leave room for half again as many elements to be added before the filter has to be rebuilt
+        filter = BRBloomFilterNew(BLOOM_REDUCED_FALSEPOSITIVE_RATE, elemCount + elemCount/2 + 100, BRRand(0),
+                                  BLOOM_UPDATE_ALL);
+        _BRPeerManagerFilterAddWallet(manager, filter, utxos, utxosCount, transactions, txCount);
+        // a filter at BLOOM_MAX_FILTER_LENGTH may start out above the max rate, so allow it to double from there
+        manager->filterCacheMaxFpRate = BRBloomFilterFalsePositiveRate(filter)*2.0;
+        if (manager->filterCacheMaxFpRate < BLOOM_CACHE_MAX_FALSEPOSITIVE_RATE) {
+            manager->filterCacheMaxFpRate = BLOOM_CACHE_MAX_FALSEPOSITIVE_RATE;
         }
+        manager->filterCache = filter;
+        manager->filterRebuilds++;
     }
-    
+
+    free(utxos);
     free(transactions);
-    if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
-    manager->bloomFilter = filter;
     // TODO: XXX if already synced, recursively add inputs of unconfirmed receives
 
     uint8_t data[BRBloomFilterSerialize(filter, NULL, 0)];
     size_t len = BRBloomFilterSerialize(filter, data, sizeof(data));
-    
+
+    _BRPeerManagerLock(&manager->filterLock);
+    if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
+    manager->bloomFilter = BRBloomFilterParse(data, len); // a copy, so the cache can be extended while it's shared
+    manager->fpRate = BLOOM_REDUCED_FALSEPOSITIVE_RATE;
+    _BRPeerManagerUnlock(&manager->filterLock);
     BRPeerSendFilterload(peer, data, len);
 }
 
@@ -348,16 +542,18 @@ static void _updateFilterRerequestDone(void *info, int success)
     free(info);
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
 
         if ((peer->flags & PEER_FLAG_NEEDSUPDATE) == 0) {
+            _BRPeerManagerLock(&manager->chainLock);
             UInt256 locators[_BRPeerManagerBlockLocators(manager, NULL, 0)];
             size_t count = _BRPeerManagerBlockLocators(manager, locators, sizeof(locators)/sizeof(*locators));
             
+            _BRPeerManagerUnlock(&manager->chainLock);
             BRPeerSendGetblocks(peer, locators, count, UINT256_ZERO);
         }
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 }
 
@@ -366,27 +562,33 @@ static void _updateFilterLoadDone(void *info, int success)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPeerCallbackInfo *peerInfo;
+    UInt256 lastBlockHash;
+    int isSyncing;
 
     free(info);
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
         BRPeerSetNeedsFilterUpdate(peer, 0);
         peer->flags &= ~PEER_FLAG_NEEDSUPDATE;
-        
-        if (manager->lastBlock->height < manager->estimatedHeight) { // if syncing, rerequest blocks
+        _BRPeerManagerLock(&manager->chainLock);
+        isSyncing = (manager->lastBlock->height < manager->estimatedHeight);
+        lastBlockHash = manager->lastBlock->blockHash;
+        _BRPeerManagerUnlock(&manager->chainLock);
+
+        if (isSyncing) { // if syncing, rerequest blocks
             if (manager->downloadPeer) {
                 peerInfo = calloc(1, sizeof(*peerInfo));
                 assert(peerInfo != NULL);
                 peerInfo->peer = peer;
                 peerInfo->manager = manager;
-                BRPeerRerequestBlocks(manager->downloadPeer, manager->lastBlock->blockHash);
+                BRPeerRerequestBlocks(manager->downloadPeer, lastBlockHash);
                 BRPeerSendPing(manager->downloadPeer, peerInfo, _updateFilterRerequestDone);
             }
         }
         else BRPeerSendMempool(peer, NULL, 0, NULL, NULL); // if not syncing, request mempool
         
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 }
 
@@ -395,14 +597,20 @@ static void _updateFilterPingDone(void *info, int success)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPeerCallbackInfo *peerInfo;
+    int isSyncing;
     
     if (success) {
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
         peer_log(peer, "updating filter with newly created wallet addresses");
+        _BRPeerManagerLock(&manager->chainLock);
+        isSyncing = (manager->lastBlock->height < manager->estimatedHeight);
+        _BRPeerManagerUnlock(&manager->chainLock);
+        _BRPeerManagerLock(&manager->filterLock);
         if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
         manager->bloomFilter = NULL;
+        _BRPeerManagerUnlock(&manager->filterLock);
 
-        if (manager->lastBlock->height < manager->estimatedHeight) { // if we're syncing, only update download peer
+        if (isSyncing) { // if we're syncing, only update download peer
             if (manager->downloadPeer) {
                 _BRPeerManagerLoadBloomFilter(manager, manager->downloadPeer);
                 BRPeerSendPing(manager->downloadPeer, info, _updateFilterLoadDone); // wait for pong so filter is loaded
@@ -423,11 +631,12 @@ static void _updateFilterPingDone(void *info, int success)
             }
         }
 
-         pthread_mutex_unlock(&manager->lock);
+         _BRPeerManagerUnlock(&manager->peerLock);
     }
     else free(info);
 }
 
+// called with peerLock held
 static void _BRPeerManagerUpdateFilter(BRPeerManager *manager)
 {
     BRPeerCallbackInfo *info;
@@ -451,10 +660,11 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     int isPublishing;
+    uint32_t lastHeight;
     size_t count = 0;
 
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     if (success) peer->flags |= PEER_FLAG_SYNCED;
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
@@ -473,6 +683,10 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
         BRTransaction *tx[(txCount*sizeof(BRTransaction *) <= 0x1000) ? txCount : 0x1000/sizeof(BRTransaction *)];
         
         txCount = BRWalletTxUnconfirmedBefore(manager->wallet, tx, sizeof(tx)/sizeof(*tx), TX_UNCONFIRMED);
+        _BRPeerManagerLock(&manager->chainLock);
+        lastHeight = manager->lastBlock->height;
+        _BRPeerManagerUnlock(&manager->chainLock);
+        _BRPeerManagerLock(&manager->txLock);
 
         for (size_t i = txCount; i > 0; i--) {
             hash = tx[i - 1]->txHash;
@@ -485,7 +699,7 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
             
             if (! isPublishing && _BRTxPeerListCount(manager->txRelays, hash) == 0 &&
                 _BRTxPeerListCount(manager->txRequests, hash) == 0) {
-                peer_log(peer, "removing tx unconfirmed at: %d, txHash: %s", manager->lastBlock->height, u256hex(hash));
+                peer_log(peer, "removing tx unconfirmed at: %d, txHash: %s", lastHeight, u256hex(hash));
                 assert(tx[i - 1]->blockHeight == TX_UNCONFIRMED);
                 BRWalletRemoveTransaction(manager->wallet, hash);
             }
@@ -494,11 +708,14 @@ static void _requestUnrelayedTxGetdataDone(void *info, int success)
                 BRWalletUpdateTransactions(manager->wallet, &hash, 1, TX_UNCONFIRMED, 0);
             }
         }
+
+        _BRPeerManagerUnlock(&manager->txLock);
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 }
 
+// called with peerLock held
 static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *peer)
 {
     BRPeerCallbackInfo *info;
@@ -507,6 +724,7 @@ static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *pee
     UInt256 txHashes[txCount];
     
     txCount = BRWalletTxUnconfirmedBefore(manager->wallet, tx, txCount, TX_UNCONFIRMED);
+    _BRPeerManagerLock(&manager->txLock);
     
     for (size_t i = 0; i < txCount; i++) {
         if (! _BRTxPeerListHasPeer(manager->txRelays, tx[i]->txHash, peer) &&
@@ -516,6 +734,8 @@ static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *pee
         }
     }
 
+    _BRPeerManagerUnlock(&manager->txLock);
+
     if (hashCount > 0) {
         BRPeerSendGetdata(peer, txHashes, hashCount, NULL, 0);
     
@@ -532,6 +752,8 @@ static void _BRPeerManagerRequestUnrelayedTx(BRPeerManager *manager, BRPeer *pee
 
 static void _BRPeerManagerPublishPendingTx(BRPeerManager *manager, BRPeer *peer)
 {
+    _BRPeerManagerLock(&manager->txLock);
+
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         if (manager->publishedTx[i - 1].callback == NULL) continue;
         BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule publish timeout
@@ -539,6 +761,7 @@ static void _BRPeerManagerPublishPendingTx(BRPeerManager *manager, BRPeer *peer)
     }
     
     BRPeerSendInv(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes));
+    _BRPeerManagerUnlock(&manager->txLock);
 }
 
 static void _mempoolDone(void *info, int success)
@@ -551,7 +774,7 @@ static void _mempoolDone(void *info, int success)
     
     if (success) {
         peer_log(peer, "mempool request finished");
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
         if (manager->syncStartHeight > 0) {
             peer_log(peer, "sync succeeded");
             syncFinished = 1;
@@ -560,7 +783,7 @@ static void _mempoolDone(void *info, int success)
 
         _BRPeerManagerRequestUnrelayedTx(manager, peer);
         BRPeerSendGetaddr(peer); // request a list of other bitcoin peers
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
         if (manager->txStatusUpdate) manager->txStatusUpdate(manager->info);
         if (syncFinished && manager->syncStopped) manager->syncStopped(manager->info, 0);
     }
@@ -572,12 +795,14 @@ static void _loadBloomFilterDone(void *info, int success)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     
     if (success) {
+        _BRPeerManagerLock(&manager->txLock);
         BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
                           _mempoolDone);
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->txLock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
     else {
         free(info);
@@ -585,15 +810,18 @@ static void _loadBloomFilterDone(void *info, int success)
         if (peer == manager->downloadPeer) {
             peer_log(peer, "sync succeeded");
             _BRPeerManagerSyncStopped(manager);
-            pthread_mutex_unlock(&manager->lock);
+            _BRPeerManagerUnlock(&manager->peerLock);
             if (manager->syncStopped) manager->syncStopped(manager->info, 0);
         }
-        else pthread_mutex_unlock(&manager->lock);
+        else _BRPeerManagerUnlock(&manager->peerLock);
     }
 }
 
+// called with peerLock held
 static void _BRPeerManagerLoadMempools(BRPeerManager *manager)
 {
+    double fpRate;
+
     // after syncing, load filters and get mempools from other peers
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
         BRPeer *peer = manager->connectedPeers[i - 1];
@@ -604,14 +832,21 @@ static void _BRPeerManagerLoadMempools(BRPeerManager *manager)
         assert(info != NULL);
         info->peer = peer;
         info->manager = manager;
-        
-        if (peer != manager->downloadPeer || manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) {
+        _BRPeerManagerLock(&manager->filterLock);
+        fpRate = manager->fpRate;
+        _BRPeerManagerUnlock(&manager->filterLock);
+
+        if (peer != manager->downloadPeer || fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*5.0) {
             _BRPeerManagerLoadBloomFilter(manager, peer);
             _BRPeerManagerPublishPendingTx(manager, peer);
             BRPeerSendPing(peer, info, _loadBloomFilterDone); // load mempool after updating bloomfilter
         }
-        else BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
-                               _mempoolDone);
+        else {
+            _BRPeerManagerLock(&manager->txLock);
+            BRPeerSendMempool(peer, manager->publishedTxHashes, array_count(manager->publishedTxHashes), info,
+                              _mempoolDone);
+            _BRPeerManagerUnlock(&manager->txLock);
+        }
     }
 }
 
@@ -654,7 +889,7 @@ static void *_findPeersThreadRoutine(void *arg)
     pthread_cleanup_push(manager->threadCleanup, manager->info);
     addrList = _addressLookup(((BRFindPeersInfo *)arg)->hostname);
     free(arg);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     
     for (addr = addrList; addr && ! UInt128IsZero(*addr); addr++) {
         age = 24*60*60 + BRRand(2*24*60*60); // add between 1 and 3 days
@@ -662,7 +897,7 @@ static void *_findPeersThreadRoutine(void *arg)
     }
 
     manager->dnsThreadCount--;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     if (addrList) free(addrList);
     pthread_cleanup_pop(1);
     return NULL;
@@ -706,9 +941,9 @@ static void _BRPeerManagerFindPeers(BRPeerManager *manager)
         ts.tv_nsec = 1;
 
         do {
-            pthread_mutex_unlock(&manager->lock);
+            _BRPeerManagerUnlock(&manager->peerLock);
             nanosleep(&ts, NULL); // pthread_yield() isn't POSIX standard :(
-            pthread_mutex_lock(&manager->lock);
+            _BRPeerManagerLock(&manager->peerLock);
         } while (manager->dnsThreadCount > 0 && array_count(manager->peers) < PEER_MAX_CONNECTIONS);
     
         qsort(manager->peers, array_count(manager->peers), sizeof(*manager->peers), _peerTimestampCompare);
@@ -721,9 +956,13 @@ static void _peerConnected(void *info)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPeerCallbackInfo *peerInfo;
     time_t now = time(NULL);
+    uint32_t lastHeight;
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     if (peer->timestamp > now + 2*60*60 || peer->timestamp < now - 2*60*60) peer->timestamp = (uint64_t) now; // sanity check
+    _BRPeerManagerLock(&manager->chainLock);
+    lastHeight = manager->lastBlock->height;
+    _BRPeerManagerUnlock(&manager->chainLock);
     
     // TODO: XXX does this work with 0.11 pruned nodes?
     if ((peer->services & manager->params->services) != manager->params->services) {
@@ -734,7 +973,7 @@ static void _peerConnected(void *info)
         peer_log(peer, "node doesn't carry full blocks");
         BRPeerDisconnect(peer);
     }
-    else if (BRPeerLastBlock(peer) + 10 < manager->lastBlock->height) {
+    else if (BRPeerLastBlock(peer) + 10 < lastHeight) {
         peer_log(peer, "node isn't synced");
         BRPeerDisconnect(peer);
     }
@@ -743,9 +982,8 @@ static void _peerConnected(void *info)
         BRPeerDisconnect(peer);
     }
     else if (manager->downloadPeer && // check if we should stick with the existing download peer
-             (BRPeerLastBlock(manager->downloadPeer) >= BRPeerLastBlock(peer) ||
-              manager->lastBlock->height >= BRPeerLastBlock(peer))) {
-        if (manager->lastBlock->height >= BRPeerLastBlock(peer)) { // only load bloom filter if we're done syncing
+             (BRPeerLastBlock(manager->downloadPeer) >= BRPeerLastBlock(peer) || lastHeight >= BRPeerLastBlock(peer))) {
+        if (lastHeight >= BRPeerLastBlock(peer)) { // only load bloom filter if we're done syncing
             manager->connectFailureCount = 0; // also reset connect failure count if we're already synced
             _BRPeerManagerLoadBloomFilter(manager, peer);
             _BRPeerManagerPublishPendingTx(manager, peer);
@@ -774,20 +1012,25 @@ static void _peerConnected(void *info)
         
         manager->downloadPeer = peer;
         manager->isConnected = 1;
+        _BRPeerManagerLock(&manager->chainLock);
         manager->estimatedHeight = BRPeerLastBlock(peer);
+        _BRPeerManagerUnlock(&manager->chainLock);
         _BRPeerManagerLoadBloomFilter(manager, peer);
-        BRPeerSetCurrentBlockHeight(peer, manager->lastBlock->height);
+        BRPeerSetCurrentBlockHeight(peer, lastHeight);
         _BRPeerManagerPublishPendingTx(manager, peer);
             
-        if (manager->lastBlock->height < BRPeerLastBlock(peer)) { // start blockchain sync
+        if (lastHeight < BRPeerLastBlock(peer)) { // start blockchain sync
+            _BRPeerManagerLock(&manager->chainLock);
             UInt256 locators[_BRPeerManagerBlockLocators(manager, NULL, 0)];
             size_t count = _BRPeerManagerBlockLocators(manager, locators, sizeof(locators)/sizeof(*locators));
+            uint32_t lastTimestamp = manager->lastBlock->timestamp;
             
+            _BRPeerManagerUnlock(&manager->chainLock);
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // schedule sync timeout
 
             // request just block headers up to a week before earliestKeyTime, and then merkleblocks after that
             // we do not reset connect failure count yet incase this request times out
-            if (manager->lastBlock->timestamp + 7*24*60*60 >= manager->earliestKeyTime) {
+            if (lastTimestamp + 7*24*60*60 >= manager->earliestKeyTime) {
                 BRPeerSendGetblocks(peer, locators, count, UINT256_ZERO);
             }
             else BRPeerSendGetheaders(peer, locators, count, UINT256_ZERO);
@@ -798,7 +1041,7 @@ static void _peerConnected(void *info)
         }
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 }
 
 static void _peerDisconnected(void *info, int error)
@@ -810,9 +1053,7 @@ static void _peerDisconnected(void *info, int error)
     size_t txCount = 0;
     
     //free(info);
-    pthread_mutex_lock(&manager->lock);
-
-    BRPublishedTx pubTx[array_count(manager->publishedTx)];
+    _BRPeerManagerLock(&manager->peerLock);
     
     if (error == EPROTO) { // if it's protocol error, the peer isn't following standard policy
         _BRPeerManagerPeerMisbehavin(manager, peer);
@@ -829,14 +1070,6 @@ static void _peerDisconnected(void *info, int error)
         if (error == ETIMEDOUT && (peer != manager->downloadPeer || manager->syncStartHeight == 0 ||
                                    array_count(manager->connectedPeers) == 1)) txError = ETIMEDOUT;
     }
-    
-    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
-        peerList = &manager->txRelays[i - 1];
-
-        for (size_t j = array_count(peerList->peers); j > 0; j--) {
-            if (BRPeerEq(&peerList->peers[j - 1], peer)) array_rm(peerList->peers, j - 1);
-        }
-    }
 
     if (peer == manager->downloadPeer) { // download peer disconnected
         manager->isConnected = 0;
@@ -855,6 +1088,17 @@ static void _peerDisconnected(void *info, int error)
     }
     else if (manager->connectFailureCount < MAX_CONNECT_FAILURES) willReconnect = 1;
     
+    _BRPeerManagerLock(&manager->txLock);
+    BRPublishedTx pubTx[array_count(manager->publishedTx)];
+
+    for (size_t i = array_count(manager->txRelays); i > 0; i--) {
+        peerList = &manager->txRelays[i - 1];
+
+        for (size_t j = array_count(peerList->peers); j > 0; j--) {
+            if (BRPeerEq(&peerList->peers[j - 1], peer)) array_rm(peerList->peers, j - 1);
+        }
+    }
+
     if (txError) {
         for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
             if (manager->publishedTx[i - 1].callback == NULL) continue;
@@ -864,6 +1108,8 @@ static void _peerDisconnected(void *info, int error)
             manager->publishedTx[i - 1].info = NULL;
         }
     }
+
+    _BRPeerManagerUnlock(&manager->txLock);
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
         if (manager->connectedPeers[i - 1] != peer) continue;
@@ -872,7 +1118,7 @@ static void _peerDisconnected(void *info, int error)
     }
 
     BRPeerFree(peer);
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     
     for (size_t i = 0; i < txCount; i++) {
         pubTx[i].callback(pubTx[i].info, txError);
@@ -890,7 +1136,7 @@ static void _peerRelayedPeers(void *info, const BRPeer peers[], size_t peersCoun
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     time_t now = time(NULL);
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     peer_log(peer, "relayed %zu peer(s)", peersCount);
 
     array_add_array(manager->peers, peers, peersCount);
@@ -907,7 +1153,7 @@ static void _peerRelayedPeers(void *info, const BRPeer peers[], size_t peersCoun
     BRPeer save[peersCount];
 
     for (size_t i = 0; i < peersCount; i++) save[i] = manager->peers[i];
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     
     // peer relaying is complete when we receive <1000
     if (peersCount > 1 && peersCount < 1000 &&
@@ -920,10 +1166,17 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     void *txInfo = NULL;
     void (*txCallback)(void *, int) = NULL;
-    int isWalletTx = 0, hasPendingCallbacks = 0;
-    size_t relayCount = 0;
+    int isWalletTx = 0, hasPendingCallbacks = 0, isDownloadPeer, needsFilterUpdate = 0;
+    uint32_t syncStartHeight;
+    size_t relayCount = 0, maxConnectCount;
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
+    syncStartHeight = manager->syncStartHeight;
+    isDownloadPeer = (peer == manager->downloadPeer);
+    maxConnectCount = manager->maxConnectCount;
+    _BRPeerManagerUnlock(&manager->peerLock);
+
+    _BRPeerManagerLock(&manager->txLock);
     peer_log(peer, "relayed tx: %s", u256hex(tx->txHash));
     
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) { // see if tx is in list of published tx
@@ -938,11 +1191,11 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
     }
 
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (! hasPendingCallbacks && (syncStartHeight == 0 || ! isDownloadPeer)) {
         BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
-    if (manager->syncStartHeight == 0 || BRWalletContainsTransaction(manager->wallet, tx)) {
+    if (syncStartHeight == 0 || BRWalletContainsTransaction(manager->wallet, tx)) {
         isWalletTx = BRWalletRegisterTransaction(manager->wallet, tx);
         if (isWalletTx) tx = BRWalletTransactionForHash(manager->wallet, tx->txHash);
     }
@@ -953,7 +1206,7 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
     
     if (tx && isWalletTx) {
         // reschedule sync timeout
-        if (manager->syncStartHeight > 0 && peer == manager->downloadPeer) {
+        if (syncStartHeight > 0 && isDownloadPeer) {
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
         }
         
@@ -963,36 +1216,46 @@ static void _peerRelayedTx(void *info, BRTransaction *tx)
 
         // keep track of how many peers have or relay a tx, this indicates how likely the tx is to confirm
         // (we only need to track this after syncing is complete)
-        if (manager->syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, tx->txHash, peer);
+        if (syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, tx->txHash, peer);
         
         _BRTxPeerListRemovePeer(manager->txRequests, tx->txHash, peer);
-        
-        if (manager->bloomFilter != NULL) { // check if bloom filter is already being updated
-            BRAddress addrs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
-            UInt160 hash;
-
-            // the transaction likely consumed one or more wallet addresses, so check that at least the next <gap limit>
-            // unused addresses are still matched by the bloom filter
-            BRWalletUnusedAddrs(manager->wallet, addrs, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
-            BRWalletUnusedAddrs(manager->wallet, addrs + SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
-
-            for (size_t i = 0; i < SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL; i++) {
-                if (! BRAddressHash160(&hash, manager->params->addrParams, addrs[i].s) ||
-                    BRBloomFilterContainsData(manager->bloomFilter, hash.u8, sizeof(hash))) continue;
-                if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
-                manager->bloomFilter = NULL; // reset bloom filter so it's recreated with new wallet addresses
-                _BRPeerManagerUpdateFilter(manager);
-                break;
-            }
-        }
     }
     
     // set timestamp when tx is verified
-    if (tx && relayCount >= manager->maxConnectCount && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
+    if (tx && relayCount >= maxConnectCount && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
         BRWalletUpdateTransactions(manager->wallet, &tx->txHash, 1, TX_UNCONFIRMED, (uint32_t)time(NULL));
     }
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->txLock);
+
+    if (tx && isWalletTx) {
+        BRAddress addrs[SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL];
+        UInt160 hash;
+
+        // the transaction likely consumed one or more wallet addresses, so check that at least the next <gap limit>
+        // unused addresses are still matched by the bloom filter
+        BRWalletUnusedAddrs(manager->wallet, addrs, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
+        BRWalletUnusedAddrs(manager->wallet, addrs + SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
+        _BRPeerManagerLock(&manager->filterLock);
+
+        // a NULL bloom filter is already being updated
+        for (size_t i = 0; manager->bloomFilter && i < SEQUENCE_GAP_LIMIT_EXTERNAL + SEQUENCE_GAP_LIMIT_INTERNAL; i++) {
+            if (! BRAddressHash160(&hash, manager->params->addrParams, addrs[i].s) ||
+                BRBloomFilterContainsData(manager->bloomFilter, hash.u8, sizeof(hash))) continue;
+            BRBloomFilterFree(manager->bloomFilter);
+            manager->bloomFilter = NULL; // reset bloom filter so it's recreated with new wallet addresses
+            needsFilterUpdate = 1;
+        }
+
+        _BRPeerManagerUnlock(&manager->filterLock);
+    }
+
+    if (needsFilterUpdate) {
+        _BRPeerManagerLock(&manager->peerLock);
+        _BRPeerManagerUpdateFilter(manager);
+        _BRPeerManagerUnlock(&manager->peerLock);
+    }
+
     if (txCallback) txCallback(txInfo, 0);
 }
 
@@ -1002,10 +1265,17 @@ static void _peerHasTx(void *info, UInt256 txHash)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRTransaction *tx;
     BRPublishedTx pubTx = { NULL, NULL, NULL };
-    int isWalletTx = 0, hasPendingCallbacks = 0;
-    size_t relayCount = 0;
+    int isWalletTx = 0, hasPendingCallbacks = 0, isDownloadPeer;
+    uint32_t syncStartHeight;
+    size_t relayCount = 0, maxConnectCount;
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
+    syncStartHeight = manager->syncStartHeight;
+    isDownloadPeer = (peer == manager->downloadPeer);
+    maxConnectCount = manager->maxConnectCount;
+    _BRPeerManagerUnlock(&manager->peerLock);
+
+    _BRPeerManagerLock(&manager->txLock);
     tx = BRWalletTransactionForHash(manager->wallet, txHash);
     peer_log(peer, "has tx: %s", u256hex(txHash));
 
@@ -1021,7 +1291,7 @@ static void _peerHasTx(void *info, UInt256 txHash)
     }
     
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (! hasPendingCallbacks && (syncStartHeight == 0 || ! isDownloadPeer)) {
         BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
@@ -1030,23 +1300,23 @@ static void _peerHasTx(void *info, UInt256 txHash)
         if (isWalletTx) tx = BRWalletTransactionForHash(manager->wallet, tx->txHash);
 
         // reschedule sync timeout
-        if (manager->syncStartHeight > 0 && peer == manager->downloadPeer && isWalletTx) {
+        if (syncStartHeight > 0 && isDownloadPeer && isWalletTx) {
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT);
         }
         
         // keep track of how many peers have or relay a tx, this indicates how likely the tx is to confirm
         // (we only need to track this after syncing is complete)
-        if (manager->syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
+        if (syncStartHeight == 0) relayCount = _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
 
         // set timestamp when tx is verified
-        if (relayCount >= manager->maxConnectCount && tx && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
+        if (relayCount >= maxConnectCount && tx && tx->blockHeight == TX_UNCONFIRMED && tx->timestamp == 0) {
             BRWalletUpdateTransactions(manager->wallet, &txHash, 1, TX_UNCONFIRMED, (uint32_t)time(NULL));
         }
 
         _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
     }
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->txLock);
     if (pubTx.callback) pubTx.callback(pubTx.info, 0);
 }
 
@@ -1056,7 +1326,7 @@ static void _peerRejectedTx(void *info, UInt256 txHash, uint8_t code)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRTransaction *tx, *t;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->txLock);
     peer_log(peer, "rejected tx: %s", u256hex(txHash));
     tx = BRWalletTransactionForHash(manager->wallet, txHash);
     _BRTxPeerListRemovePeer(manager->txRequests, txHash, peer);
@@ -1075,15 +1345,22 @@ static void _peerRejectedTx(void *info, UInt256 txHash, uint8_t code)
                 tx = NULL;
                 break;
             }
-            
-            if (tx) _BRPeerManagerPeerMisbehavin(manager, peer);
         }
+        else tx = NULL;
+    }
+
+    _BRPeerManagerUnlock(&manager->txLock);
+
+    if (tx) {
+        _BRPeerManagerLock(&manager->peerLock);
+        _BRPeerManagerPeerMisbehavin(manager, peer);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 
-    pthread_mutex_unlock(&manager->lock);
     if (manager->txStatusUpdate) manager->txStatusUpdate(manager->info);
 }
 
+// called with chainLock held
 static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *block, BRMerkleBlock *prev, BRPeer *peer)
 {
     int r = 1;
@@ -1095,8 +1372,14 @@ static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *bloc
         BRMerkleBlock *b = block;
         UInt256 prevBlock;
 
-        for (uint32_t i = 0; b && i < BLOCK_DIFFICULTY_INTERVAL; i++) {
-            b = BRSetGet(manager->blocks, &b->prevBlock);
+        if (_BRPeerManagerChainBlock(manager, prev->height) == prev) { // block extends the main chain
+            b = (block->height >= BLOCK_DIFFICULTY_INTERVAL) ?
+                _BRPeerManagerChainBlock(manager, block->height - BLOCK_DIFFICULTY_INTERVAL) : NULL;
+        }
+        else {
+            for (uint32_t i = 0; b && i < BLOCK_DIFFICULTY_INTERVAL; i++) {
+                b = BRSetGet(manager->blocks, &b->prevBlock);
+            }
         }
 
         if (! b) {
@@ -1110,6 +1393,7 @@ static int _BRPeerManagerVerifyBlock(BRPeerManager *manager, BRMerkleBlock *bloc
             if (b) prevBlock = b->prevBlock;
 
             if (b && (b->height % BLOCK_DIFFICULTY_INTERVAL) != 0) {
+                _BRPeerManagerForgetBlock(manager, b);
                 BRSetRemove(manager->blocks, b);
                 BRMerkleBlockFree(b);
             }
@@ -1157,7 +1441,9 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     size_t i, j, fpCount = 0, saveCount = 0;
     BRMerkleBlock orphan, *b, *b2, *prev, *next = NULL;
-    uint32_t txTime = 0;
+    uint32_t txTime = 0, currentBlockHeight = 0;
+    int isDownloadPeer, isFilterPending, misbehavin = 0, resetFailureCount = 0, needsFilterUpdate = 0, loadMempools = 0;
+    double fpRate;
 
     if (NULL == peer || NULL == manager) {
         _peerRelayedBlockFailed (block, peer, "missed 'peer' or 'manager'");
@@ -1186,7 +1472,19 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
     assert(txHashes != NULL);
     txCount = BRMerkleBlockTxHashes(block, txHashes, txCount);
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
+    isDownloadPeer = (peer == manager->downloadPeer);
+    _BRPeerManagerUnlock(&manager->peerLock);
+
+    if (isDownloadPeer && block->totalTx > 0) {
+        for (i = 0; i < txCount; i++) { // wallet tx are not false-positives
+            if (! BRWalletTransactionForHash(manager->wallet, txHashes[i])) fpCount++;
+        }
+    }
+
+    // the chain is updated holding only chainLock (and filterLock, briefly), so that tx relays and inventory from other
+    // peers aren't held up; changes to the peer list and connection state are made after chainLock is released
+    _BRPeerManagerLock(&manager->chainLock);
     prev = BRSetGet(manager->blocks, &block->prevBlock);
 
     if (prev) {
@@ -1194,12 +1492,10 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         block->height = prev->height + 1;
     }
     
+    _BRPeerManagerLock(&manager->filterLock);
+
     // track the observed bloom filter false positive rate using a low pass filter to smooth out variance
-    if (peer == manager->downloadPeer && block->totalTx > 0) {
-        for (i = 0; i < txCount; i++) { // wallet tx are not false-positives
-            if (! BRWalletTransactionForHash(manager->wallet, txHashes[i])) fpCount++;
-        }
-        
+    if (isDownloadPeer && block->totalTx > 0) {
         // moving average number of tx-per-block
         manager->averageTxPerBlock = manager->averageTxPerBlock*0.999 + block->totalTx*0.001;
         
@@ -1216,22 +1512,27 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         }
         else if (manager->lastBlock->height + 500 < BRPeerLastBlock(peer) &&
                  manager->fpRate > BLOOM_REDUCED_FALSEPOSITIVE_RATE*10.0) {
-            _BRPeerManagerUpdateFilter(manager); // rebuild bloom filter when it starts to degrade
+            manager->filterNeedsRebuild = 1; // rebuild bloom filter when it starts to degrade
+            needsFilterUpdate = 1;
         }
     }
 
+    fpRate = manager->fpRate;
+    isFilterPending = (manager->bloomFilter == NULL);
+    _BRPeerManagerUnlock(&manager->filterLock);
+
     // ignore block headers that are newer than one week before earliestKeyTime (it's a header if it has 0 totalTx)
     if (block->totalTx == 0 && block->timestamp + 7*24*60*60 - 2*60*60 > manager->earliestKeyTime) {
         BRMerkleBlockFree(block);
         block = NULL;
     }
-    else if (manager->bloomFilter == NULL) { // ingore potentially incomplete blocks when a filter update is pending
+    else if (isFilterPending) { // ingore potentially incomplete blocks when a filter update is pending
         BRMerkleBlockFree(block);
         block = NULL;
 
-        if (peer == manager->downloadPeer && manager->lastBlock->height < manager->estimatedHeight) {
+        if (isDownloadPeer && manager->lastBlock->height < manager->estimatedHeight) {
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
-            manager->connectFailureCount = 0; // reset failure count once we know our initial request didn't timeout
+            resetFailureCount = 1; // reset failure count once we know our initial request didn't timeout
         }
     }
     else if (! prev) { // block is an orphan
@@ -1263,21 +1564,21 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         peer_log(peer, "relayed invalid block");
         BRMerkleBlockFree(block);
         block = NULL;
-        _BRPeerManagerPeerMisbehavin(manager, peer);
+        misbehavin = 1;
     }
     else if (UInt256Eq(block->prevBlock, manager->lastBlock->blockHash)) { // new block extends main chain
         if ((block->height % 500) == 0 || txCount > 0 || block->height >= BRPeerLastBlock(peer)) {
-            peer_log(peer, "adding block #%"PRIu32", false positive rate: %f", block->height, manager->fpRate);
+            peer_log(peer, "adding block #%"PRIu32", false positive rate: %f", block->height, fpRate);
         }
         
         BRSetAdd(manager->blocks, block);
-        manager->lastBlock = block;
+        _BRPeerManagerSetLastBlock(manager, block);
         if (txCount > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, txCount, block->height, txTime);
-        if (manager->downloadPeer) BRPeerSetCurrentBlockHeight(manager->downloadPeer, block->height);
+        currentBlockHeight = block->height;
             
-        if (block->height < manager->estimatedHeight && peer == manager->downloadPeer) {
+        if (block->height < manager->estimatedHeight && isDownloadPeer) {
             BRPeerScheduleDisconnect(peer, PROTOCOL_TIMEOUT); // reschedule sync timeout
-            manager->connectFailureCount = 0; // reset failure count once we know our initial request didn't timeout
+            resetFailureCount = 1; // reset failure count once we know our initial request didn't timeout
         }
         
         if ((block->height % BLOCK_DIFFICULTY_INTERVAL) == 0 && block->height + 100 < manager->estimatedHeight) {
@@ -1286,7 +1587,7 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         
         if (block->height == manager->estimatedHeight) { // chain download is complete
             saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
-            _BRPeerManagerLoadMempools(manager);
+            loadMempools = 1;
         }
     }
     else if (BRSetContains(manager->blocks, block)) { // we already have the block (or at least the header)
@@ -1294,11 +1595,11 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
             peer_log(peer, "relayed existing block #%"PRIu32, block->height);
         }
         
-        b = manager->lastBlock;
-        while (b && b->height > block->height) b = BRSetGet(manager->blocks, &b->prevBlock); // is block in main chain?
+        b = _BRPeerManagerChainBlock(manager, block->height); // is block in main chain?
 
         if (b && BRMerkleBlockEq(b, block)) { // if it's not on a fork, set block heights for its transactions
             if (txCount > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, txCount, block->height, txTime);
+            if (b != block) manager->chain[block->height - manager->chainStart] = block;
             if (block->height == manager->lastBlock->height) manager->lastBlock = block;
         }
         
@@ -1324,13 +1625,14 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         // TODO: calculate chain work and use that instead of block height to determine longest chain
         if (block->height > manager->lastBlock->height) { // check if fork is now longer than main chain
             b = block;
-            b2 = manager->lastBlock;
-            
-            while (b && b2 && ! BRMerkleBlockEq(b, b2)) { // walk back to where the fork joins the main chain
+
+            // walk back to where the fork joins the main chain
+            while (b && b->height >= manager->chainStart && _BRPeerManagerChainBlock(manager, b->height) != b) {
                 b = BRSetGet(manager->blocks, &b->prevBlock);
-                if (b && b->height < b2->height) b2 = BRSetGet(manager->blocks, &b2->prevBlock);
             }
 
+            b2 = (b) ? _BRPeerManagerChainBlock(manager, b->height) : NULL;
+
             if (NULL == b) {
                 _peerRelayedBlockFailed (NULL, peer, "In 'on a fork' missed 'b'");
                 return;
@@ -1356,16 +1658,16 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
                 }
                 
                 count = BRMerkleBlockTxHashes(b, txHashes, count);
-                b = BRSetGet(manager->blocks, &b->prevBlock);
+                b = _BRPeerManagerPrevBlock(manager, b);
                 if (b) timestamp = timestamp/2 + b->timestamp/2;
                 if (count > 0) BRWalletUpdateTransactions(manager->wallet, txHashes, count, height, timestamp);
             }
         
-            manager->lastBlock = block;
+            _BRPeerManagerSetLastBlock(manager, block);
             
             if (block->height == manager->estimatedHeight) { // chain download is complete
                 saveCount = (block->height % BLOCK_DIFFICULTY_INTERVAL) + BLOCK_DIFFICULTY_INTERVAL + 1;
-                _BRPeerManagerLoadMempools(manager);
+                loadMempools = 1;
             }
         }
     }
@@ -1388,7 +1690,7 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
             return;
         }
         saveBlocks[i] = b;
-        b = BRSetGet(manager->blocks, &b->prevBlock);
+        b = _BRPeerManagerPrevBlock(manager, b);
     }
     
     // make sure the set of blocks to be saved starts at a difficulty interval
@@ -1399,7 +1701,20 @@ static void _peerRelayedBlock(void *info, BRMerkleBlock *block)
         return;
     }
     if (i > 0 && manager->saveBlocks) manager->saveBlocks(manager->info, (i > 1 ? 1 : 0), saveBlocks, i);
-    pthread_mutex_unlock(&manager->lock);
+    if (i > 0 && manager->headerStore) BRHeaderStoreSync(manager->headerStore); // flush once per save, not per header
+    _BRPeerManagerUnlock(&manager->chainLock);
+
+    if (resetFailureCount || currentBlockHeight || needsFilterUpdate || loadMempools || misbehavin) {
+        _BRPeerManagerLock(&manager->peerLock);
+        if (resetFailureCount) manager->connectFailureCount = 0;
+        if (currentBlockHeight && manager->downloadPeer) {
+            BRPeerSetCurrentBlockHeight(manager->downloadPeer, currentBlockHeight);
+        }
+        if (needsFilterUpdate) _BRPeerManagerUpdateFilter(manager);
+        if (loadMempools) _BRPeerManagerLoadMempools(manager);
+        if (misbehavin) _BRPeerManagerPeerMisbehavin(manager, peer);
+        _BRPeerManagerUnlock(&manager->peerLock);
+    }
     
     if (block && block->height != BLOCK_UNKNOWN_HEIGHT && block->height >= BRPeerLastBlock(peer) &&
         manager->txStatusUpdate) {
@@ -1415,14 +1730,14 @@ static void _peerDataNotfound(void *info, const UInt256 txHashes[], size_t txCou
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->txLock);
 
     for (size_t i = 0; i < txCount; i++) {
         _BRTxPeerListRemovePeer(manager->txRelays, txHashes[i], peer);
         _BRTxPeerListRemovePeer(manager->txRequests, txHashes[i], peer);
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->txLock);
 }
 
 static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
@@ -1431,7 +1746,7 @@ static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     uint64_t maxFeePerKb = 0, secondFeePerKb = 0;
     
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) { // find second highest fee rate
         p = manager->connectedPeers[i - 1];
@@ -1445,7 +1760,7 @@ static void _peerSetFeePerKb(void *info, uint64_t feePerKb)
         BRWalletSetFeePerKb(manager->wallet, secondFeePerKb*3/2);
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 }
 
 static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
@@ -1453,9 +1768,15 @@ static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
     BRPeer *peer = ((BRPeerCallbackInfo *)info)->peer;
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     BRPublishedTx pubTx = { NULL, NULL, NULL };
-    int hasPendingCallbacks = 0, error = 0;
+    int hasPendingCallbacks = 0, error = 0, isDownloadPeer;
+    uint32_t syncStartHeight;
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
+    syncStartHeight = manager->syncStartHeight;
+    isDownloadPeer = (peer == manager->downloadPeer);
+    _BRPeerManagerUnlock(&manager->peerLock);
+
+    _BRPeerManagerLock(&manager->txLock);
 
     for (size_t i = array_count(manager->publishedTx); i > 0; i--) {
         if (UInt256Eq(manager->publishedTxHashes[i - 1], txHash)) {
@@ -1467,14 +1788,14 @@ static BRTransaction *_peerRequestedTx(void *info, UInt256 txHash)
     }
 
     // cancel tx publish timeout if no publish callbacks are pending, and syncing is done or this is not downloadPeer
-    if (! hasPendingCallbacks && (manager->syncStartHeight == 0 || peer != manager->downloadPeer)) {
+    if (! hasPendingCallbacks && (syncStartHeight == 0 || ! isDownloadPeer)) {
         BRPeerScheduleDisconnect(peer, -1); // cancel publish tx timeout
     }
 
     _BRTxPeerListAddPeer(&manager->txRelays, txHash, peer);
     if (pubTx.tx) BRWalletRegisterTransaction(manager->wallet, pubTx.tx);
     if (pubTx.tx && ! BRWalletTransactionIsValid(manager->wallet, pubTx.tx)) error = EINVAL;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->txLock);
     if (pubTx.callback) pubTx.callback(pubTx.info, error);
     return pubTx.tx;
 }
@@ -1491,9 +1812,9 @@ static void _peerThreadCleanup(void *info)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
 
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     manager->peerThreadCount--;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     if (manager->threadCleanup) manager->threadCleanup(manager->info);
 }
 
@@ -1560,13 +1881,18 @@ BRPeerManager *BRPeerManagerNew(const BRChainParams *params, BRWallet *wallet, u
         block = BRSetGet(manager->orphans, &orphan);
     }
 
+    array_new(manager->chain, BLOCK_DIFFICULTY_INTERVAL*2);
+    _BRPeerManagerSetLastBlock(manager, manager->lastBlock);
     _peer_log("BPM: initialized with %u last block height\n", manager->lastBlock->height);
 
     array_new(manager->txRelays, 10);
     array_new(manager->txRequests, 10);
     array_new(manager->publishedTx, 10);
     array_new(manager->publishedTxHashes, 10);
-    pthread_mutex_init(&manager->lock, NULL);
+    _BRPeerManagerLockInit(&manager->peerLock);
+    _BRPeerManagerLockInit(&manager->chainLock);
+    _BRPeerManagerLockInit(&manager->filterLock);
+    _BRPeerManagerLockInit(&manager->txLock);
     manager->threadCleanup = _dummyThreadCleanup;
     return manager;
 }
@@ -1608,28 +1934,91 @@ void BRPeerManagerSetFixedPeer(BRPeerManager *manager, UInt128 address, uint16_t
 {
     assert(manager != NULL);
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     int samePeer = (UInt128Eq(address, manager->fixedPeer.address) &&
                     (port == manager->fixedPeer.port || UInt128IsZero(address)));
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 
     if (!samePeer) {
         BRPeerManagerDisconnect(manager);
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
         manager->maxConnectCount = UInt128IsZero(address) ? PEER_MAX_CONNECTIONS : 1;
         manager->fixedPeer = ((const BRPeer) { address, port, 0, 0, 0 });
         array_clear(manager->peers);
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 }
 
+// handles the connections to peers on reactor, rather than on a thread per peer; set reactor to NULL to revert to
+// default behavior - reactor must not be freed while the manager is connected
+void BRPeerManagerSetReactor(BRPeerManager *manager, BRPeerReactor *reactor)
+{
+    assert(manager != NULL);
+    _BRPeerManagerLock(&manager->peerLock);
+    manager->reactor = reactor; // applies to peers connected from now on
+    _BRPeerManagerUnlock(&manager->peerLock);
+}
+
+// appends main chain block headers to store as the chain grows, and if store has headers past the manager's last
+// block, restores the chain from them
+void BRPeerManagerSetHeaderStore(BRPeerManager *manager, BRHeaderStore *store)
+{
+    BRMerkleBlock *block = NULL, *b, *existing, *checkpoint;
+    uint32_t height, lastHeight, now = (uint32_t)time(NULL);
+
+    assert(manager != NULL);
+    _BRPeerManagerLock(&manager->chainLock);
+    manager->headerStore = NULL;
+    lastHeight = (store) ? BRHeaderStoreLastHeight(store) : BLOCK_UNKNOWN_HEIGHT;
+
+    if (lastHeight != BLOCK_UNKNOWN_HEIGHT && lastHeight > manager->lastBlock->height) {
+        // verifying the blocks that follow only needs the ones since the last difficulty transition
+        height = lastHeight - lastHeight % BLOCK_DIFFICULTY_INTERVAL;
+        if (height < BRHeaderStoreStartHeight(store)) height = BRHeaderStoreStartHeight(store);
+
+        for (; height <= lastHeight && (b = BRHeaderStoreBlock(store, height)) != NULL; height++) {
+            existing = BRSetGet(manager->blocks, b);
+
+            if (existing) BRMerkleBlockFree(b), b = existing;
+            else {
+                // the store's file is only checked for an unbroken chain, so restored headers are held to the same
+                // rules as relayed ones - the first has no previous block to check its difficulty against, and the
+                // ones after it follow it within the same difficulty interval
+                checkpoint = BRSetGet(manager->checkpoints, b);
+
+                if (! BRMerkleBlockIsValid(b, now) ||
+                    (checkpoint && ! UInt256Eq(b->blockHash, checkpoint->blockHash)) ||
+                    (block && (! UInt256Eq(b->prevBlock, block->blockHash) || b->height != block->height + 1 ||
+                               ! manager->params->verifyDifficulty(b, manager->blocks)))) {
+                    _peer_log("BPM: invalid header at height %"PRIu32" in header store\n", height);
+                    BRMerkleBlockFree(b);
+                    BRHeaderStoreTruncate(store, height);
+                    break;
+                }
+
+                BRSetAdd(manager->blocks, b);
+            }
+
+            block = b;
+        }
+
+        if (block && block->height > manager->lastBlock->height) _BRPeerManagerSetLastBlock(manager, block);
+        _peer_log("BPM: restored %u last block height from header store\n", manager->lastBlock->height);
+    }
+
+    manager->headerStore = store;
+    _BRPeerManagerStoreHeaders(manager, manager->chainStart); // seed the store with any blocks it doesn't have
+    if (store) BRHeaderStoreSync(store);
+    _BRPeerManagerUnlock(&manager->chainLock);
+}
+
 // current connect status
 BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager)
 {
     BRPeerStatus status = BRPeerStatusDisconnected;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     if (manager->isConnected != 0) status = BRPeerStatusConnected;
 
     for (size_t i = array_count(manager->connectedPeers); i > 0 && status == BRPeerStatusDisconnected; i--) {
@@ -1637,23 +2026,28 @@ BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager)
         status = BRPeerStatusConnecting;
     }
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     return status;
 }
 
 // connect to bitcoin peer-to-peer network (also call this whenever networkIsReachable() status changes)
 void BRPeerManagerConnect(BRPeerManager *manager)
 {
+    uint32_t lastHeight, estimatedHeight;
+
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     if (manager->connectFailureCount >= MAX_CONNECT_FAILURES) manager->connectFailureCount = 0; //this is a manual retry
-    
-    if ((! manager->downloadPeer || manager->lastBlock->height < manager->estimatedHeight) &&
-        manager->syncStartHeight == 0) {
-        manager->syncStartHeight = manager->lastBlock->height + 1;
-        pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerLock(&manager->chainLock);
+    lastHeight = manager->lastBlock->height;
+    estimatedHeight = manager->estimatedHeight;
+    _BRPeerManagerUnlock(&manager->chainLock);
+    
+    if ((! manager->downloadPeer || lastHeight < estimatedHeight) && manager->syncStartHeight == 0) {
+        manager->syncStartHeight = lastHeight + 1;
+        _BRPeerManagerUnlock(&manager->peerLock);
         if (manager->syncStarted) manager->syncStarted(manager->info);
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
     }
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
@@ -1700,12 +2094,13 @@ void BRPeerManagerConnect(BRPeerManager *manager)
                                    _peerRelayedTx, _peerHasTx, _peerRejectedTx, _peerRelayedBlock, _peerDataNotfound,
                                    _peerSetFeePerKb, _peerRequestedTx, _peerNetworkIsReachable, _peerThreadCleanup);
                 BRPeerSetEarliestKeyTime(info->peer, manager->earliestKeyTime);
+                if (manager->reactor) BRPeerSetReactor(info->peer, manager->reactor);
                 BRPeerConnect(info->peer);
 
                 if (BRPeerConnectStatus(info->peer) == BRPeerStatusDisconnected) {
-                    pthread_mutex_unlock(&manager->lock);
+                    _BRPeerManagerUnlock(&manager->peerLock);
                     _peerDisconnected(info, ENOTCONN);
-                    pthread_mutex_lock(&manager->lock);
+                    _BRPeerManagerLock(&manager->peerLock);
                     manager->peerThreadCount--;
                 }
             }
@@ -1716,10 +2111,10 @@ void BRPeerManagerConnect(BRPeerManager *manager)
     
     if (array_count(manager->connectedPeers) == 0) {
         _BRPeerManagerSyncStopped(manager);
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
         if (manager->syncStopped) manager->syncStopped(manager->info, ENETUNREACH);
     }
-    else pthread_mutex_unlock(&manager->lock);
+    else _BRPeerManagerUnlock(&manager->peerLock);
 }
 
 void BRPeerManagerDisconnect(BRPeerManager *manager)
@@ -1729,7 +2124,7 @@ void BRPeerManagerDisconnect(BRPeerManager *manager)
     BRPeer *p;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
 
     // prevent new peers from being spawned
     maxConnectCount = manager->maxConnectCount;
@@ -1744,27 +2139,29 @@ void BRPeerManagerDisconnect(BRPeerManager *manager)
 
     peerThreadCount = manager->peerThreadCount;
     dnsThreadCount = manager->dnsThreadCount;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     ts.tv_sec = 0;
     ts.tv_nsec = 1;
     
     while (peerThreadCount > 0 || dnsThreadCount > 0) {
         nanosleep(&ts, NULL); // pthread_yield() isn't POSIX standard :(
-        pthread_mutex_lock(&manager->lock);
+        _BRPeerManagerLock(&manager->peerLock);
         peerThreadCount = manager->peerThreadCount;
         dnsThreadCount = manager->dnsThreadCount;
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     manager->maxConnectCount = maxConnectCount;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 }
 
+// called with peerLock and chainLock held
 static int _BRPeerManagerRescan(BRPeerManager *manager, BRMerkleBlock *newLastBlock) {
     if (NULL == newLastBlock) return 0;
 
-    manager->lastBlock = newLastBlock;
+    _BRPeerManagerSetLastBlock(manager, newLastBlock);
+    if (manager->headerStore) BRHeaderStoreTruncate(manager->headerStore, newLastBlock->height + 1);
     _peer_log("BPM: rescanning with %u last block height", manager->lastBlock->height);
 
     if (manager->downloadPeer) { // disconnect the current download peer so a new random one will be selected
@@ -1784,12 +2181,14 @@ static int _BRPeerManagerRescan(BRPeerManager *manager, BRMerkleBlock *newLastBl
 void BRPeerManagerRescan(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     
     int needConnect = 0;
     if (manager->isConnected) {
         BRMerkleBlock *newLastBlock = NULL;
 
+        _BRPeerManagerLock(&manager->chainLock);
+
         // start the chain download from the most recent checkpoint that's at least a week older than earliestKeyTime
         for (size_t i = manager->params->checkpointsCount; i > 0; i--) {
             if (i - 1 == 0 || manager->params->checkpoints[i - 1].timestamp + 7*24*60*60 < manager->earliestKeyTime) {
@@ -1801,8 +2200,9 @@ void BRPeerManagerRescan(BRPeerManager *manager)
         }
 
         needConnect = _BRPeerManagerRescan(manager, newLastBlock);
+        _BRPeerManagerUnlock(&manager->chainLock);
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
@@ -1810,29 +2210,28 @@ void BRPeerManagerRescan(BRPeerManager *manager)
 void BRPeerManagerRescanFromLastHardcodedCheckpoint(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
 
     int needConnect = 0;
     if (manager->isConnected) {
         size_t i = manager->params->checkpointsCount;
         if (i > 0) {
             UInt256 hash = UInt256Reverse(manager->params->checkpoints[i - 1].hash);
+            _BRPeerManagerLock(&manager->chainLock);
             needConnect = _BRPeerManagerRescan(manager, BRSetGet (manager->blocks, &hash));
+            _BRPeerManagerUnlock(&manager->chainLock);
         }
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
+// called with chainLock held
 static BRMerkleBlock *_BRPeerManagerLookupBlockFromBlockNumber(BRPeerManager *manager, uint32_t blockNumber)
 {
-    BRMerkleBlock *block = manager->lastBlock;
+    BRMerkleBlock *block = _BRPeerManagerChainBlock(manager, blockNumber);
 
-    // walk the chain, looking for blockNumber
-    while (block) {
-        if (block->height == blockNumber) return block;
-        block = BRSetGet (manager->blocks, &block->prevBlock);
-    }
+    if (block) return block;
 
     // blockNumber not in the (abbreviated) chain - look through checkpoints
     for (int i = 0; i < manager->params->checkpointsCount; i++)
@@ -1849,10 +2248,11 @@ static BRMerkleBlock *_BRPeerManagerLookupBlockFromBlockNumber(BRPeerManager *ma
 void BRPeerManagerRescanFromBlockNumber(BRPeerManager *manager, uint32_t blockNumber)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
 
     int needConnect = 0;
     if (manager->isConnected) {
+        _BRPeerManagerLock(&manager->chainLock);
         BRMerkleBlock *block = _BRPeerManagerLookupBlockFromBlockNumber(manager, blockNumber);
 
         // If there was no block, find the preceeding hardcoded checkpoint.
@@ -1867,8 +2267,9 @@ void BRPeerManagerRescanFromBlockNumber(BRPeerManager *manager, uint32_t blockNu
         }
 
         needConnect = _BRPeerManagerRescan(manager, block);
+        _BRPeerManagerUnlock(&manager->chainLock);
     }
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     if (needConnect) BRPeerManagerConnect(manager);
 }
 
@@ -1878,10 +2279,10 @@ uint32_t BRPeerManagerEstimatedBlockHeight(BRPeerManager *manager)
     uint32_t height;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->chainLock);
     height = (manager->lastBlock->height < manager->estimatedHeight) ? manager->estimatedHeight :
              manager->lastBlock->height;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->chainLock);
     return height;
 }
 
@@ -1891,9 +2292,9 @@ uint32_t BRPeerManagerLastBlockHeight(BRPeerManager *manager)
     uint32_t height;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->chainLock);
     height = manager->lastBlock->height;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->chainLock);
     return height;
 }
 
@@ -1903,9 +2304,9 @@ uint32_t BRPeerManagerLastBlockTimestamp(BRPeerManager *manager)
     uint32_t timestamp;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->chainLock);
     timestamp = manager->lastBlock->timestamp;
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->chainLock);
     return timestamp;
 }
 
@@ -1916,8 +2317,9 @@ double BRPeerManagerSyncProgress(BRPeerManager *manager, uint32_t startHeight)
     double progress;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     if (startHeight == 0) startHeight = manager->syncStartHeight;
+    _BRPeerManagerLock(&manager->chainLock);
     
     if (! manager->downloadPeer && manager->syncStartHeight == 0) {
         progress = 0.0;
@@ -1930,7 +2332,8 @@ double BRPeerManagerSyncProgress(BRPeerManager *manager, uint32_t startHeight)
     }
     else progress = 1.0;
 
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->chainLock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     return progress;
 }
 
@@ -1940,13 +2343,13 @@ size_t BRPeerManagerPeerCount(BRPeerManager *manager)
     size_t count = 0;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) {
         if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) != BRPeerStatusDisconnected) count++;
     }
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     return count;
 }
 
@@ -1954,14 +2357,14 @@ size_t BRPeerManagerPeerCount(BRPeerManager *manager)
 const char *BRPeerManagerDownloadPeerName(BRPeerManager *manager)
 {
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
 
     if (manager->downloadPeer) {
         sprintf(manager->downloadPeerName, "%s:%d", BRPeerHost(manager->downloadPeer), manager->downloadPeer->port);
     }
     else manager->downloadPeerName[0] = '\0';
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
     return manager->downloadPeerName;
 }
 
@@ -1971,9 +2374,9 @@ static void _publishTxInvDone(void *info, int success)
     BRPeerManager *manager = ((BRPeerCallbackInfo *)info)->manager;
     
     free(info);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     _BRPeerManagerRequestUnrelayedTx(manager, peer);
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
 }
 
 // publishes tx to bitcoin network (do not call BRTransactionFree() on tx afterward)
@@ -1982,31 +2385,33 @@ void BRPeerManagerPublishTx(BRPeerManager *manager, BRTransaction *tx, void *inf
 {
     assert(manager != NULL);
     assert(tx != NULL && BRTransactionIsSigned(tx));
-    if (tx) pthread_mutex_lock(&manager->lock);
+    if (tx) _BRPeerManagerLock(&manager->peerLock);
     
     if (tx && ! BRTransactionIsSigned(tx)) {
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
         if (callback) callback(info, EINVAL); // transaction not signed
         tx = NULL;
     }
     else if (tx && ! manager->isConnected) {
         int connectFailureCount = manager->connectFailureCount;
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
 
         if (connectFailureCount >= MAX_CONNECT_FAILURES ||
             (manager->networkIsReachable && ! manager->networkIsReachable(manager->info))) {
             if (callback) callback(info, ENOTCONN); // not connected to bitcoin network
             tx = NULL;
         }
-        else pthread_mutex_lock(&manager->lock);
+        else _BRPeerManagerLock(&manager->peerLock);
     }
     
     if (tx) {
         size_t i, count = 0;
         
         tx->timestamp = (uint32_t)time(NULL); // set timestamp to publish time
+        _BRPeerManagerLock(&manager->txLock);
         _BRPeerManagerAddTxToPublishList(manager, tx, info, callback);
+        _BRPeerManagerUnlock(&manager->txLock);
 
         for (i = array_count(manager->connectedPeers); i > 0; i--) {
             if (BRPeerConnectStatus(manager->connectedPeers[i - 1]) == BRPeerStatusConnected) count++;
@@ -2030,7 +2435,7 @@ void BRPeerManagerPublishTx(BRPeerManager *manager, BRTransaction *tx, void *inf
             }
         }
 
-        pthread_mutex_unlock(&manager->lock);
+        _BRPeerManagerUnlock(&manager->peerLock);
     }
 }
 
@@ -2041,7 +2446,7 @@ size_t BRPeerManagerRelayCount(BRPeerManager *manager, UInt256 txHash)
 
     assert(manager != NULL);
     assert(! UInt256IsZero(txHash));
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->txLock);
     
     for (size_t i = array_count(manager->txRelays); i > 0; i--) {
         if (! UInt256Eq(manager->txRelays[i - 1].txHash, txHash)) continue;
@@ -2049,10 +2454,42 @@ size_t BRPeerManagerRelayCount(BRPeerManager *manager, UInt256 txHash)
         break;
     }
     
-    pthread_mutex_unlock(&manager->lock);
+    _BRPeerManagerUnlock(&manager->txLock);
     return count;
 }
 
+// acquired and contended counts for each of the manager's locks
+void BRPeerManagerGetLockStats(BRPeerManager *manager, BRPeerManagerLockStats *peers, BRPeerManagerLockStats *chain,
+                               BRPeerManagerLockStats *filter, BRPeerManagerLockStats *tx)
+{
+    BRPeerManagerLock *locks[] = { &manager->peerLock, &manager->chainLock, &manager->filterLock, &manager->txLock };
+    BRPeerManagerLockStats *stats[] = { peers, chain, filter, tx };
+
+    assert(manager != NULL);
+
+    for (size_t i = 0; i < sizeof(locks)/sizeof(*locks); i++) {
+        if (! stats[i]) continue;
+        pthread_mutex_lock(&locks[i]->mutex); // not counted
+        *stats[i] = (BRPeerManagerLockStats) { locks[i]->acquired, locks[i]->contended };
+        pthread_mutex_unlock(&locks[i]->mutex);
+    }
+}
+
+// the expected and max false positive rates of the bloom filter shared by peers, its element count, and the number of
+// times it was rebuilt or extended and reused
+void BRPeerManagerGetFilterStats(BRPeerManager *manager, BRPeerManagerFilterStats *stats)
+{
+    assert(manager != NULL);
+    assert(stats != NULL);
+    _BRPeerManagerLock(&manager->peerLock);
+    *stats = (BRPeerManagerFilterStats) {
+        (manager->filterCache) ? BRBloomFilterFalsePositiveRate(manager->filterCache) : 0.0,
+        manager->filterCacheMaxFpRate, (manager->filterCache) ? manager->filterCache->elemCount : 0,
+        manager->filterRebuilds, manager->filterUpdates
+    };
+    _BRPeerManagerUnlock(&manager->peerLock);
+}
+
 const BRChainParams *BRPeerManagerChainParams (BRPeerManager *manager) {
     return manager->params;
 }
@@ -2063,12 +2500,13 @@ void BRPeerManagerFree(BRPeerManager *manager)
     BRTransaction *tx;
     
     assert(manager != NULL);
-    pthread_mutex_lock(&manager->lock);
+    _BRPeerManagerLock(&manager->peerLock);
     array_free(manager->peers);
     for (size_t i = array_count(manager->connectedPeers); i > 0; i--) BRPeerFree(manager->connectedPeers[i - 1]);
     array_free(manager->connectedPeers);
     BRSetApply(manager->blocks, NULL, _setApplyFreeBlock);
     BRSetFree(manager->blocks);
+    array_free(manager->chain);
     BRSetApply(manager->orphans, NULL, _setApplyFreeBlock);
     BRSetFree(manager->orphans);
     BRSetFree(manager->checkpoints);
@@ -2083,10 +2521,14 @@ void BRPeerManagerFree(BRPeerManager *manager)
     }
 
     if (manager->bloomFilter) BRBloomFilterFree(manager->bloomFilter);
+    if (manager->filterCache) BRBloomFilterFree(manager->filterCache);
 
     array_free(manager->publishedTx);
     array_free(manager->publishedTxHashes);
-    pthread_mutex_unlock(&manager->lock);
-    pthread_mutex_destroy(&manager->lock);
+    _BRPeerManagerUnlock(&manager->peerLock);
+    pthread_mutex_destroy(&manager->peerLock.mutex);
+    pthread_mutex_destroy(&manager->chainLock.mutex);
+    pthread_mutex_destroy(&manager->filterLock.mutex);
+    pthread_mutex_destroy(&manager->txLock.mutex);
     free(manager);
 }
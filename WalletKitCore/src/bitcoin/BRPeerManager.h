@@ -27,6 +27,7 @@
 
 #include "BRPeer.h"
 #include "BRMerkleBlock.h"
+#include "BRHeaderStore.h"
 #include "BRTransaction.h"
 #include "BRWallet.h"
 #include "BRChainParams.h"
@@ -69,6 +70,16 @@ void BRPeerManagerSetCallbacks(BRPeerManager *manager, void *info,
 // set address to UINT128_ZERO to revert to default behavior
 void BRPeerManagerSetFixedPeer(BRPeerManager *manager, UInt128 address, uint16_t port);
 
+// handles the connections to peers on reactor, rather than on a thread per peer; set reactor to NULL to revert to
+// default behavior - reactor must not be freed while the manager is connected
+void BRPeerManagerSetReactor(BRPeerManager *manager, BRPeerReactor *reactor);
+
+// appends main chain block headers to store as the chain grows, and if store has headers past the manager's last
+// block, restores the chain from them, materializing only the blocks since the last difficulty transition - restored
+// headers must pass the same proof-of-work checks as relayed ones, and store is truncated at the first that doesn't
+// - store must not be freed before the manager, call once before BRPeerManagerConnect()
+void BRPeerManagerSetHeaderStore(BRPeerManager *manager, BRHeaderStore *store);
+
 // current connect status
 BRPeerStatus BRPeerManagerConnectStatus(BRPeerManager *manager);
 
@@ -115,6 +126,27 @@ void BRPeerManagerPublishTx(BRPeerManager *manager, BRTransaction *tx, void *inf
 // number of connected peers that have relayed the given unconfirmed transaction
 size_t BRPeerManagerRelayCount(BRPeerManager *manager, UInt256 txHash);
 
+typedef struct {
+    uint64_t acquired;  // number of times the lock was taken
+    uint64_t contended; // number of those times the lock was already held by another thread
+} BRPeerManagerLockStats;
+
+// lock statistics for each separately locked part of the manager's state: the peer list and connection state, the
+// chain, the bloom filter, and published/relayed transactions (any of the stats pointers may be NULL)
+void BRPeerManagerGetLockStats(BRPeerManager *manager, BRPeerManagerLockStats *peers, BRPeerManagerLockStats *chain,
+                               BRPeerManagerLockStats *filter, BRPeerManagerLockStats *tx);
+
+typedef struct {
+    double fpRate;     // expected false positive rate of the bloom filter shared by peers
+    double maxFpRate;  // expected rate past which the filter is rebuilt, rather than extended with new wallet elements
+    size_t elemCount;  // number of elements in the filter
+    uint64_t rebuilds; // number of times the filter was built from scratch
+    uint64_t updates;  // number of times the filter was extended in place and reused
+} BRPeerManagerFilterStats;
+
+// statistics for the cached bloom filter loaded into peers
+void BRPeerManagerGetFilterStats(BRPeerManager *manager, BRPeerManagerFilterStats *stats);
+
 // return the BRChainParams used to create this peer manager
 const BRChainParams *BRPeerManagerChainParams(BRPeerManager *manager);
 
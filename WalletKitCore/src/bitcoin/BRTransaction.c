@@ -24,6 +24,7 @@
 
 #include "BRTransaction.h"
 #include "support/BRArray.h"
+#include "support/BROSCompat.h"
 #include <stdlib.h>
 #include <limits.h>
 #include <time.h>
@@ -184,22 +185,21 @@ static size_t _BRTransactionOutputData(const BRTransaction *tx, uint8_t *data, s
     return (! data || off <= dataLen) ? off : 0;
 }
 
-// writes the BIP143 witness program data that needs to be hashed and signed for the tx input at index
-// https://github.com/bitcoin/bips/blob/master/bip-0143.mediawiki
-// returns number of bytes written, or total len needed if data is NULL
-static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index,
-                                        int hashType)
+// BIP143 hashes of the tx prevouts, sequences and outputs for a signature hashType
+// these are the same for every input, so they need only be computed once to sign them all
+typedef struct {
+    UInt256 prevouts;
+    UInt256 sequence;
+    UInt256 outputs; // SIGHASH_ALL only, SIGHASH_SINGLE outputs depend on the input index
+} _BRTxWitnessHashes;
+
+static void _BRTransactionWitnessHashes(const BRTransaction *tx, _BRTxWitnessHashes *hashes, int hashType)
 {
-    BRTxInput input;
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f);
-    size_t i, off = 0;
-    uint8_t scriptCode[] = { OP_DUP, OP_HASH160, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-                             0, 0, 0, 0, 0, 0, 0, 0, 0, OP_EQUALVERIFY, OP_CHECKSIG };
+    size_t i;
+
+    hashes->prevouts = hashes->sequence = hashes->outputs = UINT256_ZERO;
 
-    if (index >= tx->inCount) return 0;
-    if (data && off + sizeof(uint32_t) <= dataLen) UInt32SetLE(&data[off], tx->version); // tx version
-    off += sizeof(uint32_t);
-    
     if (! anyoneCanPay) {
         uint8_t buf[(sizeof(UInt256) + sizeof(uint32_t))*tx->inCount];
         
@@ -208,20 +208,47 @@ static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data,
             UInt32SetLE(&buf[(sizeof(UInt256) + sizeof(uint32_t))*i + sizeof(UInt256)], tx->inputs[i].index);
         }
         
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // inputs hash
+        BRSHA256_2(&hashes->prevouts, buf, sizeof(buf)); // inputs hash
     }
-    else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // anyone-can-pay
-    
-    off += sizeof(UInt256);
     
     if (! anyoneCanPay && sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
         uint8_t buf[sizeof(uint32_t)*tx->inCount];
         
         for (i = 0; i < tx->inCount; i++) UInt32SetLE(&buf[sizeof(uint32_t)*i], tx->inputs[i].sequence);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, sizeof(buf)); // sequence hash
+        BRSHA256_2(&hashes->sequence, buf, sizeof(buf)); // sequence hash
     }
-    else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO);
     
+    if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
+        size_t bufLen = _BRTransactionOutputData(tx, NULL, 0, SIZE_MAX);
+        uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
+        
+        bufLen = _BRTransactionOutputData(tx, buf, bufLen, SIZE_MAX);
+        BRSHA256_2(&hashes->outputs, buf, bufLen); // SIGHASH_ALL outputs hash
+        if (buf != _buf) free(buf);
+    }
+}
+
+// writes the BIP143 witness program data that needs to be hashed and signed for the tx input at index
+// https://github.com/bitcoin/bips/blob/master/bip-0143.mediawiki
+// hashes may be NULL, in which case they are computed for hashType
+// returns number of bytes written, or total len needed if data is NULL
+static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data, size_t dataLen, size_t index,
+                                        int hashType, const _BRTxWitnessHashes *hashes)
+{
+    BRTxInput input;
+    _BRTxWitnessHashes _hashes;
+    int sigHash = (hashType & 0x1f);
+    size_t off = 0;
+    uint8_t scriptCode[] = { OP_DUP, OP_HASH160, 20, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+                             0, 0, 0, 0, 0, 0, 0, 0, 0, OP_EQUALVERIFY, OP_CHECKSIG };
+
+    if (index >= tx->inCount) return 0;
+    if (data && ! hashes) _BRTransactionWitnessHashes(tx, &_hashes, hashType), hashes = &_hashes;
+    if (data && off + sizeof(uint32_t) <= dataLen) UInt32SetLE(&data[off], tx->version); // tx version
+    off += sizeof(uint32_t);
+    if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes->prevouts); // inputs hash
+    off += sizeof(UInt256);
+    if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes->sequence); // sequence hash
     off += sizeof(UInt256);
     input = tx->inputs[index];
     input.signature = input.script; // TODO: handle OP_CODESEPARATOR
@@ -235,21 +262,13 @@ static size_t _BRTransactionWitnessData(const BRTransaction *tx, uint8_t *data,
 
     off += _BRTxInputData(&input, (data ? &data[off] : NULL), (off <= dataLen ? dataLen - off : 0));
     
-    if (sigHash != SIGHASH_SINGLE && sigHash != SIGHASH_NONE) {
-        size_t bufLen = _BRTransactionOutputData(tx, NULL, 0, SIZE_MAX);
-        uint8_t _buf[0x1000], *buf = (bufLen <= 0x1000) ? _buf : malloc(bufLen);
-        
-        bufLen = _BRTransactionOutputData(tx, buf, bufLen, SIZE_MAX);
-        if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); // SIGHASH_ALL outputs hash
-        if (buf != _buf) free(buf);
-    }
-    else if (sigHash == SIGHASH_SINGLE && index < tx->outCount) {
+    if (sigHash == SIGHASH_SINGLE && index < tx->outCount) {
         uint8_t buf[_BRTransactionOutputData(tx, NULL, 0, index)];
         size_t bufLen = _BRTransactionOutputData(tx, buf, sizeof(buf), index);
         
         if (data && off + sizeof(UInt256) <= dataLen) BRSHA256_2(&data[off], buf, bufLen); //SIGHASH_SINGLE outputs hash
     }
-    else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], UINT256_ZERO); // SIGHASH_NONE
+    else if (data && off + sizeof(UInt256) <= dataLen) UInt256Set(&data[off], hashes->outputs); // zero if SIGHASH_NONE
     
     off += sizeof(UInt256);
     if (data && off + sizeof(uint32_t) <= dataLen) UInt32SetLE(&data[off], tx->lockTime); // locktime
@@ -268,7 +287,7 @@ static size_t _BRTransactionData(const BRTransaction *tx, uint8_t *data, size_t
     int anyoneCanPay = (hashType & SIGHASH_ANYONECANPAY), sigHash = (hashType & 0x1f), witnessFlag = 0;
     size_t i, count, len, woff, off = 0;
     
-    if (hashType & SIGHASH_FORKID) return _BRTransactionWitnessData(tx, data, dataLen, index, hashType);
+    if (hashType & SIGHASH_FORKID) return _BRTransactionWitnessData(tx, data, dataLen, index, hashType, NULL);
     if (anyoneCanPay && index >= tx->inCount) return 0;
     
     for (i = 0; index == SIZE_MAX && ! witnessFlag && i < tx->inCount; i++) {
@@ -351,6 +370,128 @@ static size_t _BRTransactionData(const BRTransaction *tx, uint8_t *data, size_t
     return (! data || off <= dataLen) ? off : 0;
 }
 
+// signature pre-image state shared by every input of a tx, for SIGHASH_ALL signatures
+// the tx inputs and outputs must not change while it is in use, other than to add input signatures and witnesses
+// once prepared for the inputs to be signed, it is only read, and may be shared by signing threads
+typedef struct {
+    int hashType;
+    int hasWitnessHashes;
+    _BRTxWitnessHashes witnessHashes;
+    uint8_t *legacy; // legacy pre-image with every input script left empty, NULL until needed
+    size_t legacyLen;
+} _BRTxSigHashCache;
+
+static void _BRTxSigHashCacheFree(_BRTxSigHashCache *cache)
+{
+    if (cache->legacy) free(cache->legacy);
+}
+
+// prepares cache for hashing inputs using a BIP143 pre-image if witness is true or the hashType has SIGHASH_FORKID set
+static void _BRTxSigHashCachePrepare(_BRTxSigHashCache *cache, const BRTransaction *tx, int witness)
+{
+    assert((cache->hashType & 0x1f) != SIGHASH_SINGLE && (cache->hashType & 0x1f) != SIGHASH_NONE &&
+           ! (cache->hashType & SIGHASH_ANYONECANPAY));
+
+    if (witness || (cache->hashType & SIGHASH_FORKID)) {
+        if (! cache->hasWitnessHashes) _BRTransactionWitnessHashes(tx, &cache->witnessHashes, cache->hashType);
+        cache->hasWitnessHashes = 1;
+    }
+    else if (! cache->legacy) {
+        // With SIGHASH_ALL, the legacy pre-image for each input is the tx with that input's script as its scriptSig,
+        // and every other scriptSig empty.  Serialize the tx once with all scriptSigs empty; each input's script is
+        // then spliced in.
+        BRTransaction view = *tx;
+
+        view.inputs = malloc(tx->inCount*sizeof(*view.inputs));
+        memcpy(view.inputs, tx->inputs, tx->inCount*sizeof(*view.inputs));
+        view.inputs[0].scriptLen = 0;
+        cache->legacyLen = _BRTransactionData(&view, NULL, 0, 0, cache->hashType);
+        cache->legacy = malloc(cache->legacyLen);
+        cache->legacyLen = _BRTransactionData(&view, cache->legacy, cache->legacyLen, 0, cache->hashType);
+        free(view.inputs);
+    }
+}
+
+// returns the hash to sign for the tx input at index, with cache prepared for the input
+// buf and bufLen are scratch space for the legacy pre-image, reallocated as needed and to be freed by the caller
+static UInt256 _BRTxSigHashCacheHash(const _BRTxSigHashCache *cache, const BRTransaction *tx, size_t index, int witness,
+                                     uint8_t **buf, size_t *bufLen)
+{
+    const BRTxInput *input = &tx->inputs[index];
+    UInt256 md = UINT256_ZERO;
+    size_t sigOff, off, len;
+
+    assert(index < tx->inCount);
+
+    if (witness || (cache->hashType & SIGHASH_FORKID)) {
+        assert(cache->hasWitnessHashes);
+
+        uint8_t data[_BRTransactionWitnessData(tx, NULL, 0, index, cache->hashType, &cache->witnessHashes)];
+        size_t dataLen = _BRTransactionWitnessData(tx, data, sizeof(data), index, cache->hashType,
+                                                   &cache->witnessHashes);
+
+        BRSHA256_2(&md, data, dataLen);
+        return md;
+    }
+
+    assert(cache->legacy != NULL);
+    // each empty input is its outpoint, a zero scriptSig length and its sequence
+    sigOff = sizeof(uint32_t) + BRVarIntSet(NULL, 0, tx->inCount) +
+             (sizeof(UInt256) + sizeof(uint32_t) + 1 + sizeof(uint32_t))*index + sizeof(UInt256) + sizeof(uint32_t);
+    len = cache->legacyLen - 1 + BRVarIntSet(NULL, 0, input->scriptLen) + input->scriptLen;
+
+    if (*bufLen < len) {
+        *buf = realloc(*buf, len);
+        *bufLen = len;
+    }
+
+    memcpy(*buf, cache->legacy, sigOff);
+    off = sigOff + BRVarIntSet(&(*buf)[sigOff], len - sigOff, input->scriptLen);
+    memcpy(&(*buf)[off], input->script, input->scriptLen); // TODO: handle OP_CODESEPARATOR
+    off += input->scriptLen;
+    memcpy(&(*buf)[off], &cache->legacy[sigOff + 1], cache->legacyLen - (sigOff + 1));
+    BRSHA256_2(&md, *buf, len);
+    return md;
+}
+
+// sets txHash and wtxHash of a signed tx, hashing its serialization directly rather than re-parsing it
+static void _BRTransactionSetHashes(BRTransaction *tx)
+{
+    int witnessFlag = 0;
+    size_t i, count, woff, len, wlen = 0, dataLen = _BRTransactionData(tx, NULL, 0, SIZE_MAX, SIGHASH_ALL);
+    uint8_t _data[0x1000], *data = (dataLen <= 0x1000) ? _data : malloc(dataLen);
+
+    dataLen = _BRTransactionData(tx, data, dataLen, SIZE_MAX, SIGHASH_ALL);
+
+    for (i = 0; ! witnessFlag && i < tx->inCount; i++) {
+        if (tx->inputs[i].witLen > 0) witnessFlag = 1;
+    }
+
+    for (i = 0; witnessFlag && i < tx->inCount; i++) { // witness data length, as serialized by _BRTransactionData()
+        for (count = 0, woff = 0; woff < tx->inputs[i].witLen; count++) {
+            woff += BRVarInt(&tx->inputs[i].witness[woff], tx->inputs[i].witLen - woff, &len);
+            woff += len;
+        }
+
+        wlen += BRVarIntSet(NULL, 0, count) + tx->inputs[i].witLen;
+    }
+
+    if (witnessFlag) {
+        BRSHA256_2(&tx->wtxHash, data, dataLen);
+        // drop the marker and flag after the tx version, and the witness data before the locktime
+        dataLen -= 2 + wlen;
+        memmove(&data[sizeof(uint32_t)], &data[sizeof(uint32_t) + 2], dataLen - 2*sizeof(uint32_t));
+        UInt32SetLE(&data[dataLen - sizeof(uint32_t)], tx->lockTime);
+        BRSHA256_2(&tx->txHash, data, dataLen);
+    }
+    else {
+        BRSHA256_2(&tx->txHash, data, dataLen);
+        tx->wtxHash = tx->txHash;
+    }
+
+    if (data != _data) free(data);
+}
+
 // returns a newly allocated empty transaction that must be freed by calling BRTransactionFree()
 BRTransaction *BRTransactionNew(void)
 {
@@ -636,13 +777,62 @@ int BRTransactionIsSigned(const BRTransaction *tx)
     return (tx) ? 1 : 0;
 }
 
+#define TX_SIGN_WITNESS   1 // pay-to-witness-pubkey-hash
+#define TX_SIGN_PKH       2 // pay-to-pubkey-hash
+#define TX_SIGN_PK        3 // pay-to-pubkey
+
+// an input signature, computed by _BRTransactionSignWorker()
+typedef struct {
+    size_t index;
+    const BRKey *key;
+    int type; // TX_SIGN_WITNESS, TX_SIGN_PKH or TX_SIGN_PK
+    uint8_t sig[73];
+    size_t sigLen;
+} _BRTxSigJob;
+
+typedef struct {
+    const BRTransaction *tx;
+    const _BRTxSigHashCache *cache;
+    _BRTxSigJob *jobs;
+    size_t jobsCount;
+    size_t first, stride; // the jobs for a worker are first, first + stride, first + 2*stride...
+} _BRTxSigWork;
+
+static void *_BRTransactionSignWorker(void *info)
+{
+    _BRTxSigWork *work = info;
+    uint8_t *buf = NULL;
+    size_t bufLen = 0;
+
+    for (size_t i = work->first; i < work->jobsCount; i += work->stride) {
+        _BRTxSigJob *job = &work->jobs[i];
+        UInt256 md = _BRTxSigHashCacheHash(work->cache, work->tx, job->index, (job->type == TX_SIGN_WITNESS),
+                                           &buf, &bufLen);
+
+        job->sigLen = BRKeySign(job->key, job->sig, sizeof(job->sig) - 1, md);
+        job->sig[job->sigLen++] = work->cache->hashType;
+    }
+
+    if (buf) free(buf);
+    return NULL;
+}
+
 // adds signatures to any inputs with NULL signatures that can be signed with any keys
 // forkId is 0 for bitcoin, 0x40 for b-cash, 0x4f for b-gold
 // returns true if tx is signed
 int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount)
+{
+    return BRTransactionSignParallel(tx, forkId, keys, keysCount, 1);
+}
+
+// like BRTransactionSign(), but computes the input signatures on up to threadCount threads, including the caller's
+// signatures are deterministic (RFC6979), so tx is signed exactly as by BRTransactionSign()
+int BRTransactionSignParallel(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount, size_t threadCount)
 {
     UInt160 pkh[keysCount];
-    size_t i, j;
+    _BRTxSigHashCache cache = { forkId | SIGHASH_ALL };
+    _BRTxSigJob *jobs = (tx && tx->inCount > 0) ? calloc(tx->inCount, sizeof(*jobs)) : NULL;
+    size_t i, j, jobsCount = 0;
     
     assert(tx != NULL);
     assert(keys != NULL || keysCount == 0);
@@ -661,56 +851,55 @@ int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCo
         
         const uint8_t *elems[BRScriptElements(NULL, 0, input->script, input->scriptLen)];
         size_t elemsCount = BRScriptElements(elems, sizeof(elems)/sizeof(*elems), input->script, input->scriptLen);
-        uint8_t pubKey[BRKeyPubKey(&keys[j], NULL, 0)];
-        size_t pkLen = BRKeyPubKey(&keys[j], pubKey, sizeof(pubKey));
-        uint8_t sig[73], script[1 + sizeof(sig) + 1 + sizeof(pubKey)];
-        size_t sigLen, scriptLen;
-        UInt256 md = UINT256_ZERO;
+        _BRTxSigJob *job = &jobs[jobsCount++];
+
+        job->index = i;
+        job->key = &keys[j];
         
-        if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) { // pay-to-witness-pubkey-hash
-            uint8_t data[_BRTransactionWitnessData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionWitnessData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-            
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
+        if (elemsCount == 2 && *elems[0] == OP_0 && *elems[1] == 20) job->type = TX_SIGN_WITNESS;
+        else if (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY) job->type = TX_SIGN_PKH;
+        else job->type = TX_SIGN_PK;
+
+        _BRTxSigHashCachePrepare(&cache, tx, (job->type == TX_SIGN_WITNESS));
+    }
+
+    if (threadCount > jobsCount) threadCount = jobsCount;
+    if (threadCount < 1) threadCount = 1;
+
+    _BRTxSigWork work[threadCount];
+
+    for (i = 0; i < threadCount; i++) {
+        work[i] = (_BRTxSigWork) { tx, &cache, jobs, jobsCount, i, threadCount };
+    }
+
+    run_parallel_brd(_BRTransactionSignWorker, work, sizeof(*work), threadCount);
+
+    for (i = 0; i < jobsCount; i++) {
+        BRTxInput *input = &tx->inputs[jobs[i].index];
+        uint8_t pubKey[BRKeyPubKey((BRKey *)jobs[i].key, NULL, 0)];
+        size_t pkLen = BRKeyPubKey((BRKey *)jobs[i].key, pubKey, sizeof(pubKey));
+        uint8_t script[1 + sizeof(jobs[i].sig) + 1 + sizeof(pubKey)];
+        size_t scriptLen = BRScriptPushData(script, sizeof(script), jobs[i].sig, jobs[i].sigLen);
+
+        if (jobs[i].type != TX_SIGN_PK) {
             scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
+        }
+
+        if (jobs[i].type == TX_SIGN_WITNESS) {
             BRTxInputSetSignature(input, script, 0);
             BRTxInputSetWitness(input, script, scriptLen);
         }
-        else if (elemsCount >= 2 && *elems[elemsCount - 2] == OP_EQUALVERIFY) { // pay-to-pubkey-hash
-            uint8_t data[_BRTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-            
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
-            scriptLen += BRScriptPushData(&script[scriptLen], sizeof(script) - scriptLen, pubKey, pkLen);
-            BRTxInputSetSignature(input, script, scriptLen);
-            BRTxInputSetWitness(input, script, 0);
-        }
-        else { // pay-to-pubkey
-            uint8_t data[_BRTransactionData(tx, NULL, 0, i, forkId | SIGHASH_ALL)];
-            size_t dataLen = _BRTransactionData(tx, data, sizeof(data), i, forkId | SIGHASH_ALL);
-
-            BRSHA256_2(&md, data, dataLen);
-            sigLen = BRKeySign(&keys[j], sig, sizeof(sig) - 1, md);
-            sig[sigLen++] = forkId | SIGHASH_ALL;
-            scriptLen = BRScriptPushData(script, sizeof(script), sig, sigLen);
+        else {
             BRTxInputSetSignature(input, script, scriptLen);
             BRTxInputSetWitness(input, script, 0);
         }
     }
+
+    if (jobs) free(jobs);
+    _BRTxSigHashCacheFree(&cache);
     
     if (tx && BRTransactionIsSigned(tx)) {
-        uint8_t data[BRTransactionSerialize(tx, NULL, 0)];
-        size_t len = BRTransactionSerialize(tx, data, sizeof(data));
-        BRTransaction *t = BRTransactionParse(data, len);
-        
-        if (t) tx->txHash = t->txHash, tx->wtxHash = t->wtxHash;
-        if (t) BRTransactionFree(t);
+        _BRTransactionSetHashes(tx);
         return 1;
     }
     else return 0;
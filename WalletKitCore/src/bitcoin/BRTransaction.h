@@ -135,6 +135,10 @@ int BRTransactionIsSigned(const BRTransaction *tx);
 // returns true if tx is signed
 int BRTransactionSign(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount);
 
+// like BRTransactionSign(), but computes the input signatures on up to threadCount threads, including the caller's
+// signatures are deterministic (RFC6979), so tx is signed exactly as by BRTransactionSign()
+int BRTransactionSignParallel(BRTransaction *tx, int forkId, BRKey keys[], size_t keysCount, size_t threadCount);
+
 // true if tx meets IsStandard() rules: https://bitcoin.org/en/developer-guide#standard-transactions
 int BRTransactionIsStandard(const BRTransaction *tx);
 
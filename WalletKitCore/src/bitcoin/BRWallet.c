@@ -26,6 +26,8 @@
 #include "support/BRSet.h"
 #include "support/BRAddress.h"
 #include "support/BRArray.h"
+#include "support/BRCrypto.h"
+#include "support/BROSCompat.h"
 #include <stdlib.h>
 #include <inttypes.h>
 #include <limits.h>
@@ -33,6 +35,14 @@
 #include <pthread.h>
 #include <assert.h>
 
+// the fewest keys worth deriving on a thread of their own
+#define WALLET_DERIVE_MIN_PER_THREAD 64
+
+// the largest account discovery window, see BRWalletDiscoverAddrs()
+#if !defined (WALLET_DISCOVERY_WINDOW_MAX)
+#define WALLET_DISCOVERY_WINDOW_MAX  2500
+#endif
+
 inline static size_t _pkhHash(const void *pkh)
 {
     return (size_t)UInt32GetLE(pkh);
@@ -51,20 +61,48 @@ inline static uint64_t _txFee(uint64_t feePerKb, size_t size)
     return (fee > standardFee) ? fee : standardFee;
 }
 
-// chain position of first tx output address that appears in chain
-inline static size_t _txChainIndex(const BRTransaction *tx, const UInt160 *chain)
-{
-    const uint8_t *pkh;
-    
-    for (size_t i = array_count(chain); i > 0; i--) {
-        for (size_t j = 0; j < tx->outCount; j++) {
-            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
-            if (pkh && _pkhEq(pkh, &chain[i - 1])) return i - 1;
-        }
-    }
-    
-    return (size_t) -1;
-}
+// a wallet transaction spending an outpoint, used to find the wallet transactions that depend on a given transaction
+typedef struct BRWalletTxSpendStruct {
+    BRUTXO outpoint;                    // must be first, so spends can be looked up by outpoint
+    struct BRWalletTxNodeStruct *node;  // the spending transaction
+    struct BRWalletTxSpendStruct *next; // another wallet transaction spending the same outpoint (a double spend)
+} BRWalletTxSpend;
+
+// the cached sort key of a wallet transaction: wallet->transactions is ordered by blockHeight, then by dependency depth
+// (so that a transaction comes after any transaction in the same block that it spends), then by the chain positions of
+// its wallet outputs, and finally by insertion order
+typedef struct BRWalletTxNodeStruct {
+    UInt256 txHash;           // must be first, so nodes can be looked up by tx hash
+    BRTransaction *tx;
+    uint32_t blockHeight;     // tx->blockHeight when the key was computed
+    uint32_t depth;           // longest chain of wallet transaction ancestors with the same blockHeight
+    size_t internalIndex;     // internal chain position of the last output address in that chain, or SIZE_MAX
+    size_t externalIndex;     // external chain position of the last output address in that chain, or SIZE_MAX
+    uint64_t sequence;
+    BRWalletTxSpend *spends;  // one per tx input
+} BRWalletTxNode;
+
+// the effect of applying a single wallet transaction to the balance state (utxos, spentOutputs, usedPKH, etc), recorded
+// so it can be undone when an earlier transaction is inserted, removed or reordered
+typedef struct {
+    BRTransaction *tx;
+    uint8_t state;         // _BALANCE_TX_APPLIED, _BALANCE_TX_INVALID or _BALANCE_TX_PENDING
+    uint8_t unconfirmed;   // tx->blockHeight was TX_UNCONFIRMED when applied
+    uint32_t utxoCount;    // outputs appended to wallet->utxos
+    uint32_t spentCount;   // entries pushed to wallet->balanceSpent
+    uint32_t removedCount; // entries pushed to wallet->balanceRemoved
+    uint32_t usedCount;    // entries pushed to wallet->balanceUsedPKH
+} BRWalletBalanceDelta;
+
+#define _BALANCE_TX_APPLIED  0
+#define _BALANCE_TX_INVALID  1
+#define _BALANCE_TX_PENDING  2
+
+// a utxo removed from wallet->utxos, along with the index it was removed from
+typedef struct {
+    BRUTXO utxo;
+    size_t index;
+} BRWalletRemovedUTXO;
 
 struct BRWalletStruct {
     uint64_t balance, totalSent, totalReceived, feePerKb, *balanceHist;
@@ -72,9 +110,18 @@ struct BRWalletStruct {
     BRUTXO *utxos;
     BRTransaction **transactions;
     BRMasterPubKey masterPubKey;
+    BRBIP32PubKeyNode internalNode, externalNode; // N(m/0H/1) and N(m/0H/0), the parents of the chains' keys
     BRAddressParams addrParams;
     UInt160 *internalChain, *externalChain;
     BRSet *allTx, *invalidTx, *pendingTx, *spentOutputs, *usedPKH, *allPKH;
+    BRSet *txNodes, *txSpends;           // sort keys of wallet->transactions, and their inputs by outpoint
+    uint64_t txSequence;
+    int incrementalBalance, balanceNeedsReset;
+    BRWalletBalanceDelta *balanceDeltas; // one per wallet->transactions entry that has been applied, oldest first
+    BRTxInput **balanceSpent;            // spentOutputs item replaced by each applied input, or NULL
+    BRWalletRemovedUTXO *balanceRemoved; // utxos removed by applied transactions, in removal order
+    const uint8_t **balanceUsedPKH;      // pkhs newly added to usedPKH by applied transactions
+    BRSet *foreignPKH;                   // output pkhs of applied transactions that are not in allPKH
     void *callbackInfo;
     void (*balanceChanged)(void *info, uint64_t balance);
     void (*txAdded)(void *info, BRTransaction *tx);
@@ -83,52 +130,176 @@ struct BRWalletStruct {
     pthread_mutex_t lock;
 };
 
-inline static int _BRWalletTxIsAscending(BRWallet *wallet, const BRTransaction *tx1, const BRTransaction *tx2)
+// chain position of the last tx output address that appears in chain, using allPKH as the pkh to chain entry map
+inline static size_t _BRWalletTxChainIndex(BRWallet *wallet, const BRTransaction *tx, const UInt160 *chain)
 {
-    if (! tx1 || ! tx2) return 0;
-    if (tx1->blockHeight > tx2->blockHeight) return 1;
-    if (tx1->blockHeight < tx2->blockHeight) return 0;
-    
-    for (size_t i = 0; i < tx1->inCount; i++) {
-        if (UInt256Eq(tx1->inputs[i].txHash, tx2->txHash)) return 1;
+    size_t index = SIZE_MAX;
+    const UInt160 *entry;
+    const uint8_t *pkh;
+
+    for (size_t j = 0; j < tx->outCount; j++) {
+        pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+        entry = (pkh) ? BRSetGet(wallet->allPKH, pkh) : NULL;
+        if (! entry || entry < chain || entry >= chain + array_count(chain)) continue;
+        if (index == SIZE_MAX || (size_t)(entry - chain) > index) index = (size_t)(entry - chain);
     }
-    
-    for (size_t i = 0; i < tx2->inCount; i++) {
-        if (UInt256Eq(tx2->inputs[i].txHash, tx1->txHash)) return 0;
+
+    return index;
+}
+
+inline static int _BRWalletTxNodeCompare(const BRWalletTxNode *n1, const BRWalletTxNode *n2)
+{
+    if (n1->blockHeight != n2->blockHeight) return (n1->blockHeight > n2->blockHeight) ? 1 : -1;
+    if (n1->depth != n2->depth) return (n1->depth > n2->depth) ? 1 : -1;
+    if (n1->internalIndex != n2->internalIndex) return (n1->internalIndex > n2->internalIndex) ? 1 : -1;
+    if (n1->externalIndex != n2->externalIndex) return (n1->externalIndex > n2->externalIndex) ? 1 : -1;
+    if (n1->sequence != n2->sequence) return (n1->sequence > n2->sequence) ? 1 : -1;
+    return 0;
+}
+
+// index of the first entry in wallet->transactions that sorts after node
+static size_t _BRWalletTxUpperBound(BRWallet *wallet, const BRWalletTxNode *node)
+{
+    size_t lo = 0, hi = array_count(wallet->transactions), mid;
+
+    while (lo < hi) {
+        mid = lo + (hi - lo)/2;
+        if (_BRWalletTxNodeCompare(BRSetGet(wallet->txNodes, wallet->transactions[mid]), node) > 0) hi = mid;
+        else lo = mid + 1;
     }
 
-    for (size_t i = 0; i < tx1->inCount; i++) {
-        if (_BRWalletTxIsAscending(wallet, BRSetGet(wallet->allTx, &(tx1->inputs[i].txHash)), tx2)) return 1;
+    return lo;
+}
+
+// index of tx in wallet->transactions, or SIZE_MAX if it isn't there
+static size_t _BRWalletTxIndex(BRWallet *wallet, const BRTransaction *tx)
+{
+    const BRWalletTxNode *node = BRSetGet(wallet->txNodes, tx);
+    size_t i = (node) ? _BRWalletTxUpperBound(wallet, node) : 0;
+
+    return (i > 0 && wallet->transactions[i - 1] == node->tx) ? i - 1 : SIZE_MAX;
+}
+
+// moves node, at index i in wallet->transactions, to its sorted position after its sort key increased
+static void _BRWalletTxMoveUp(BRWallet *wallet, size_t i, const BRWalletTxNode *node)
+{
+    size_t count = array_count(wallet->transactions), lo = i + 1, hi = i + 1, step = 1, mid;
+
+    // galloping search, since a node usually only moves past a few of its neighbours
+    while (hi < count && _BRWalletTxNodeCompare(BRSetGet(wallet->txNodes, wallet->transactions[hi]), node) <= 0) {
+        lo = hi + 1;
+        hi = (count - hi > step) ? hi + step : count;
+        step *= 2;
     }
 
-    return 0;
+    while (lo < hi) {
+        mid = lo + (hi - lo)/2;
+        if (_BRWalletTxNodeCompare(BRSetGet(wallet->txNodes, wallet->transactions[mid]), node) > 0) hi = mid;
+        else lo = mid + 1;
+    }
+
+    memmove(&wallet->transactions[i], &wallet->transactions[i + 1], (lo - i - 1)*sizeof(*wallet->transactions));
+    wallet->transactions[lo - 1] = node->tx;
 }
 
-inline static int _BRWalletTxCompare(BRWallet *wallet, const BRTransaction *tx1, const BRTransaction *tx2)
+// sets the dependency depth of node from its wallet transaction inputs with the same blockHeight
+static void _BRWalletTxNodeSetDepth(BRWallet *wallet, BRWalletTxNode *node)
 {
-    size_t i = (size_t) -1, j = (size_t) -1;
+    const BRWalletTxNode *parent;
 
-    if (_BRWalletTxIsAscending(wallet, tx1, tx2)) return 1;
-    if (_BRWalletTxIsAscending(wallet, tx2, tx1)) return -1;
-    if ((i = _txChainIndex(tx1, wallet->internalChain)) != -1) j = _txChainIndex(tx2, wallet->internalChain);
-    if (j == -1 && (i = _txChainIndex(tx1, wallet->externalChain)) != -1) j = _txChainIndex(tx2, wallet->externalChain);
-    if (i != -1 && j != -1 && i != j) return (i > j) ? 1 : -1;
-    return 0;
+    node->depth = 0;
+
+    for (size_t i = 0; i < node->tx->inCount; i++) {
+        parent = BRSetGet(wallet->txNodes, &node->tx->inputs[i].txHash);
+        if (parent && parent->blockHeight == node->blockHeight && parent->depth >= node->depth)
+            node->depth = parent->depth + 1;
+    }
 }
 
-// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first (insertion sort)
-inline static void _BRWalletInsertTx(BRWallet *wallet, BRTransaction *tx)
+static BRWalletTxNode *_BRWalletTxNodeNew(BRWallet *wallet, BRTransaction *tx)
 {
-    size_t i = array_count(wallet->transactions);
-    
-    array_set_count(wallet->transactions, i + 1);
-    
-    while (i > 0 && _BRWalletTxCompare(wallet, wallet->transactions[i - 1], tx) > 0) {
-        wallet->transactions[i] = wallet->transactions[i - 1];
-        i--;
+    BRWalletTxNode *node = calloc(1, sizeof(*node));
+    BRWalletTxSpend *spend;
+
+    assert(node != NULL);
+    node->txHash = tx->txHash;
+    node->tx = tx;
+    node->spends = calloc(tx->inCount + 1, sizeof(*node->spends));
+    assert(node->spends != NULL);
+
+    for (size_t i = 0; i < tx->inCount; i++) {
+        spend = &node->spends[i];
+        spend->outpoint = (BRUTXO) { tx->inputs[i].txHash, tx->inputs[i].index };
+        spend->node = node;
+        spend->next = BRSetAdd(wallet->txSpends, spend);
     }
-    
-    wallet->transactions[i] = tx;
+
+    BRSetAdd(wallet->txNodes, node);
+    return node;
+}
+
+static void _BRWalletTxNodeFree(BRWallet *wallet, BRWalletTxNode *node)
+{
+    BRWalletTxSpend *spend, **prev;
+
+    for (size_t i = 0; i < node->tx->inCount; i++) {
+        spend = &node->spends[i];
+        prev = NULL;
+
+        for (BRWalletTxSpend *s = BRSetGet(wallet->txSpends, spend); s && s != spend; s = s->next) prev = &s->next;
+
+        if (prev) *prev = spend->next;
+        else if (spend->next) BRSetAdd(wallet->txSpends, spend->next);
+        else BRSetRemove(wallet->txSpends, spend);
+    }
+
+    BRSetRemove(wallet->txNodes, node);
+    free(node->spends);
+    free(node);
+}
+
+// inserts tx into wallet->transactions, keeping wallet->transactions sorted by date, oldest first (binary search on the
+// cached sort keys), then moves any wallet transactions spending tx in the same block after it
+// returns the lowest index of wallet->transactions that changed
+static size_t _BRWalletInsertTx(BRWallet *wallet, BRTransaction *tx)
+{
+    BRWalletTxNode *node = BRSetGet(wallet->txNodes, tx), **pending, *child;
+    BRWalletTxSpend *spend;
+    size_t i, index;
+
+    if (! node) node = _BRWalletTxNodeNew(wallet, tx);
+    node->blockHeight = tx->blockHeight;
+    node->internalIndex = _BRWalletTxChainIndex(wallet, tx, wallet->internalChain);
+    node->externalIndex = _BRWalletTxChainIndex(wallet, tx, wallet->externalChain);
+    node->sequence = ++wallet->txSequence;
+    _BRWalletTxNodeSetDepth(wallet, node);
+    index = _BRWalletTxUpperBound(wallet, node);
+    array_insert(wallet->transactions, index, tx);
+
+    // only needed when a transaction is added after transactions that spend it
+    array_new(pending, 0);
+    array_add(pending, node);
+
+    while (array_count(pending) > 0) {
+        node = pending[array_count(pending) - 1];
+        array_rm_last(pending);
+
+        for (uint32_t n = 0; n < node->tx->outCount; n++) {
+            for (spend = BRSetGet(wallet->txSpends, &((const BRUTXO) { node->txHash, n })); spend; spend = spend->next) {
+                child = spend->node;
+                if (child->blockHeight != node->blockHeight || child->depth > node->depth) continue;
+                i = _BRWalletTxIndex(wallet, child->tx);
+                if (i == SIZE_MAX) continue; // child was removed from the wallet
+                if (i < index) index = i;
+                child->depth = node->depth + 1;
+                _BRWalletTxMoveUp(wallet, i, child);
+                array_add(pending, child);
+            }
+        }
+    }
+
+    array_free(pending);
+    return index;
 }
 
 // non-threadsafe version of BRWalletContainsTransaction()
@@ -161,100 +332,182 @@ static int _BRWalletContainsTx(BRWallet *wallet, const BRTransaction *tx)
     return r;
 }
 
-static void _BRWalletUpdateBalance(BRWallet *wallet)
+// applies tx, the next transaction in wallet->transactions, to the balance state and records a delta to undo it
+static void _BRWalletApplyTx(BRWallet *wallet, BRTransaction *tx, time_t now)
 {
+    BRWalletBalanceDelta delta = { tx, _BALANCE_TX_APPLIED, (tx->blockHeight == TX_UNCONFIRMED), 0, 0, 0, 0 };
+    size_t count = array_count(wallet->balanceHist), j;
+    uint64_t balance = (count > 0) ? wallet->balanceHist[count - 1] : 0, prevBalance = balance;
     int isInvalid, isPending;
-    uint64_t balance = 0, prevBalance = 0;
-    time_t now = time(NULL);
-    size_t i, j;
-    BRTransaction *tx, *t;
+    BRTransaction *t;
     const uint8_t *pkh;
-    
-    array_clear(wallet->utxos);
-    array_clear(wallet->balanceHist);
-    BRSetClear(wallet->spentOutputs);
-    BRSetClear(wallet->invalidTx);
-    BRSetClear(wallet->pendingTx);
-    BRSetClear(wallet->usedPKH);
-    wallet->totalSent = 0;
-    wallet->totalReceived = 0;
-
-    for (i = 0; i < array_count(wallet->transactions); i++) {
-        tx = wallet->transactions[i];
-
-        // check if any inputs are invalid or already spent
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
-                if (BRSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
-                    BRSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
-            }
-        
-            if (isInvalid) {
-                BRSetAdd(wallet->invalidTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
-            }
+
+    // check if any inputs are invalid or already spent
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        for (j = 0, isInvalid = 0; ! isInvalid && j < tx->inCount; j++) {
+            if (BRSetContains(wallet->spentOutputs, &tx->inputs[j]) ||
+                BRSetContains(wallet->invalidTx, &tx->inputs[j].txHash)) isInvalid = 1;
         }
 
-        // add inputs to spent output set
-        for (j = 0; j < tx->inCount; j++) {
-            BRSetAdd(wallet->spentOutputs, &tx->inputs[j]);
+        if (isInvalid) {
+            BRSetAdd(wallet->invalidTx, tx);
+            delta.state = _BALANCE_TX_INVALID;
+            array_add(wallet->balanceHist, balance);
+            array_add(wallet->balanceDeltas, delta);
+            return;
         }
+    }
 
-        // check if tx is pending
-        if (tx->blockHeight == TX_UNCONFIRMED) {
-            isPending = (BRTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
-            
-            for (j = 0; ! isPending && j < tx->outCount; j++) {
-                if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
-            }
+    // add inputs to spent output set
+    for (j = 0; j < tx->inCount; j++) {
+        array_add(wallet->balanceSpent, BRSetAdd(wallet->spentOutputs, &tx->inputs[j]));
+        delta.spentCount++;
+    }
 
-            for (j = 0; ! isPending && j < tx->inCount; j++) {
-                if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
-                    tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
-                if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
-                if (BRSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
-                // TODO: XXX handle BIP68 check lock time verify rules
-            }
-            
-            if (isPending) {
-                BRSetAdd(wallet->pendingTx, tx);
-                array_add(wallet->balanceHist, balance);
-                continue;
-            }
+    // check if tx is pending
+    if (tx->blockHeight == TX_UNCONFIRMED) {
+        isPending = (BRTransactionVSize(tx) > TX_MAX_SIZE) ? 1 : 0; // check tx size is under TX_MAX_SIZE
+
+        for (j = 0; ! isPending && j < tx->outCount; j++) {
+            if (tx->outputs[j].amount < TX_MIN_OUTPUT_AMOUNT) isPending = 1; // check that no outputs are dust
         }
 
-        // add outputs to UTXO set
-        // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
-        // TODO: don't add coin generation outputs < 100 blocks deep
-        // NOTE: balance/UTXOs will then need to be recalculated when last block changes
-        for (j = 0; j < tx->outCount; j++) {
-            pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+        for (j = 0; ! isPending && j < tx->inCount; j++) {
+            if (tx->inputs[j].sequence < UINT32_MAX - 1) isPending = 1; // check for replace-by-fee
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime < TX_MAX_LOCK_HEIGHT &&
+                tx->lockTime > wallet->blockHeight + 1) isPending = 1; // future lockTime
+            if (tx->inputs[j].sequence < UINT32_MAX && tx->lockTime > now) isPending = 1; // future lockTime
+            if (BRSetContains(wallet->pendingTx, &tx->inputs[j].txHash)) isPending = 1; // check for pending inputs
+            // TODO: XXX handle BIP68 check lock time verify rules
+        }
 
-            if (pkh && BRSetContains(wallet->allPKH, pkh)) {
+        if (isPending) {
+            BRSetAdd(wallet->pendingTx, tx);
+            delta.state = _BALANCE_TX_PENDING;
+            array_add(wallet->balanceHist, balance);
+            array_add(wallet->balanceDeltas, delta);
+            return;
+        }
+    }
+
+    // add outputs to UTXO set
+    // TODO: don't add outputs below TX_MIN_OUTPUT_AMOUNT
+    // TODO: don't add coin generation outputs < 100 blocks deep
+    // NOTE: balance/UTXOs will then need to be recalculated when last block changes
+    for (j = 0; j < tx->outCount; j++) {
+        pkh = BRScriptPKH(tx->outputs[j].script, tx->outputs[j].scriptLen);
+
+        if (pkh && BRSetContains(wallet->allPKH, pkh)) {
+            if (! BRSetContains(wallet->usedPKH, pkh)) {
                 BRSetAdd(wallet->usedPKH, (void *)pkh);
-                array_add(wallet->utxos, ((const BRUTXO) { tx->txHash, (uint32_t)j }));
-                balance += tx->outputs[j].amount;
+                array_add(wallet->balanceUsedPKH, pkh);
+                delta.usedCount++;
             }
-        }
 
-        // transaction ordering is not guaranteed, so check the entire UTXO set against the entire spent output set
-        for (j = array_count(wallet->utxos); j > 0; j--) {
-            if (! BRSetContains(wallet->spentOutputs, &wallet->utxos[j - 1])) continue;
-            t = BRSetGet(wallet->allTx, &wallet->utxos[j - 1].hash);
-            balance -= t->outputs[wallet->utxos[j - 1].n].amount;
-            array_rm(wallet->utxos, j - 1);
+            array_add(wallet->utxos, ((const BRUTXO) { tx->txHash, (uint32_t)j }));
+            delta.utxoCount++;
+            balance += tx->outputs[j].amount;
         }
-        
-        if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
-        if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
-        array_add(wallet->balanceHist, balance);
-        prevBalance = balance;
+        else if (pkh) BRSetAdd(wallet->foreignPKH, (void *)pkh); // see BRWalletUnusedAddrs()
+    }
+
+    // transaction ordering is not guaranteed, so check the entire UTXO set against the entire spent output set
+    for (j = array_count(wallet->utxos); j > 0; j--) {
+        if (! BRSetContains(wallet->spentOutputs, &wallet->utxos[j - 1])) continue;
+        t = BRSetGet(wallet->allTx, &wallet->utxos[j - 1].hash);
+        balance -= t->outputs[wallet->utxos[j - 1].n].amount;
+        array_add(wallet->balanceRemoved, ((const BRWalletRemovedUTXO) { wallet->utxos[j - 1], j - 1 }));
+        delta.removedCount++;
+        array_rm(wallet->utxos, j - 1);
+    }
+
+    if (prevBalance < balance) wallet->totalReceived += balance - prevBalance;
+    if (balance < prevBalance) wallet->totalSent += prevBalance - balance;
+    array_add(wallet->balanceHist, balance);
+    array_add(wallet->balanceDeltas, delta);
+}
+
+// undoes the most recently applied transaction, restoring the balance state to exactly what it was before
+static void _BRWalletUnapplyTx(BRWallet *wallet)
+{
+    size_t count = array_count(wallet->balanceDeltas), j;
+    BRWalletBalanceDelta delta;
+    uint64_t balance, prevBalance;
+    BRWalletRemovedUTXO removed;
+    BRTxInput *replaced;
+
+    assert(count > 0 && count == array_count(wallet->balanceHist));
+    delta = wallet->balanceDeltas[count - 1];
+    balance = wallet->balanceHist[count - 1];
+    prevBalance = (count > 1) ? wallet->balanceHist[count - 2] : 0;
+
+    for (j = 0; j < delta.removedCount; j++) { // re-insert removed utxos in the reverse order they were removed
+        removed = wallet->balanceRemoved[array_count(wallet->balanceRemoved) - 1];
+        array_rm_last(wallet->balanceRemoved);
+        array_insert(wallet->utxos, removed.index, removed.utxo);
+    }
+
+    array_set_count(wallet->utxos, array_count(wallet->utxos) - delta.utxoCount);
+
+    for (j = 0; j < delta.usedCount; j++) {
+        BRSetRemove(wallet->usedPKH, wallet->balanceUsedPKH[array_count(wallet->balanceUsedPKH) - 1]);
+        array_rm_last(wallet->balanceUsedPKH);
+    }
+
+    for (j = delta.spentCount; j > 0; j--) {
+        replaced = wallet->balanceSpent[array_count(wallet->balanceSpent) - 1];
+        array_rm_last(wallet->balanceSpent);
+        if (replaced) BRSetAdd(wallet->spentOutputs, replaced);
+        else BRSetRemove(wallet->spentOutputs, &delta.tx->inputs[j - 1]);
+    }
+
+    if (delta.state == _BALANCE_TX_INVALID) BRSetRemove(wallet->invalidTx, delta.tx);
+    if (delta.state == _BALANCE_TX_PENDING) BRSetRemove(wallet->pendingTx, delta.tx);
+    if (prevBalance < balance) wallet->totalReceived -= balance - prevBalance;
+    if (balance < prevBalance) wallet->totalSent -= prevBalance - balance;
+    array_rm_last(wallet->balanceHist);
+    array_rm_last(wallet->balanceDeltas);
+}
+
+// updates the balance state after wallet->transactions changed at or after index; in incremental mode, only the
+// transactions from index onward are undone and re-applied, along with any trailing unconfirmed transactions since
+// their pending status depends on the current time and block height; otherwise the entire state is recomputed
+static void _BRWalletUpdateBalance(BRWallet *wallet, size_t index)
+{
+    time_t now = time(NULL);
+    size_t i;
+
+    if (! wallet->incrementalBalance || wallet->balanceNeedsReset) index = 0;
+
+    if (index == 0) {
+        array_clear(wallet->utxos);
+        array_clear(wallet->balanceHist);
+        array_clear(wallet->balanceDeltas);
+        array_clear(wallet->balanceSpent);
+        array_clear(wallet->balanceRemoved);
+        array_clear(wallet->balanceUsedPKH);
+        BRSetClear(wallet->spentOutputs);
+        BRSetClear(wallet->invalidTx);
+        BRSetClear(wallet->pendingTx);
+        BRSetClear(wallet->usedPKH);
+        BRSetClear(wallet->foreignPKH);
+        wallet->totalSent = 0;
+        wallet->totalReceived = 0;
+        wallet->balanceNeedsReset = 0;
+    }
+
+    for (i = array_count(wallet->balanceDeltas);
+         i > 0 && (i > index || wallet->balanceDeltas[i - 1].unconfirmed); i--) {
+        _BRWalletUnapplyTx(wallet);
+    }
+
+    for (i = array_count(wallet->balanceDeltas); i < array_count(wallet->transactions); i++) {
+        _BRWalletApplyTx(wallet, wallet->transactions[i], now);
     }
 
     assert(array_count(wallet->balanceHist) == array_count(wallet->transactions));
-    wallet->balance = balance;
+    i = array_count(wallet->balanceHist);
+    wallet->balance = (i > 0) ? wallet->balanceHist[i - 1] : 0;
 }
 
 // allocates and populates a BRWallet struct which must be freed by calling BRWalletFree()
@@ -271,6 +524,8 @@ BRWallet *BRWalletNew(BRAddressParams addrParams, BRTransaction *transactions[],
     array_new(wallet->transactions, txCount + 100);
     wallet->feePerKb = DEFAULT_FEE_PER_KB;
     wallet->masterPubKey = mpk;
+    wallet->internalNode = BRBIP32PubKeyChainNode(mpk, SEQUENCE_INTERNAL_CHAIN);
+    wallet->externalNode = BRBIP32PubKeyChainNode(mpk, SEQUENCE_EXTERNAL_CHAIN);
     wallet->addrParams = addrParams;
     array_new(wallet->internalChain, 100);
     array_new(wallet->externalChain, 100);
@@ -281,6 +536,14 @@ BRWallet *BRWalletNew(BRAddressParams addrParams, BRTransaction *transactions[],
     wallet->spentOutputs = BRSetNew(BRUTXOHash, BRUTXOEq, txCount + 100);
     wallet->usedPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
     wallet->allPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
+    wallet->txNodes = BRSetNew(BRTransactionHash, BRTransactionEq, txCount + 100);
+    wallet->txSpends = BRSetNew(BRUTXOHash, BRUTXOEq, txCount + 100);
+    wallet->incrementalBalance = 1;
+    array_new(wallet->balanceDeltas, txCount + 100);
+    array_new(wallet->balanceSpent, txCount + 100);
+    array_new(wallet->balanceRemoved, txCount + 100);
+    array_new(wallet->balanceUsedPKH, txCount + 100);
+    wallet->foreignPKH = BRSetNew(_pkhHash, _pkhEq, txCount + 100);
     pthread_mutex_init(&wallet->lock, NULL);
 
     for (size_t i = 0; transactions && i < txCount; i++) {
@@ -298,7 +561,7 @@ BRWallet *BRWalletNew(BRAddressParams addrParams, BRTransaction *transactions[],
     BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN);
     BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN);
 
-    _BRWalletUpdateBalance(wallet);
+    _BRWalletUpdateBalance(wallet, 0);
 
     if (txCount > 0 && ! _BRWalletContainsTx(wallet, transactions[0])) { // verify transactions match master pubKey
         BRWalletFree(wallet);
@@ -331,49 +594,39 @@ void BRWalletSetCallbacks(BRWallet *wallet, void *info,
     wallet->txDeleted = txDeleted;
 }
 
-// wallets are composed of chains of addresses
-// each chain is traversed until a gap of a number of addresses is found that haven't been used in any transactions
-// this function writes to addrs an array of <gapLimit> unused addresses following the last used address in the chain
-// the internal chain is used for change addresses and the external chain for receive addresses
-// addrs may be NULL to only generate addresses for BRWalletContainsAddress()
-// returns the number addresses written to addrs
-size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal)
+// enables (the default) or disables incremental balance updates; when disabled, every change to the wallet's
+// transactions recomputes the balance, utxos and balance history of all transactions from scratch
+void BRWalletSetIncrementalBalance(BRWallet *wallet, int incremental)
 {
-    UInt160 *chain = NULL, *origChain;
-    size_t i, j = 0, count, startCount;
-
     assert(wallet != NULL);
-    assert(gapLimit > 0);
     pthread_mutex_lock(&wallet->lock);
-    if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
-    if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
-    assert(chain != NULL);
-    origChain = chain;
-    i = count = startCount = array_count(chain);
-    
-    // keep only the trailing contiguous block of addresses with no transactions
-    while (i > 0 && ! BRSetContains(wallet->usedPKH, &chain[i - 1])) i--;
-    
-    while (i + gapLimit > count) { // generate new addresses up to gapLimit
-        BRKey key;
-        uint8_t pubKey[BRBIP32PubKey(NULL, 0, wallet->masterPubKey, internal, count)];
-        size_t len = BRBIP32PubKey(pubKey, sizeof(pubKey), wallet->masterPubKey, internal, (uint32_t)count);
-        
-        if (! BRKeySetPubKey(&key, pubKey, len)) break;
-        array_add(chain, BRKeyHash160(&key));
-        count++;
-        if (BRSetContains(wallet->usedPKH, &chain[array_count(chain) - 1])) i = count;
+    wallet->incrementalBalance = incremental;
+    wallet->balanceNeedsReset = 1;
+    pthread_mutex_unlock(&wallet->lock);
+}
+
+// appends the pkhs of chain keys from through from + count - 1 that aren't already in the chain
+static void _BRWalletAddChainPKHs(BRWallet *wallet, uint32_t internal, const UInt160 pkhs[], size_t from, size_t count)
+{
+    UInt160 *chain = (internal == SEQUENCE_INTERNAL_CHAIN) ? wallet->internalChain : wallet->externalChain,
+            *origChain = chain;
+    size_t i, startCount = array_count(chain);
+
+    assert(startCount >= from);
+
+    // another call may have extended the chain while the keys were derived
+    for (i = startCount; i < from + count; i++) {
+        array_add(chain, pkhs[i - from]);
     }
 
-    if (addrs && i + gapLimit <= count) {
-        for (j = 0; j < gapLimit; j++) {
-            BRAddressFromHash160(addrs[j].s, sizeof(*addrs), wallet->addrParams, &chain[i + j]);
-        }
+    // an output of an already applied transaction now belongs to the wallet, so its balance must be recomputed
+    for (i = startCount; i < array_count(chain); i++) {
+        if (BRSetContains(wallet->foreignPKH, &chain[i])) wallet->balanceNeedsReset = 1;
     }
-    
+
     // was chain moved to a new memory location?
     if (chain == origChain) {
-        for (i = startCount; i < count; i++) {
+        for (i = startCount; i < array_count(chain); i++) {
             BRSetAdd(wallet->allPKH, &chain[i]);
         }
     }
@@ -391,11 +644,146 @@ size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimi
             BRSetAdd(wallet->allPKH, &wallet->externalChain[i - 1]);
         }
     }
+}
+
+typedef struct {
+    const BRBIP32PubKeyNode *node;
+    uint32_t from;
+    size_t count, derived;
+    UInt160 *pkhs;
+} _BRWalletDeriveWork;
+
+static void *_BRWalletDeriveWorker(void *info)
+{
+    _BRWalletDeriveWork *work = info;
+    BRECPoint *pubKeys = (work->count > 0) ? malloc(work->count*sizeof(*pubKeys)) : NULL;
+
+    assert(pubKeys != NULL || work->count == 0);
+    work->derived = BRBIP32PubKeyNodeRange(pubKeys, work->node, work->from, work->count);
+
+    for (size_t i = 0; i < work->derived; i++) {
+        BRHash160(&work->pkhs[i], &pubKeys[i], sizeof(pubKeys[i]));
+    }
+
+    if (pubKeys) free(pubKeys);
+    return NULL;
+}
+
+// writes the pkhs of the node's child keys from through from + count - 1 to pkhs, deriving them in contiguous slices on
+// up to threadCount threads, including the caller's
+// returns the number of leading pkhs written, which is less than count only on failure
+static size_t _BRWalletDerivePKHs(UInt160 pkhs[], const BRBIP32PubKeyNode *node, uint32_t from, size_t count,
+                                  size_t threadCount)
+{
+    size_t i, n = 0;
+
+    if (threadCount > count/WALLET_DERIVE_MIN_PER_THREAD) threadCount = count/WALLET_DERIVE_MIN_PER_THREAD;
+    if (threadCount < 1) threadCount = 1;
+
+    _BRWalletDeriveWork work[threadCount];
+
+    for (i = 0; i < threadCount; i++) {
+        size_t begin = i*count/threadCount, end = (i + 1)*count/threadCount;
+
+        work[i] = (_BRWalletDeriveWork) { node, from + (uint32_t)begin, end - begin, 0, &pkhs[begin] };
+    }
+
+    run_parallel_brd(_BRWalletDeriveWorker, work, sizeof(*work), threadCount);
+
+    for (i = 0; i < threadCount; i++) { // the pkhs are contiguous up to the first slice that failed
+        n += work[i].derived;
+        if (work[i].derived < work[i].count) break;
+    }
+
+    return n;
+}
+
+// wallets are composed of chains of addresses
+// each chain is traversed until a gap of a number of addresses is found that haven't been used in any transactions
+// this function writes to addrs an array of <gapLimit> unused addresses following the last used address in the chain
+// the internal chain is used for change addresses and the external chain for receive addresses
+// addrs may be NULL to only generate addresses for BRWalletContainsAddress()
+// returns the number addresses written to addrs
+size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal)
+{
+    return BRWalletUnusedAddrsParallel(wallet, addrs, gapLimit, internal, 1);
+}
+
+// like BRWalletUnusedAddrs(), but derives new addresses on up to threadCount threads, including the caller's
+size_t BRWalletUnusedAddrsParallel(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal,
+                                   size_t threadCount)
+{
+    const BRBIP32PubKeyNode *node = NULL;
+    UInt160 *chain, *pkhs;
+    size_t i, j = 0, n, count;
+
+    assert(wallet != NULL);
+    assert(gapLimit > 0);
+    if (internal == SEQUENCE_EXTERNAL_CHAIN) node = &wallet->externalNode;
+    if (internal == SEQUENCE_INTERNAL_CHAIN) node = &wallet->internalNode;
+    assert(node != NULL);
+    pthread_mutex_lock(&wallet->lock);
+
+    while (1) {
+        chain = (internal == SEQUENCE_INTERNAL_CHAIN) ? wallet->internalChain : wallet->externalChain;
+        i = count = array_count(chain);
+
+        // keep only the trailing contiguous block of addresses with no transactions
+        while (i > 0 && ! BRSetContains(wallet->usedPKH, &chain[i - 1])) i--;
+        if (i + gapLimit <= count) break;
+
+        // generate new addresses up to gapLimit, doing the EC work from the cached chain node without holding the lock
+        n = i + gapLimit - count;
+        pthread_mutex_unlock(&wallet->lock);
+        pkhs = malloc(n*sizeof(*pkhs));
+        assert(pkhs != NULL);
+        n = _BRWalletDerivePKHs(pkhs, node, (uint32_t)count, n, threadCount);
+        pthread_mutex_lock(&wallet->lock);
+
+        // new addresses that were used in a transaction move i forward, so the gap is checked again
+        if (n > 0) _BRWalletAddChainPKHs(wallet, internal, pkhs, count, n);
+        free(pkhs);
+        if (n == 0) break; // key derivation failed
+    }
+
+    if (addrs && i + gapLimit <= count) {
+        for (j = 0; j < gapLimit; j++) {
+            BRAddressFromHash160(addrs[j].s, sizeof(*addrs), wallet->addrParams, &chain[i + j]);
+        }
+    }
 
     pthread_mutex_unlock(&wallet->lock);
     return j;
 }
 
+// for account discovery, extends the chain past its last used address by a window of unused addresses, to be queried
+// all at once; the window is the number of addresses up to and including the last used one, but at least gapLimit and
+// at most WALLET_DISCOVERY_WINDOW_MAX, so a chain with n used addresses is discovered in about log2(n/gapLimit) rounds
+// rather than n/gapLimit
+// keys are derived on up to threadCount threads, including the caller's
+// returns the size of the window
+uint32_t BRWalletDiscoverAddrs(BRWallet *wallet, uint32_t gapLimit, uint32_t internal, size_t threadCount)
+{
+    const UInt160 *chain = NULL;
+    size_t i;
+    uint32_t window = gapLimit;
+
+    assert(wallet != NULL);
+    assert(gapLimit > 0);
+    pthread_mutex_lock(&wallet->lock);
+    if (internal == SEQUENCE_EXTERNAL_CHAIN) chain = wallet->externalChain;
+    if (internal == SEQUENCE_INTERNAL_CHAIN) chain = wallet->internalChain;
+    assert(chain != NULL);
+    i = array_count(chain);
+    while (i > 0 && ! BRSetContains(wallet->usedPKH, &chain[i - 1])) i--;
+    pthread_mutex_unlock(&wallet->lock);
+
+    if (i > window) window = (i < WALLET_DISCOVERY_WINDOW_MAX) ? (uint32_t)i : WALLET_DISCOVERY_WINDOW_MAX;
+    if (window < gapLimit) window = gapLimit;
+    BRWalletUnusedAddrsParallel(wallet, NULL, window, internal, threadCount);
+    return window;
+}
+
 // current wallet balance, not including transactions known to be invalid
 uint64_t BRWalletBalance(BRWallet *wallet)
 {
@@ -570,6 +958,25 @@ size_t BRWalletAllAddrs(BRWallet *wallet, BRAddress addrs[], size_t addrsCount)
     return internalCount + externalCount;
 }
 
+// writes the pubkey hashes of the given chain previously generated with BRWalletUnusedAddrs(), starting at index from,
+// to pkhs
+// returns the number of hashes written, or the total number past from if pkhs is NULL
+size_t BRWalletChainPKHs(BRWallet *wallet, UInt160 pkhs[], size_t pkhsCount, uint32_t internal, size_t from)
+{
+    UInt160 *chain;
+    size_t count = 0;
+    
+    assert(wallet != NULL);
+    assert(internal == SEQUENCE_EXTERNAL_CHAIN || internal == SEQUENCE_INTERNAL_CHAIN);
+    pthread_mutex_lock(&wallet->lock);
+    chain = (internal == SEQUENCE_INTERNAL_CHAIN) ? wallet->internalChain : wallet->externalChain;
+    if (from < array_count(chain)) count = array_count(chain) - from;
+    if (pkhs && count > pkhsCount) count = pkhsCount;
+    if (pkhs && count > 0) memcpy(pkhs, &chain[from], count*sizeof(*pkhs));
+    pthread_mutex_unlock(&wallet->lock);
+    return count;
+}
+
 // true if the address was previously generated by BRWalletUnusedAddrs() (even if it's now used)
 int BRWalletContainsAddress(BRWallet *wallet, const char *addr)
 {
@@ -730,6 +1137,14 @@ BRTransaction *BRWalletCreateTxForOutputsWithFeePerKb(BRWallet *wallet, uint64_t
 // seed is the master private key (wallet seed) corresponding to the master public key given when the wallet was created
 // returns true if all inputs were signed, or false if there was an error or not all inputs were able to be signed
 int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, uint8_t forkId, const void *seed, size_t seedLen)
+{
+    return BRWalletSignTransactionParallel(wallet, tx, forkId, seed, seedLen, 1);
+}
+
+// like BRWalletSignTransaction(), but computes the input signatures on up to threadCount threads
+// (see BRTransactionSignParallel())
+int BRWalletSignTransactionParallel(BRWallet *wallet, BRTransaction *tx, uint8_t forkId, const void *seed, size_t seedLen,
+                                    size_t threadCount)
 {
     uint32_t j, internalIdx[tx->inCount], externalIdx[tx->inCount];
     size_t i, internalCount = 0, externalCount = 0;
@@ -760,7 +1175,7 @@ int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, uint8_t forkId,
         BRBIP32PrivKeyList(&keys[internalCount], externalCount, seed, seedLen, SEQUENCE_EXTERNAL_CHAIN, externalIdx);
         // TODO: XXX wipe seed callback
         seed = NULL;
-        if (tx) r = BRTransactionSign(tx, forkId, keys, internalCount + externalCount);
+        if (tx) r = BRTransactionSignParallel(tx, forkId, keys, internalCount + externalCount, threadCount);
         for (i = 0; i < internalCount + externalCount; i++) BRKeyClean(&keys[i]);
     }
     else r = -1; // user canceled authentication
@@ -798,8 +1213,7 @@ int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx)
                 // TODO: handle tx replacement with input sequence numbers
                 //       (for now, replacements appear invalid until confirmation)
                 BRSetAdd(wallet->allTx, tx);
-                _BRWalletInsertTx(wallet, tx);
-                _BRWalletUpdateBalance(wallet);
+                _BRWalletUpdateBalance(wallet, _BRWalletInsertTx(wallet, tx));
                 wasAdded = 1;
             }
             else { // keep track of unconfirmed non-wallet tx for invalid tx checks and child-pays-for-parent fees
@@ -825,6 +1239,76 @@ int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx)
     return r;
 }
 
+// adds transactions to the wallet, extending the address chains, updating the balance and calling balanceChanged once
+// per batch rather than once per transaction; returns the number of transactions added
+// transactions that aren't associated with the wallet are handled as in BRWalletRegisterTransaction()
+size_t BRWalletRegisterTransactions(BRWallet *wallet, BRTransaction *transactions[], size_t txCount)
+{
+    BRTransaction *tx, **added, **pending;
+    size_t i, j, k, index, count;
+
+    assert(wallet != NULL);
+    assert(transactions != NULL || txCount == 0);
+    array_new(added, txCount);
+    array_new(pending, txCount);
+
+    for (i = 0; i < txCount; i++) {
+        assert(transactions[i] != NULL && BRTransactionIsSigned(transactions[i]));
+        if (transactions[i] && BRTransactionIsSigned(transactions[i])) array_add(pending, transactions[i]);
+    }
+
+    // a tx may only be associated with the wallet through an address generated for an earlier tx in the batch, so
+    // repeat until no more are added
+    for (index = 0; index != SIZE_MAX && array_count(pending) > 0;) {
+        pthread_mutex_lock(&wallet->lock);
+
+        for (i = 0, j = 0, index = SIZE_MAX; i < array_count(pending); i++) {
+            tx = pending[i];
+            if (BRSetContains(wallet->allTx, tx)) continue;
+
+            if (_BRWalletContainsTx(wallet, tx)) {
+                BRSetAdd(wallet->allTx, tx);
+                k = _BRWalletInsertTx(wallet, tx);
+                if (k < index) index = k;
+                array_add(added, tx);
+            }
+            else pending[j++] = tx;
+        }
+
+        array_set_count(pending, j);
+        if (index != SIZE_MAX) _BRWalletUpdateBalance(wallet, index);
+        pthread_mutex_unlock(&wallet->lock);
+
+        if (index != SIZE_MAX) {
+            // when a wallet address is used in a transaction, generate a new address to replace it
+            BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_EXTERNAL, SEQUENCE_EXTERNAL_CHAIN);
+            BRWalletUnusedAddrs(wallet, NULL, SEQUENCE_GAP_LIMIT_INTERNAL, SEQUENCE_INTERNAL_CHAIN);
+        }
+    }
+
+    pthread_mutex_lock(&wallet->lock);
+
+    for (i = 0; i < array_count(pending); i++) {
+        // keep track of unconfirmed non-wallet tx for invalid tx checks and child-pays-for-parent fees
+        // BUG: limit total non-wallet unconfirmed tx to avoid memory exhaustion attack
+        if (pending[i]->blockHeight == TX_UNCONFIRMED && ! BRSetContains(wallet->allTx, pending[i])) {
+            BRSetAdd(wallet->allTx, pending[i]);
+        }
+    }
+
+    pthread_mutex_unlock(&wallet->lock);
+    count = array_count(added);
+    if (count > 0 && wallet->balanceChanged) wallet->balanceChanged(wallet->callbackInfo, wallet->balance);
+
+    for (i = 0; i < count && wallet->txAdded; i++) {
+        wallet->txAdded(wallet->callbackInfo, added[i]);
+    }
+
+    array_free(pending);
+    array_free(added);
+    return count;
+}
+
 // removes a tx from the wallet, along with any tx that depend on its outputs
 void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash)
 {
@@ -862,13 +1346,12 @@ void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash)
             BRWalletRemoveTransaction(wallet, txHash);
         }
         else {
-            for (size_t i = array_count(wallet->transactions); i > 0; i--) {
-                if (! BRTransactionEq(wallet->transactions[i - 1], tx)) continue;
-                array_rm(wallet->transactions, i - 1);
-                break;
-            }
-            
-            _BRWalletUpdateBalance(wallet);
+            size_t i = _BRWalletTxIndex(wallet, tx);
+            BRWalletTxNode *node = BRSetGet(wallet->txNodes, tx);
+
+            if (i != SIZE_MAX) array_rm(wallet->transactions, i);
+            if (node) _BRWalletTxNodeFree(wallet, node);
+            _BRWalletUpdateBalance(wallet, (i != SIZE_MAX) ? i : array_count(wallet->transactions));
             pthread_mutex_unlock(&wallet->lock);
             
             // if this is for a transaction we sent, and it wasn't already known to be invalid, notify user
@@ -1062,8 +1545,7 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
     UInt256 hashesBuf[4096];
     UInt256 *hashes = (txCount <= 4096 ? hashesBuf : calloc (txCount, sizeof (UInt256)));
 
-    int needsUpdate = 0;
-    size_t i, j, k;
+    size_t i, j, k, index = SIZE_MAX;
     
     assert(wallet != NULL);
     assert(txHashes != NULL || txCount == 0);
@@ -1077,15 +1559,16 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
         tx->blockHeight = blockHeight;
         
         if (_BRWalletContainsTx(wallet, tx)) {
-            for (k = array_count(wallet->transactions); k > 0; k--) { // remove and re-insert tx to keep wallet sorted
-                if (! BRTransactionEq(wallet->transactions[k - 1], tx)) continue;
-                array_rm(wallet->transactions, k - 1);
-                _BRWalletInsertTx(wallet, tx);
-                break;
+            k = _BRWalletTxIndex(wallet, tx);
+
+            if (k != SIZE_MAX) { // remove and re-insert tx to keep wallet sorted
+                array_rm(wallet->transactions, k);
+                if (k < index) index = k;
+                k = _BRWalletInsertTx(wallet, tx);
+                if (k < index) index = k;
             }
             
             hashes[j++] = txHashes[i];
-            if (BRSetContains(wallet->pendingTx, tx) || BRSetContains(wallet->invalidTx, tx)) needsUpdate = 1;
         }
         else if (blockHeight != TX_UNCONFIRMED) { // remove and free confirmed non-wallet tx
             BRSetRemove(wallet->allTx, tx);
@@ -1093,7 +1576,8 @@ void BRWalletUpdateTransactions(BRWallet *wallet, const UInt256 txHashes[], size
         }
     }
     
-    if (needsUpdate) _BRWalletUpdateBalance(wallet);
+    // the balance history follows the order of wallet->transactions, so it needs updating whenever a tx moved
+    if (index != SIZE_MAX) _BRWalletUpdateBalance(wallet, index);
     pthread_mutex_unlock(&wallet->lock);
     if (j > 0 && wallet->txUpdated) wallet->txUpdated(wallet->callbackInfo, hashes, j, blockHeight, timestamp);
     if (hashes != hashesBuf) free (hashes);
@@ -1114,12 +1598,20 @@ void BRWalletSetTxUnconfirmedAfter(BRWallet *wallet, uint32_t blockHeight)
     UInt256 hashesBuf[4096];
     UInt256 *hashes = (count <= 4096 ? hashesBuf : calloc (count, sizeof (UInt256)));
 
+    BRTransaction *txsBuf[4096];
+    BRTransaction **txs = (count <= 4096 ? txsBuf : calloc (count, sizeof (BRTransaction *)));
+
     for (j = 0; j < count; j++) {
-        wallet->transactions[i + j]->blockHeight = TX_UNCONFIRMED;
-        hashes[j] = wallet->transactions[i + j]->txHash;
+        txs[j] = wallet->transactions[i + j];
+        txs[j]->blockHeight = TX_UNCONFIRMED;
+        hashes[j] = txs[j]->txHash;
     }
-    
-    if (count > 0) _BRWalletUpdateBalance(wallet);
+
+    // re-insert, oldest first, so the sort keys reflect the new blockHeight
+    array_set_count(wallet->transactions, i);
+    for (j = 0; j < count; j++) _BRWalletInsertTx(wallet, txs[j]);
+    if (count > 0) _BRWalletUpdateBalance(wallet, i);
+    if (txs != txsBuf) free (txs);
     pthread_mutex_unlock(&wallet->lock);
     if (count > 0 && wallet->txUpdated) wallet->txUpdated(wallet->callbackInfo, hashes, count, TX_UNCONFIRMED, 0);
     if (hashes != hashesBuf) free (hashes);
@@ -1327,6 +1819,12 @@ static void _setApplyFreeTx(void *info, void *tx)
 }
 
 // frees memory allocated for wallet, and calls BRTransactionFree() for all registered transactions
+static void _setApplyFreeTxNode(void *info, void *node)
+{
+    free(((BRWalletTxNode *)node)->spends);
+    free(node);
+}
+
 void BRWalletFree(BRWallet *wallet)
 {
     assert(wallet != NULL);
@@ -1338,11 +1836,19 @@ void BRWalletFree(BRWallet *wallet)
     BRSetApply(wallet->allTx, NULL, _setApplyFreeTx);
     BRSetFree(wallet->allTx);
     BRSetFree(wallet->spentOutputs);
+    BRSetFree(wallet->foreignPKH);
+    BRSetApply(wallet->txNodes, NULL, _setApplyFreeTxNode);
+    BRSetFree(wallet->txNodes);
+    BRSetFree(wallet->txSpends);
     array_free(wallet->internalChain);
     array_free(wallet->externalChain);
     array_free(wallet->balanceHist);
     array_free(wallet->transactions);
     array_free(wallet->utxos);
+    array_free(wallet->balanceDeltas);
+    array_free(wallet->balanceSpent);
+    array_free(wallet->balanceRemoved);
+    array_free(wallet->balanceUsedPKH);
     pthread_mutex_unlock(&wallet->lock);
     pthread_mutex_destroy(&wallet->lock);
     free(wallet);
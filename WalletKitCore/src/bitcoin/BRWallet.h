@@ -75,6 +75,10 @@ void BRWalletSetCallbacks(BRWallet *wallet, void *info,
                                             uint32_t timestamp),
                           void (*txDeleted)(void *info, UInt256 txHash, int notifyUser, int recommendRescan));
 
+// enables (the default) or disables incremental balance updates; when disabled, every change to the wallet's
+// transactions recomputes the balance, utxos and balance history of all transactions from scratch
+void BRWalletSetIncrementalBalance(BRWallet *wallet, int incremental);
+
 // wallets are composed of chains of addresses
 // each chain is traversed until a gap of a number of addresses is found that haven't been used in any transactions
 // this function writes to addrs an array of <gapLimit> unused addresses following the last used address in the chain
@@ -83,6 +87,18 @@ void BRWalletSetCallbacks(BRWallet *wallet, void *info,
 // returns the number addresses written to addrs
 size_t BRWalletUnusedAddrs(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal);
 
+// like BRWalletUnusedAddrs(), but derives new addresses on up to threadCount threads, including the caller's
+size_t BRWalletUnusedAddrsParallel(BRWallet *wallet, BRAddress addrs[], uint32_t gapLimit, uint32_t internal,
+                                   size_t threadCount);
+
+// for account discovery, extends the chain past its last used address by a window of unused addresses, to be queried
+// all at once; the window is the number of addresses up to and including the last used one, but at least gapLimit and
+// at most WALLET_DISCOVERY_WINDOW_MAX, so a chain with n used addresses is discovered in about log2(n/gapLimit) rounds
+// rather than n/gapLimit
+// keys are derived on up to threadCount threads, including the caller's
+// returns the size of the window
+uint32_t BRWalletDiscoverAddrs(BRWallet *wallet, uint32_t gapLimit, uint32_t internal, size_t threadCount);
+
 BRAddressParams BRWalletGetAddressParams (BRWallet *wallet);
 
 // returns the first unused external address (bech32 pay-to-witness-pubkey-hash)
@@ -98,6 +114,11 @@ BRAddress BRWalletAddressToLegacy (BRWallet *wallet, BRAddress *addr);
 // returns the number addresses written, or total number available if addrs is NULL
 size_t BRWalletAllAddrs(BRWallet *wallet, BRAddress addrs[], size_t addrsCount);
 
+// writes the pubkey hashes of the given chain previously generated with BRWalletUnusedAddrs(), starting at index from,
+// to pkhs - chains only grow, so a caller can pick up new addresses where it left off without encoding them
+// returns the number of hashes written, or the total number past from if pkhs is NULL
+size_t BRWalletChainPKHs(BRWallet *wallet, UInt160 pkhs[], size_t pkhsCount, uint32_t internal, size_t from);
+
 // true if the address was previously generated by BRWalletUnusedAddrs() (even if it's now used)
 int BRWalletContainsAddress(BRWallet *wallet, const char *addr);
 
@@ -159,12 +180,22 @@ BRTransaction *BRWalletCreateTxForOutputsWithFeePerKb(BRWallet *wallet, uint64_t
 // returns true if all inputs were signed, or false if there was an error or not all inputs were able to be signed
 int BRWalletSignTransaction(BRWallet *wallet, BRTransaction *tx, uint8_t forkId, const void *seed, size_t seedLen);
 
+// like BRWalletSignTransaction(), but computes the input signatures on up to threadCount threads
+// (see BRTransactionSignParallel())
+int BRWalletSignTransactionParallel(BRWallet *wallet, BRTransaction *tx, uint8_t forkId, const void *seed, size_t seedLen,
+                                    size_t threadCount);
+
 // true if the given transaction is associated with the wallet (even if it hasn't been registered)
 int BRWalletContainsTransaction(BRWallet *wallet, const BRTransaction *tx);
 
 // adds a transaction to the wallet, or returns false if it isn't associated with the wallet
 int BRWalletRegisterTransaction(BRWallet *wallet, BRTransaction *tx);
 
+// adds transactions to the wallet, extending the address chains, updating the balance and calling balanceChanged once
+// per batch rather than once per transaction; returns the number of transactions added
+// transactions that aren't associated with the wallet are handled as in BRWalletRegisterTransaction()
+size_t BRWalletRegisterTransactions(BRWallet *wallet, BRTransaction *transactions[], size_t txCount);
+
 // removes a tx from the wallet, along with any tx that depend on its outputs
 void BRWalletRemoveTransaction(BRWallet *wallet, UInt256 txHash);
 
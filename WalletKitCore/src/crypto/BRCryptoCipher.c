@@ -23,8 +23,7 @@ struct BRCryptoCipherRecord {
 
     union {
         struct {
-            uint8_t key[32];
-            size_t keyLen;
+            BRAESContext aes;
         } aesecb;
 
         struct {
@@ -64,9 +63,8 @@ cryptoCipherCreateForAESECB(const uint8_t *key,
     }
 
     BRCryptoCipher cipher  = cryptoCipherCreateInternal (CRYPTO_CIPHER_AESECB);
-    // aesecb.key initialized to zero via calloc
-    memcpy (cipher->u.aesecb.key, key, keyLen);
-    cipher->u.aesecb.keyLen = keyLen;
+    // expand the key schedule once, rather than on every block
+    BRAESContextInit (&cipher->u.aesecb.aes, key, keyLen);
 
     return cipher;
 }
@@ -135,7 +133,7 @@ cryptoCipherRelease (BRCryptoCipher cipher) {
         }
     }
 
-    memset (cipher, 0, sizeof(*cipher));
+    mem_clean (cipher, sizeof(*cipher));
     free (cipher);
 }
 
@@ -208,9 +206,7 @@ cryptoCipherEncrypt (BRCryptoCipher cipher,
         case CRYPTO_CIPHER_AESECB: {
             if (srcLen == dstLen && (0 == srcLen % 16)) {
                 memcpy (dst, src, dstLen);
-                for (size_t index = 0; index < dstLen; index += 16) {
-                    BRAESECBEncrypt (&dst[index], cipher->u.aesecb.key, cipher->u.aesecb.keyLen);
-                }
+                BRAESContextECBEncrypt (&cipher->u.aesecb.aes, dst, dstLen);
                 result = CRYPTO_TRUE;
             }
             break;
@@ -318,9 +314,7 @@ cryptoCipherDecrypt (BRCryptoCipher cipher,
         case CRYPTO_CIPHER_AESECB: {
             if (srcLen == dstLen && (0 == srcLen % 16)) {
                 memcpy (dst, src, dstLen);
-                for (size_t index = 0; index < dstLen; index += 16) {
-                    BRAESECBDecrypt (&dst[index], cipher->u.aesecb.key, cipher->u.aesecb.keyLen);
-                }
+                BRAESContextECBDecrypt (&cipher->u.aesecb.aes, dst, dstLen);
                 result = CRYPTO_TRUE;
             }
             break;
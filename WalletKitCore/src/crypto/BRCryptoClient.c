@@ -186,6 +186,7 @@ cryptoClientQRYManagerCreate (BRCryptoClient client,
     qry->sync.completed = true;
     qry->sync.success   = false;
     qry->sync.unbounded = CRYPTO_CLIENT_QRY_IS_UNBOUNDED;
+    qry->sync.recovery  = true;
 
     qry->connected = false;
 
@@ -271,6 +272,10 @@ cryptoClientQRYManagerUpdateSync (BRCryptoClientQRYManager qry,
     qry->sync.completed = completed;
     qry->sync.success   = success;
 
+    // Once a sync from the earliest block succeeds, the account is recovered; subsequent syncs are
+    // incremental and query only the addresses the wallet already has.
+    if (completed && success) qry->sync.recovery = false;
+
     if (needBegEvent) {
         cryptoWalletManagerSetState (qry->manager, (BRCryptoWalletManagerState) {
             CRYPTO_WALLET_MANAGER_STATE_SYNCING
@@ -359,8 +364,10 @@ cryptoClientQRYRequestSync (BRCryptoClientQRYManager qry, bool needLock) {
         // Mark the sync as completed, unsucessfully (the initial state)
         cryptoClientQRYManagerUpdateSync (qry, false, false, false);
 
-        // Get the addresses for the manager's wallet
+        // Get the addresses for the manager's wallet; when recovering, discover addresses past
+        // those already used so that the query covers them too.
         BRCryptoWallet wallet = cryptoWalletManagerGetWallet (qry->manager);
+        if (qry->sync.recovery) cryptoWalletDiscoverAddressesForRecovery (wallet);
         BRSetOf(BRCryptoAddress) addresses = cryptoWalletGetAddressesForRecovery (wallet);
         assert (0 != BRSetCount(addresses));
 
@@ -597,6 +604,7 @@ cryptoClientHandleTransactions (OwnershipKept BRCryptoWalletManager manager,
 
     pthread_mutex_lock (&qry->lock);
     bool matchedRids = (callbackState->rid == qry->sync.rid);
+    bool recovery    = qry->sync.recovery;
     pthread_mutex_unlock (&qry->lock);
 
     bool syncCompleted = false;
@@ -621,9 +629,8 @@ cryptoClientHandleTransactions (OwnershipKept BRCryptoWalletManager manager,
                 mergesort_brd (bundles, bundlesCount, sizeof (BRCryptoClientTransactionBundle),
                                cryptoClientTransactionBundleCompareForSort);
 
-                // Recover transfers from each bundle
-                for (size_t index = 0; index < bundlesCount; index++)
-                   cryptoWalletManagerRecoverTransfersFromTransactionBundle (manager, bundles[index]);
+                // Recover transfers from all bundles at once
+                cryptoWalletManagerRecoverTransfersFromTransactionBundles (manager, bundles, bundlesCount);
 
                 // The following assumes `bundles` has produced transfers which may have
                 // impacted the wallet's addresses.  Thus the recovery must be *serial w.r.t. the
@@ -635,6 +642,7 @@ cryptoClientHandleTransactions (OwnershipKept BRCryptoWalletManager manager,
                 BRSetOf(BRCryptoAddress) oldAddresses = callbackState->u.getTransactions.addresses;
 
                 // We'll need another query if `newAddresses` is now larger then `oldAddresses`
+                if (recovery) cryptoWalletDiscoverAddressesForRecovery (wallet);
                 BRSetOf(BRCryptoAddress) newAddresses = cryptoWalletGetAddressesForRecovery (wallet);
 
                 // Make the actual request; if none is needed, then we are done
@@ -728,6 +736,7 @@ cryptoClientHandleTransfers (OwnershipKept BRCryptoWalletManager manager,
 
     pthread_mutex_lock (&qry->lock);
     bool matchedRids = (callbackState->rid == qry->sync.rid);
+    bool recovery    = qry->sync.recovery;
     pthread_mutex_unlock (&qry->lock);
 
     bool syncCompleted = false;
@@ -759,6 +768,7 @@ cryptoClientHandleTransfers (OwnershipKept BRCryptoWalletManager manager,
                 BRSetOf(BRCryptoAddress) oldAddresses = callbackState->u.getTransactions.addresses;
 
                 // We'll need another query if `newAddresses` is now larger then `oldAddresses`
+                if (recovery) cryptoWalletDiscoverAddressesForRecovery (wallet);
                 BRSetOf(BRCryptoAddress) newAddresses = cryptoWalletGetAddressesForRecovery (wallet);
 
                 // Make the actual request; if none is needed, then we are done.  Use the
@@ -347,6 +347,7 @@ struct BRCryptoClientQRYManagerRecord {
         bool completed;
         bool success;
         bool unbounded;     // true if `endBlockNumber` should be unbounded on request
+        bool recovery;      // true until a sync from the earliest block completes successfully
         BRCryptoBlockNumber begBlockNumber;
         BRCryptoBlockNumber endBlockNumber;
         size_t rid;
@@ -43,9 +43,9 @@ cryptoFileServiceTypeTransferV1Reader (BRFileServiceContext context,
                                  uint32_t bytesCount) {
     BRCryptoWalletManager manager = (BRCryptoWalletManager) context; (void) manager;
 
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCompact();
     BRRlpData  data  = (BRRlpData) { bytesCount, bytes };
-    BRRlpItem  item  = rlpDataGetItem (coder, data);
+    BRRlpItem  item  = rlpDataGetItemView (coder, data);
 
     BRCryptoClientTransferBundle bundle = cryptoClientTransferBundleRlpDecode (item, coder,
                                                                                CRYPTO_FILE_SERVICE_TYPE_TRANSFER_VERSION_1);
@@ -63,9 +63,9 @@ cryptoFileServiceTypeTransferV2Reader (BRFileServiceContext context,
                                        uint32_t bytesCount) {
     BRCryptoWalletManager manager = (BRCryptoWalletManager) context; (void) manager;
 
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCompact();
     BRRlpData  data  = (BRRlpData) { bytesCount, bytes };
-    BRRlpItem  item  = rlpDataGetItem (coder, data);
+    BRRlpItem  item  = rlpDataGetItemView (coder, data);
 
     BRCryptoClientTransferBundle bundle = cryptoClientTransferBundleRlpDecode(item, coder,
                                                                               CRYPTO_FILE_SERVICE_TYPE_TRANSFER_VERSION_2);
@@ -84,7 +84,7 @@ cryptoFileServiceTypeTransferV1Writer (BRFileServiceContext context,
     BRCryptoWalletManager        manager = (BRCryptoWalletManager) context; (void) manager;
     BRCryptoClientTransferBundle bundle  = (BRCryptoClientTransferBundle) entity;
 
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCompact();
     BRRlpItem  item  = cryptoClientTransferBundleRlpEncode (bundle, coder);
     BRRlpData  data  = rlpItemGetData (coder, item);
 
@@ -95,6 +95,14 @@ cryptoFileServiceTypeTransferV1Writer (BRFileServiceContext context,
     return data.bytes;
 }
 
+private_extern uint64_t
+cryptoFileServiceTypeTransferSortKey (BRFileServiceContext context,
+                                      BRFileService fs,
+                                      const void *entity) {
+    BRCryptoClientTransferBundle bundle  = (BRCryptoClientTransferBundle) entity;
+    return bundle->blockNumber;
+}
+
 // MARK: - Client Transaction Bundle
 
 private_extern UInt256
@@ -119,9 +127,9 @@ cryptoFileServiceTypeTransactionV1Reader (BRFileServiceContext context,
     BRCryptoWalletManager manager = (BRCryptoWalletManager) context;
     (void) manager;
 
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCompact();
     BRRlpData  data  = (BRRlpData) { bytesCount, bytes };
-    BRRlpItem  item  = rlpDataGetItem (coder, data);
+    BRRlpItem  item  = rlpDataGetItemView (coder, data);
 
     BRCryptoClientTransactionBundle bundle = cryptoClientTransactionBundleRlpDecode(item, coder);
 
@@ -139,7 +147,7 @@ cryptoFileServiceTypeTransactionV1Writer (BRFileServiceContext context,
     BRCryptoWalletManager           manager = (BRCryptoWalletManager) context; (void) manager;
     BRCryptoClientTransactionBundle bundle  = (BRCryptoClientTransactionBundle) entity;
 
-    BRRlpCoder coder = rlpCoderCreate();
+    BRRlpCoder coder = rlpCoderCreateCompact();
     BRRlpItem  item  = cryptoClientTransactionBundleRlpEncode (bundle, coder);
     BRRlpData  data  = rlpItemGetData (coder, item);
 
@@ -150,6 +158,14 @@ cryptoFileServiceTypeTransactionV1Writer (BRFileServiceContext context,
     return data.bytes;
 }
 
+private_extern uint64_t
+cryptoFileServiceTypeTransactionSortKey (BRFileServiceContext context,
+                                         BRFileService fs,
+                                         const void *entity) {
+    BRCryptoClientTransactionBundle bundle  = (BRCryptoClientTransactionBundle) entity;
+    return bundle->blockHeight;
+}
+
 BRFileServiceTypeSpecification cryptoFileServiceSpecifications[] = {
     {
         CRYPTO_FILE_SERVICE_TYPE_TRANSFER,
@@ -168,7 +184,8 @@ BRFileServiceTypeSpecification cryptoFileServiceSpecifications[] = {
                 cryptoFileServiceTypeTransferV2Reader,
                 cryptoFileServiceTypeTransferV1Writer
             },
-        }
+        },
+        cryptoFileServiceTypeTransferSortKey
     },
 
     {
@@ -182,7 +199,8 @@ BRFileServiceTypeSpecification cryptoFileServiceSpecifications[] = {
                 cryptoFileServiceTypeTransactionV1Reader,
                 cryptoFileServiceTypeTransactionV1Writer
             },
-        }
+        },
+        cryptoFileServiceTypeTransactionSortKey
     }
 };
 size_t cryptoFileServiceSpecificationsCount = (sizeof (cryptoFileServiceSpecifications) / sizeof (BRFileServiceTypeSpecification));
@@ -49,6 +49,11 @@ cryptoFileServiceTypeTransferV1Writer (BRFileServiceContext context,
                                  const void* entity,
                                  uint32_t *bytesCount);
 
+private_extern uint64_t
+cryptoFileServiceTypeTransferSortKey (BRFileServiceContext context,
+                                      BRFileService fs,
+                                      const void *entity);
+
 
 #define CRYPTO_FILE_SERVICE_TYPE_TRANSACTION      "crypto_transactions"
 
@@ -73,6 +78,11 @@ cryptoFileServiceTypeTransactionV1Writer (BRFileServiceContext context,
                                     const void* entity,
                                     uint32_t *bytesCount);
 
+private_extern uint64_t
+cryptoFileServiceTypeTransactionSortKey (BRFileServiceContext context,
+                                         BRFileService fs,
+                                         const void *entity);
+
 extern BRFileServiceTypeSpecification cryptoFileServiceSpecifications[];
 extern size_t cryptoFileServiceSpecificationsCount;
 
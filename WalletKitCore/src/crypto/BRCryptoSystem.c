@@ -127,7 +127,7 @@ fileServiceTypeCurrencyBundleV1Reader (BRFileServiceContext context,
 
     BRRlpCoder coder = rlpCoderCreate();
     BRRlpData  data  = (BRRlpData) { bytesCount, bytes };
-    BRRlpItem  item  = rlpDataGetItem (coder, data);
+    BRRlpItem  item  = rlpDataGetItemView (coder, data);
 
     BRCryptoClientCurrencyBundle bundle = cryptoClientCurrencyBundleRlpDecode(item, coder);
 
@@ -709,8 +709,7 @@ cryptoSystemHandleCurrencyBundles (BRCryptoSystem system,
                                    OwnershipKept BRArrayOf (BRCryptoClientCurrencyBundle) bundles) {
 
     // Save the bundles straight away
-    for (size_t bundleIndex = 0; bundleIndex < array_count(bundles); bundleIndex++)
-        fileServiceSave (system->fileService, FILE_SERVICE_TYPE_CURRENCY_BUNDLE, bundles[bundleIndex]);
+    fileServiceSaveBatch (system->fileService, FILE_SERVICE_TYPE_CURRENCY_BUNDLE, (const void **) bundles, array_count(bundles));
 
     pthread_mutex_lock (&system->lock);
 
@@ -417,9 +417,14 @@ cryptoTransferSetUids (BRCryptoTransfer transfer,
     assert (NULL == transfer->uids || NULL == uids || 0 == strcmp (uids, transfer->uids));
 
     pthread_mutex_lock (&transfer->lock);
+    bool assigned = (NULL == transfer->uids && NULL != uids);
     if (NULL != transfer->uids) free (transfer->uids);
     transfer->uids = (NULL == uids ? NULL : strdup (uids));
     pthread_mutex_unlock (&transfer->lock);
+
+    // The wallet indexes transfers by uids; a NULL state tells it only the uids has changed.
+    if (assigned && NULL != transfer->listener.transferChangedCallback)
+        transfer->listener.transferChangedCallback (transfer->listener.wallet, transfer, NULL);
 }
 
 extern const char *
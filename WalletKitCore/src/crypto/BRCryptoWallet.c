@@ -293,6 +293,316 @@ cryptoWalletEventIsEqual (BRCryptoWalletEvent event1,
     }
 }
 
+// MARK: - Wallet Transfer Index
+
+struct BRCryptoWalletTransferEntryRecord {
+    BRCryptoTransfer transfer;
+
+    // The keys `transfer` is indexed under.  These are copies; the transfer's own hash, uids and
+    // state can change while it is in the wallet, after which the entry must be reindexed.
+    BRCryptoHash hash;
+    char *uids;
+    uint64_t blockNumber;
+    uint64_t timestamp;
+
+    // Other entries indexed under the same hash and uids.  Only the first entry for a key is in
+    // `transfersByHash` or `transfersByUids`; the rest are chained from it.
+    BRCryptoWalletTransferEntry nextWithHash;
+    BRCryptoWalletTransferEntry nextWithUids;
+};
+
+static size_t
+cryptoWalletTransferEntryHashValue (const void *entry) {
+    return (size_t) ((BRCryptoWalletTransferEntry) entry)->transfer;
+}
+
+static int
+cryptoWalletTransferEntryIsEqual (const void *entry1, const void *entry2) {
+    return ((BRCryptoWalletTransferEntry) entry1)->transfer == ((BRCryptoWalletTransferEntry) entry2)->transfer;
+}
+
+static size_t
+cryptoWalletTransferEntryHashHashValue (const void *entry) {
+    return (size_t) cryptoHashGetHashValue (((BRCryptoWalletTransferEntry) entry)->hash);
+}
+
+static int
+cryptoWalletTransferEntryHashIsEqual (const void *entry1, const void *entry2) {
+    return CRYPTO_TRUE == cryptoHashEqual (((BRCryptoWalletTransferEntry) entry1)->hash,
+                                           ((BRCryptoWalletTransferEntry) entry2)->hash);
+}
+
+static size_t
+cryptoWalletTransferEntryUidsHashValue (const void *entry) {
+    size_t value = 0x811C9dc5; // FNV-1a
+
+    for (const char *c = ((BRCryptoWalletTransferEntry) entry)->uids; '\0' != *c; c++)
+        value = (value ^ (uint8_t) *c) * 0x01000193;
+
+    return value;
+}
+
+static int
+cryptoWalletTransferEntryUidsIsEqual (const void *entry1, const void *entry2) {
+    return 0 == strcmp (((BRCryptoWalletTransferEntry) entry1)->uids,
+                        ((BRCryptoWalletTransferEntry) entry2)->uids);
+}
+
+static size_t
+cryptoWalletTransferEntryPointerHashValue (const void *entry) {
+    return (size_t) entry;
+}
+
+static int
+cryptoWalletTransferEntryPointerIsEqual (const void *entry1, const void *entry2) {
+    return entry1 == entry2;
+}
+
+static void
+cryptoWalletTransferIndexCreate (BRCryptoWallet wallet) {
+    wallet->transfersByTransfer = BRSetNew (cryptoWalletTransferEntryHashValue,        cryptoWalletTransferEntryIsEqual,        5);
+    wallet->transfersByHash     = BRSetNew (cryptoWalletTransferEntryHashHashValue,    cryptoWalletTransferEntryHashIsEqual,    5);
+    wallet->transfersByUids     = BRSetNew (cryptoWalletTransferEntryUidsHashValue,    cryptoWalletTransferEntryUidsIsEqual,    5);
+    wallet->transfersUnhashed   = BRSetNew (cryptoWalletTransferEntryPointerHashValue, cryptoWalletTransferEntryPointerIsEqual, 5);
+    array_new (wallet->transfersByBlock, 5);
+}
+
+static void
+cryptoWalletTransferEntryRelease (BRCryptoWalletTransferEntry entry) {
+    cryptoHashGive (entry->hash);
+    if (NULL != entry->uids) free (entry->uids);
+    free (entry);
+}
+
+static void
+cryptoWalletTransferIndexRelease (BRCryptoWallet wallet) {
+    BRSetFree (wallet->transfersUnhashed);
+    BRSetFree (wallet->transfersByUids);
+    BRSetFree (wallet->transfersByHash);
+    BRSetFreeAll (wallet->transfersByTransfer, (void (*) (void *)) cryptoWalletTransferEntryRelease);
+    array_free (wallet->transfersByBlock);
+}
+
+static BRCryptoWalletTransferEntry
+cryptoWalletTransferIndexGet (BRCryptoWallet wallet,
+                              BRCryptoTransfer transfer) {
+    struct BRCryptoWalletTransferEntryRecord key = { transfer };
+    return BRSetGet (wallet->transfersByTransfer, &key);
+}
+
+/// Add `entry` to the chain of entries for its key in `set`; `next` selects the chain.
+static void
+cryptoWalletTransferChainAdd (BRSet *set,
+                              BRCryptoWalletTransferEntry entry,
+                              BRCryptoWalletTransferEntry *(*next) (BRCryptoWalletTransferEntry)) {
+    BRCryptoWalletTransferEntry first = BRSetGet (set, entry);
+
+    if (NULL == first) BRSetAdd (set, entry);
+    else {
+        *next(entry) = *next(first);
+        *next(first) = entry;
+    }
+}
+
+static void
+cryptoWalletTransferChainRem (BRSet *set,
+                              BRCryptoWalletTransferEntry entry,
+                              BRCryptoWalletTransferEntry *(*next) (BRCryptoWalletTransferEntry)) {
+    BRCryptoWalletTransferEntry first = BRSetGet (set, entry);
+
+    if (first == entry) {
+        BRSetRemove (set, entry);
+        if (NULL != *next(entry)) BRSetAdd (set, *next(entry));
+    }
+    else {
+        for (BRCryptoWalletTransferEntry prev = first; NULL != prev; prev = *next(prev))
+            if (*next(prev) == entry) { *next(prev) = *next(entry); break; }
+    }
+    *next(entry) = NULL;
+}
+
+static BRCryptoWalletTransferEntry *
+cryptoWalletTransferEntryNextWithHash (BRCryptoWalletTransferEntry entry) {
+    return &entry->nextWithHash;
+}
+
+static BRCryptoWalletTransferEntry *
+cryptoWalletTransferEntryNextWithUids (BRCryptoWalletTransferEntry entry) {
+    return &entry->nextWithUids;
+}
+
+static int
+cryptoWalletTransferEntryBlockCompare (BRCryptoWalletTransferEntry entry,
+                                       uint64_t blockNumber,
+                                       uint64_t timestamp) {
+    return (entry->blockNumber != blockNumber
+            ? (entry->blockNumber < blockNumber ? -1 : 1)
+            : (entry->timestamp   != timestamp ? (entry->timestamp < timestamp ? -1 : 1) : 0));
+}
+
+/// Return the index of the first entry in `transfersByBlock` at or after `blockNumber`/`timestamp`
+static size_t
+cryptoWalletTransferBlockLowerBound (BRCryptoWallet wallet,
+                                     uint64_t blockNumber,
+                                     uint64_t timestamp) {
+    size_t lo = 0, hi = array_count (wallet->transfersByBlock);
+
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (cryptoWalletTransferEntryBlockCompare (wallet->transfersByBlock[mid], blockNumber, timestamp) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/// Fill in `entry`'s keys from its transfer and add it to the hash, uids and block indexes
+static void
+cryptoWalletTransferIndexAddKeys (BRCryptoWallet wallet,
+                                  BRCryptoWalletTransferEntry entry) {
+    BRCryptoTransfer transfer = entry->transfer;
+
+    entry->hash = cryptoTransferGetHash (transfer);
+
+    pthread_mutex_lock (&transfer->lock);
+    entry->uids = (NULL == transfer->uids ? NULL : strdup (transfer->uids));
+    bool included = cryptoTransferStateExtractIncluded (transfer->state, &entry->blockNumber, &entry->timestamp,
+                                                        NULL, NULL, NULL, NULL);
+    pthread_mutex_unlock (&transfer->lock);
+
+    if (!included) {
+        entry->blockNumber = BLOCK_HEIGHT_UNBOUND;
+        entry->timestamp   = 0;
+    }
+
+    if (NULL != entry->hash) cryptoWalletTransferChainAdd (wallet->transfersByHash, entry, cryptoWalletTransferEntryNextWithHash);
+    else BRSetAdd (wallet->transfersUnhashed, entry);
+
+    if (NULL != entry->uids) cryptoWalletTransferChainAdd (wallet->transfersByUids, entry, cryptoWalletTransferEntryNextWithUids);
+
+    // Transfers are mostly added in block order; inserting after any equal keys keeps this an append
+    size_t index = cryptoWalletTransferBlockLowerBound (wallet, entry->blockNumber, entry->timestamp);
+    while (index < array_count (wallet->transfersByBlock) &&
+           0 == cryptoWalletTransferEntryBlockCompare (wallet->transfersByBlock[index], entry->blockNumber, entry->timestamp))
+        index++;
+    array_insert (wallet->transfersByBlock, index, entry);
+}
+
+static void
+cryptoWalletTransferIndexRemKeys (BRCryptoWallet wallet,
+                                  BRCryptoWalletTransferEntry entry) {
+    if (NULL != entry->hash) cryptoWalletTransferChainRem (wallet->transfersByHash, entry, cryptoWalletTransferEntryNextWithHash);
+    else BRSetRemove (wallet->transfersUnhashed, entry);
+
+    if (NULL != entry->uids) cryptoWalletTransferChainRem (wallet->transfersByUids, entry, cryptoWalletTransferEntryNextWithUids);
+
+    for (size_t index = cryptoWalletTransferBlockLowerBound (wallet, entry->blockNumber, entry->timestamp);
+         index < array_count (wallet->transfersByBlock);
+         index++)
+        if (entry == wallet->transfersByBlock[index]) {
+            array_rm (wallet->transfersByBlock, index);
+            break;
+        }
+
+    cryptoHashGive (entry->hash);
+    if (NULL != entry->uids) free (entry->uids);
+    entry->hash = NULL;
+    entry->uids = NULL;
+}
+
+static void
+cryptoWalletTransferIndexAdd (BRCryptoWallet wallet,
+                              BRCryptoTransfer transfer) {
+    BRCryptoWalletTransferEntry entry = calloc (1, sizeof (struct BRCryptoWalletTransferEntryRecord));
+    entry->transfer = transfer;
+
+    BRSetAdd (wallet->transfersByTransfer, entry);
+    cryptoWalletTransferIndexAddKeys (wallet, entry);
+}
+
+static void
+cryptoWalletTransferIndexRem (BRCryptoWallet wallet,
+                              BRCryptoTransfer transfer) {
+    BRCryptoWalletTransferEntry entry = cryptoWalletTransferIndexGet (wallet, transfer);
+    if (NULL == entry) return;
+
+    cryptoWalletTransferIndexRemKeys (wallet, entry);
+    BRSetRemove (wallet->transfersByTransfer, entry);
+    cryptoWalletTransferEntryRelease (entry);
+}
+
+static void
+cryptoWalletTransferIndexUpdate (BRCryptoWallet wallet,
+                                 BRCryptoTransfer transfer) {
+    BRCryptoWalletTransferEntry entry = cryptoWalletTransferIndexGet (wallet, transfer);
+    if (NULL == entry) return;
+
+    cryptoWalletTransferIndexRemKeys (wallet, entry);
+    cryptoWalletTransferIndexAddKeys (wallet, entry);
+}
+
+/// Reindex the entries in `transfersUnhashed` whose transfer has since been assigned a hash.
+/// These are the few transfers created, but not yet signed, by the wallet itself.
+static void
+cryptoWalletTransferIndexSettle (BRCryptoWallet wallet) {
+    size_t count = BRSetCount (wallet->transfersUnhashed);
+    if (0 == count) return;
+
+    BRCryptoWalletTransferEntry entries[count];
+    BRSetAll (wallet->transfersUnhashed, (void **) entries, count);
+
+    for (size_t index = 0; index < count; index++) {
+        BRCryptoTransfer transfer = entries[index]->transfer;
+        BRCryptoHash hash = cryptoTransferGetHash (transfer);
+
+        if (NULL != hash) cryptoWalletTransferIndexUpdate (wallet, transfer);
+        cryptoHashGive (hash);
+    }
+}
+
+/// Find the wallet's transfer that is `cryptoTransferEqual` to `transfer`; called with `lock` held.
+static BRCryptoTransfer
+cryptoWalletTransferIndexFind (BRCryptoWallet wallet,
+                               BRCryptoTransfer transfer) {
+    if (NULL != cryptoWalletTransferIndexGet (wallet, transfer)) return transfer;
+
+    // Two transfers are equal if they have the same uids or, lacking uids, per the transfer's
+    // handler, which compares hashes.  So an equal transfer is found under `transfer`'s hash
+    // or uids, or is one without a hash.
+    struct BRCryptoWalletTransferEntryRecord key = { transfer };
+    key.hash = cryptoTransferGetHash (transfer);
+    pthread_mutex_lock (&transfer->lock);
+    key.uids = (NULL == transfer->uids ? NULL : strdup (transfer->uids));
+    pthread_mutex_unlock (&transfer->lock);
+
+    cryptoWalletTransferIndexSettle (wallet);
+
+    BRCryptoTransfer found = NULL;
+
+    if (NULL != key.hash)
+        for (BRCryptoWalletTransferEntry entry = BRSetGet (wallet->transfersByHash, &key);
+             NULL == found && NULL != entry;
+             entry = entry->nextWithHash)
+            if (CRYPTO_TRUE == cryptoTransferEqual (transfer, entry->transfer)) found = entry->transfer;
+
+    if (NULL != key.uids)
+        for (BRCryptoWalletTransferEntry entry = BRSetGet (wallet->transfersByUids, &key);
+             NULL == found && NULL != entry;
+             entry = entry->nextWithUids)
+            if (CRYPTO_TRUE == cryptoTransferEqual (transfer, entry->transfer)) found = entry->transfer;
+
+    for (BRCryptoWalletTransferEntry entry = BRSetIterate (wallet->transfersUnhashed, NULL);
+         NULL == found && NULL != entry;
+         entry = BRSetIterate (wallet->transfersUnhashed, entry))
+        if (CRYPTO_TRUE == cryptoTransferEqual (transfer, entry->transfer)) found = entry->transfer;
+
+    cryptoHashGive (key.hash);
+    if (NULL != key.uids) free (key.uids);
+
+    return found;
+}
+
 // MARK: - Wallet
 
 IMPLEMENT_CRYPTO_GIVE_TAKE (BRCryptoWallet, cryptoWallet)
@@ -333,6 +643,7 @@ cryptoWalletAllocAndInit (size_t sizeInBytes,
     wallet->defaultFeeBasis = cryptoFeeBasisTake (defaultFeeBasis);
 
     array_new (wallet->transfers, 5);
+    cryptoWalletTransferIndexCreate (wallet);
 
     wallet->ref = CRYPTO_REF_ASSIGN (cryptoWalletRelease);
 
@@ -349,8 +660,9 @@ cryptoWalletAllocAndInit (size_t sizeInBytes,
 
 static void
 cryptoWalletRelease (BRCryptoWallet wallet) {
-    pthread_mutex_lock (&wallet->lock);
+    // Set the state before taking `lock`; cryptoWalletSetState() takes it too.
     cryptoWalletSetState (wallet, CRYPTO_WALLET_STATE_DELETED);
+    pthread_mutex_lock (&wallet->lock);
 
     cryptoUnitGive (wallet->unit);
     cryptoUnitGive (wallet->unitForFee);
@@ -364,6 +676,7 @@ cryptoWalletRelease (BRCryptoWallet wallet) {
     for (size_t index = 0; index < array_count(wallet->transfers); index++)
         cryptoTransferGive (wallet->transfers[index]);
     array_free (wallet->transfers);
+    cryptoWalletTransferIndexRelease (wallet);
 
     wallet->handlers->release (wallet);
 
@@ -593,11 +906,8 @@ static BRCryptoBoolean
 cryptoWalletHasTransferLock (BRCryptoWallet wallet,
                              BRCryptoTransfer transfer,
                              bool needLock) {
-    BRCryptoBoolean r = CRYPTO_FALSE;
     if (needLock) pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers) && CRYPTO_FALSE == r; index++) {
-        r = cryptoTransferEqual (transfer, wallet->transfers[index]);
-    }
+    BRCryptoBoolean r = AS_CRYPTO_BOOLEAN (NULL != cryptoWalletTransferIndexFind (wallet, transfer));
     if (needLock) pthread_mutex_unlock (&wallet->lock);
     return r;
 }
@@ -625,6 +935,7 @@ cryptoWalletAddTransfer (BRCryptoWallet wallet,
     pthread_mutex_lock (&wallet->lock);
     if (CRYPTO_FALSE == cryptoWalletHasTransferLock (wallet, transfer, false)) {
         array_add (wallet->transfers, cryptoTransferTake(transfer));
+        cryptoWalletTransferIndexAdd (wallet, transfer);
         cryptoWalletAnnounceTransfer (wallet, transfer, CRYPTO_WALLET_EVENT_TRANSFER_ADDED);
         cryptoWalletGenerateEvent (wallet, cryptoWalletEventCreateTransfer (CRYPTO_WALLET_EVENT_TRANSFER_ADDED, transfer));
         cryptoWalletIncBalance (wallet, cryptoWalletGetTransferAmountDirectedNet(wallet, transfer));
@@ -640,6 +951,7 @@ cryptoWalletAddTransfers (BRCryptoWallet wallet,
         BRCryptoTransfer transfer = transfers[index];
         if (CRYPTO_FALSE == cryptoWalletHasTransferLock (wallet, transfer, false)) {
             array_add (wallet->transfers, cryptoTransferTake(transfer));
+            cryptoWalletTransferIndexAdd (wallet, transfer);
             cryptoWalletAnnounceTransfer (wallet, transfer, CRYPTO_WALLET_EVENT_TRANSFER_ADDED);
             // Must announce
 
@@ -663,11 +975,14 @@ extern void
 cryptoWalletRemTransfer (BRCryptoWallet wallet, BRCryptoTransfer transfer) {
     BRCryptoTransfer walletTransfer = NULL;
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-        if (CRYPTO_TRUE == cryptoTransferEqual (wallet->transfers[index], transfer)) {
+    BRCryptoTransfer found = cryptoWalletTransferIndexFind (wallet, transfer);
+    for (size_t index = 0; NULL != found && index < array_count(wallet->transfers); index++) {
+        if (found == wallet->transfers[index]) {
             walletTransfer = wallet->transfers[index];
             array_rm (wallet->transfers, index);
-            cryptoWalletAnnounceTransfer (wallet, transfer, CRYPTO_WALLET_EVENT_TRANSFER_DELETED);
+            cryptoWalletTransferIndexRem (wallet, walletTransfer);
+            // Announce the wallet's own transfer; `transfer` may be an equal but distinct object.
+            cryptoWalletAnnounceTransfer (wallet, walletTransfer, CRYPTO_WALLET_EVENT_TRANSFER_DELETED);
             cryptoWalletGenerateEvent (wallet, cryptoWalletEventCreateTransfer (CRYPTO_WALLET_EVENT_TRANSFER_DELETED, transfer));
             cryptoWalletDecBalance (wallet, cryptoWalletGetTransferAmountDirectedNet(wallet, transfer));
             break;
@@ -686,13 +1001,15 @@ cryptoWalletReplaceTransfer (BRCryptoWallet wallet,
     BRCryptoTransfer walletTransfer = NULL;
     
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-        if (oldTransfer == wallet->transfers[index] ||
-            CRYPTO_TRUE == cryptoTransferEqual (wallet->transfers[index], oldTransfer)) {
+    BRCryptoTransfer found = cryptoWalletTransferIndexFind (wallet, oldTransfer);
+    for (size_t index = 0; NULL != found && index < array_count(wallet->transfers); index++) {
+        if (found == wallet->transfers[index]) {
             walletTransfer = wallet->transfers[index];
             wallet->transfers[index] = cryptoTransferTake (newTransfer);
+            cryptoWalletTransferIndexRem (wallet, walletTransfer);
+            cryptoWalletTransferIndexAdd (wallet, newTransfer);
 
-            cryptoWalletAnnounceTransfer (wallet, oldTransfer, CRYPTO_WALLET_EVENT_TRANSFER_DELETED);
+            cryptoWalletAnnounceTransfer (wallet, walletTransfer, CRYPTO_WALLET_EVENT_TRANSFER_DELETED);
             cryptoWalletGenerateEvent (wallet, cryptoWalletEventCreateTransfer (CRYPTO_WALLET_EVENT_TRANSFER_DELETED, oldTransfer));
             cryptoWalletDecBalance (wallet, cryptoWalletGetTransferAmountDirectedNet(wallet, oldTransfer));
 
@@ -710,16 +1027,26 @@ cryptoWalletReplaceTransfer (BRCryptoWallet wallet,
     cryptoTransferGive (newTransfer);
 }
 
-// This is called as the 'transferListener' by BRCryptoTransfer from `cryptoTransferSetState`.  It
-// is a way for a wallet to listen in on transfer changes.
+// This is called as the 'transferListener' by BRCryptoTransfer from `cryptoTransferSetState`, and
+// with a NULL `newState` from `cryptoTransferSetUids`.  It is a way for a wallet to listen in on
+// transfer changes.
 static void
 cryptoWalletUpdTransfer (BRCryptoWallet wallet,
                          BRCryptoTransfer transfer,
                          BRCryptoTransferState newState) {
+    pthread_mutex_lock (&wallet->lock);
+    BRCryptoTransfer found = cryptoWalletTransferIndexFind (wallet, transfer);
+
+    // The transfer's uids has been assigned; an index key, but nothing else changes.
+    if (NULL != found && NULL == newState)
+        cryptoWalletTransferIndexUpdate (wallet, found);
+
     // The transfer's state has changed.  This implies a possible amount/fee change as well as
     // perhaps other wallet changes, such a nonce change.
-    pthread_mutex_lock (&wallet->lock);
-    if (CRYPTO_TRUE == cryptoWalletHasTransferLock (wallet, transfer, false)) {
+    else if (NULL != found) {
+        // The state, and possibly the hash, has changed; these are index keys
+        cryptoWalletTransferIndexUpdate (wallet, found);
+
         switch (newState->type) {
             case CRYPTO_TRANSFER_STATE_CREATED:
             case CRYPTO_TRANSFER_STATE_SIGNED:
@@ -736,7 +1063,7 @@ cryptoWalletUpdTransfer (BRCryptoWallet wallet,
         }
 
         // Announce a 'TRANSFER_CHANGED'; each currency might respond differently.
-        cryptoWalletAnnounceTransfer (wallet, transfer, CRYPTO_WALLET_EVENT_TRANSFER_CHANGED);
+        cryptoWalletAnnounceTransfer (wallet, found, CRYPTO_WALLET_EVENT_TRANSFER_CHANGED);
     }
     pthread_mutex_unlock (&wallet->lock);
 }
@@ -756,15 +1083,40 @@ cryptoWalletGetTransfers (BRCryptoWallet wallet, size_t *count) {
     return transfers;
 }
 
+private_extern BRCryptoTransfer *
+cryptoWalletGetTransfersFromBlockNumber (BRCryptoWallet wallet,
+                                         uint64_t blockNumber,
+                                         size_t *count) {
+    pthread_mutex_lock (&wallet->lock);
+    size_t start = cryptoWalletTransferBlockLowerBound (wallet, blockNumber, 0);
+    *count = array_count (wallet->transfersByBlock) - start;
+    BRCryptoTransfer *transfers = NULL;
+    if (0 != *count) {
+        transfers = calloc (*count, sizeof(BRCryptoTransfer));
+        for (size_t index = 0; index < *count; index++) {
+            transfers[index] = cryptoTransferTake (wallet->transfersByBlock[start + index]->transfer);
+        }
+    }
+    pthread_mutex_unlock (&wallet->lock);
+    return transfers;
+}
+
 private_extern BRCryptoTransfer
 cryptoWalletGetTransferByHash (BRCryptoWallet wallet, BRCryptoHash hashToMatch) {
     BRCryptoTransfer transfer = NULL;
 
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; NULL == transfer && index < array_count(wallet->transfers); index++) {
-        BRCryptoHash hash = cryptoTransferGetHash (wallet->transfers[index]);
+    cryptoWalletTransferIndexSettle (wallet);
+
+    struct BRCryptoWalletTransferEntryRecord key = { NULL };
+    key.hash = hashToMatch;
+
+    for (BRCryptoWalletTransferEntry entry = BRSetGet (wallet->transfersByHash, &key);
+         NULL == transfer && NULL != entry;
+         entry = entry->nextWithHash) {
+        BRCryptoHash hash = cryptoTransferGetHash (entry->transfer);
         if (CRYPTO_TRUE == cryptoHashEqual(hash, hashToMatch))
-            transfer = wallet->transfers[index];
+            transfer = entry->transfer;
         cryptoHashGive(hash);
     }
     pthread_mutex_unlock (&wallet->lock);
@@ -777,11 +1129,13 @@ cryptoWalletGetTransferByUIDS (BRCryptoWallet wallet, const char *uids) {
     BRCryptoTransfer transfer = NULL;
 
     pthread_mutex_lock (&wallet->lock);
-    for (size_t index = 0; NULL == transfer && index < array_count(wallet->transfers); index++) {
-        const char *transferUIDS = wallet->transfers[index]->uids;
-        if (NULL != transferUIDS && 0 == strcmp (transferUIDS, uids))
-            transfer = wallet->transfers[index];
-    }
+
+    struct BRCryptoWalletTransferEntryRecord key = { NULL };
+    key.uids = (char *) uids;
+
+    // A transfer's uids, once assigned, does not change; every entry in the chain matches
+    BRCryptoWalletTransferEntry entry = BRSetGet (wallet->transfersByUids, &key);
+    if (NULL != entry) transfer = entry->transfer;
     pthread_mutex_unlock (&wallet->lock);
 
     return cryptoTransferTake (transfer);
@@ -809,8 +1163,9 @@ cryptoWalletGetTransferByHashOrUIDS (BRCryptoWallet wallet, BRCryptoHash hash, c
     if (NULL == transfer) return NULL;
 
     // 4) If we wanted a UIDS but then transfer doesn't have one, then we are done.  This is a
-    // transfer that we created... and it is waiting for a uids
-    if (NULL != uids && NULL == transfer->uids) return transfer;
+    // transfer that we created... and it is waiting for a uids.  Or it has the uids, assigned while
+    // the transfer was announced to another wallet (one paying the fee), so `wallet` isn't indexed.
+    if (NULL != uids && (NULL == transfer->uids || 0 == strcmp (uids, transfer->uids))) return transfer;
 
     // 5) We are done.
     return NULL;
@@ -838,6 +1193,12 @@ cryptoWalletGetAddressesForRecovery (BRCryptoWallet wallet) {
     return wallet->handlers->getAddressesForRecovery (wallet);
 }
 
+private_extern void
+cryptoWalletDiscoverAddressesForRecovery (BRCryptoWallet wallet) {
+    if (NULL != wallet->handlers->discoverAddressesForRecovery)
+        wallet->handlers->discoverAddressesForRecovery (wallet);
+}
+
 extern BRCryptoFeeBasis
 cryptoWalletGetDefaultFeeBasis (BRCryptoWallet wallet) {
     pthread_mutex_lock (&wallet->lock);
@@ -136,90 +136,141 @@ cryptoWalletManagerReleaseCurrenciesOfInterest (BRCryptoWalletManager cwm,
 #pragma clang diagnostic pop
 #pragma GCC diagnostic pop
 
-static void // not locked; called during manager init
-cryptoWalletManagerInitialTransferBundlesLoad (BRCryptoWalletManager manager) {
-    assert (NULL == manager->bundleTransfers);
+// Bundles are loaded in block order, directly into a sorted array.  Only bundles saved before the
+// file service had a sort key arrive out of order; if so, the array is sorted after the load.
+// Otherwise transfer bundles are recovered as they load, a block at a time.
+typedef struct {
+    BRCryptoWalletManager manager;  // if not NULL, recover each block's bundles as the next one starts
+    BRArrayOf(void*) bundles;
+    size_t count;
+    bool needSort;
+} BRCryptoWalletManagerBundlesLoad;
+
+static void // called with manager->lock
+cryptoWalletManagerInitialTransferBundlesRecoverAll (BRCryptoWalletManager manager,
+                                                     BRArrayOf(BRCryptoClientTransferBundle) bundles) {
+    for (size_t index = 0; index < array_count(bundles); index++) {
+        cryptoWalletManagerRecoverTransferFromTransferBundle (manager, bundles[index]);
+        cryptoClientTransferBundleRelease (bundles[index]);
+    }
+    array_clear (bundles);
+}
+
+static int
+cryptoWalletManagerInitialTransferBundleLoaded (BRFileServiceContext context,
+                                                BRFileService fs,
+                                                void *entity) {
+    BRCryptoWalletManagerBundlesLoad *load = context;
+    BRCryptoClientTransferBundle bundle = entity;
+    BRCryptoClientTransferBundle *bundles = (BRCryptoClientTransferBundle *) load->bundles;
 
-    BRSetOf(BRCryptoClientTransferBundle) bundles = cryptoClientTransferBundleSetCreate (25);
+    // When sorted, a bundle from a later block completes the prior block's bundles.
+    size_t count = array_count (load->bundles);
+    if (NULL != load->manager && count > 0 && bundles[count - 1]->blockNumber != bundle->blockNumber)
+        cryptoWalletManagerInitialTransferBundlesRecoverAll (load->manager,
+                                                             (BRArrayOf(BRCryptoClientTransferBundle)) load->bundles);
+
+    // Within one block, bundles are ordered by their transaction and transfer index.
+    size_t index = array_count (load->bundles);
+    while (index > 0 &&
+           bundles[index - 1]->blockNumber == bundle->blockNumber &&
+           cryptoClientTransferBundleCompare (bundles[index - 1], bundle) > 0)
+        index--;
+
+    if (index > 0 && cryptoClientTransferBundleCompare (bundles[index - 1], bundle) > 0)
+        load->needSort = true;
+
+    array_insert (load->bundles, index, entity);
+    load->count += 1;
+    return 1;
+}
 
-    if (fileServiceHasType (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSFER) &&
-        1 != fileServiceLoad (manager->fileService, bundles, CRYPTO_FILE_SERVICE_TYPE_TRANSFER, 1)) {
+static void // called wtih manager->lock
+cryptoWalletManagerInitialTransferBundlesRecover (BRCryptoWalletManager manager) {
+    if (!fileServiceHasType (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSFER)) return;
+
+    // If sorted, recover the bundles as they load, under the file service's lock; recovering a
+    // transfer bundle does not use the file service.  Otherwise, recover once all are loaded.
+    bool sorted = fileServiceIsSorted (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSFER);
+
+    BRCryptoWalletManagerBundlesLoad load = { (sorted ? manager : NULL), NULL, 0, false };
+    array_new (load.bundles, 25);
+
+    if (1 != fileServiceLoadIterate (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSFER, 1,
+                                     &load, cryptoWalletManagerInitialTransferBundleLoaded)) {
         printf ("CRY: %4s: failed to load transfer bundles",
                 cryptoBlockChainTypeGetCurrencyCode (manager->type));
-        cryptoClientTransferBundleSetRelease(bundles);
+        array_free_all (load.bundles, cryptoClientTransferBundleRelease);
         return;
     }
-    size_t sortedBundlesCount = BRSetCount(bundles);
 
     printf ("CRY: %4s: loaded %4zu transfer bundles\n",
             cryptoBlockChainTypeGetCurrencyCode (manager->type),
-            sortedBundlesCount);
-
-    if (0 != sortedBundlesCount) {
-        array_new (manager->bundleTransfers, sortedBundlesCount);
-        BRSetAll (bundles, (void**) manager->bundleTransfers, sortedBundlesCount);
-        array_set_count (manager->bundleTransfers, sortedBundlesCount);
+            load.count);
 
-        mergesort_brd (manager->bundleTransfers, sortedBundlesCount, sizeof (BRCryptoClientTransferBundle),
+    if (load.needSort)
+        mergesort_brd (load.bundles, array_count (load.bundles), sizeof (BRCryptoClientTransferBundle),
                        cryptoClientTransferBundleCompareForSort);
-    }
 
-    // Don't release the set's bundles
-    BRSetFree(bundles);
+    cryptoWalletManagerInitialTransferBundlesRecoverAll (manager,
+                                                         (BRArrayOf(BRCryptoClientTransferBundle)) load.bundles);
+    array_free (load.bundles);
 }
 
-static void // called wtih manager->lock
-cryptoWalletManagerInitialTransferBundlesRecover (BRCryptoWalletManager manager) {
-    if (NULL != manager->bundleTransfers) {
-        for (size_t index = 0; index < array_count(manager->bundleTransfers); index++) {
-            cryptoWalletManagerRecoverTransferFromTransferBundle (manager, manager->bundleTransfers[index]);
-        }
+static int
+cryptoWalletManagerInitialTransactionBundleLoaded (BRFileServiceContext context,
+                                                   BRFileService fs,
+                                                   void *entity) {
+    BRCryptoWalletManagerBundlesLoad *load = context;
+    BRCryptoClientTransactionBundle bundle = entity;
+    size_t count = array_count (load->bundles);
 
-        array_free_all (manager->bundleTransfers, cryptoClientTransferBundleRelease);
-        manager->bundleTransfers = NULL;
-    }
+    if (count > 0 &&
+        cryptoClientTransactionBundleCompareByBlockheight (load->bundles[count - 1], bundle) > 0)
+        load->needSort = true;
+
+    array_add (load->bundles, entity);
+    return 1;
 }
 
+// Transaction bundles are loaded in full.  A handler may recover them as one batch, which saves to
+// the file service and so can't run as they load, under the file service's lock.
 static void // not locked; called during manager init
 cryptoWalletManagerInitialTransactionBundlesLoad (BRCryptoWalletManager manager) {
     assert (NULL == manager->bundleTransactions);
 
-    BRSetOf(BRCryptoClientTransactionBundle) bundles = cryptoClientTransactionBundleSetCreate (25);
+    BRCryptoWalletManagerBundlesLoad load = { NULL, NULL, 0, false };
+    array_new (load.bundles, 25);
+
     if (fileServiceHasType (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSACTION) &&
-        1 != fileServiceLoad (manager->fileService, bundles, CRYPTO_FILE_SERVICE_TYPE_TRANSACTION, 1)) {
-        cryptoClientTransactionBundleSetRelease (bundles);
+        1 != fileServiceLoadIterate (manager->fileService, CRYPTO_FILE_SERVICE_TYPE_TRANSACTION, 1,
+                                     &load, cryptoWalletManagerInitialTransactionBundleLoaded)) {
+        array_free_all (load.bundles, cryptoClientTransactionBundleRelease);
         printf ("CRY: %4s: failed to load transaction bundles",
                 cryptoBlockChainTypeGetCurrencyCode (manager->type));
         return;
     }
-    size_t sortedBundlesCount = BRSetCount(bundles);
+    size_t sortedBundlesCount = array_count (load.bundles);
 
     printf ("CRY: %4s: loaded %4zu transaction bundles\n",
             cryptoBlockChainTypeGetCurrencyCode (manager->type),
             sortedBundlesCount);
 
-    if (0 != sortedBundlesCount) {
-        BRArrayOf(BRCryptoClientTransactionBundle) sortedBundles;
-        array_new (sortedBundles, sortedBundlesCount);
-        BRSetAll (bundles, (void**) sortedBundles, sortedBundlesCount);
-        array_set_count(sortedBundles, sortedBundlesCount);
+    if (0 == sortedBundlesCount) { array_free (load.bundles); return; }
 
-        mergesort_brd (sortedBundles, sortedBundlesCount, sizeof (BRCryptoClientTransactionBundle),
+    if (load.needSort)
+        mergesort_brd (load.bundles, sortedBundlesCount, sizeof (BRCryptoClientTransactionBundle),
                        cryptoClientTransactionBundleCompareByBlockheightForSort);
 
-        manager->bundleTransactions = sortedBundles;
-    }
-
-    // Don't release the set's bundles
-    BRSetFree(bundles);
+    manager->bundleTransactions = (BRArrayOf(BRCryptoClientTransactionBundle)) load.bundles;
 }
 
 static void // called wtih manager->lock
 cryptoWalletManagerInitialTransactionBundlesRecover (BRCryptoWalletManager manager) {
     if (NULL != manager->bundleTransactions) {
-        for (size_t index = 0; index < array_count(manager->bundleTransactions); index++) {
-            cryptoWalletManagerRecoverTransfersFromTransactionBundle (manager, manager->bundleTransactions[index]);
-        }
+        cryptoWalletManagerRecoverTransfersFromTransactionBundles (manager,
+                                                                   manager->bundleTransactions,
+                                                                   array_count(manager->bundleTransactions));
 
         array_free_all (manager->bundleTransactions, cryptoClientTransactionBundleRelease);
         manager->bundleTransactions = NULL;
@@ -327,14 +378,14 @@ cryptoWalletManagerAllocAndInit (size_t sizeInBytes,
         CRYPTO_WALLET_MANAGER_EVENT_CREATED
     });
 
-    cryptoWalletManagerInitialTransferBundlesLoad (manager);
+    // Transfer bundles are loaded as they are recovered, once the manager is created.
     cryptoWalletManagerInitialTransactionBundlesLoad (manager);
 
     // Create the primary wallet
     manager->wallet = cryptoWalletManagerCreateWalletInitialized (manager,
                                                                   network->currency,
                                                                   manager->bundleTransactions,
-                                                                  manager->bundleTransfers);
+                                                                  NULL);
 
     // Create the P2P manager
     manager->p2pManager = manager->handlers->createP2PManager (manager);
@@ -802,8 +853,11 @@ cryptoWalletManagerWipe (BRCryptoNetwork network,
     const char *currencyName = cryptoBlockChainTypeGetCurrencyCode (cryptoNetworkGetType(network));
     const char *networkName  = cryptoNetworkGetDesc(network);
 
+    const BRCryptoWalletManagerHandlers *handlers = cryptoHandlersLookup (cryptoNetworkGetType (network))->manager;
+
     pthread_mutex_lock (&network->lock);
     fileServiceWipe (path, currencyName, networkName);
+    if (NULL != handlers->wipe) handlers->wipe (path, currencyName, networkName);
     pthread_mutex_unlock (&network->lock);
 }
 
@@ -1189,6 +1243,18 @@ cryptoWalletManagerRecoverTransfersFromTransactionBundle (BRCryptoWalletManager
     cwm->handlers->recoverTransfersFromTransactionBundle (cwm, bundle);
 }
 
+// Recover from all of `bundles` at once, if the handler supports that; otherwise one at a time.
+private_extern void
+cryptoWalletManagerRecoverTransfersFromTransactionBundles (BRCryptoWalletManager cwm,
+                                                           OwnershipKept BRCryptoClientTransactionBundle *bundles,
+                                                           size_t bundlesCount) {
+    if (NULL != cwm->handlers->recoverTransfersFromTransactionBundles)
+        cwm->handlers->recoverTransfersFromTransactionBundles (cwm, bundles, bundlesCount);
+    else
+        for (size_t index = 0; index < bundlesCount; index++)
+            cwm->handlers->recoverTransfersFromTransactionBundle (cwm, bundles[index]);
+}
+
 private_extern void
 cryptoWalletManagerRecoverTransferFromTransferBundle (BRCryptoWalletManager cwm,
                                                       OwnershipKept BRCryptoClientTransferBundle bundle) {
@@ -111,6 +111,11 @@ typedef void
 (*BRCryptoWalletManagerRecoverTransfersFromTransactionBundleHandler) (BRCryptoWalletManager cwm,
                                                                       OwnershipKept BRCryptoClientTransactionBundle bundle);
 
+typedef void
+(*BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler) (BRCryptoWalletManager cwm,
+                                                                       OwnershipKept BRCryptoClientTransactionBundle *bundles,
+                                                                       size_t bundlesCount);
+
 typedef void
 (*BRCryptoWalletManagerRecoverTransferFromTransferBundleHandler) (BRCryptoWalletManager cwm,
                                                                   OwnershipKept BRCryptoClientTransferBundle bundle);
@@ -134,6 +139,11 @@ typedef BRCryptoWalletSweeper
                                                     BRCryptoWallet wallet,
                                                     BRCryptoKey key);
 
+typedef void
+(*BRCryptoWalletManagerWipeHandler) (const char *basePath,
+                                     const char *currency,
+                                     const char *network);
+
 typedef struct {
     BRCryptoWalletManagerCreateHandler create;
     BRCryptoWalletManagerReleaseHandler release;
@@ -148,10 +158,12 @@ typedef struct {
     BRCryptoWalletManagerSaveTransactionBundleHandler saveTransactionBundle;
     BRCryptoWalletManagerSaveTransferBundleHandler    saveTransferBundle;
     BRCryptoWalletManagerRecoverTransfersFromTransactionBundleHandler recoverTransfersFromTransactionBundle;
+    BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler recoverTransfersFromTransactionBundles; // optional
     BRCryptoWalletManagerRecoverTransferFromTransferBundleHandler     recoverTransferFromTransferBundle;
     BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler        recoverFeeBasisFromFeeEstimate;
     BRCryptoWalletManagerWalletSweeperValidateSupportedHandler validateSweeperSupported;
     BRCryptoWalletManagerCreateWalletSweeperHandler createSweeper;
+    BRCryptoWalletManagerWipeHandler wipe; // optional, removes any persistent state kept outside the file service
 } BRCryptoWalletManagerHandlers;
 
 // MARK: - Wallet Manager State
@@ -203,8 +215,7 @@ struct BRCryptoWalletManagerRecord {
     BRCryptoWalletManagerListener listener;
     BRCryptoWalletListener listenerWallet;
 
-    /// The {Transfer,Transaction}Bundle (modifiable)
-    Nullable BRArrayOf(BRCryptoClientTransferBundle) bundleTransfers;
+    /// The TransactionBundle (modifiable)
     Nullable BRArrayOf(BRCryptoClientTransactionBundle) bundleTransactions;
 };
 
@@ -261,6 +272,11 @@ private_extern void
 cryptoWalletManagerRecoverTransfersFromTransactionBundle (BRCryptoWalletManager cwm,
                                                           OwnershipKept BRCryptoClientTransactionBundle bundle);
 
+private_extern void
+cryptoWalletManagerRecoverTransfersFromTransactionBundles (BRCryptoWalletManager cwm,
+                                                           OwnershipKept BRCryptoClientTransactionBundle *bundles,
+                                                           size_t bundlesCount);
+
 // Is it possible that the transfers do not have the 'submitted' state?  In some race between
 // the submit call and the included call?  Highly, highly unlikely but possible?
 private_extern void
@@ -104,6 +104,9 @@ typedef BRCryptoTransfer
 typedef OwnershipGiven BRSetOf(BRCryptoAddress)
 (*BRCryptoWalletGetAddressesForRecoveryHandler) (BRCryptoWallet wallet);
 
+typedef void
+(*BRCryptoWalletDiscoverAddressesForRecoveryHandler) (BRCryptoWallet wallet);
+
 typedef void
 (*BRCryptoWalletAnnounceTransfer) (BRCryptoWallet wallet,
                                    BRCryptoTransfer transfer,
@@ -124,11 +127,15 @@ typedef struct {
     BRCryptoWalletGetAddressesForRecoveryHandler getAddressesForRecovery;
     BRCryptoWalletAnnounceTransfer announceTransfer; // May be NULL
     BRCryptoWalletIsEqualHandler isEqual;
+    BRCryptoWalletDiscoverAddressesForRecoveryHandler discoverAddressesForRecovery; // May be NULL
 } BRCryptoWalletHandlers;
 
 
 // MARK: - Wallet
 
+/// An entry in a wallet's transfer indexes; defined in BRCryptoWallet.c
+typedef struct BRCryptoWalletTransferEntryRecord *BRCryptoWalletTransferEntry;
+
 struct BRCryptoWalletRecord {
     BRCryptoBlockChainType type;
     const BRCryptoWalletHandlers *handlers;
@@ -147,6 +154,18 @@ struct BRCryptoWalletRecord {
     /// The transfers (modifiable)
     BRArrayOf (BRCryptoTransfer) transfers;
 
+    /// Indexes over `transfers`, kept consistent with `transfers` under `lock`.  Entries are found
+    /// by transfer, by hash and by uids.  A transfer's hash and uids can be assigned after it is
+    /// added; `transfersUnhashed` holds the entries indexed without a hash.  An assigned uids is
+    /// announced through the transfer listener, which reindexes the entry.
+    BRSetOf (BRCryptoWalletTransferEntry) transfersByTransfer;
+    BRSetOf (BRCryptoWalletTransferEntry) transfersByHash;
+    BRSetOf (BRCryptoWalletTransferEntry) transfersByUids;
+    BRSetOf (BRCryptoWalletTransferEntry) transfersUnhashed;
+
+    /// The index entries ordered by block number then timestamp; not yet included transfers last.
+    BRArrayOf (BRCryptoWalletTransferEntry) transfersByBlock;
+
     /// The balance (modifiable)
     BRCryptoAmount balance;
     BRCryptoAmount balanceMinimum;
@@ -190,6 +209,13 @@ cryptoWalletGetTransferByUIDS (BRCryptoWallet wallet, const char *identifier);
 private_extern BRCryptoTransfer
 cryptoWalletGetTransferByHashOrUIDS (BRCryptoWallet wallet, BRCryptoHash hash, const char *uids);
 
+/// Return the transfers included in or after `blockNumber`, along with those not yet included,
+/// ordered by block number.  The returned transfers are 'taken'; the returned array is 'calloc'ed.
+private_extern BRCryptoTransfer *
+cryptoWalletGetTransfersFromBlockNumber (BRCryptoWallet wallet,
+                                         uint64_t blockNumber,
+                                         size_t *count);
+
 private_extern void
 cryptoWalletAddTransfer (BRCryptoWallet wallet, BRCryptoTransfer transfer);
 
@@ -208,6 +234,9 @@ cryptoWalletReplaceTransfer (BRCryptoWallet wallet,
 private_extern OwnershipGiven BRSetOf(BRCyptoAddress)
 cryptoWalletGetAddressesForRecovery (BRCryptoWallet wallet);
 
+private_extern void
+cryptoWalletDiscoverAddressesForRecovery (BRCryptoWallet wallet);
+
 private_extern void
 cryptoWalletUpdBalance (BRCryptoWallet wallet, bool needLock);
 
@@ -22,6 +22,7 @@
 #include "bitcoin/BRTransaction.h"
 #include "bitcoin/BRChainParams.h"
 #include "bitcoin/BRPaymentProtocol.h"
+#include "bitcoin/BRHeaderStore.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -257,6 +258,11 @@ extern BRArrayOf(BRTransaction*) initialTransactionsLoadBTC (BRCryptoWalletManag
 extern BRArrayOf(BRPeer)         initialPeersLoadBTC        (BRCryptoWalletManager manager);
 extern BRArrayOf(BRMerkleBlock*) initialBlocksLoadBTC       (BRCryptoWalletManager manager);
 
+/// MARK: - Header Store
+
+extern BRHeaderStore *headerStoreCreateBTC (BRCryptoWalletManager manager);
+extern void           headerStoreWipeBTC   (const char *basePath, const char *currency, const char *network);
+
 #ifdef __cplusplus
 }
 #endif
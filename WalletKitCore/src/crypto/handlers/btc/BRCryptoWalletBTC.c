@@ -11,10 +11,18 @@
 #include "BRCryptoBTC.h"
 
 #include "bitcoin/BRWallet.h"
+#include "support/BROSCompat.h"
 
 #define DEFAULT_FEE_BASIS_SIZE_IN_BYTES     (200)
 #define DEFAULT_TIDS_UNRESOLVED_COUNT         (2)
 
+// The most threads on which to derive the addresses of an account discovery window; fewer are
+// used when fewer processors are online, and windows with few addresses use fewer still.  The
+// addresses are the same for any count.
+#if !defined (CRYPTO_BTC_DISCOVERY_THREAD_COUNT)
+#define CRYPTO_BTC_DISCOVERY_THREAD_COUNT   (4)
+#endif
+
 private_extern BRCryptoWalletBTC
 cryptoWalletCoerceBTC (BRCryptoWallet wallet) {
     assert (CRYPTO_NETWORK_TYPE_BTC == wallet->type ||
@@ -88,6 +96,18 @@ private_extern BRCryptoTransfer
 cryptoWalletFindTransferAsBTC (BRCryptoWallet wallet,
                                BRTransaction *btc) {
     BRCryptoTransfer transfer = NULL;
+
+    // A signed transaction is found by its hash; otherwise search
+    if (!UInt256IsZero (btc->txHash)) {
+        BRCryptoHash hash = cryptoHashCreateAsBTC (btc->txHash);
+        transfer = cryptoWalletGetTransferByHash (wallet, hash);
+        cryptoHashGive (hash);
+
+        if (NULL != transfer && CRYPTO_TRUE == cryptoTransferHasBTC (transfer, btc)) return transfer;
+        cryptoTransferGive (transfer);
+        transfer = NULL;
+    }
+
     pthread_mutex_lock (&wallet->lock);
     for (size_t index = 0; index < array_count(wallet->transfers); index++) {
         if (CRYPTO_TRUE == cryptoTransferHasBTC (wallet->transfers[index], btc)) {
@@ -105,14 +125,13 @@ cryptoWalletFindTransferByHashAsBTC (BRCryptoWallet wallet,
 
     BRCryptoTransferBTC transfer = NULL;
     if (! UInt256IsZero(hash)) {
-        pthread_mutex_lock (&wallet->lock);
-        for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-            transfer = (BRCryptoTransferBTC) wallet->transfers[index];
-            if (UInt256Eq (hash, transfer->tid->txHash))
-                break;
-            transfer = NULL;
-        }
-        pthread_mutex_unlock (&wallet->lock);
+        BRCryptoHash hashToMatch = cryptoHashCreateAsBTC (hash);
+        BRCryptoTransfer found = cryptoWalletGetTransferByHash (wallet, hashToMatch);
+        cryptoHashGive (hashToMatch);
+
+        // The wallet holds a reference; return `found` as borrowed, as before
+        transfer = (NULL == found ? NULL : cryptoTransferCoerceBTC (found));
+        cryptoTransferGive (found);
     }
     return transfer;
 }
@@ -370,6 +389,21 @@ cryptoWalletGetAddressesForRecoveryBTC (BRCryptoWallet wallet) {
     return addresses;
 }
 
+static void
+cryptoWalletDiscoverAddressesForRecoveryBTC (BRCryptoWallet wallet) {
+    BRCryptoWalletBTC walletBTC = cryptoWalletCoerceBTC(wallet);
+    BRWallet *btcWallet = walletBTC->wid;
+
+    // Extend each chain past its last used address by a window that grows with the addresses used
+    // so far.  Each recovery query then covers the whole window, rather than one gap limit's worth
+    // of addresses past the last query's results, and a heavily used wallet is recovered in a
+    // handful of queries.
+    size_t threadCount = thread_count_brd (CRYPTO_BTC_DISCOVERY_THREAD_COUNT);
+
+    BRWalletDiscoverAddrs (btcWallet, SEQUENCE_GAP_LIMIT_EXTERNAL_EXTENDED, SEQUENCE_EXTERNAL_CHAIN, threadCount);
+    BRWalletDiscoverAddrs (btcWallet, SEQUENCE_GAP_LIMIT_INTERNAL_EXTENDED, SEQUENCE_INTERNAL_CHAIN, threadCount);
+}
+
 BRCryptoWalletHandlers cryptoWalletHandlersBTC = {
     cryptoWalletReleaseBTC,
     cryptoWalletGetAddressBTC,
@@ -381,7 +415,8 @@ BRCryptoWalletHandlers cryptoWalletHandlersBTC = {
     cryptoWalletCreateTransferMultipleBTC,
     cryptoWalletGetAddressesForRecoveryBTC,
     NULL,
-    cryptoWalletIsEqualBTC
+    cryptoWalletIsEqualBTC,
+    cryptoWalletDiscoverAddressesForRecoveryBTC
 };
 
 BRCryptoWalletHandlers cryptoWalletHandlersBCH = {
@@ -395,7 +430,8 @@ BRCryptoWalletHandlers cryptoWalletHandlersBCH = {
     cryptoWalletCreateTransferMultipleBTC,
     cryptoWalletGetAddressesForRecoveryBTC,
     NULL,
-    cryptoWalletIsEqualBTC
+    cryptoWalletIsEqualBTC,
+    cryptoWalletDiscoverAddressesForRecoveryBTC
 };
 
 BRCryptoWalletHandlers cryptoWalletHandlersBSV = {
@@ -409,5 +445,6 @@ BRCryptoWalletHandlers cryptoWalletHandlersBSV = {
     cryptoWalletCreateTransferMultipleBTC,
     cryptoWalletGetAddressesForRecoveryBTC,
     NULL,
-    cryptoWalletIsEqualBTC
+    cryptoWalletIsEqualBTC,
+    cryptoWalletDiscoverAddressesForRecoveryBTC
 };
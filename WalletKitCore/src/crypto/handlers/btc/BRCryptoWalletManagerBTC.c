@@ -17,6 +17,16 @@
 #include "crypto/BRCryptoWalletManagerP.h"
 #include "crypto/BRCryptoWalletSweeperP.h"
 
+#include "support/BROSCompat.h"
+
+// The most threads on which to compute a transaction's input signatures, as for large sweeps and
+// consolidations; fewer are used when fewer processors are online.  Signatures are deterministic,
+// so the signed transaction is the same for any count.  Parallel signing is opt-in: the default of
+// 1 signs on the caller's thread alone.
+#if !defined (CRYPTO_BTC_SIGN_THREAD_COUNT)
+#define CRYPTO_BTC_SIGN_THREAD_COUNT        (1)
+#endif
+
 // BRWallet Callbacks
 
 // MARK: - Foward Declarations
@@ -104,7 +114,8 @@ cryptoWalletManagerSignTransactionWithSeedBTC (BRCryptoWalletManager manager,
     BRTransaction *btcTransaction  = cryptoTransferAsBTC (transfer);         // OWN/REF ?
     const BRChainParams *btcParams = cryptoNetworkAsBTC  (manager->network);
 
-    return AS_CRYPTO_BOOLEAN (1 == BRWalletSignTransaction (btcWallet, btcTransaction, btcParams->forkId, seed.u8, sizeof(UInt512)));
+    return AS_CRYPTO_BOOLEAN (1 == BRWalletSignTransactionParallel (btcWallet, btcTransaction, btcParams->forkId, seed.u8, sizeof(UInt512),
+                                                                    thread_count_brd (CRYPTO_BTC_SIGN_THREAD_COUNT)));
 }
 
 static BRCryptoBoolean
@@ -116,7 +127,8 @@ cryptoWalletManagerSignTransactionWithKeyBTC (BRCryptoWalletManager manager,
     BRKey         *btcKey          = cryptoKeyGetCore (key);
     const BRChainParams *btcParams = cryptoNetworkAsBTC  (manager->network);
 
-    return AS_CRYPTO_BOOLEAN (1 == BRTransactionSign (btcTransaction, btcParams->forkId, btcKey, 1));
+    return AS_CRYPTO_BOOLEAN (1 == BRTransactionSignParallel (btcTransaction, btcParams->forkId, btcKey, 1,
+                                                              thread_count_brd (CRYPTO_BTC_SIGN_THREAD_COUNT)));
 }
 
 static BRCryptoAmount
@@ -267,83 +279,110 @@ cryptoWalletManagerSaveTransactionBundleBTC (BRCryptoWalletManager manager,
 }
 
 static void
-cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC (BRCryptoWalletManager manager,
-                                                             OwnershipKept BRCryptoClientTransactionBundle bundle) {
-    BRTransaction *btcTransaction = BRTransactionParse (bundle->serialization, bundle->serializationCount);
+cryptoWalletManagerRecoverTransfersFromTransactionBundlesBTC (BRCryptoWalletManager manager,
+                                                              OwnershipKept BRCryptoClientTransactionBundle *bundles,
+                                                              size_t bundlesCount) {
+    BRWallet *btcWallet = cryptoWalletAsBTC(manager->wallet);
 
-    bool error = CRYPTO_TRANSFER_STATE_ERRORED == bundle->status;
-    bool needRegistration = (!error && NULL != btcTransaction && BRTransactionIsSigned (btcTransaction));
-    bool needFree = true;
+    BRTransaction **btcTransactions = calloc (bundlesCount > 0 ? bundlesCount : 1, sizeof (BRTransaction*));
 
-    BRWallet *btcWallet = cryptoWalletAsBTC(manager->wallet);
+    BRArrayOf(BRTransaction*) btcTransactionsToRegister;
+    array_new (btcTransactionsToRegister, bundlesCount);
 
-    // Convert from `uint64_t` to `uint32_t` with a bit of care regarding BLOCK_HEIGHT_UNBOUND
-    // and TX_UNCONFIRMED - they are directly coercible but be explicit about it.
-    uint32_t btcBlockHeight = (BLOCK_HEIGHT_UNBOUND == bundle->blockHeight ? TX_UNCONFIRMED : (uint32_t) bundle->blockHeight);
-    uint32_t btcTimestamp   = (uint32_t) bundle->timestamp;
-
-
-    //     if (needRegistration) {
-    //         if (0 == pthread_mutex_lock (&manager->lock)) {
-    //             // confirm completion is for in-progress sync
-    //             needRegistration &= (rid == BRClientSyncManagerScanStateGetRequestId (&manager->scanState) && manager->isConnected);
-    //             pthread_mutex_unlock (&manager->lock);
-    //         } else {
-    //             assert (0);
-    //         }
-    //     }
-
-    if (needRegistration) {
-        if (NULL == BRWalletTransactionForHash (btcWallet, btcTransaction->txHash)) {
-            // BRWalletRegisterTransaction doesn't reliably report if the txn was added to the wallet.
-            BRWalletRegisterTransaction (btcWallet, btcTransaction);
-            if (btcTransaction == BRWalletTransactionForHash (btcWallet, btcTransaction->txHash)) {
-                // If our transaction made it into the wallet, do not deallocate it
-                needFree = false;
-            }
+    for (size_t index = 0; index < bundlesCount; index++) {
+        BRCryptoClientTransactionBundle bundle = bundles[index];
+        BRTransaction *btcTransaction = BRTransactionParse (bundle->serialization, bundle->serializationCount);
+
+        bool error = CRYPTO_TRANSFER_STATE_ERRORED == bundle->status;
+        bool needRegistration = (!error && NULL != btcTransaction && BRTransactionIsSigned (btcTransaction));
+
+        btcTransactions[index] = btcTransaction;
+
+        if (needRegistration && NULL == BRWalletTransactionForHash (btcWallet, btcTransaction->txHash)) {
+            // Register with the bundle's blockHeight and timestamp; otherwise every transaction is
+            // first added as unconfirmed and then moved by the BRWalletUpdateTransactions() below.
+            btcTransaction->blockHeight = (BLOCK_HEIGHT_UNBOUND == bundle->blockHeight ? TX_UNCONFIRMED : (uint32_t) bundle->blockHeight);
+            btcTransaction->timestamp   = (uint32_t) bundle->timestamp;
+            array_add (btcTransactionsToRegister, btcTransaction);
         }
     }
 
-    // Check if the wallet knows about transaction.  This is an important check.  If the wallet
-    // does not know about the tranaction then the subsequent BRWalletUpdateTransactions will
-    // free the transaction (with BRTransactionFree()).
-    if (BRWalletContainsTransaction (btcWallet, btcTransaction)) {
-        if (error) {
-            // On an error, remove the transaction.  This will cascade through BRWallet callbacks
-            // to produce `balanceUpdated` and `txDeleted`.  The later will be handled by removing
-            // a BRTransactionWithState from the BRWalletManager.
-            BRWalletRemoveTransaction (btcWallet, btcTransaction->txHash);
+    // Register all the transactions at once.  This extends the wallet's addresses, sorts the
+    // transactions and updates the balance once, rather than once per bundle.
+    BRWalletRegisterTransactions (btcWallet, btcTransactionsToRegister, array_count (btcTransactionsToRegister));
+    array_free (btcTransactionsToRegister);
+
+    // The lowest block height of a transaction added to the wallet.
+    uint32_t btcBlockHeightAdded = TX_UNCONFIRMED;
+
+    for (size_t index = 0; index < bundlesCount; index++) {
+        BRCryptoClientTransactionBundle bundle = bundles[index];
+        BRTransaction *btcTransaction = btcTransactions[index];
+        if (NULL == btcTransaction) continue;
+
+        bool error = CRYPTO_TRANSFER_STATE_ERRORED == bundle->status;
+
+        // BRWalletRegisterTransactions doesn't report which txns were added to the wallet.  If our
+        // transaction made it into the wallet, do not deallocate it
+        bool needFree = (btcTransaction != BRWalletTransactionForHash (btcWallet, btcTransaction->txHash));
+
+        // Convert from `uint64_t` to `uint32_t` with a bit of care regarding BLOCK_HEIGHT_UNBOUND
+        // and TX_UNCONFIRMED - they are directly coercible but be explicit about it.
+        uint32_t btcBlockHeight = (BLOCK_HEIGHT_UNBOUND == bundle->blockHeight ? TX_UNCONFIRMED : (uint32_t) bundle->blockHeight);
+        uint32_t btcTimestamp   = (uint32_t) bundle->timestamp;
+
+        // Check if the wallet knows about transaction.  This is an important check.  If the wallet
+        // does not know about the tranaction then the subsequent BRWalletUpdateTransactions will
+        // free the transaction (with BRTransactionFree()).
+        if (BRWalletContainsTransaction (btcWallet, btcTransaction)) {
+            if (error) {
+                // On an error, remove the transaction.  This will cascade through BRWallet callbacks
+                // to produce `balanceUpdated` and `txDeleted`.  The later will be handled by removing
+                // a BRTransactionWithState from the BRWalletManager.
+                BRWalletRemoveTransaction (btcWallet, btcTransaction->txHash);
+            }
+            else {
+                // If the transaction has transitioned from 'included' back to 'submitted' (like when
+                // there is a blockchain reord), the blockHeight will be TX_UNCONFIRMED and the
+                // timestamp will be 0.  This will cascade through BRWallet callbacks to produce
+                // 'balanceUpdated' and 'txUpdated'.
+                //
+                // If no longer 'included' this might cause dependent transactions to go to 'invalid'.
+                BRWalletUpdateTransactions (btcWallet,
+                                            &btcTransaction->txHash, 1,
+                                            btcBlockHeight,
+                                            btcTimestamp);
+            }
         }
-        else {
-            // If the transaction has transitioned from 'included' back to 'submitted' (like when
-            // there is a blockchain reord), the blockHeight will be TX_UNCONFIRMED and the
-            // timestamp will be 0.  This will cascade through BRWallet callbacks to produce
-            // 'balanceUpdated' and 'txUpdated'.
-            //
-            // If no longer 'included' this might cause dependent transactions to go to 'invalid'.
-            BRWalletUpdateTransactions (btcWallet,
-                                        &btcTransaction->txHash, 1,
-                                        btcBlockHeight,
-                                        btcTimestamp);
+
+        // Free if ownership hasn't been passed
+        if (needFree) {
+            BRTransactionFree (btcTransaction);
         }
-    }
 
-    // Free if ownership hasn't been passed
-    if (needFree) {
-        BRTransactionFree (btcTransaction);
+        else if (TX_UNCONFIRMED != btcBlockHeight && btcBlockHeight < btcBlockHeightAdded)
+            btcBlockHeightAdded = btcBlockHeight;
     }
 
-    // The transaction is in the wallet, this has generated more BRWallet EXTERNAL and INTERNAL
+    free (btcTransactions);
+
+    // The transactions are in the wallet, this has generated more BRWallet EXTERNAL and INTERNAL
     // addresses.  Because the order of bundle arrival is not guaranteed to be by block number,
     // it is possible that some other transaction in the wallet now has inputs or outputs that are
-    // now in BRWallet.  This changes the amount and fee, possibly.  Find those and replace them.
-    else if (TX_UNCONFIRMED != btcBlockHeight) {
-        for (size_t index = 0; index < array_count (manager->wallet->transfers); index++) {
-            BRCryptoTransfer oldTransfer = manager->wallet->transfers[index];
+    // now in BRWallet.  This changes the amount and fee, possibly.  Find those and replace them;
+    // one pass covers every transaction added above.
+    if (TX_UNCONFIRMED != btcBlockHeightAdded) {
+        size_t transfersCount;
+        BRCryptoTransfer *transfers = cryptoWalletGetTransfersFromBlockNumber (manager->wallet,
+                                                                              btcBlockHeightAdded,
+                                                                              &transfersCount);
+
+        for (size_t index = 0; index < transfersCount; index++) {
+            BRCryptoTransfer oldTransfer = transfers[index];
             BRTransaction *tid = cryptoTransferCoerceBTC(oldTransfer)->tid;
 
-            if (TX_UNCONFIRMED   != tid->blockHeight &&
-                tid->blockHeight >= btcBlockHeight   &&
+            if (TX_UNCONFIRMED   != tid->blockHeight  &&
+                tid->blockHeight >= btcBlockHeightAdded &&
                 CRYPTO_TRUE == cryptoTransferChangedAmountBTC (oldTransfer, btcWallet)) {
                 cryptoTransferTake (oldTransfer);
 
@@ -357,10 +396,18 @@ cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC (BRCryptoWalletManag
                 cryptoWalletReplaceTransfer (manager->wallet, oldTransfer, newTransfer);
                 cryptoTransferGive (oldTransfer);
             }
+            cryptoTransferGive (oldTransfer);
         }
+        free (transfers);
     }
 }
 
+static void
+cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC (BRCryptoWalletManager manager,
+                                                             OwnershipKept BRCryptoClientTransactionBundle bundle) {
+    cryptoWalletManagerRecoverTransfersFromTransactionBundlesBTC (manager, &bundle, 1);
+}
+
 static void
 cryptoWalletManagerRecoverTransferFromTransferBundleBTC (BRCryptoWalletManager cwm,
                                                          OwnershipKept BRCryptoClientTransferBundle bundle) {
@@ -670,10 +717,12 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersBTC = {
     cryptoWalletManagerSaveTransactionBundleBTC,
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC,
+    cryptoWalletManagerRecoverTransfersFromTransactionBundlesBTC,
     cryptoWalletManagerRecoverTransferFromTransferBundleBTC,
     NULL,//BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler not supported
     cryptoWalletManagerWalletSweeperValidateSupportedBTC,
-    cryptoWalletManagerCreateWalletSweeperBTC
+    cryptoWalletManagerCreateWalletSweeperBTC,
+    headerStoreWipeBTC
 };
 
 BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersBCH = {
@@ -690,10 +739,12 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersBCH = {
     cryptoWalletManagerSaveTransactionBundleBTC,
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC,
+    cryptoWalletManagerRecoverTransfersFromTransactionBundlesBTC,
     cryptoWalletManagerRecoverTransferFromTransferBundleBTC,
     NULL,//BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler not supported
     cryptoWalletManagerWalletSweeperValidateSupportedBTC,
-    cryptoWalletManagerCreateWalletSweeperBTC
+    cryptoWalletManagerCreateWalletSweeperBTC,
+    headerStoreWipeBTC
 };
 
 BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersBSV = {
@@ -710,8 +761,10 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersBSV = {
     cryptoWalletManagerSaveTransactionBundleBTC,
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleBTC,
+    cryptoWalletManagerRecoverTransfersFromTransactionBundlesBTC,
     cryptoWalletManagerRecoverTransferFromTransferBundleBTC,
     NULL,//BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler not supported
     cryptoWalletManagerWalletSweeperValidateSupportedBTC,
-    cryptoWalletManagerCreateWalletSweeperBTC
+    cryptoWalletManagerCreateWalletSweeperBTC,
+    headerStoreWipeBTC
 };
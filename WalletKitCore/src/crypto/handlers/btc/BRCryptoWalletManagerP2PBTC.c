@@ -34,6 +34,10 @@ typedef struct BRCryptoClientP2PManagerRecordBTC {
     BRCryptoWalletManagerBTC manager;
     BRPeerManager *btcPeerManager;
 
+    // The main chain's headers, persisted as the chain grows; NULL if the store couldn't be opened,
+    // in which case blocks are saved with the file service.
+    BRHeaderStore *headerStore;
+
     // The begining and end blockheight for an ongoing sync.  The end block height will be increased
     // a the blockchain is extended.  The begining block height is used to compute the completion
     // percentage.  These will have values of BLOCK_HEIGHT_UNBOUND when a sync is inactive.
@@ -69,6 +73,7 @@ static void
 cryptoClientP2PManagerReleaseBTC (BRCryptoClientP2PManager baseManager) {
     BRCryptoClientP2PManagerBTC manager = cryptoClientP2PManagerCoerce (baseManager);
     BRPeerManagerFree (manager->btcPeerManager);
+    if (NULL != manager->headerStore) BRHeaderStoreFree (manager->headerStore);
 }
 
 static void
@@ -347,13 +352,17 @@ static void cryptoWalletManagerBTCTxStatusUpdate (void *info) {
 
 static void cryptoWalletManagerBTCSaveBlocks (void *info, int replace, BRMerkleBlock **blocks, size_t count) {
     BRCryptoWalletManagerBTC manager = info;
+    BRCryptoClientP2PManager baseP2P = manager->base.p2pManager;
+
+    // The header store, if there is one, already has the blocks
+    if (NULL != baseP2P && NULL != cryptoClientP2PManagerCoerce (baseP2P)->headerStore) return;
 
     if (replace) {
         fileServiceReplace (manager->base.fileService, fileServiceTypeBlocksBTC, (const void **) blocks, count);
     }
     else {
-        for (size_t index = 0; index < count; index++)
-            fileServiceSave (manager->base.fileService, fileServiceTypeBlocksBTC, blocks[index]);
+        // save all blocks in one DB transaction
+        fileServiceSaveBatch (manager->base.fileService, fileServiceTypeBlocksBTC, (const void **) blocks, count);
     }
 }
 
@@ -362,27 +371,25 @@ static void cryptoWalletManagerBTCSavePeers  (void *info, int replace, const BRP
 
     // filesystem changes are NOT queued; they are acted upon immediately
 
-    if (!replace) {
-        // save each peer, one-by-one
-        for (size_t index = 0; index < count; index++)
-            fileServiceSave (manager->base.fileService, fileServiceTypePeersBTC, &peers[index]);
-    }
-
-    else if (0 == count) {
+    if (replace && 0 == count) {
         // no peers to set, just do a clear
         fileServiceClear (manager->base.fileService, fileServiceTypePeersBTC);
     }
 
-    else {
-        // fileServiceReplace expects an array of pointers to entities, instead of an array of
-        // structures so let's do the conversion here
+    else if (0 != count) {
+        // fileServiceReplace and fileServiceSaveBatch expect an array of pointers to entities,
+        // instead of an array of structures so let's do the conversion here
         const BRPeer **peerRefs = calloc (count, sizeof(BRPeer *));
 
         for (size_t i = 0; i < count; i++) {
             peerRefs[i] = &peers[i];
         }
 
-        fileServiceReplace (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
+        if (replace)
+            fileServiceReplace   (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
+        else
+            fileServiceSaveBatch (manager->base.fileService, fileServiceTypePeersBTC, (const void **) peerRefs, count);
+
         free (peerRefs);
     }
 }
@@ -439,7 +446,11 @@ cryptoWalletManagerCreateP2PManagerBTC (BRCryptoWalletManager manager) {
     BRWallet *btcWallet = cryptoWalletAsBTC(manager->wallet);
     uint32_t btcEarliestKeyTime = (uint32_t) cryptoAccountGetTimestamp(manager->account);
 
-    BRArrayOf(BRMerkleBlock*) blocks = initialBlocksLoadBTC (manager);
+    BRHeaderStore            *store  = headerStoreCreateBTC (manager);
+    // Blocks saved with the file service are only needed until the header store has the chain
+    BRArrayOf(BRMerkleBlock*) blocks = (NULL == store || 0 == BRHeaderStoreCount (store)
+                                        ? initialBlocksLoadBTC (manager)
+                                        : NULL);
     BRArrayOf(BRPeer)         peers  = initialPeersLoadBTC  (manager);
 
     p2pManagerBTC->begBlockHeight = BLOCK_HEIGHT_UNBOUND;
@@ -455,6 +466,19 @@ cryptoWalletManagerCreateP2PManagerBTC (BRCryptoWalletManager manager) {
 
     assert (NULL != p2pManagerBTC->btcPeerManager);
 
+    p2pManagerBTC->headerStore = store;
+    if (NULL != store) {
+        BRPeerManagerSetHeaderStore (p2pManagerBTC->btcPeerManager, store);
+
+        // The store now has the chain loaded from the file service's blocks, but those only go once the store
+        // holds it through the last block, flushed to disk.  Headers the store fails to append, or ones dropped
+        // as invalid, leave the file service's blocks in place to load again on the next start.
+        if (NULL != blocks &&
+            BRHeaderStoreLastHeight (store) == BRPeerManagerLastBlockHeight (p2pManagerBTC->btcPeerManager) &&
+            BRHeaderStoreSync (store))
+            fileServiceClear (manager->fileService, fileServiceTypeBlocksBTC);
+    }
+
     BRPeerManagerSetCallbacks (p2pManagerBTC->btcPeerManager,
                                cryptoWalletManagerCoerceBTC (manager, p2pManager->type),
                                cryptoWalletManagerBTCSyncStarted,
@@ -190,6 +190,53 @@ initialBlocksLoadBTC (BRCryptoWalletManager manager) {
     return blocks;
 }
 
+/// MARK: - Header Store
+
+// The main chain's block headers are kept in a memory-mapped file alongside the file service's
+// database, rather than as file service entities, so that they can be appended to as the chain
+// grows and read back without parsing every block at startup.
+
+#define HEADER_STORE_FILENAME       "headers"
+
+static char *
+headerStorePathCreateBTC (const char *basePath,
+                          const char *currency,
+                          const char *network) {
+    size_t pathLength = strlen (basePath) + 1 + strlen (currency) + 1 + strlen (network) + 1 + strlen (HEADER_STORE_FILENAME) + 1;
+    char  *path       = malloc (pathLength);
+    snprintf (path, pathLength, "%s/%s-%s-%s", basePath, currency, network, HEADER_STORE_FILENAME);
+    return path;
+}
+
+extern BRHeaderStore *
+headerStoreCreateBTC (BRCryptoWalletManager manager) {
+    char *path = headerStorePathCreateBTC (manager->path,
+                                           cryptoBlockChainTypeGetCurrencyCode (manager->type),
+                                           cryptoNetworkGetDesc (manager->network));
+    BRHeaderStore *store = BRHeaderStoreNew (path);
+
+    if (NULL == store)
+        _peer_log ("BWM: %4s: failed to open header store %s\n",
+                   cryptoBlockChainTypeGetCurrencyCode (manager->type),
+                   path);
+    else
+        _peer_log ("BWM: %4s: loaded %4zu headers\n",
+                   cryptoBlockChainTypeGetCurrencyCode (manager->type),
+                   BRHeaderStoreCount (store));
+
+    free (path);
+    return store;
+}
+
+extern void
+headerStoreWipeBTC (const char *basePath,
+                    const char *currency,
+                    const char *network) {
+    char *path = headerStorePathCreateBTC (basePath, currency, network);
+    remove (path);
+    free (path);
+}
+
 /// MARK: - Peer File Service
 
 #define FILE_SERVICE_TYPE_PEER        "peers"
@@ -115,6 +115,12 @@ typedef struct BRCryptoWalletETHRecord {
     BREthereumAccount ethAccount;
     BREthereumToken   ethToken;    // NULL if `ETH`
     BREthereumGas     ethGasLimit;
+
+    // The assigned nonces of outbound, non-errored transfers, one record per transfer, as a
+    // max-heap; and those same records by transfer.  Maintained on `announceTransfer`, under the
+    // wallet's lock, and only for the `ETH` wallet; token wallets don't own the account's nonce.
+    BRArrayOf(struct BRCryptoWalletNonceETHRecord *) nonces;
+    BRSet *noncesByTransfer;
 } *BRCryptoWalletETH;
 
 extern BRCryptoWalletETH
@@ -145,6 +151,14 @@ extern BRCryptoTransferETH
 cryptoWalletLookupTransferByOriginatingHash (BRCryptoWalletETH wallet,
                                              BREthereumHash hash);
 
+/// Fill `gaps` with up to `gapsCount` nonces, below the wallet's largest assigned nonce, that no
+/// outbound, non-errored transfer holds.  Returns the number of such nonces, which may exceed
+/// `gapsCount`; pass `gaps` as NULL to just count.  A gap is typically a stuck transaction.
+extern size_t
+cryptoWalletGetNonceGapsETH (BRCryptoWallet wallet,
+                             uint64_t *gaps,
+                             size_t gapsCount);
+
 // MARK: - Wallet Manager
 
 typedef struct BRCryptoWalletManagerETHRecord {
@@ -22,6 +22,94 @@ cryptoWalletCoerce (BRCryptoWallet wallet) {
     return (BRCryptoWalletETH) wallet;
 }
 
+// MARK: - Wallet Nonces
+
+/// The nonce a transfer contributes to `BRCryptoWalletETH.nonces`
+typedef struct BRCryptoWalletNonceETHRecord {
+    BRCryptoTransfer transfer;
+    uint64_t nonce;
+    size_t index;       // the record's position in `BRCryptoWalletETH.nonces`
+} BRCryptoWalletNonceETH;
+
+static size_t
+cryptoWalletNonceHashValueETH (const void *record) {
+    return (size_t) ((const BRCryptoWalletNonceETH *) record)->transfer;
+}
+
+static int
+cryptoWalletNonceIsEqualETH (const void *record1, const void *record2) {
+    return ((const BRCryptoWalletNonceETH *) record1)->transfer == ((const BRCryptoWalletNonceETH *) record2)->transfer;
+}
+
+static int
+cryptoWalletNonceCompareETH (const void *nonce1, const void *nonce2) {
+    uint64_t n1 = *(const uint64_t *) nonce1;
+    uint64_t n2 = *(const uint64_t *) nonce2;
+    return (n1 < n2 ? -1 : (n1 > n2 ? 1 : 0));
+}
+
+static void
+cryptoWalletNoncesSwapETH (BRCryptoWalletETH walletETH,
+                           size_t index1,
+                           size_t index2) {
+    BRCryptoWalletNonceETH *record = walletETH->nonces[index1];
+
+    walletETH->nonces[index1] = walletETH->nonces[index2];
+    walletETH->nonces[index1]->index = index1;
+
+    walletETH->nonces[index2] = record;
+    walletETH->nonces[index2]->index = index2;
+}
+
+/// Restore the max-heap order of `walletETH->nonces` about the record at `index`, which may need
+/// to move either up or down.
+static void
+cryptoWalletNoncesSiftETH (BRCryptoWalletETH walletETH,
+                           size_t index) {
+    BRCryptoWalletNonceETH **nonces = walletETH->nonces;
+    size_t count = array_count (nonces);
+
+    while (index > 0 && nonces[(index - 1) / 2]->nonce < nonces[index]->nonce) {
+        cryptoWalletNoncesSwapETH (walletETH, index, (index - 1) / 2);
+        index = (index - 1) / 2;
+    }
+
+    while (true) {
+        size_t largest = index, left = 2 * index + 1, right = left + 1;
+
+        if (left  < count && nonces[left]->nonce  > nonces[largest]->nonce) largest = left;
+        if (right < count && nonces[right]->nonce > nonces[largest]->nonce) largest = right;
+        if (largest == index) break;
+
+        cryptoWalletNoncesSwapETH (walletETH, index, largest);
+        index = largest;
+    }
+}
+
+static void
+cryptoWalletNoncesAddETH (BRCryptoWalletETH walletETH,
+                          BRCryptoWalletNonceETH *record) {
+    record->index = array_count (walletETH->nonces);
+    array_add (walletETH->nonces, record);
+    cryptoWalletNoncesSiftETH (walletETH, record->index);
+}
+
+static void
+cryptoWalletNoncesRemETH (BRCryptoWalletETH walletETH,
+                          BRCryptoWalletNonceETH *record) {
+    size_t index = record->index;
+    size_t last  = array_count (walletETH->nonces) - 1;
+
+    assert (index <= last && record == walletETH->nonces[index]);
+
+    // Fill the hole with the last record, which then finds its place from there.
+    if (index != last) cryptoWalletNoncesSwapETH (walletETH, index, last);
+    array_rm_last (walletETH->nonces);
+    if (index != last) cryptoWalletNoncesSiftETH (walletETH, index);
+}
+
+// MARK: - Wallet
+
 typedef struct {
     BREthereumAccount ethAccount;
     BREthereumToken   ethToken;
@@ -37,6 +125,9 @@ cryptoWalletCreateCallbackETH (BRCryptoWalletCreateContext context,
     walletETH->ethAccount  = contextETH->ethAccount;
     walletETH->ethToken    = contextETH->ethToken;
     walletETH->ethGasLimit = contextETH->ethGasLimit;
+
+    array_new (walletETH->nonces, 10);
+    walletETH->noncesByTransfer = BRSetNew (cryptoWalletNonceHashValueETH, cryptoWalletNonceIsEqualETH, 10);
 }
 
 private_extern BRCryptoWallet
@@ -77,6 +168,10 @@ cryptoWalletCreateAsETH (BRCryptoWalletListener listener,
 
 static void
 cryptoWalletReleaseETH (BRCryptoWallet wallet) {
+    BRCryptoWalletETH walletETH = cryptoWalletCoerce (wallet);
+
+    array_free (walletETH->nonces);
+    BRSetFreeAll (walletETH->noncesByTransfer, free);
 }
 
 
@@ -285,28 +380,74 @@ cryptoWalletAnnounceTransferETH (BRCryptoWallet wallet,
     // We are only interested in updating the accounts nonce; therefore token wallets are ignored.
     if (NULL != walletETH->ethToken) return;
 
-    uint64_t nonce = TRANSACTION_NONCE_IS_NOT_ASSIGNED;
+    // Withdraw any nonce that `transfer` contributed; its nonce or state may have since changed.
+    BRCryptoWalletNonceETH key = { transfer, 0 };
+    BRCryptoWalletNonceETH *record = BRSetRemove (walletETH->noncesByTransfer, &key);
+
+    if (NULL != record) {
+        cryptoWalletNoncesRemETH (walletETH, record);
+        free (record);
+    }
 
-    // Ignore `type`; just iterate over all transfers.
-    for (size_t index = 0; index < array_count(wallet->transfers); index++) {
-        BRCryptoTransferETH transferETH = cryptoTransferCoerceETH (wallet->transfers[index]);
+    if (CRYPTO_WALLET_EVENT_TRANSFER_DELETED != type) {
+        BRCryptoTransferETH transferETH = cryptoTransferCoerceETH (transfer);
         uint64_t transferNonce = cryptoTransferGetNonceETH(transferETH);
 
         if (CRYPTO_TRANSFER_RECEIVED          != transferETH->base.direction &&
             TRANSACTION_NONCE_IS_NOT_ASSIGNED != transferNonce               &&
-            CRYPTO_TRANSFER_STATE_ERRORED     != cryptoTransferGetStateType (wallet->transfers[index]))
-            // Assign the nonce as the MAX.
-            nonce = (TRANSACTION_NONCE_IS_NOT_ASSIGNED == nonce
-                     ? transferNonce
-                     : MAX (nonce, transferNonce));
+            CRYPTO_TRANSFER_STATE_ERRORED     != cryptoTransferGetStateType (transfer)) {
+            record = malloc (sizeof (BRCryptoWalletNonceETH));
+            record->transfer = transfer;
+            record->nonce    = transferNonce;
+
+            BRSetAdd (walletETH->noncesByTransfer, record);
+            cryptoWalletNoncesAddETH (walletETH, record);
+        }
     }
 
+    // The account's next nonce follows the MAX assigned nonce, atop the heap.
+    size_t noncesCount = array_count (walletETH->nonces);
+
     ethAccountSetAddressNonce (walletETH->ethAccount,
                                ethAccountGetPrimaryAddress(walletETH->ethAccount),
-                               (TRANSACTION_NONCE_IS_NOT_ASSIGNED == nonce ? 0 : (nonce + 1)),
+                               (0 == noncesCount ? 0 : (walletETH->nonces[0]->nonce + 1)),
                                ETHEREUM_BOOLEAN_TRUE);
 }
 
+extern size_t
+cryptoWalletGetNonceGapsETH (BRCryptoWallet wallet,
+                             uint64_t *gaps,
+                             size_t gapsCount) {
+    BRCryptoWalletETH walletETH = cryptoWalletCoerce (wallet);
+    size_t total = 0;
+
+    pthread_mutex_lock (&wallet->lock);
+    size_t noncesCount = array_count (walletETH->nonces);
+    uint64_t *nonces = malloc ((0 == noncesCount ? 1 : noncesCount) * sizeof (uint64_t));
+
+    // The heap holds the nonces in no useful order; gaps need them sorted.
+    for (size_t index = 0; index < noncesCount; index++)
+        nonces[index] = walletETH->nonces[index]->nonce;
+    pthread_mutex_unlock (&wallet->lock);
+
+    qsort (nonces, noncesCount, sizeof (uint64_t), cryptoWalletNonceCompareETH);
+
+    uint64_t expected = 0;
+    for (size_t index = 0; index < noncesCount; index++) {
+        uint64_t nonce = nonces[index];
+
+        for (; expected < nonce && NULL != gaps && total < gapsCount; expected++)
+            gaps[total++] = expected;
+
+        // Count, but don't enumerate, any gaps beyond `gapsCount`
+        if (expected < nonce) total += (size_t) (nonce - expected);
+        if (expected <= nonce) expected = nonce + 1;
+    }
+    free (nonces);
+
+    return total;
+}
+
 static bool
 cryptoWalletIsEqualETH (BRCryptoWallet wb1, BRCryptoWallet wb2) {
     return wb1 == wb2;
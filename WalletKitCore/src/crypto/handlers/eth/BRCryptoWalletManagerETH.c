@@ -1016,6 +1016,7 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersETH = {
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleETH,
+    NULL, // BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler
     cryptoWalletManagerRecoverTransferFromTransferBundleETH,
     cryptoWalletManagerRecoverFeeBasisFromFeeEstimateETH,
     NULL,//BRCryptoWalletManagerWalletSweeperValidateSupportedHandler not supported
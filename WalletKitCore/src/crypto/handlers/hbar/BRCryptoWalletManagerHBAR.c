@@ -305,6 +305,7 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersHBAR = {
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleHBAR,
+    NULL, // BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler
     cryptoWalletManagerRecoverTransferFromTransferBundleHBAR,
     NULL,//BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler not supported
     cryptoWalletManagerWalletSweeperValidateSupportedHBAR,
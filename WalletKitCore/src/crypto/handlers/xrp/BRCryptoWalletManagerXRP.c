@@ -306,6 +306,7 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersXRP = {
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleXRP,
+    NULL, // BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler
     cryptoWalletManagerRecoverTransferFromTransferBundleXRP,
     NULL,//BRCryptoWalletManagerRecoverFeeBasisFromFeeEstimateHandler not supported
     cryptoWalletManagerWalletSweeperValidateSupportedXRP,
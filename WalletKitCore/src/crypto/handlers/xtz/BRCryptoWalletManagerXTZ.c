@@ -363,6 +363,7 @@ BRCryptoWalletManagerHandlers cryptoWalletManagerHandlersXTZ = {
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     NULL, // BRCryptoWalletManagerSaveTransactionBundleHandler
     cryptoWalletManagerRecoverTransfersFromTransactionBundleXTZ,
+    NULL, // BRCryptoWalletManagerRecoverTransfersFromTransactionBundlesHandler
     cryptoWalletManagerRecoverTransferFromTransferBundleXTZ,
     cryptoWalletManagerRecoverFeeBasisFromFeeEstimateXTZ,
     cryptoWalletManagerWalletSweeperValidateSupportedXTZ,
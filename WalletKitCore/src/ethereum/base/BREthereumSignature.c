@@ -86,6 +86,64 @@ ethSignatureCreate(BREthereumSignatureType type,
     return signature;
 }
 
+extern void
+ethSignatureExtractAddresses (const BREthereumSignature *signatures,
+                              const uint8_t **bytes,
+                              const size_t *bytesCounts,
+                              size_t count,
+                              size_t threadCount,
+                              BREthereumAddress *addresses,
+                              int *successes) {
+    if (0 == count) return;
+
+    UInt256    *digests = malloc (count * sizeof (UInt256));
+    BRKey      *keys    = calloc (count, sizeof (BRKey));
+    const void **sigs   = malloc (count * sizeof (void*));
+    size_t     *indices = malloc (count * sizeof (size_t));
+    int        *results = malloc (count * sizeof (int));
+
+    // Each signature type has its own compact encoding; recover each type's keys as one batch.
+    BREthereumSignatureType types[] = { SIGNATURE_TYPE_RECOVERABLE_VRS_EIP, SIGNATURE_TYPE_RECOVERABLE_RSV };
+
+    for (size_t t = 0; t < sizeof (types) / sizeof (types[0]); t++) {
+        size_t typeCount = 0;
+
+        for (size_t index = 0; index < count; index++)
+            if (types[t] == signatures[index].type) {
+                BRKeccak256 (&digests[typeCount], bytes[index], bytesCounts[index]);
+                sigs[typeCount]    = (SIGNATURE_TYPE_RECOVERABLE_VRS_EIP == types[t]
+                                      ? (const void *) &signatures[index].sig.vrs
+                                      : (const void *) &signatures[index].sig.rsv);
+                indices[typeCount] = index;
+                typeCount += 1;
+            }
+
+        if (0 == typeCount) continue;
+
+        switch (types[t]) {
+            case SIGNATURE_TYPE_RECOVERABLE_VRS_EIP:
+                BRKeyRecoverPubKeyBatch (keys, digests, sigs, typeCount, results, threadCount);
+                break;
+            case SIGNATURE_TYPE_RECOVERABLE_RSV:
+                BRKeyRecoverPubKeyEthereumBatch (keys, digests, sigs, typeCount, results, threadCount);
+                break;
+        }
+
+        for (size_t index = 0; index < typeCount; index++) {
+            successes[indices[index]] = results[index];
+            addresses[indices[index]] = (0 == results[index]
+                                         ? (BREthereumAddress) EMPTY_ADDRESS_INIT
+                                         : ethAddressCreateKey (&keys[index]));
+        }
+    }
+
+    free (results);
+    free (indices);
+    free (sigs);
+    free (keys);
+    free (digests);
+}
+
 extern BREthereumBoolean
 ethSignatureEqual (BREthereumSignature s1, BREthereumSignature s2) {
     return (s1.type == s2.type &&
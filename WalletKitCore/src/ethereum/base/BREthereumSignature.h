@@ -92,6 +92,20 @@ ethSignatureExtractAddress (const BREthereumSignature signature,
                             size_t bytesCount,
                             int *success);
 
+/**
+ * Extract the addresses for `count` signatures, each of `bytes[i]`, as if by
+ * `ethSignatureExtractAddress()`.  The public keys are recovered as a batch, on up to
+ * `threadCount` threads including the caller's.
+ */
+extern void
+ethSignatureExtractAddresses (const BREthereumSignature *signatures,
+                              const uint8_t **bytes,
+                              const size_t *bytesCounts,
+                              size_t count,
+                              size_t threadCount,
+                              BREthereumAddress *addresses,
+                              int *successes);
+
 extern BREthereumBoolean
 ethSignatureEqual (BREthereumSignature s1, BREthereumSignature s2);
 
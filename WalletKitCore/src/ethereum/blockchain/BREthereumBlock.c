@@ -946,18 +946,7 @@ blockTransactionsRlpDecode (BRRlpItem item,
     size_t itemsCount = 0;
     const BRRlpItem *items = rlpDecodeList(coder, item, &itemsCount);
 
-    BRArrayOf(BREthereumTransaction) transactions;
-    array_new(transactions, itemsCount);
-
-    for (int i = 0; i < itemsCount; i++) {
-        BREthereumTransaction transaction = transactionRlpDecode(items[i],
-                                                                     network,
-                                                                     type,
-                                                                     coder);
-        array_add (transactions, transaction);
-    }
-
-    return transactions;
+    return transactionsRlpDecode (items, itemsCount, network, type, coder);
 }
 
 static BRRlpItem
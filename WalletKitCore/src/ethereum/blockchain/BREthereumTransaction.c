@@ -11,12 +11,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include "support/BROSCompat.h"
 #include "BREthereumTransaction.h"
 
 // #define TRANSACTION_LOG_ALLOC_COUNT
 
 #define MAX(a,b) ((a) > (b) ? (a) : (b))
 
+// The most threads, including the caller's, used by `transactionsRlpDecode()` to recover the
+// transactions' source addresses; fewer are used when fewer processors are online.  Fanning out
+// is optional: the default of 1 recovers on the caller's thread alone.
+#if !defined (ETHEREUM_SIGNATURE_RECOVERY_THREAD_COUNT)
+#define ETHEREUM_SIGNATURE_RECOVERY_THREAD_COUNT      (1)
+#endif
+
 #if defined (TRANSACTION_LOG_ALLOC_COUNT)
 static unsigned int transactionAllocCount = 0;
 #endif
@@ -404,11 +412,12 @@ transactionRlpEncode(BREthereumTransaction transaction,
 //
 // Tranaction RLP Decode
 //
-extern BREthereumTransaction
-transactionRlpDecode (BRRlpItem item,
-                      BREthereumNetwork network,
-                      BREthereumRlpType type,
-                      BRRlpCoder coder) {
+static BREthereumTransaction
+transactionRlpDecodeInternal (BRRlpItem item,
+                              BREthereumNetwork network,
+                              BREthereumRlpType type,
+                              BRRlpCoder coder,
+                              BREthereumBoolean extractAddress) {
     
     BREthereumTransaction transaction = calloc (1, sizeof(struct BREthereumTransactionRecord));
     
@@ -477,7 +486,8 @@ transactionRlpDecode (BRRlpItem item,
             transaction->hash = ethHashCreateFromData(result);
 
             // :fingers-crossed:
-            transaction->sourceAddress = transactionExtractAddress (transaction, network, coder);
+            if (ETHEREUM_BOOLEAN_IS_TRUE (extractAddress))
+                transaction->sourceAddress = transactionExtractAddress (transaction, network, coder);
             break;
         }
 
@@ -490,6 +500,74 @@ transactionRlpDecode (BRRlpItem item,
     return transaction;
 }
 
+extern BREthereumTransaction
+transactionRlpDecode (BRRlpItem item,
+                      BREthereumNetwork network,
+                      BREthereumRlpType type,
+                      BRRlpCoder coder) {
+    return transactionRlpDecodeInternal (item, network, type, coder, ETHEREUM_BOOLEAN_TRUE);
+}
+
+extern BRArrayOf(BREthereumTransaction)
+transactionsRlpDecode (const BRRlpItem *items,
+                       size_t itemsCount,
+                       BREthereumNetwork network,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder) {
+    BRArrayOf(BREthereumTransaction) transactions;
+    array_new (transactions, itemsCount);
+
+    for (size_t index = 0; index < itemsCount; index++)
+        array_add (transactions, transactionRlpDecodeInternal (items[index], network, type, coder, ETHEREUM_BOOLEAN_FALSE));
+
+    if (RLP_TYPE_TRANSACTION_SIGNED != type || 0 == itemsCount) return transactions;
+
+    // Extract the source addresses, as `transactionRlpDecode()` does, but with one batch of
+    // signature recoveries for all the signed transactions.
+    BREthereumTransaction *signedTransactions = malloc (itemsCount * sizeof (BREthereumTransaction));
+    BREthereumSignature   *signatures         = malloc (itemsCount * sizeof (BREthereumSignature));
+    BRRlpItem             *unsignedItems      = malloc (itemsCount * sizeof (BRRlpItem));
+    BRRlpData             *unsignedData       = malloc (itemsCount * sizeof (BRRlpData));
+    const uint8_t        **bytes              = malloc (itemsCount * sizeof (uint8_t*));
+    size_t                *bytesCounts        = malloc (itemsCount * sizeof (size_t));
+    BREthereumAddress     *addresses          = malloc (itemsCount * sizeof (BREthereumAddress));
+    int                   *successes          = malloc (itemsCount * sizeof (int));
+    size_t signedCount = 0;
+
+    for (size_t index = 0; index < itemsCount; index++) {
+        BREthereumTransaction transaction = transactions[index];
+        if (ETHEREUM_BOOLEAN_IS_FALSE (transactionIsSigned (transaction))) continue;
+
+        signedTransactions[signedCount] = transaction;
+        signatures[signedCount]         = transaction->signature;
+        unsignedItems[signedCount]      = transactionRlpEncode (transaction, network, RLP_TYPE_TRANSACTION_UNSIGNED, coder);
+        unsignedData[signedCount]       = rlpItemGetDataSharedDontRelease (coder, unsignedItems[signedCount]);
+        bytes[signedCount]              = unsignedData[signedCount].bytes;
+        bytesCounts[signedCount]        = unsignedData[signedCount].bytesCount;
+        signedCount += 1;
+    }
+
+    ethSignatureExtractAddresses (signatures, bytes, bytesCounts, signedCount,
+                                  thread_count_brd (ETHEREUM_SIGNATURE_RECOVERY_THREAD_COUNT),
+                                  addresses, successes);
+
+    for (size_t index = 0; index < signedCount; index++) {
+        signedTransactions[index]->sourceAddress = addresses[index];
+        rlpItemRelease (coder, unsignedItems[index]);
+    }
+
+    free (successes);
+    free (addresses);
+    free (bytesCounts);
+    free (bytes);
+    free (unsignedData);
+    free (unsignedItems);
+    free (signatures);
+    free (signedTransactions);
+
+    return transactions;
+}
+
 extern BRRlpData
 transactionGetRlpData (BREthereumTransaction transaction,
                        BREthereumNetwork network,
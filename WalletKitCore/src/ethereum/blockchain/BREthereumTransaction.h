@@ -184,6 +184,17 @@ transactionRlpDecode (BRRlpItem item,
                       BREthereumRlpType type,
                       BRRlpCoder coder);
 
+/**
+ * RLP decode `itemsCount` transactions as if by `transactionRlpDecode()`.  For a signed type,
+ * the source addresses are recovered from the signatures as one batch.
+ */
+extern BRArrayOf(BREthereumTransaction)
+transactionsRlpDecode (const BRRlpItem *items,
+                       size_t itemsCount,
+                       BREthereumNetwork network,
+                       BREthereumRlpType type,
+                       BRRlpCoder coder);
+
 /**
  * RLP encode transaction for the provided network with the specified type.  Different networks
  * have different RLP encodings - notably the network's chainId is part of the encoding.
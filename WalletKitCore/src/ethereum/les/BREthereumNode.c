@@ -2155,7 +2155,7 @@ nodeRecv (BREthereumNode node,
 
             // Actual body
             BRRlpData data = { headerCount - 1, &bytes[1] };
-            BRRlpItem item = rlpDataGetItem (node->coder.rlp, data);
+            BRRlpItem item = rlpDataGetItemView (node->coder.rlp, data);
 
 #if defined (NEED_TO_PRINT_SEND_RECV_DATA)
             eth_log (LES_LOG_TOPIC, "Size: Recv: TCP: Type: %u, Subtype: %d", type, subtype);
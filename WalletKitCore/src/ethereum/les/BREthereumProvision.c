@@ -350,7 +350,7 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
 
                     if (ETHEREUM_BOOLEAN_IS_TRUE (isValid)) {
                         // When valid extract [hash, totalDifficulty] from the MPT proof's value
-                        BRRlpItem item = rlpDataGetItem(coder, data);
+                        BRRlpItem item = rlpDataGetItemView (coder, data);
 
                         size_t itemsCount = 0;
                         const BRRlpItem *items = rlpDecodeList (coder, item, &itemsCount);
@@ -453,7 +453,7 @@ provisionHandleMessageLES (BREthereumProvision *provisionMulti,
                     BREthereumBoolean foundValue = ETHEREUM_BOOLEAN_FALSE;
                     BRRlpData data = mptNodePathGetValue (path, key, &foundValue);
                     if (ETHEREUM_BOOLEAN_IS_TRUE(foundValue)) {
-                        BRRlpItem item = rlpDataGetItem (coder, data);
+                        BRRlpItem item = rlpDataGetItemView (coder, data);
                         provisionAccounts[offset + index] = accountStateRlpDecode (item, coder);
                         rlpItemRelease (coder, item);
                     }
@@ -258,7 +258,7 @@ mptNodePathDecodeFromBytes (BRRlpItem item,
         // items[index] holds bytes as the RLP encoding of MPT nodes.  We'll decode the bytes
         // and then RLP encode the bytes (but this time as RLP items.... got it??).
         BRRlpData data = rlpDecodeBytesSharedDontRelease (coder, items[index]);
-        BRRlpItem item = rlpDataGetItem(coder, data);
+        BRRlpItem item = rlpDataGetItemView (coder, data);
         array_add (nodes, mptNodeDecode (item, coder));
 #if defined (MPT_SHOW_PROOF_NODES)
         rlpShowItem (coder, item, "MPTN");
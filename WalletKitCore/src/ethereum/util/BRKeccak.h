@@ -5,12 +5,6 @@
 //  Created by Lamont Samuels on 7/19/18.
 //  Copyright © 2018-2019 Breadwinner AG.  All rights reserved.
 //
-//  *****LICENSE DISCLAIMER*****
-//  The original code was written by Andrey Jivsov
-//  @cite :  Andrey Jivsov crypto@brainhub.org  Aug 2015
-//  License : Released in the Public Domain
-//  *********************
-//
 //  See the LICENSE file at the project root for license information.
 //  See the CONTRIBUTORS file at the project root for a list of contributors.
 
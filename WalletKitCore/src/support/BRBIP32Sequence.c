@@ -25,6 +25,7 @@
 #include "BRBIP32Sequence.h"
 #include "BRCrypto.h"
 #include "BRBase58.h"
+#include <stdlib.h>
 #include <string.h>
 #include <assert.h>
 
@@ -154,6 +155,57 @@ size_t BRBIP32PubKey(uint8_t *pubKey, size_t pubKeyLen, BRMasterPubKey mpk, uint
     return (! pubKey || sizeof(BRECPoint) <= pubKeyLen) ? sizeof(BRECPoint) : 0;
 }
 
+// returns the extended public key for path N(m/0H/chain)
+BRBIP32PubKeyNode BRBIP32PubKeyChainNode(BRMasterPubKey mpk, uint32_t chain)
+{
+    BRBIP32PubKeyNode node = { *(BRECPoint *)mpk.pubKey, mpk.chainCode };
+
+    assert(memcmp(&mpk, &BR_MASTER_PUBKEY_NONE, sizeof(mpk)) != 0);
+    _CKDpub(&node.pubKey, &node.chainCode, chain); // path N(m/0H/chain)
+    return node;
+}
+
+// writes the public keys for paths N(node/from) through N(node/from + count - 1) to pubKeys
+// returns the number of public keys written, which is less than count only on failure
+size_t BRBIP32PubKeyNodeRange(BRECPoint pubKeys[], const BRBIP32PubKeyNode *node, uint32_t from, size_t count)
+{
+    uint8_t buf[sizeof(node->pubKey) + sizeof(from)];
+    UInt256 *tweaks = (count > 0) ? malloc(count*sizeof(*tweaks)) : NULL;
+    UInt512 I;
+    size_t r;
+
+    assert(pubKeys != NULL || count == 0);
+    assert(node != NULL);
+    assert(from <= BIP32_HARD && count <= BIP32_HARD - from); // can't derive private child keys from a public parent key
+    assert(tweaks != NULL || count == 0);
+    *(BRECPoint *)buf = node->pubKey;
+
+    // CKDpub for each index, but with the parent point decoded once for all of the point additions
+    for (size_t n = 0; n < count; n++) {
+        UInt32SetBE(&buf[sizeof(node->pubKey)], from + (uint32_t)n);
+        BRHMAC(&I, BRSHA512, sizeof(UInt512), &node->chainCode, sizeof(node->chainCode), buf, sizeof(buf));
+        tweaks[n] = *(UInt256 *)&I; // IL, the child's chain code IR isn't needed
+    }
+
+    r = BRSecp256k1PointAddBatch(pubKeys, &node->pubKey, tweaks, count);
+    var_clean(&I);
+    mem_clean(buf, sizeof(buf));
+    if (tweaks) mem_clean(tweaks, count*sizeof(*tweaks));
+    if (tweaks) free(tweaks);
+    return r;
+}
+
+// writes the public keys for paths N(m/0H/chain/from) through N(m/0H/chain/from + count - 1) to pubKeys
+// returns the number of public keys written, which is less than count only on failure
+size_t BRBIP32PubKeyRange(BRECPoint pubKeys[], BRMasterPubKey mpk, uint32_t chain, uint32_t from, size_t count)
+{
+    BRBIP32PubKeyNode node = BRBIP32PubKeyChainNode(mpk, chain);
+    size_t r = BRBIP32PubKeyNodeRange(pubKeys, &node, from, count);
+
+    var_clean(&node.chainCode);
+    return r;
+}
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index)
 {
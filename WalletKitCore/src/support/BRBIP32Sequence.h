@@ -82,6 +82,23 @@ BRMasterPubKey BRBIP32MasterPubKey(const void *seed, size_t seedLen);
 // returns number of bytes written, or pubKeyLen needed if pubKey is NULL
 size_t BRBIP32PubKey(uint8_t *pubKey, size_t pubKeyLen, BRMasterPubKey mpk, uint32_t chain, uint32_t index);
 
+// the extended public key of a chain, path N(m/0H/chain), from which the chain's keys are derived
+typedef struct {
+    BRECPoint pubKey;
+    UInt256 chainCode;
+} BRBIP32PubKeyNode;
+
+// returns the extended public key for path N(m/0H/chain)
+BRBIP32PubKeyNode BRBIP32PubKeyChainNode(BRMasterPubKey mpk, uint32_t chain);
+
+// writes the public keys for paths N(node/from) through N(node/from + count - 1) to pubKeys
+// returns the number of public keys written, which is less than count only on failure
+size_t BRBIP32PubKeyNodeRange(BRECPoint pubKeys[], const BRBIP32PubKeyNode *node, uint32_t from, size_t count);
+
+// writes the public keys for paths N(m/0H/chain/from) through N(m/0H/chain/from + count - 1) to pubKeys
+// returns the number of public keys written, which is less than count only on failure
+size_t BRBIP32PubKeyRange(BRECPoint pubKeys[], BRMasterPubKey mpk, uint32_t chain, uint32_t from, size_t count);
+
 // sets the private key for path m/0H/chain/index to key
 void BRBIP32PrivKey(BRKey *key, const void *seed, size_t seedLen, uint32_t chain, uint32_t index);
 
@@ -135,3 +135,25 @@ void BRBIP39DeriveKey(void *key64, const char *phrase, const char *passphrase)
         mem_clean(salt, sizeof(salt));
     }
 }
+
+// derives the keys for count phrases with the same passphrase, as BRBIP39DeriveKey(), writing them to keys64 64 bytes
+// apart - this is several times faster per key than deriving them one at a time when the cpu has vector lanes to spare
+void BRBIP39DeriveKeys(void *keys64, const char *phrases[], const char *passphrase, size_t count)
+{
+    char salt[strlen("mnemonic") + (passphrase ? strlen(passphrase) : 0) + 1];
+    const void *pws[count + 1];
+    size_t pwLens[count + 1];
+
+    assert(keys64 != NULL || count == 0);
+    assert(phrases != NULL || count == 0);
+
+    for (size_t i = 0; i < count; i++) {
+        assert(phrases[i] != NULL);
+        pws[i] = phrases[i], pwLens[i] = strlen(phrases[i]);
+    }
+
+    strcpy(salt, "mnemonic");
+    if (passphrase) strcpy(salt + strlen("mnemonic"), passphrase);
+    BRPBKDF2Batch(keys64, 64, BRSHA512, 512/8, pws, pwLens, salt, strlen(salt), 2048, count);
+    mem_clean(salt, sizeof(salt));
+}
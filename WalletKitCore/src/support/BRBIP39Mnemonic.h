@@ -52,6 +52,10 @@ int BRBIP39PhraseIsValid(const char *wordList[], const char *phrase);
 // BUG: does not currently support passphrases containing NULL characters
 void BRBIP39DeriveKey(void *key64, const char *phrase, const char *passphrase);
 
+// derives the keys for count phrases with the same passphrase, as BRBIP39DeriveKey(), writing them to keys64 64 bytes
+// apart - this is several times faster per key than deriving them one at a time when the cpu has vector lanes to spare
+void BRBIP39DeriveKeys(void *keys64, const char *phrases[], const char *passphrase, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
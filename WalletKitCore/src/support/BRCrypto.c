@@ -23,9 +23,20 @@
 //  THE SOFTWARE.
 
 #include "BRCrypto.h"
+#include "BROSCompat.h"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#include <cpuid.h>
+#define SHA256_X86  1
+#define SHA256_LANES 1 // multi-buffer sha-256 using compiler vector extensions
+#elif defined(__aarch64__)
+#define SHA256_LANES 1
+#endif
 
 // endian swapping
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
@@ -110,19 +121,23 @@ void BRSHA1(void *md20, const void *data, size_t dataLen)
 #define s2(x) (ror32((x), 7) ^ ror32((x), 18) ^ ((x) >> 3))
 #define s3(x) (ror32((x), 17) ^ ror32((x), 19) ^ ((x) >> 10))
 
+static const uint32_t _sha256k[] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static const uint32_t _sha256iv[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
+                                      0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
+
+// portable reference implementation, the accelerated backends below must give the same results
 static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
 {
-    static const uint32_t k[] = {
-        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
-        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
-        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
-        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
-        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
-        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
-        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
-        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
-    };
-    
     int i;
     uint32_t a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[64];
     
@@ -130,7 +145,7 @@ static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
     for (; i < 64; i++) w[i] = s3(w[i - 2]) + w[i - 7] + s2(w[i - 15]) + w[i - 16];
     
     for (i = 0; i < 64; i++) {
-        t1 = h + s1(e) + ch(e, f, g) + k[i] + w[i];
+        t1 = h + s1(e) + ch(e, f, g) + _sha256k[i] + w[i];
         t2 = s0(a) + maj(a, b, c);
         h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
     }
@@ -140,6 +155,183 @@ static void _BRSHA256Compress(uint32_t *r, const uint32_t *x)
     mem_clean(w, sizeof(w));
 }
 
+#if SHA256_X86
+// four rounds with the message words in m0, then the message words for the next four rounds after m3 are put in m0
+#define shani4(m0, m1, m2, m3, i) (t = _mm_add_epi32(m0, _mm_loadu_si128((const __m128i *)&_sha256k[i])),\
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, t), abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(t, 0x0e)),\
+    m0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(m0, m1), _mm_alignr_epi8(m3, m2, 4)), m3))
+
+// x86 sha extensions, which keep the state as abef and cdgh
+__attribute__((target("sha,sse4.1")))
+static void _BRSHA256CompressSHANI(uint32_t *r, const uint32_t *x)
+{
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i t, abef, cdgh, abef0, cdgh0, m0, m1, m2, m3;
+
+    t = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[0]), 0xb1); // cdab
+    cdgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&r[4]), 0x1b); // efgh
+    abef = abef0 = _mm_alignr_epi8(t, cdgh, 8);
+    cdgh = cdgh0 = _mm_blend_epi16(cdgh, t, 0xf0);
+    m0 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[0]), bswap);
+    m1 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[4]), bswap);
+    m2 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[8]), bswap);
+    m3 = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&x[12]), bswap);
+
+    for (int i = 0; i < 64; i += 16) {
+        shani4(m0, m1, m2, m3, i);
+        shani4(m1, m2, m3, m0, i + 4);
+        shani4(m2, m3, m0, m1, i + 8);
+        shani4(m3, m0, m1, m2, i + 12);
+    }
+
+    t = _mm_shuffle_epi32(_mm_add_epi32(abef, abef0), 0x1b); // feba
+    cdgh = _mm_shuffle_epi32(_mm_add_epi32(cdgh, cdgh0), 0xb1); // dchg
+    _mm_storeu_si128((__m128i *)&r[0], _mm_blend_epi16(t, cdgh, 0xf0)); // dcba
+    _mm_storeu_si128((__m128i *)&r[4], _mm_alignr_epi8(cdgh, t, 8)); // hgfe
+}
+#endif
+
+#if SHA256_LANES
+typedef uint32_t _v4u32 __attribute__((vector_size(16)));
+typedef uint32_t _v8u32 __attribute__((vector_size(32)));
+
+// compresses a block of each of several messages at once, one per vector lane - word i of lane j is at r[i*lanes + j]
+// and x[i*lanes + j], with message words already in host byte order
+#define sha256lanes(name, vtype, attr)\
+attr static void name(uint32_t *r, const uint32_t *x)\
+{\
+    vtype a, b, c, d, e, f, g, h, t1, t2, st[8], w[64];\
+    int i;\
+\
+    memcpy(st, r, sizeof(st));\
+    memcpy(w, x, 16*sizeof(*w));\
+    for (i = 16; i < 64; i++) w[i] = s3(w[i - 2]) + w[i - 7] + s2(w[i - 15]) + w[i - 16];\
+    a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];\
+\
+    for (i = 0; i < 64; i++) {\
+        t1 = h + s1(e) + ch(e, f, g) + _sha256k[i] + w[i];\
+        t2 = s0(a) + maj(a, b, c);\
+        h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;\
+    }\
+\
+    st[0] += a, st[1] += b, st[2] += c, st[3] += d, st[4] += e, st[5] += f, st[6] += g, st[7] += h;\
+    memcpy(r, st, sizeof(st));\
+}
+
+#if SHA256_X86
+sha256lanes(_BRSHA256CompressSSE4, _v4u32, __attribute__((target("sse4.1"))))
+sha256lanes(_BRSHA256CompressAVX2, _v8u32, __attribute__((target("avx2"))))
+#else
+sha256lanes(_BRSHA256CompressNEON, _v4u32, )
+#endif
+
+// double-sha-256 of count messages of dataLen bytes each, stride bytes apart, with lanes messages compressed at once
+static void _BRSHA256_2Lanes(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count,
+                             void (*compress)(uint32_t *, const uint32_t *), size_t lanes)
+{
+    uint8_t buf[64];
+    uint32_t r[8*lanes], x[16*lanes], v;
+    size_t i, j, k, l, n, blocks = (dataLen + 8)/64 + 1; // number of 64 byte blocks once padded
+
+    for (i = 0; i + lanes <= count; i += lanes) {
+        for (j = 0; j < 8*lanes; j++) r[j] = _sha256iv[j/lanes];
+
+        for (k = 0; k < blocks; k++) {
+            for (l = 0; l < lanes; l++) { // interleave the next block of each message, padding as in BRSHA256()
+                n = (dataLen > k*64) ? dataLen - k*64 : 0;
+                if (n > 64) n = 64;
+                if (n > 0) memcpy(buf, (const uint8_t *)data + (i + l)*stride + k*64, n);
+                memset(&buf[n], 0, 64 - n);
+                if (dataLen/64 == k) buf[dataLen % 64] = 0x80; // append padding
+                if (k + 1 == blocks) { // append length in bits
+                    uint64_t bits = be64((uint64_t)dataLen << 3);
+                    memcpy(&buf[56], &bits, sizeof(bits));
+                }
+
+                for (j = 0; j < 16; j++) {
+                    memcpy(&v, &buf[j*4], sizeof(v));
+                    x[j*lanes + l] = be32(v);
+                }
+            }
+
+            compress(r, x);
+        }
+
+        // the second sha-256 is of the 32 byte digest, which is already in host byte order, as a single padded block
+        for (j = 0; j < 8*lanes; j++) x[j] = r[j], r[j] = _sha256iv[j/lanes];
+        for (; j < 16*lanes; j++) x[j] = 0;
+        for (l = 0; l < lanes; l++) x[8*lanes + l] = 0x80000000, x[15*lanes + l] = 32 << 3;
+        compress(r, x);
+
+        for (l = 0; l < lanes; l++) {
+            for (j = 0; j < 8; j++) {
+                v = be32(r[j*lanes + l]);
+                memcpy((uint8_t *)md32s + (i + l)*32 + j*4, &v, sizeof(v));
+            }
+        }
+    }
+
+    for (; i < count; i++) BRSHA256_2((uint8_t *)md32s + i*32, (const uint8_t *)data + i*stride, dataLen);
+    mem_clean(buf, sizeof(buf));
+    mem_clean(x, sizeof(x));
+    mem_clean(r, sizeof(r));
+}
+#endif
+
+static void (*_sha256_compress)(uint32_t *r, const uint32_t *x) = _BRSHA256Compress;
+static void (*_sha256_lanes)(uint32_t *r, const uint32_t *x) = NULL;
+static size_t _sha256_lanesCount = 0;
+static int _sha256_supported = 0, _sha256_backends = 0;
+static pthread_once_t _sha256_once = PTHREAD_ONCE_INIT;
+
+static void _sha256_select(int backends)
+{
+    _sha256_backends = backends & _sha256_supported;
+    _sha256_compress = _BRSHA256Compress;
+    _sha256_lanes = NULL, _sha256_lanesCount = 0;
+#if SHA256_X86
+    // sha extensions hash a single message faster than avx2 hashes eight at once in vector lanes
+    if (_sha256_backends & SHA256_BACKEND_SHANI) _sha256_compress = _BRSHA256CompressSHANI;
+    else if (_sha256_backends & SHA256_BACKEND_AVX2) _sha256_lanes = _BRSHA256CompressAVX2, _sha256_lanesCount = 8;
+    else if (_sha256_backends & SHA256_BACKEND_SSE4) _sha256_lanes = _BRSHA256CompressSSE4, _sha256_lanesCount = 4;
+#elif SHA256_LANES
+    if (_sha256_backends & SHA256_BACKEND_NEON) _sha256_lanes = _BRSHA256CompressNEON, _sha256_lanesCount = 4;
+#endif
+}
+
+static void _sha256_init(void)
+{
+#if SHA256_X86
+    unsigned a, b, c, d;
+
+    __builtin_cpu_init();
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 29)) && __builtin_cpu_supports("sse4.1"))
+        _sha256_supported |= SHA256_BACKEND_SHANI;
+    if (__builtin_cpu_supports("sse4.1")) _sha256_supported |= SHA256_BACKEND_SSE4;
+    if (__builtin_cpu_supports("avx2")) _sha256_supported |= SHA256_BACKEND_AVX2;
+#elif SHA256_LANES
+    _sha256_supported |= SHA256_BACKEND_NEON; // neon is part of the aarch64 base instruction set
+#endif
+    _sha256_select(_sha256_supported);
+}
+
+// returns the sha-256 backends supported by the cpu, as a mask of SHA256_BACKEND_* flags
+int BRSHA256Backends(void)
+{
+    pthread_once(&_sha256_once, _sha256_init);
+    return _sha256_supported;
+}
+
+// limits sha-256 to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRSHA256SetBackends(int backends)
+{
+    pthread_once(&_sha256_once, _sha256_init);
+    _sha256_select(backends);
+    return _sha256_backends;
+}
+
 void BRSHA224(void *md28, const void *data, size_t dataLen) {
     size_t i;
     uint32_t x[16], buf[] = { 0xc1059ed8, 0x367cd507, 0x3070dd17, 0xf70e5939, 0xffc00b31, 0x68581511,
@@ -147,18 +339,19 @@ void BRSHA224(void *md28, const void *data, size_t dataLen) {
 
     assert(md28 != NULL);
     assert(data != NULL || dataLen == 0);
+    pthread_once(&_sha256_once, _sha256_init);
 
     for (i = 0; i < dataLen; i += 64) { // process data in 64 byte blocks
         memcpy(x, (const uint8_t *)data + i, (i + 64 < dataLen) ? 64 : dataLen - i);
         if (i + 64 > dataLen) break;
-        _BRSHA256Compress(buf, x);
+        _sha256_compress(buf, x);
     }
 
     memset((uint8_t *)x + (dataLen - i), 0, 64 - (dataLen - i)); // clear remainder of x
     ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
-    if (dataLen - i >= 56) _BRSHA256Compress(buf, x), memset(x, 0, 64); // length goes to next block
+    if (dataLen - i >= 56) _sha256_compress(buf, x), memset(x, 0, 64); // length goes to next block
     x[14] = be32((uint32_t)(dataLen >> 29)), x[15] = be32((uint32_t)(dataLen << 3)); // append length in bits
-    _BRSHA256Compress(buf, x); // finalize
+    _sha256_compress(buf, x); // finalize
     for (i = 0; i < 7; i++) buf[i] = be32(buf[i]); // endian swap
     memcpy(md28, buf, 28); // write to md
     mem_clean(x, sizeof(x));
@@ -168,29 +361,83 @@ void BRSHA224(void *md28, const void *data, size_t dataLen) {
 void BRSHA256(void *md32, const void *data, size_t dataLen)
 {
     size_t i;
-    uint32_t x[16], buf[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c,
-                              0x1f83d9ab, 0x5be0cd19 }; // initial buffer values
+    uint32_t x[16], buf[8];
     
     assert(md32 != NULL);
     assert(data != NULL || dataLen == 0);
+    pthread_once(&_sha256_once, _sha256_init);
+    memcpy(buf, _sha256iv, sizeof(buf));
 
     for (i = 0; i < dataLen; i += 64) { // process data in 64 byte blocks
         memcpy(x, (const uint8_t *)data + i, (i + 64 < dataLen) ? 64 : dataLen - i);
         if (i + 64 > dataLen) break;
-        _BRSHA256Compress(buf, x);
+        _sha256_compress(buf, x);
     }
     
     memset((uint8_t *)x + (dataLen - i), 0, 64 - (dataLen - i)); // clear remainder of x
     ((uint8_t *)x)[dataLen - i] = 0x80; // append padding
-    if (dataLen - i >= 56) _BRSHA256Compress(buf, x), memset(x, 0, 64); // length goes to next block
+    if (dataLen - i >= 56) _sha256_compress(buf, x), memset(x, 0, 64); // length goes to next block
     x[14] = be32((uint32_t)(dataLen >> 29)), x[15] = be32((uint32_t)(dataLen << 3)); // append length in bits
-    _BRSHA256Compress(buf, x); // finalize
+    _sha256_compress(buf, x); // finalize
     for (i = 0; i < 8; i++) buf[i] = be32(buf[i]); // endian swap
     memcpy(md32, buf, 32); // write to md
     mem_clean(x, sizeof(x));
     mem_clean(buf, sizeof(buf));
 }
 
+// starts an incremental sha-256 hash
+void BRSHA256Init(BRSHA256State *ctx)
+{
+    assert(ctx != NULL);
+    pthread_once(&_sha256_once, _sha256_init);
+    memcpy(ctx->h, _sha256iv, sizeof(ctx->h));
+    ctx->len = 0;
+}
+
+void BRSHA256Update(BRSHA256State *ctx, const void *data, size_t dataLen)
+{
+    size_t n;
+
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    n = ctx->len % 64, ctx->len += dataLen;
+
+    while (n + dataLen >= 64) { // process data in 64 byte blocks, after any left from the previous update
+        memcpy((uint8_t *)ctx->x + n, data, 64 - n);
+        _sha256_compress(ctx->h, ctx->x);
+        data = (const uint8_t *)data + 64 - n, dataLen -= 64 - n, n = 0;
+    }
+
+    if (dataLen > 0) memcpy((uint8_t *)ctx->x + n, data, dataLen);
+}
+
+void BRSHA256Final(BRSHA256State *ctx, void *md32)
+{
+    size_t i, n;
+
+    assert(ctx != NULL);
+    assert(md32 != NULL);
+    n = ctx->len % 64;
+    memset((uint8_t *)ctx->x + n, 0, 64 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] = 0x80; // append padding
+    if (n >= 56) _sha256_compress(ctx->h, ctx->x), memset(ctx->x, 0, 64); // length goes to next block
+    ctx->x[14] = be32((uint32_t)(ctx->len >> 29)), ctx->x[15] = be32((uint32_t)(ctx->len << 3)); // length in bits
+    _sha256_compress(ctx->h, ctx->x); // finalize
+    for (i = 0; i < 8; i++) ctx->h[i] = be32(ctx->h[i]); // endian swap
+    memcpy(md32, ctx->h, 32); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
+// compresses a block with message words already in host byte order, as the lanes functions take them
+static void _BRSHA256CompressHost(uint32_t *r, const uint32_t *x)
+{
+    uint32_t w[16];
+
+    for (int i = 0; i < 16; i++) w[i] = be32(x[i]);
+    _sha256_compress(r, w);
+    mem_clean(w, sizeof(w));
+}
+
 // double-sha-256 = sha-256(sha-256(x))
 void BRSHA256_2(void *md32, const void *data, size_t dataLen)
 {
@@ -202,6 +449,21 @@ void BRSHA256_2(void *md32, const void *data, size_t dataLen)
     BRSHA256(md32, t, sizeof(t));
 }
 
+// double-sha-256 of count messages of dataLen bytes each, stride bytes apart in data, written to md32s 32 bytes apart
+// several messages are hashed at once in vector lanes when the cpu supports it
+void BRSHA256_2Batch(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count)
+{
+    assert(md32s != NULL || count == 0);
+    assert(data != NULL || count == 0);
+    pthread_once(&_sha256_once, _sha256_init);
+
+#if SHA256_LANES
+    if (_sha256_lanes) _BRSHA256_2Lanes(md32s, data, dataLen, stride, count, _sha256_lanes, _sha256_lanesCount);
+    else
+#endif
+    for (size_t i = 0; i < count; i++) BRSHA256_2((uint8_t *)md32s + i*32, (const uint8_t *)data + i*stride, dataLen);
+}
+
 // bitwise right rotation
 #define ror64(a, b) (((a) >> (b)) | ((a) << (64 - (b))))
 
@@ -211,27 +473,30 @@ void BRSHA256_2(void *md32, const void *data, size_t dataLen)
 #define S2(x) (ror64((x), 1) ^ ror64((x), 8) ^ ((x) >> 7))
 #define S3(x) (ror64((x), 19) ^ ror64((x), 61) ^ ((x) >> 6))
 
+static const uint64_t _sha512k[] = {
+    0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
+    0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
+    0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
+    0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
+    0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
+    0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
+    0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
+    0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
+    0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
+    0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
+    0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
+    0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
+    0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
+    0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
+    0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
+    0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
+};
+
+static const uint64_t _sha512iv[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
+                                      0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179 };
+
 static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
 {
-    static const uint64_t k[] = {
-        0x428a2f98d728ae22, 0x7137449123ef65cd, 0xb5c0fbcfec4d3b2f, 0xe9b5dba58189dbbc, 0x3956c25bf348b538,
-        0x59f111f1b605d019, 0x923f82a4af194f9b, 0xab1c5ed5da6d8118, 0xd807aa98a3030242, 0x12835b0145706fbe,
-        0x243185be4ee4b28c, 0x550c7dc3d5ffb4e2, 0x72be5d74f27b896f, 0x80deb1fe3b1696b1, 0x9bdc06a725c71235,
-        0xc19bf174cf692694, 0xe49b69c19ef14ad2, 0xefbe4786384f25e3, 0x0fc19dc68b8cd5b5, 0x240ca1cc77ac9c65,
-        0x2de92c6f592b0275, 0x4a7484aa6ea6e483, 0x5cb0a9dcbd41fbd4, 0x76f988da831153b5, 0x983e5152ee66dfab,
-        0xa831c66d2db43210, 0xb00327c898fb213f, 0xbf597fc7beef0ee4, 0xc6e00bf33da88fc2, 0xd5a79147930aa725,
-        0x06ca6351e003826f, 0x142929670a0e6e70, 0x27b70a8546d22ffc, 0x2e1b21385c26c926, 0x4d2c6dfc5ac42aed,
-        0x53380d139d95b3df, 0x650a73548baf63de, 0x766a0abb3c77b2a8, 0x81c2c92e47edaee6, 0x92722c851482353b,
-        0xa2bfe8a14cf10364, 0xa81a664bbc423001, 0xc24b8b70d0f89791, 0xc76c51a30654be30, 0xd192e819d6ef5218,
-        0xd69906245565a910, 0xf40e35855771202a, 0x106aa07032bbd1b8, 0x19a4c116b8d2d0c8, 0x1e376c085141ab53,
-        0x2748774cdf8eeb99, 0x34b0bcb5e19b48a8, 0x391c0cb3c5c95a63, 0x4ed8aa4ae3418acb, 0x5b9cca4f7763e373,
-        0x682e6ff3d6b2b8a3, 0x748f82ee5defb2fc, 0x78a5636f43172f60, 0x84c87814a1f0ab72, 0x8cc702081a6439ec,
-        0x90befffa23631e28, 0xa4506cebde82bde9, 0xbef9a3f7b2c67915, 0xc67178f2e372532b, 0xca273eceea26619c,
-        0xd186b8c721c0c207, 0xeada7dd6cde0eb1e, 0xf57d4f7fee6ed178, 0x06f067aa72176fba, 0x0a637dc5a2c898a6,
-        0x113f9804bef90dae, 0x1b710b35131c471b, 0x28db77f523047d84, 0x32caab7b40c72493, 0x3c9ebe0a15c9bebc,
-        0x431d67c49c100d4c, 0x4cc5d4becb3e42b6, 0x597f299cfc657e2a, 0x5fcb6fab3ad6faec, 0x6c44198c4a475817
-    };
-    
     int i;
     uint64_t a = r[0], b = r[1], c = r[2], d = r[3], e = r[4], f = r[5], g = r[6], h = r[7], t1, t2, w[80];
     
@@ -239,7 +504,7 @@ static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
     for (; i < 80; i++) w[i] = S3(w[i - 2]) + w[i - 7] + S2(w[i - 15]) + w[i - 16];
     
     for (i = 0; i < 80; i++) {
-        t1 = h + S1(e) + ch(e, f, g) + k[i] + w[i];
+        t1 = h + S1(e) + ch(e, f, g) + _sha512k[i] + w[i];
         t2 = S0(a) + maj(a, b, c);
         h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
     }
@@ -249,6 +514,71 @@ static void _BRSHA512Compress(uint64_t *r, const uint64_t *x)
     mem_clean(w, sizeof(w));
 }
 
+// compresses a block with message words already in host byte order, as the lanes functions take them
+static void _BRSHA512CompressHost(uint64_t *r, const uint64_t *x)
+{
+    uint64_t w[16];
+
+    for (int i = 0; i < 16; i++) w[i] = be64(x[i]);
+    _BRSHA512Compress(r, w);
+    mem_clean(w, sizeof(w));
+}
+
+#if SHA256_X86
+typedef uint64_t _v4u64 __attribute__((vector_size(32)));
+
+// compresses a block of each of four messages at once, one per vector lane, laid out as in sha256lanes
+__attribute__((target("avx2")))
+static void _BRSHA512CompressAVX2(uint64_t *r, const uint64_t *x)
+{
+    _v4u64 a, b, c, d, e, f, g, h, t1, t2, st[8], w[80];
+    int i;
+
+    memcpy(st, r, sizeof(st));
+    memcpy(w, x, 16*sizeof(*w));
+    for (i = 16; i < 80; i++) w[i] = S3(w[i - 2]) + w[i - 7] + S2(w[i - 15]) + w[i - 16];
+    a = st[0], b = st[1], c = st[2], d = st[3], e = st[4], f = st[5], g = st[6], h = st[7];
+
+    for (i = 0; i < 80; i++) {
+        t1 = h + S1(e) + ch(e, f, g) + _sha512k[i] + w[i];
+        t2 = S0(a) + maj(a, b, c);
+        h = g, g = f, f = e, e = d + t1, d = c, c = b, b = a, a = t1 + t2;
+    }
+
+    st[0] += a, st[1] += b, st[2] += c, st[3] += d, st[4] += e, st[5] += f, st[6] += g, st[7] += h;
+    memcpy(r, st, sizeof(st));
+}
+#endif
+
+static int _sha512_supported = 0, _sha512_backends = 0;
+static pthread_once_t _sha512_once = PTHREAD_ONCE_INIT;
+
+static void _sha512_init(void)
+{
+#if SHA256_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) _sha512_supported |= SHA512_BACKEND_AVX2;
+#endif
+    _sha512_backends = _sha512_supported;
+}
+
+// returns the sha-512 backends supported by the cpu, as a mask of SHA512_BACKEND_* flags
+int BRSHA512Backends(void)
+{
+    pthread_once(&_sha512_once, _sha512_init);
+    return _sha512_supported;
+}
+
+// limits sha-512 to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRSHA512SetBackends(int backends)
+{
+    pthread_once(&_sha512_once, _sha512_init);
+    _sha512_backends = backends & _sha512_supported;
+    return _sha512_backends;
+}
+
 void BRSHA384(void *md48, const void *data, size_t dataLen)
 {
     size_t i;
@@ -278,11 +608,11 @@ void BRSHA384(void *md48, const void *data, size_t dataLen)
 void BRSHA512(void *md64, const void *data, size_t dataLen)
 {
     size_t i;
-    uint64_t x[16], buf[] = { 0x6a09e667f3bcc908, 0xbb67ae8584caa73b, 0x3c6ef372fe94f82b, 0xa54ff53a5f1d36f1,
-                              0x510e527fade682d1, 0x9b05688c2b3e6c1f, 0x1f83d9abfb41bd6b, 0x5be0cd19137e2179 };
+    uint64_t x[16], buf[8];
     
     assert(md64 != NULL);
     assert(data != NULL || dataLen == 0);
+    memcpy(buf, _sha512iv, sizeof(buf));
 
     for (i = 0; i < dataLen; i += 128) { // process data in 128 byte blocks
         memcpy(x, (const uint8_t *)data + i, (i + 128 < dataLen) ? 128 : dataLen - i);
@@ -301,6 +631,48 @@ void BRSHA512(void *md64, const void *data, size_t dataLen)
     mem_clean(buf, sizeof(buf));
 }
 
+// starts an incremental sha-512 hash
+void BRSHA512Init(BRSHA512State *ctx)
+{
+    assert(ctx != NULL);
+    memcpy(ctx->h, _sha512iv, sizeof(ctx->h));
+    ctx->len = 0;
+}
+
+void BRSHA512Update(BRSHA512State *ctx, const void *data, size_t dataLen)
+{
+    size_t n;
+
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    n = ctx->len % 128, ctx->len += dataLen;
+
+    while (n + dataLen >= 128) { // process data in 128 byte blocks, after any left from the previous update
+        memcpy((uint8_t *)ctx->x + n, data, 128 - n);
+        _BRSHA512Compress(ctx->h, ctx->x);
+        data = (const uint8_t *)data + 128 - n, dataLen -= 128 - n, n = 0;
+    }
+
+    if (dataLen > 0) memcpy((uint8_t *)ctx->x + n, data, dataLen);
+}
+
+void BRSHA512Final(BRSHA512State *ctx, void *md64)
+{
+    size_t i, n;
+
+    assert(ctx != NULL);
+    assert(md64 != NULL);
+    n = ctx->len % 128;
+    memset((uint8_t *)ctx->x + n, 0, 128 - n); // clear remainder of x
+    ((uint8_t *)ctx->x)[n] = 0x80; // append padding
+    if (n >= 112) _BRSHA512Compress(ctx->h, ctx->x), memset(ctx->x, 0, 128); // length goes to next block
+    ctx->x[14] = be64(ctx->len >> 61), ctx->x[15] = be64(ctx->len << 3); // append length in bits
+    _BRSHA512Compress(ctx->h, ctx->x); // finalize
+    for (i = 0; i < 8; i++) ctx->h[i] = be64(ctx->h[i]); // endian swap
+    memcpy(md64, ctx->h, 64); // write to md
+    mem_clean(ctx, sizeof(*ctx));
+}
+
 // basic ripemd functions
 #define f(x, y, z) ((x) ^ (y) ^ (z))
 #define g(x, y, z) (((x) & (y)) | (~(x) & (z)))
@@ -399,103 +771,231 @@ void BRHash160(void *md20, const void *data, size_t datalen)
 // bitwise left rotation
 #define rol64(a, b) ((a) << (b) ^ ((a) >> (64 - (b))))
 
-static void _BRSHA3Compress(uint64_t *r, const uint64_t *x, size_t blockSize)
+static const uint64_t _keccakrc[] = { // keccak round constants
+    0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
+    0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
+    0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
+    0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
+    0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
+};
+
+// keccak-f[1600] with each round unrolled, theta, rho and pi folded into one pass and chi and iota into another
+// instantiated for a single state, and for several independent states at once, one per vector lane, with word i of
+// state j at s[i*lanes + j]
+#define keccakf1600(name, vtype, attr)\
+attr static void name(uint64_t *s)\
+{\
+    vtype a[25], b[25], c[5], d[5];\
+\
+    memcpy(a, s, sizeof(a));\
+\
+    for (int i = 0; i < 24; i++) {\
+        c[0] = a[0] ^ a[5] ^ a[10] ^ a[15] ^ a[20], c[1] = a[1] ^ a[6] ^ a[11] ^ a[16] ^ a[21];\
+        c[2] = a[2] ^ a[7] ^ a[12] ^ a[17] ^ a[22], c[3] = a[3] ^ a[8] ^ a[13] ^ a[18] ^ a[23];\
+        c[4] = a[4] ^ a[9] ^ a[14] ^ a[19] ^ a[24];\
+        d[0] = c[4] ^ rol64(c[1], 1), d[1] = c[0] ^ rol64(c[2], 1), d[2] = c[1] ^ rol64(c[3], 1);\
+        d[3] = c[2] ^ rol64(c[4], 1), d[4] = c[3] ^ rol64(c[0], 1);\
+        b[0] = (a[0] ^ d[0]), b[1] = rol64(a[6] ^ d[1], 44), b[2] = rol64(a[12] ^ d[2], 43),\
+        b[3] = rol64(a[18] ^ d[3], 21), b[4] = rol64(a[24] ^ d[4], 14);\
+        b[5] = rol64(a[3] ^ d[3], 28), b[6] = rol64(a[9] ^ d[4], 20), b[7] = rol64(a[10] ^ d[0], 3),\
+        b[8] = rol64(a[16] ^ d[1], 45), b[9] = rol64(a[22] ^ d[2], 61);\
+        b[10] = rol64(a[1] ^ d[1], 1), b[11] = rol64(a[7] ^ d[2], 6), b[12] = rol64(a[13] ^ d[3], 25),\
+        b[13] = rol64(a[19] ^ d[4], 8), b[14] = rol64(a[20] ^ d[0], 18);\
+        b[15] = rol64(a[4] ^ d[4], 27), b[16] = rol64(a[5] ^ d[0], 36), b[17] = rol64(a[11] ^ d[1], 10),\
+        b[18] = rol64(a[17] ^ d[2], 15), b[19] = rol64(a[23] ^ d[3], 56);\
+        b[20] = rol64(a[2] ^ d[2], 62), b[21] = rol64(a[8] ^ d[3], 55), b[22] = rol64(a[14] ^ d[4], 39),\
+        b[23] = rol64(a[15] ^ d[0], 41), b[24] = rol64(a[21] ^ d[1], 2);\
+        a[0] = b[0] ^ (~b[1] & b[2]), a[1] = b[1] ^ (~b[2] & b[3]), a[2] = b[2] ^ (~b[3] & b[4]),\
+        a[3] = b[3] ^ (~b[4] & b[0]), a[4] = b[4] ^ (~b[0] & b[1]);\
+        a[5] = b[5] ^ (~b[6] & b[7]), a[6] = b[6] ^ (~b[7] & b[8]), a[7] = b[7] ^ (~b[8] & b[9]),\
+        a[8] = b[8] ^ (~b[9] & b[5]), a[9] = b[9] ^ (~b[5] & b[6]);\
+        a[10] = b[10] ^ (~b[11] & b[12]), a[11] = b[11] ^ (~b[12] & b[13]), a[12] = b[12] ^ (~b[13] & b[14]),\
+        a[13] = b[13] ^ (~b[14] & b[10]), a[14] = b[14] ^ (~b[10] & b[11]);\
+        a[15] = b[15] ^ (~b[16] & b[17]), a[16] = b[16] ^ (~b[17] & b[18]), a[17] = b[17] ^ (~b[18] & b[19]),\
+        a[18] = b[18] ^ (~b[19] & b[15]), a[19] = b[19] ^ (~b[15] & b[16]);\
+        a[20] = b[20] ^ (~b[21] & b[22]), a[21] = b[21] ^ (~b[22] & b[23]), a[22] = b[22] ^ (~b[23] & b[24]),\
+        a[23] = b[23] ^ (~b[24] & b[20]), a[24] = b[24] ^ (~b[20] & b[21]);\
+        a[0] ^= _keccakrc[i];\
+    }\
+\
+    memcpy(s, a, sizeof(a));\
+    mem_clean(a, sizeof(a));\
+    mem_clean(b, sizeof(b));\
+}
+
+keccakf1600(_BRKeccakF, uint64_t, )
+
+#if SHA256_X86
+keccakf1600(_BRKeccakFAVX2, _v4u64, __attribute__((target("avx2"))))
+
+// keccak-256 of count messages of dataLen bytes each, stride bytes apart, with four messages permuted at once
+__attribute__((target("avx2")))
+static void _BRKeccak256AVX2(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count)
 {
-    static const uint64_t k[] = { // keccak round constants
-        0x0000000000000001, 0x0000000000008082, 0x800000000000808a, 0x8000000080008000, 0x000000000000808b,
-        0x0000000080000001, 0x8000000080008081, 0x8000000000008009, 0x000000000000008a, 0x0000000000000088,
-        0x0000000080008009, 0x000000008000000a, 0x000000008000808b, 0x800000000000008b, 0x8000000000008089,
-        0x8000000000008003, 0x8000000000008002, 0x8000000000000080, 0x000000000000800a, 0x800000008000000a,
-        0x8000000080008081, 0x8000000000008080, 0x0000000080000001, 0x8000000080008008
-    };
-    
-    size_t i, j;
-    uint64_t a[5], b[5], r0, r1;
-    
-    for (i = 0; i < blockSize/sizeof(uint64_t); i++) r[i] ^= le64(x[i]);
-    
-    for (i = 0; i < 24; i++) { // permute r
-        // theta(r)
-        for (j = 0; j < 5; j++) a[j] = r[j] ^ r[j + 5] ^ r[j + 10] ^ r[j + 15] ^ r[j + 20];
-        b[0] = rol64(a[1], 1) ^ a[4], b[1] = rol64(a[2], 1) ^ a[0], b[2] = rol64(a[3], 1) ^ a[1];
-        b[3] = rol64(a[4], 1) ^ a[2], b[4] = rol64(a[0], 1) ^ a[3];
-        for (j = 0; j < 5; j++) r[j] ^= b[j], r[j + 5] ^= b[j], r[j + 10] ^= b[j], r[j + 15] ^= b[j], r[j + 20] ^= b[j];
-        
-        // rho(r)
-        r[1] = rol64(r[1], 1), r[2] = rol64(r[2], 62), r[3] = rol64(r[3], 28), r[4] = rol64(r[4], 27);
-        r[5] = rol64(r[5], 36), r[6] = rol64(r[6], 44), r[7] = rol64(r[7], 6), r[8] = rol64(r[8], 55);
-        r[9] = rol64(r[9], 20), r[10] = rol64(r[10], 3), r[11] = rol64(r[11], 10), r[12] = rol64(r[12], 43);
-        r[13] = rol64(r[13], 25), r[14] = rol64(r[14], 39), r[15] = rol64(r[15], 41), r[16] = rol64(r[16], 45);
-        r[17] = rol64(r[17], 15), r[18] = rol64(r[18], 21), r[19] = rol64(r[19], 8), r[20] = rol64(r[20], 18);
-        r[21] = rol64(r[21], 2), r[22] = rol64(r[22], 61), r[23] = rol64(r[23], 56), r[24] = rol64(r[24], 14);
-        
-        // pi(r)
-        r1 = r[1], r[1] = r[6], r[6] = r[9], r[9] = r[22], r[22] = r[14], r[14] = r[20], r[20] = r[2], r[2] = r[12],
-        r[12] = r[13], r[13] = r[19], r[19] = r[23], r[23] = r[15], r[15] = r[4], r[4] = r[24], r[24] = r[21];
-        r[21] = r[8], r[8] = r[16], r[16] = r[5], r[5] = r[3], r[3] = r[18], r[18] = r[17], r[17] = r[11], r[11] = r[7];
-        r[7] = r[10], r[10] = r1; // r[0] left as is
-        
-        for (j = 0; j < 25; j += 5) { // chi(r)
-            r0 = r[0 + j], r1 = r[1 + j], r[0 + j] ^= ~r1 & r[2 + j], r[1 + j] ^= ~r[2 + j] & r[3 + j];
-            r[2 + j] ^= ~r[3 + j] & r[4 + j], r[3 + j] ^= ~r[4 + j] & r0, r[4 + j] ^= ~r0 & r1;
+    uint8_t buf[136];
+    uint64_t s[25*4], x;
+    size_t i, j, k, l, n, blocks = dataLen/136 + 1; // number of 136 byte blocks once padded
+
+    for (i = 0; i + 4 <= count; i += 4) {
+        memset(s, 0, sizeof(s));
+
+        for (k = 0; k < blocks; k++) {
+            for (l = 0; l < 4; l++) { // interleave the next block of each message, padding as in BRKeccakFinal()
+                n = (k + 1 < blocks) ? 136 : dataLen % 136;
+                if (n > 0) memcpy(buf, (const uint8_t *)data + (i + l)*stride + k*136, n);
+                memset(&buf[n], 0, sizeof(buf) - n);
+                if (k + 1 == blocks) buf[n] ^= 0x01, buf[135] ^= 0x80; // append padding
+
+                for (j = 0; j < 17; j++) {
+                    memcpy(&x, &buf[j*8], sizeof(x));
+                    s[j*4 + l] ^= le64(x);
+                }
+            }
+
+            _BRKeccakFAVX2(s);
+        }
+
+        for (l = 0; l < 4; l++) {
+            for (j = 0; j < 4; j++) {
+                x = le64(s[j*4 + l]);
+                memcpy((uint8_t *)md32s + (i + l)*32 + j*8, &x, sizeof(x));
+            }
         }
-        
-        *r ^= k[i]; // iota(r, i)
     }
-    
-    mem_clean(a, sizeof(a));
-    mem_clean(b, sizeof(b));
-    var_clean(&r0, &r1);
+
+    for (; i < count; i++) BRKeccak256((uint8_t *)md32s + i*32, (const uint8_t *)data + i*stride, dataLen);
+    mem_clean(buf, sizeof(buf));
+    mem_clean(s, sizeof(s));
+}
+#endif
+
+static void _BRKeccakInit(BRKeccakState *ctx, size_t mdLen, uint8_t pad)
+{
+    assert(ctx != NULL);
+    assert(mdLen > 0 && mdLen <= 64 && mdLen % 4 == 0);
+    memset(ctx->s, 0, sizeof(ctx->s));
+    ctx->rate = 200 - 2*mdLen, ctx->offset = 0, ctx->pad = pad;
+}
+
+// starts an incremental keccak hash with an mdLen byte digest (32 for keccak-256, as used by ethereum)
+void BRKeccakInit(BRKeccakState *ctx, size_t mdLen)
+{
+    _BRKeccakInit(ctx, mdLen, 0x01);
+}
+
+// starts an incremental sha3 hash with an mdLen byte digest
+void BRSHA3Init(BRKeccakState *ctx, size_t mdLen)
+{
+    _BRKeccakInit(ctx, mdLen, 0x06);
+}
+
+void BRKeccakUpdate(BRKeccakState *ctx, const void *data, size_t dataLen)
+{
+    const uint8_t *d = data;
+    uint64_t x;
+
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+
+    while (dataLen > 0) {
+        if (ctx->offset % 8 == 0 && dataLen >= 8) { // absorb whole words up to the end of the block
+            for (; ctx->offset < ctx->rate && dataLen >= 8; ctx->offset += 8, d += 8, dataLen -= 8) {
+                memcpy(&x, d, sizeof(x));
+                ctx->s[ctx->offset/8] ^= le64(x);
+            }
+        }
+        else ctx->s[ctx->offset/8] ^= (uint64_t)*d++ << (ctx->offset % 8)*8, ctx->offset++, dataLen--;
+
+        if (ctx->offset == ctx->rate) _BRKeccakF(ctx->s), ctx->offset = 0;
+    }
+}
+
+void BRKeccakFinal(BRKeccakState *ctx, void *md)
+{
+    size_t i, mdLen;
+    uint64_t x;
+
+    assert(ctx != NULL);
+    assert(md != NULL);
+    mdLen = (200 - ctx->rate)/2;
+    ctx->s[ctx->offset/8] ^= (uint64_t)ctx->pad << (ctx->offset % 8)*8; // append padding
+    ctx->s[ctx->rate/8 - 1] ^= 0x8000000000000000;
+    _BRKeccakF(ctx->s); // finalize
+
+    for (i = 0; i < mdLen; i += 8) { // write to md
+        x = le64(ctx->s[i/8]); // endian swap
+        memcpy((uint8_t *)md + i, &x, (mdLen - i < 8) ? mdLen - i : 8);
+    }
+
+    mem_clean(ctx, sizeof(*ctx));
+    var_clean(&x);
 }
 
 // sha3-256: http://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.202.pdf
 void BRSHA3_256(void *md32, const void *data, size_t dataLen)
 {
-    size_t i;
-    uint64_t x[17], buf[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    
+    BRKeccakState ctx;
+
     assert(md32 != NULL);
     assert(data != NULL || dataLen == 0);
-    
-    for (i = 0; i <= dataLen; i += 136) { // process data in 136 byte blocks
-        memcpy(x, (const uint8_t *)data + i, (i + 136 < dataLen) ? 136 : dataLen - i);
-        if (i + 136 > dataLen) break;
-        _BRSHA3Compress(buf, x, 136);
-    }
-    
-    memset((uint8_t *)x + (dataLen - i), 0, 136 - (dataLen - i)); // clear remainder of x
-    ((uint8_t *)x)[dataLen - i] |= 0x06; // append padding
-    ((uint8_t *)x)[135] |= 0x80;
-    _BRSHA3Compress(buf, x, 136); // finalize
-    for (i = 0; i < 4; i++) buf[i] = le64(buf[i]); // endian swap
-    memcpy(md32, buf, 32); // write to md
-    mem_clean(x, sizeof(x));
-    mem_clean(buf, sizeof(buf));
+    BRSHA3Init(&ctx, 32);
+    BRKeccakUpdate(&ctx, data, dataLen);
+    BRKeccakFinal(&ctx, md32);
 }
 
 // keccak-256: https://keccak.team/files/Keccak-submission-3.pdf
 void BRKeccak256(void *md32, const void *data, size_t dataLen)
 {
-    size_t i;
-    uint64_t x[17], buf[] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
-    
+    BRKeccakState ctx;
+
     assert(md32 != NULL);
     assert(data != NULL || dataLen == 0);
-    
-    for (i = 0; i <= dataLen; i += 136) { // process data in 136 byte blocks
-        memcpy(x, (const uint8_t *)data + i, (i + 136 < dataLen) ? 136 : dataLen - i);
-        if (i + 136 > dataLen) break;
-        _BRSHA3Compress(buf, x, 136);
-    }
-    
-    memset((uint8_t *)x + (dataLen - i), 0, 136 - (dataLen - i)); // clear remainder of x
-    ((uint8_t *)x)[dataLen - i] |= 0x01; // append padding
-    ((uint8_t *)x)[135] |= 0x80;
-    _BRSHA3Compress(buf, x, 136); // finalize
-    for (i = 0; i < 4; i++) buf[i] = le64(buf[i]); // endian swap
-    memcpy(md32, buf, 32); // write to md
-    mem_clean(x, sizeof(x));
-    mem_clean(buf, sizeof(buf));
+    BRKeccakInit(&ctx, 32);
+    BRKeccakUpdate(&ctx, data, dataLen);
+    BRKeccakFinal(&ctx, md32);
+}
+
+static int _keccak_supported = 0, _keccak_backends = 0;
+static pthread_once_t _keccak_once = PTHREAD_ONCE_INIT;
+
+static void _keccak_init(void)
+{
+#if SHA256_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) _keccak_supported |= KECCAK_BACKEND_AVX2;
+#endif
+    _keccak_backends = _keccak_supported;
+}
+
+// returns the keccak backends supported by the cpu, as a mask of KECCAK_BACKEND_* flags
+int BRKeccakBackends(void)
+{
+    pthread_once(&_keccak_once, _keccak_init);
+    return _keccak_supported;
+}
+
+// limits keccak to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRKeccakSetBackends(int backends)
+{
+    pthread_once(&_keccak_once, _keccak_init);
+    _keccak_backends = backends & _keccak_supported;
+    return _keccak_backends;
+}
+
+// keccak-256 of count messages of dataLen bytes each, stride bytes apart in data, written to md32s 32 bytes apart
+void BRKeccak256Batch(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count)
+{
+    assert(md32s != NULL || count == 0);
+    assert(data != NULL || count == 0);
+    pthread_once(&_keccak_once, _keccak_init);
+
+#if SHA256_X86
+    if (_keccak_backends & KECCAK_BACKEND_AVX2) _BRKeccak256AVX2(md32s, data, dataLen, stride, count);
+    else
+#endif
+    for (size_t i = 0; i < count; i++) BRKeccak256((uint8_t *)md32s + i*32, (const uint8_t *)data + i*stride, dataLen);
 }
 
 // basic md5 functions
@@ -643,6 +1143,15 @@ void BRHMAC(void *mac, void (*hash)(void *, const void *, size_t), size_t hashLe
     assert(hashLen > 0 && (hashLen % 4) == 0);
     assert(key != NULL || keyLen == 0);
     assert(data != NULL || dataLen == 0);
+
+    if ((hash == BRSHA256 && hashLen == 32) || (hash == BRSHA512 && hashLen == 64)) {
+        BRHMACState ctx;
+
+        BRHMACInit(&ctx, hash, hashLen, key, keyLen);
+        BRHMACUpdate(&ctx, data, dataLen);
+        BRHMACFinal(&ctx, mac);
+        return;
+    }
     
     if (keyLen > blockLen) hash(k, key, keyLen), key = k, keyLen = sizeof(k);
     memset(kipad, 0, blockLen);
@@ -660,6 +1169,63 @@ void BRHMAC(void *mac, void (*hash)(void *, const void *, size_t), size_t hashLe
     mem_clean(kopad, blockLen);
 }
 
+// starts an incremental hmac, hashing key xor ipad and key xor opad into the inner and outer hash states up front
+void BRHMACInit(BRHMACState *ctx, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key,
+                size_t keyLen)
+{
+    size_t i, blockLen = (hashLen > 32) ? 128 : 64;
+    uint64_t k[128/sizeof(uint64_t)];
+
+    assert(ctx != NULL);
+    assert((hash == BRSHA256 && hashLen == 32) || (hash == BRSHA512 && hashLen == 64));
+    assert(key != NULL || keyLen == 0);
+
+    memset(k, 0, sizeof(k));
+    if (keyLen > blockLen) hash(k, key, keyLen);
+    else if (keyLen > 0) memcpy(k, key, keyLen);
+    ctx->hashLen = hashLen;
+
+    for (i = 0; i < blockLen/sizeof(uint64_t); i++) k[i] ^= 0x3636363636363636;
+    if (hashLen == 32) BRSHA256Init(&ctx->inner.sha256), BRSHA256Update(&ctx->inner.sha256, k, blockLen);
+    else BRSHA512Init(&ctx->inner.sha512), BRSHA512Update(&ctx->inner.sha512, k, blockLen);
+
+    for (i = 0; i < blockLen/sizeof(uint64_t); i++) k[i] ^= 0x3636363636363636 ^ 0x5c5c5c5c5c5c5c5c;
+    if (hashLen == 32) BRSHA256Init(&ctx->outer.sha256), BRSHA256Update(&ctx->outer.sha256, k, blockLen);
+    else BRSHA512Init(&ctx->outer.sha512), BRSHA512Update(&ctx->outer.sha512, k, blockLen);
+
+    mem_clean(k, sizeof(k));
+}
+
+void BRHMACUpdate(BRHMACState *ctx, const void *data, size_t dataLen)
+{
+    assert(ctx != NULL);
+    assert(data != NULL || dataLen == 0);
+    if (ctx->hashLen == 32) BRSHA256Update(&ctx->inner.sha256, data, dataLen);
+    else BRSHA512Update(&ctx->inner.sha512, data, dataLen);
+}
+
+void BRHMACFinal(BRHMACState *ctx, void *mac)
+{
+    uint8_t md[64];
+
+    assert(ctx != NULL);
+    assert(mac != NULL);
+
+    if (ctx->hashLen == 32) {
+        BRSHA256Final(&ctx->inner.sha256, md);
+        BRSHA256Update(&ctx->outer.sha256, md, 32);
+        BRSHA256Final(&ctx->outer.sha256, mac);
+    }
+    else {
+        BRSHA512Final(&ctx->inner.sha512, md);
+        BRSHA512Update(&ctx->outer.sha512, md, 64);
+        BRSHA512Final(&ctx->outer.sha512, mac);
+    }
+
+    mem_clean(md, sizeof(md));
+    mem_clean(ctx, sizeof(*ctx));
+}
+
 // hmac-drbg with no prediction resistance or additional input
 // K and V must point to buffers of size hashLen, and ps (personalization string) may be NULL
 // to generate additional drbg output, use K and V from the previous call, and set seed, nonce and ps to NULL
@@ -944,6 +1510,77 @@ static const uint8_t sboxi[256] = {
     0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63, 0x55, 0x21, 0x0c, 0x7d
 };
 
+// aes round tables, each entry a little-endian word holding the four bytes a row contributes to a mixed column
+static const uint32_t _aeste[256] = { // sbox[x] times the mix columns coefficients 2, 1, 1, 3
+    0xa56363c6, 0x847c7cf8, 0x997777ee, 0x8d7b7bf6, 0x0df2f2ff, 0xbd6b6bd6, 0xb16f6fde, 0x54c5c591,
+    0x50303060, 0x03010102, 0xa96767ce, 0x7d2b2b56, 0x19fefee7, 0x62d7d7b5, 0xe6abab4d, 0x9a7676ec,
+    0x45caca8f, 0x9d82821f, 0x40c9c989, 0x877d7dfa, 0x15fafaef, 0xeb5959b2, 0xc947478e, 0x0bf0f0fb,
+    0xecadad41, 0x67d4d4b3, 0xfda2a25f, 0xeaafaf45, 0xbf9c9c23, 0xf7a4a453, 0x967272e4, 0x5bc0c09b,
+    0xc2b7b775, 0x1cfdfde1, 0xae93933d, 0x6a26264c, 0x5a36366c, 0x413f3f7e, 0x02f7f7f5, 0x4fcccc83,
+    0x5c343468, 0xf4a5a551, 0x34e5e5d1, 0x08f1f1f9, 0x937171e2, 0x73d8d8ab, 0x53313162, 0x3f15152a,
+    0x0c040408, 0x52c7c795, 0x65232346, 0x5ec3c39d, 0x28181830, 0xa1969637, 0x0f05050a, 0xb59a9a2f,
+    0x0907070e, 0x36121224, 0x9b80801b, 0x3de2e2df, 0x26ebebcd, 0x6927274e, 0xcdb2b27f, 0x9f7575ea,
+    0x1b090912, 0x9e83831d, 0x742c2c58, 0x2e1a1a34, 0x2d1b1b36, 0xb26e6edc, 0xee5a5ab4, 0xfba0a05b,
+    0xf65252a4, 0x4d3b3b76, 0x61d6d6b7, 0xceb3b37d, 0x7b292952, 0x3ee3e3dd, 0x712f2f5e, 0x97848413,
+    0xf55353a6, 0x68d1d1b9, 0x00000000, 0x2cededc1, 0x60202040, 0x1ffcfce3, 0xc8b1b179, 0xed5b5bb6,
+    0xbe6a6ad4, 0x46cbcb8d, 0xd9bebe67, 0x4b393972, 0xde4a4a94, 0xd44c4c98, 0xe85858b0, 0x4acfcf85,
+    0x6bd0d0bb, 0x2aefefc5, 0xe5aaaa4f, 0x16fbfbed, 0xc5434386, 0xd74d4d9a, 0x55333366, 0x94858511,
+    0xcf45458a, 0x10f9f9e9, 0x06020204, 0x817f7ffe, 0xf05050a0, 0x443c3c78, 0xba9f9f25, 0xe3a8a84b,
+    0xf35151a2, 0xfea3a35d, 0xc0404080, 0x8a8f8f05, 0xad92923f, 0xbc9d9d21, 0x48383870, 0x04f5f5f1,
+    0xdfbcbc63, 0xc1b6b677, 0x75dadaaf, 0x63212142, 0x30101020, 0x1affffe5, 0x0ef3f3fd, 0x6dd2d2bf,
+    0x4ccdcd81, 0x140c0c18, 0x35131326, 0x2fececc3, 0xe15f5fbe, 0xa2979735, 0xcc444488, 0x3917172e,
+    0x57c4c493, 0xf2a7a755, 0x827e7efc, 0x473d3d7a, 0xac6464c8, 0xe75d5dba, 0x2b191932, 0x957373e6,
+    0xa06060c0, 0x98818119, 0xd14f4f9e, 0x7fdcdca3, 0x66222244, 0x7e2a2a54, 0xab90903b, 0x8388880b,
+    0xca46468c, 0x29eeeec7, 0xd3b8b86b, 0x3c141428, 0x79dedea7, 0xe25e5ebc, 0x1d0b0b16, 0x76dbdbad,
+    0x3be0e0db, 0x56323264, 0x4e3a3a74, 0x1e0a0a14, 0xdb494992, 0x0a06060c, 0x6c242448, 0xe45c5cb8,
+    0x5dc2c29f, 0x6ed3d3bd, 0xefacac43, 0xa66262c4, 0xa8919139, 0xa4959531, 0x37e4e4d3, 0x8b7979f2,
+    0x32e7e7d5, 0x43c8c88b, 0x5937376e, 0xb76d6dda, 0x8c8d8d01, 0x64d5d5b1, 0xd24e4e9c, 0xe0a9a949,
+    0xb46c6cd8, 0xfa5656ac, 0x07f4f4f3, 0x25eaeacf, 0xaf6565ca, 0x8e7a7af4, 0xe9aeae47, 0x18080810,
+    0xd5baba6f, 0x887878f0, 0x6f25254a, 0x722e2e5c, 0x241c1c38, 0xf1a6a657, 0xc7b4b473, 0x51c6c697,
+    0x23e8e8cb, 0x7cdddda1, 0x9c7474e8, 0x211f1f3e, 0xdd4b4b96, 0xdcbdbd61, 0x868b8b0d, 0x858a8a0f,
+    0x907070e0, 0x423e3e7c, 0xc4b5b571, 0xaa6666cc, 0xd8484890, 0x05030306, 0x01f6f6f7, 0x120e0e1c,
+    0xa36161c2, 0x5f35356a, 0xf95757ae, 0xd0b9b969, 0x91868617, 0x58c1c199, 0x271d1d3a, 0xb99e9e27,
+    0x38e1e1d9, 0x13f8f8eb, 0xb398982b, 0x33111122, 0xbb6969d2, 0x70d9d9a9, 0x898e8e07, 0xa7949433,
+    0xb69b9b2d, 0x221e1e3c, 0x92878715, 0x20e9e9c9, 0x49cece87, 0xff5555aa, 0x78282850, 0x7adfdfa5,
+    0x8f8c8c03, 0xf8a1a159, 0x80898909, 0x170d0d1a, 0xdabfbf65, 0x31e6e6d7, 0xc6424284, 0xb86868d0,
+    0xc3414182, 0xb0999929, 0x772d2d5a, 0x110f0f1e, 0xcbb0b07b, 0xfc5454a8, 0xd6bbbb6d, 0x3a16162c
+};
+
+static const uint32_t _aestd[256] = { // sboxi[x] times the inverse mix columns coefficients e, 9, d, b
+    0x50a7f451, 0x5365417e, 0xc3a4171a, 0x965e273a, 0xcb6bab3b, 0xf1459d1f, 0xab58faac, 0x9303e34b,
+    0x55fa3020, 0xf66d76ad, 0x9176cc88, 0x254c02f5, 0xfcd7e54f, 0xd7cb2ac5, 0x80443526, 0x8fa362b5,
+    0x495ab1de, 0x671bba25, 0x980eea45, 0xe1c0fe5d, 0x02752fc3, 0x12f04c81, 0xa397468d, 0xc6f9d36b,
+    0xe75f8f03, 0x959c9215, 0xeb7a6dbf, 0xda595295, 0x2d83bed4, 0xd3217458, 0x2969e049, 0x44c8c98e,
+    0x6a89c275, 0x78798ef4, 0x6b3e5899, 0xdd71b927, 0xb64fe1be, 0x17ad88f0, 0x66ac20c9, 0xb43ace7d,
+    0x184adf63, 0x82311ae5, 0x60335197, 0x457f5362, 0xe07764b1, 0x84ae6bbb, 0x1ca081fe, 0x942b08f9,
+    0x58684870, 0x19fd458f, 0x876cde94, 0xb7f87b52, 0x23d373ab, 0xe2024b72, 0x578f1fe3, 0x2aab5566,
+    0x0728ebb2, 0x03c2b52f, 0x9a7bc586, 0xa50837d3, 0xf2872830, 0xb2a5bf23, 0xba6a0302, 0x5c8216ed,
+    0x2b1ccf8a, 0x92b479a7, 0xf0f207f3, 0xa1e2694e, 0xcdf4da65, 0xd5be0506, 0x1f6234d1, 0x8afea6c4,
+    0x9d532e34, 0xa055f3a2, 0x32e18a05, 0x75ebf6a4, 0x39ec830b, 0xaaef6040, 0x069f715e, 0x51106ebd,
+    0xf98a213e, 0x3d06dd96, 0xae053edd, 0x46bde64d, 0xb58d5491, 0x055dc471, 0x6fd40604, 0xff155060,
+    0x24fb9819, 0x97e9bdd6, 0xcc434089, 0x779ed967, 0xbd42e8b0, 0x888b8907, 0x385b19e7, 0xdbeec879,
+    0x470a7ca1, 0xe90f427c, 0xc91e84f8, 0x00000000, 0x83868009, 0x48ed2b32, 0xac70111e, 0x4e725a6c,
+    0xfbff0efd, 0x5638850f, 0x1ed5ae3d, 0x27392d36, 0x64d90f0a, 0x21a65c68, 0xd1545b9b, 0x3a2e3624,
+    0xb1670a0c, 0x0fe75793, 0xd296eeb4, 0x9e919b1b, 0x4fc5c080, 0xa220dc61, 0x694b775a, 0x161a121c,
+    0x0aba93e2, 0xe52aa0c0, 0x43e0223c, 0x1d171b12, 0x0b0d090e, 0xadc78bf2, 0xb9a8b62d, 0xc8a91e14,
+    0x8519f157, 0x4c0775af, 0xbbdd99ee, 0xfd607fa3, 0x9f2601f7, 0xbcf5725c, 0xc53b6644, 0x347efb5b,
+    0x7629438b, 0xdcc623cb, 0x68fcedb6, 0x63f1e4b8, 0xcadc31d7, 0x10856342, 0x40229713, 0x2011c684,
+    0x7d244a85, 0xf83dbbd2, 0x1132f9ae, 0x6da129c7, 0x4b2f9e1d, 0xf330b2dc, 0xec52860d, 0xd0e3c177,
+    0x6c16b32b, 0x99b970a9, 0xfa489411, 0x2264e947, 0xc48cfca8, 0x1a3ff0a0, 0xd82c7d56, 0xef903322,
+    0xc74e4987, 0xc1d138d9, 0xfea2ca8c, 0x360bd498, 0xcf81f5a6, 0x28de7aa5, 0x268eb7da, 0xa4bfad3f,
+    0xe49d3a2c, 0x0d927850, 0x9bcc5f6a, 0x62467e54, 0xc2138df6, 0xe8b8d890, 0x5ef7392e, 0xf5afc382,
+    0xbe805d9f, 0x7c93d069, 0xa92dd56f, 0xb31225cf, 0x3b99acc8, 0xa77d1810, 0x6e639ce8, 0x7bbb3bdb,
+    0x097826cd, 0xf418596e, 0x01b79aec, 0xa89a4f83, 0x656e95e6, 0x7ee6ffaa, 0x08cfbc21, 0xe6e815ef,
+    0xd99be7ba, 0xce366f4a, 0xd4099fea, 0xd67cb029, 0xafb2a431, 0x31233f2a, 0x3094a5c6, 0xc066a235,
+    0x37bc4e74, 0xa6ca82fc, 0xb0d090e0, 0x15d8a733, 0x4a9804f1, 0xf7daec41, 0x0e50cd7f, 0x2ff69117,
+    0x8dd64d76, 0x4db0ef43, 0x544daacc, 0xdf0496e4, 0xe3b5d19e, 0x1b886a4c, 0xb81f2cc1, 0x7f516546,
+    0x04ea5e9d, 0x5d358c01, 0x737487fa, 0x2e410bfb, 0x5a1d67b3, 0x52d2db92, 0x335610e9, 0x1347d66d,
+    0x8c61d79a, 0x7a0ca137, 0x8e14f859, 0x893c13eb, 0xee27a9ce, 0x35c961b7, 0xede51ce1, 0x3cb1477a,
+    0x59dfd29c, 0x3f73f255, 0x79ce1418, 0xbf37c773, 0xeacdf753, 0x5baafd5f, 0x146f3ddf, 0x86db4478,
+    0x81f3afca, 0x3ec468b9, 0x2c342438, 0x5f40a3c2, 0x72c31d16, 0x0c25e2bc, 0x8b493c28, 0x41950dff,
+    0x7101a839, 0xdeb30c08, 0x9ce4b4d8, 0x90c15664, 0x6184cb7b, 0x70b632d5, 0x745c6c48, 0x4257b8d0
+};
+
 #define xt(x) (((x) << 1) ^ ((((x) >> 7) & 1)*0x1b))
 
 static void _BRAESExpandKey(uint8_t k[256], const void *key, size_t kl)
@@ -960,89 +1597,290 @@ static void _BRAESExpandKey(uint8_t k[256], const void *key, size_t kl)
     }
 }
 
-static void _BRAESCipher(uint8_t x[16], const uint8_t k[256], size_t kl)
+// one round of the cipher on columns s0-s3, with the rows shifted by taking row i of each column from i columns on
+#define aesround(t, s0, s1, s2, s3, k) ((t)[s0 & 0xff] ^ rol32((t)[(s1 >> 8) & 0xff], 8) ^\
+    rol32((t)[(s2 >> 16) & 0xff], 16) ^ rol32((t)[s3 >> 24], 24) ^ le32(k))
+#define aeslast(b, s0, s1, s2, s3, k) (((b)[s0 & 0xff] | (b)[(s1 >> 8) & 0xff] << 8 |\
+    (b)[(s2 >> 16) & 0xff] << 16 | (uint32_t)(b)[s3 >> 24] << 24) ^ le32(k))
+
+// encrypts blocks consecutive 16 byte blocks in place, one table lookup per byte per round
+// NOTE: like the sbox lookups it replaces, this is not a constant time algorithm
+static void _BRAESEncrypt(const BRAESContext *ctx, void *buf, size_t blocks)
 {
-    uint8_t a, b, c, d, e;
-    size_t i, j, rounds = kl/4 + 6;
-    
-    for (j = 0; j < 16; j++) x[j] ^= k[j]; // first add round key
-    
-    for (i = 0; i < rounds; i++) {
-        for (j = 0; j < 16; j++) x[j] = sbox[x[j]]; // sub bytes
-        
-        // shift rows
-        a = x[1], x[1] = x[5], x[5] = x[9], x[9] = x[13], x[13] = a, a = x[10], x[10] = x[2], x[2] = a;
-        a = x[3], x[3] = x[15], x[15] = x[11], x[11] = x[7], x[7] = a, a = x[14], x[14] = x[6], x[6] = a;
-        
-        for (j = 0; i < rounds - 1 && j < 16; j += 4) { // mix columns
-            a = x[j], b = x[j + 1], c = x[j + 2], d = x[j + 3], e = a ^ b ^ c ^ d;
-            x[j] ^= e ^ xt(a ^ b), x[j + 1] ^= e ^ xt(b ^ c), x[j + 2] ^= e ^ xt(c ^ d), x[j + 3] ^= e ^ xt(d ^ a);
+    const uint32_t *k;
+    uint32_t x[4], s0, s1, s2, s3, t0, t1, t2, t3;
+    size_t i, j;
+
+    for (i = 0; i < blocks; i++) {
+        k = ctx->ek;
+        memcpy(x, (uint8_t *)buf + i*16, sizeof(x));
+        s0 = le32(x[0]) ^ le32(k[0]), s1 = le32(x[1]) ^ le32(k[1]), s2 = le32(x[2]) ^ le32(k[2]);
+        s3 = le32(x[3]) ^ le32(k[3]);
+
+        for (j = 1; j < ctx->rounds; j++) {
+            k += 4;
+            t0 = aesround(_aeste, s0, s1, s2, s3, k[0]), t1 = aesround(_aeste, s1, s2, s3, s0, k[1]);
+            t2 = aesround(_aeste, s2, s3, s0, s1, k[2]), t3 = aesround(_aeste, s3, s0, s1, s2, k[3]);
+            s0 = t0, s1 = t1, s2 = t2, s3 = t3;
         }
-        
-        for (j = 0; j < 16; j++) x[j] ^= k[(i + 1)*16 + j]; // add round key
+
+        k += 4; // the last round has no mix columns
+        t0 = aeslast(sbox, s0, s1, s2, s3, k[0]), t1 = aeslast(sbox, s1, s2, s3, s0, k[1]);
+        t2 = aeslast(sbox, s2, s3, s0, s1, k[2]), t3 = aeslast(sbox, s3, s0, s1, s2, k[3]);
+        x[0] = le32(t0), x[1] = le32(t1), x[2] = le32(t2), x[3] = le32(t3);
+        memcpy((uint8_t *)buf + i*16, x, sizeof(x));
     }
-    
-    var_clean(&a, &b, &c, &d, &e);
+
+    var_clean(&s0, &s1, &s2, &s3, &t0, &t1, &t2, &t3);
+    mem_clean(x, sizeof(x));
 }
 
-static void _BRAESDecipher(uint8_t x[16], const uint8_t k[256], size_t kl)
+// decrypts blocks consecutive 16 byte blocks in place, as the equivalent inverse cipher using the round keys in dk
+static void _BRAESDecrypt(const BRAESContext *ctx, void *buf, size_t blocks)
 {
-    uint8_t a, b, c, d, e, f, g;
-    size_t i, j, rounds = kl/4 + 6;
-    
-    for (j = 0; j < 16; j++) x[j] ^= k[rounds*16 + j]; // first add round key
-    
-    for (i = rounds; i > 0; i--) {
-        // unshift rows
-        a = x[1], x[1] = x[13], x[13] = x[9], x[9] = x[5], x[5] = a, a = x[2], x[2] = x[10], x[10] = a;
-        a = x[3], x[3] = x[7], x[7] = x[11], x[11] = x[15], x[15] = a, a = x[6], x[6] = x[14], x[14] = a;
-        
-        for (j = 0; j < 16; j++) x[j] = sboxi[x[j]]; // unsub bytes
-        
-        for (j = 0; j < 16; j++) x[j] ^= k[(i - 1)*16 + j]; // add round key
-        
-        for (j = 0; i > 1 && j < 16; j += 4) { // unmix columns
-            a = x[j], b = x[j + 1], c = x[j + 2], d = x[j + 3], e = a ^ b ^ c ^ d;
-            f = e ^ xt(xt(xt(e) ^ a ^ c)), g = e ^ xt(xt(xt(e) ^ b ^ d));
-            x[j] ^= f ^ xt(a ^ b), x[j + 1] ^= g ^ xt(b ^ c), x[j + 2] ^= f ^ xt(c ^ d), x[j + 3] ^= g ^ xt(d ^ a);
+    const uint32_t *k;
+    uint32_t x[4], s0, s1, s2, s3, t0, t1, t2, t3;
+    size_t i, j;
+
+    for (i = 0; i < blocks; i++) {
+        k = ctx->dk;
+        memcpy(x, (uint8_t *)buf + i*16, sizeof(x));
+        s0 = le32(x[0]) ^ le32(k[0]), s1 = le32(x[1]) ^ le32(k[1]), s2 = le32(x[2]) ^ le32(k[2]);
+        s3 = le32(x[3]) ^ le32(k[3]);
+
+        for (j = 1; j < ctx->rounds; j++) { // rows are unshifted by taking row i of each column from i columns back
+            k += 4;
+            t0 = aesround(_aestd, s0, s3, s2, s1, k[0]), t1 = aesround(_aestd, s1, s0, s3, s2, k[1]);
+            t2 = aesround(_aestd, s2, s1, s0, s3, k[2]), t3 = aesround(_aestd, s3, s2, s1, s0, k[3]);
+            s0 = t0, s1 = t1, s2 = t2, s3 = t3;
         }
+
+        k += 4;
+        t0 = aeslast(sboxi, s0, s3, s2, s1, k[0]), t1 = aeslast(sboxi, s1, s0, s3, s2, k[1]);
+        t2 = aeslast(sboxi, s2, s1, s0, s3, k[2]), t3 = aeslast(sboxi, s3, s2, s1, s0, k[3]);
+        x[0] = le32(t0), x[1] = le32(t1), x[2] = le32(t2), x[3] = le32(t3);
+        memcpy((uint8_t *)buf + i*16, x, sizeof(x));
     }
-    
-    var_clean(&a, &b, &c, &d, &e, &f, &g);
+
+    var_clean(&s0, &s1, &s2, &s3, &t0, &t1, &t2, &t3);
+    mem_clean(x, sizeof(x));
+}
+
+#if SHA256_X86
+// x86 aes-ni, with four blocks in flight at a time to hide the latency of each round
+__attribute__((target("aes,sse2")))
+static void _BRAESEncryptNI(const BRAESContext *ctx, void *buf, size_t blocks)
+{
+    const __m128i *k = (const __m128i *)ctx->ek;
+    __m128i *b = buf, k0 = _mm_loadu_si128(&k[0]), kr, x0, x1, x2, x3;
+    size_t i = 0, j;
+
+    for (; i + 4 <= blocks; i += 4) {
+        x0 = _mm_xor_si128(_mm_loadu_si128(&b[i]), k0), x1 = _mm_xor_si128(_mm_loadu_si128(&b[i + 1]), k0);
+        x2 = _mm_xor_si128(_mm_loadu_si128(&b[i + 2]), k0), x3 = _mm_xor_si128(_mm_loadu_si128(&b[i + 3]), k0);
+
+        for (j = 1; j < ctx->rounds; j++) {
+            kr = _mm_loadu_si128(&k[j]);
+            x0 = _mm_aesenc_si128(x0, kr), x1 = _mm_aesenc_si128(x1, kr);
+            x2 = _mm_aesenc_si128(x2, kr), x3 = _mm_aesenc_si128(x3, kr);
+        }
+
+        kr = _mm_loadu_si128(&k[ctx->rounds]);
+        _mm_storeu_si128(&b[i], _mm_aesenclast_si128(x0, kr));
+        _mm_storeu_si128(&b[i + 1], _mm_aesenclast_si128(x1, kr));
+        _mm_storeu_si128(&b[i + 2], _mm_aesenclast_si128(x2, kr));
+        _mm_storeu_si128(&b[i + 3], _mm_aesenclast_si128(x3, kr));
+    }
+
+    for (; i < blocks; i++) {
+        x0 = _mm_xor_si128(_mm_loadu_si128(&b[i]), k0);
+        for (j = 1; j < ctx->rounds; j++) x0 = _mm_aesenc_si128(x0, _mm_loadu_si128(&k[j]));
+        _mm_storeu_si128(&b[i], _mm_aesenclast_si128(x0, _mm_loadu_si128(&k[ctx->rounds])));
+    }
+}
+
+__attribute__((target("aes,sse2")))
+static void _BRAESDecryptNI(const BRAESContext *ctx, void *buf, size_t blocks)
+{
+    const __m128i *k = (const __m128i *)ctx->dk;
+    __m128i *b = buf, x;
+    size_t i, j;
+
+    for (i = 0; i < blocks; i++) {
+        x = _mm_xor_si128(_mm_loadu_si128(&b[i]), _mm_loadu_si128(&k[0]));
+        for (j = 1; j < ctx->rounds; j++) x = _mm_aesdec_si128(x, _mm_loadu_si128(&k[j]));
+        _mm_storeu_si128(&b[i], _mm_aesdeclast_si128(x, _mm_loadu_si128(&k[ctx->rounds])));
+    }
+}
+#endif
+
+static void (*_aes_encrypt)(const BRAESContext *ctx, void *buf, size_t blocks) = _BRAESEncrypt;
+static void (*_aes_decrypt)(const BRAESContext *ctx, void *buf, size_t blocks) = _BRAESDecrypt;
+static int _aes_supported = 0, _aes_backends = 0;
+static pthread_once_t _aes_once = PTHREAD_ONCE_INIT;
+
+static void _aes_select(int backends)
+{
+    _aes_backends = backends & _aes_supported;
+    _aes_encrypt = _BRAESEncrypt, _aes_decrypt = _BRAESDecrypt;
+#if SHA256_X86
+    if (_aes_backends & AES_BACKEND_NI) _aes_encrypt = _BRAESEncryptNI, _aes_decrypt = _BRAESDecryptNI;
+#endif
+}
+
+static void _aes_init(void)
+{
+#if SHA256_X86
+    unsigned a, b, c, d;
+
+    if (__get_cpuid(1, &a, &b, &c, &d) && (c & (1 << 25))) _aes_supported |= AES_BACKEND_NI;
+#endif
+    _aes_select(_aes_supported);
+}
+
+// returns the aes backends supported by the cpu, as a mask of AES_BACKEND_* flags
+int BRAESBackends(void)
+{
+    pthread_once(&_aes_once, _aes_init);
+    return _aes_supported;
+}
+
+// limits aes to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be ciphering
+int BRAESSetBackends(int backends)
+{
+    pthread_once(&_aes_once, _aes_init);
+    _aes_select(backends);
+    return _aes_backends;
+}
+
+// expands key into the round keys for encryption, and for decryption with inverse mix columns applied to all but the
+// first and last, as both the portable and hardware inverse ciphers use them
+void BRAESContextInit(BRAESContext *ctx, const void *key, size_t keyLen)
+{
+    uint8_t k[256];
+    uint32_t w;
+    size_t i, j;
+
+    assert(ctx != NULL);
+    assert(key != NULL);
+    assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
+    pthread_once(&_aes_once, _aes_init);
+
+    ctx->rounds = (unsigned)(keyLen/4 + 6);
+    _BRAESExpandKey(k, key, keyLen);
+    memcpy(ctx->ek, k, (ctx->rounds + 1)*16);
+    memcpy(&ctx->dk[0], &ctx->ek[ctx->rounds*4], 16);
+    memcpy(&ctx->dk[ctx->rounds*4], &ctx->ek[0], 16);
+
+    for (i = 1; i < ctx->rounds; i++) {
+        for (j = 0; j < 4; j++) { // _aestd[sbox[x]] is x times the inverse mix columns coefficients
+            w = le32(ctx->ek[(ctx->rounds - i)*4 + j]);
+            w = _aestd[sbox[w & 0xff]] ^ rol32(_aestd[sbox[(w >> 8) & 0xff]], 8) ^
+                rol32(_aestd[sbox[(w >> 16) & 0xff]], 16) ^ rol32(_aestd[sbox[w >> 24]], 24);
+            ctx->dk[i*4 + j] = le32(w);
+        }
+    }
+
+    mem_clean(k, sizeof(k));
+    var_clean(&w);
+}
+
+// aes-ecb of bufLen bytes in place, a multiple of 16
+void BRAESContextECBEncrypt(const BRAESContext *ctx, void *buf, size_t bufLen)
+{
+    assert(ctx != NULL);
+    assert(buf != NULL || bufLen == 0);
+    assert(bufLen % 16 == 0);
+    _aes_encrypt(ctx, buf, bufLen/16);
+}
+
+void BRAESContextECBDecrypt(const BRAESContext *ctx, void *buf, size_t bufLen)
+{
+    assert(ctx != NULL);
+    assert(buf != NULL || bufLen == 0);
+    assert(bufLen % 16 == 0);
+    _aes_decrypt(ctx, buf, bufLen/16);
+}
+
+// aes-ctr stream cipher encrypt/decrypt, with the big-endian counter in iv16 advanced past each block used
+void BRAESContextCTR(const BRAESContext *ctx, void *out, void *iv16, const void *data, size_t dataLen)
+{
+    uint8_t x[64];
+    uint64_t hi, lo, a, b;
+    size_t i, n;
+
+    assert(ctx != NULL);
+    assert(out != NULL || dataLen == 0);
+    assert(iv16 != NULL);
+    assert(data != NULL || dataLen == 0);
+    memcpy(&hi, iv16, sizeof(hi));
+    memcpy(&lo, (uint8_t *)iv16 + 8, sizeof(lo));
+    hi = be64(hi), lo = be64(lo);
+
+    while (dataLen > 0) {
+        n = (dataLen < sizeof(x)) ? dataLen : sizeof(x);
+
+        for (i = 0; i < n; i += 16) { // counter blocks for up to four blocks at a time
+            a = be64(hi), b = be64(lo);
+            memcpy(&x[i], &a, sizeof(a));
+            memcpy(&x[i + 8], &b, sizeof(b));
+            if (++lo == 0) hi++; // increment iv with overflow
+        }
+
+        _aes_encrypt(ctx, x, (n + 15)/16); // generate xor compliment
+
+        for (i = 0; i + 8 <= n; i += 8) {
+            memcpy(&a, (const uint8_t *)data + i, sizeof(a));
+            memcpy(&b, &x[i], sizeof(b));
+            a ^= b;
+            memcpy((uint8_t *)out + i, &a, sizeof(a));
+        }
+
+        for (; i < n; i++) ((uint8_t *)out)[i] = ((const uint8_t *)data)[i] ^ x[i];
+        out = (uint8_t *)out + n, data = (const uint8_t *)data + n, dataLen -= n;
+    }
+
+    hi = be64(hi), lo = be64(lo);
+    memcpy(iv16, &hi, sizeof(hi));
+    memcpy((uint8_t *)iv16 + 8, &lo, sizeof(lo));
+    mem_clean(x, sizeof(x));
+    var_clean(&a, &b);
 }
 
 // aes-ecb block cipher
 void BRAESECBEncrypt(void *buf16, const void *key, size_t keyLen)
 {
-    uint8_t k[256];
+    BRAESContext ctx;
     
     assert(buf16 != NULL);
     assert(key != NULL);
     assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
     
-    _BRAESExpandKey(k, key, keyLen);
-    _BRAESCipher(buf16, k, keyLen);
-    mem_clean(k, sizeof(k));
+    BRAESContextInit(&ctx, key, keyLen);
+    _aes_encrypt(&ctx, buf16, 1);
+    mem_clean(&ctx, sizeof(ctx));
 }
 
 void BRAESECBDecrypt(void *buf16, const void *key, size_t keyLen)
 {
-    uint8_t k[256];
+    BRAESContext ctx;
     
     assert(buf16 != NULL);
     assert(key != NULL);
     assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
     
-    _BRAESExpandKey(k, key, keyLen);
-    _BRAESDecipher(buf16, k, keyLen);
-    mem_clean(k, sizeof(k));
+    BRAESContextInit(&ctx, key, keyLen);
+    _aes_decrypt(&ctx, buf16, 1);
+    mem_clean(&ctx, sizeof(ctx));
 }
 
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const void *data, size_t dataLen)
 {
-    uint8_t x[16], iv[16], k[256];
-    size_t off, i;
+    BRAESContext ctx;
+    uint8_t iv[16];
     
     assert(out != NULL);
     assert(key != NULL);
@@ -1051,49 +1889,25 @@ void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const
     assert(data != NULL || dataLen == 0);
     
     memcpy(iv, iv16, 16);
-    _BRAESExpandKey(k, key, keyLen);
-    
-    for (off = 0; off < dataLen; off++) {
-        if ((off % 16) == 0) { // generate xor compliment
-            memcpy(x, iv, 16);
-            _BRAESCipher(x, k, keyLen);
-            i = 16;
-            do { iv[--i]++; } while (iv[i] == 0 && i > 0); // increment iv with overflow
-        }
-        
-        ((uint8_t *)out)[off] = (((uint8_t *)data)[off] ^ x[off % 16]);
-    }
-    
-    mem_clean(k, sizeof(k));
-    mem_clean(x, sizeof(x));
+    BRAESContextInit(&ctx, key, keyLen);
+    BRAESContextCTR(&ctx, out, iv, data, dataLen);
+    mem_clean(&ctx, sizeof(ctx));
 }
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR_OFFSET(void *out, size_t outLen, const void *key, size_t keyLen, void *iv16, const void *data, size_t dataLen)
 {
-    uint8_t x[16], iv[16], k[256];
-    size_t off, i, outIdx = 0;
+    BRAESContext ctx;
     
     assert(out != NULL);
     assert(key != NULL);
     assert(keyLen == 16 || keyLen == 24 || keyLen == 32);
     assert(iv16 != NULL);
     assert(data != NULL || dataLen == 0);
+    assert((dataLen - outLen) % 16 == 0); // the keystream can only be resumed at a block boundary
     
-    memcpy(iv, iv16, 16);
-    _BRAESExpandKey(k, key, keyLen);
-    
-    for (off = (dataLen - outLen); off < dataLen; off++, outIdx++) {
-        if ((off % 16) == 0) { // generate xor compliment
-            memcpy(x, iv, 16);
-            _BRAESCipher(x, k, keyLen);
-            i = 16;
-            do { iv[--i]++; } while (iv[i] == 0 && i > 0); // increment iv with overflow
-        }
-        ((uint8_t *)out)[outIdx] = (((uint8_t *)data)[outIdx] ^ x[outIdx % 16]);
-    }
-    memcpy(iv16, iv, 16);
-    mem_clean(k, sizeof(k));
-    mem_clean(x, sizeof(x));
+    BRAESContextInit(&ctx, key, keyLen);
+    BRAESContextCTR(&ctx, out, iv16, data, outLen);
+    mem_clean(&ctx, sizeof(ctx));
 }
 
 
@@ -1116,6 +1930,11 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
     assert(pw != NULL || pwLen == 0);
     assert(salt != NULL || saltLen == 0);
     assert(rounds > 0);
+
+    if ((hash == BRSHA256 && hashLen == 32) || (hash == BRSHA512 && hashLen == 64)) {
+        BRPBKDF2Batch(dk, dkLen, hash, hashLen, &pw, &pwLen, salt, saltLen, rounds, 1);
+        return;
+    }
     
     memcpy(s, salt, saltLen);
     
@@ -1139,6 +1958,122 @@ void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t)
     mem_clean(T, sizeof(T));
 }
 
+// pbkdf2 of count passwords with the same salt, several at once in vector lanes - word i of lane l of T, U, and of the
+// hash states after each password's ipad and opad blocks, is at [i*lanes + l] in host byte order, and since U and the
+// inner digest each fit in a single padded block after those, every round past the first is just two compressions
+#define pbkdf2lanes(name, type, hash, state, be)\
+static void name(void *dks, size_t dkLen, const void *const pws[], const size_t pwLens[], const void *salt,\
+                 size_t saltLen, unsigned rounds, size_t count, void (*compress)(type *, const type *), size_t lanes)\
+{\
+    BRHMACState ctx[lanes], c;\
+    type T[8*lanes], U[8*lanes], ipad[8*lanes], opad[8*lanes], r[8*lanes], x[16*lanes], md[8];\
+    size_t i, j, k, l, n, hashLen = sizeof(md), blocks = (dkLen + hashLen - 1)/hashLen;\
+    uint32_t b;\
+\
+    memset(x, 0, sizeof(x));\
+\
+    for (l = 0; l < lanes; l++) { /* append padding and length in bits, of the ipad or opad block and a digest */\
+        x[8*lanes + l] = (type)1 << (sizeof(type)*8 - 1);\
+        x[15*lanes + l] = (type)(16*sizeof(type) + hashLen)*8;\
+    }\
+\
+    for (i = 0; i + lanes <= count; i += lanes) {\
+        for (l = 0; l < lanes; l++) {\
+            BRHMACInit(&ctx[l], hash, hashLen, pws[i + l], pwLens[i + l]);\
+\
+            for (j = 0; j < 8; j++) {\
+                ipad[j*lanes + l] = ctx[l].inner.state.h[j];\
+                opad[j*lanes + l] = ctx[l].outer.state.h[j];\
+            }\
+\
+            BRHMACUpdate(&ctx[l], salt, saltLen);\
+        }\
+\
+        for (k = 0; k < blocks; k++) {\
+            for (l = 0; l < lanes; l++) {\
+                c = ctx[l], b = be32((uint32_t)k + 1);\
+                BRHMACUpdate(&c, &b, sizeof(b));\
+                BRHMACFinal(&c, md); /* U1 = hmac_hash(pw, salt || be32(i)) */\
+                for (j = 0; j < 8; j++) T[j*lanes + l] = U[j*lanes + l] = be(md[j]);\
+            }\
+\
+            for (unsigned round = 1; round < rounds; round++) { /* Urounds = hmac_hash(pw, Urounds-1) */\
+                memcpy(x, U, sizeof(U)), memcpy(r, ipad, sizeof(r));\
+                compress(r, x);\
+                memcpy(x, r, sizeof(r)), memcpy(r, opad, sizeof(r));\
+                compress(r, x);\
+                for (j = 0; j < 8*lanes; j++) U[j] = r[j], T[j] ^= r[j]; /* Ti = U1 ^ U2 ^ ... ^ Urounds */\
+            }\
+\
+            for (l = 0; l < lanes; l++) { /* dk = T1 || T2 || ... || Tdklen/hlen */\
+                for (j = 0; j < 8; j++) md[j] = be(T[j*lanes + l]);\
+                n = (k*hashLen + hashLen <= dkLen) ? hashLen : dkLen % hashLen;\
+                memcpy((uint8_t *)dks + (i + l)*dkLen + k*hashLen, md, n);\
+            }\
+        }\
+    }\
+\
+    mem_clean(ctx, sizeof(ctx));\
+    mem_clean(&c, sizeof(c));\
+    mem_clean(T, sizeof(T));\
+    mem_clean(U, sizeof(U));\
+    mem_clean(ipad, sizeof(ipad));\
+    mem_clean(opad, sizeof(opad));\
+    mem_clean(r, sizeof(r));\
+    mem_clean(x, sizeof(x));\
+    mem_clean(md, sizeof(md));\
+}
+
+pbkdf2lanes(_BRPBKDF2SHA256Lanes, uint32_t, BRSHA256, sha256, be32)
+pbkdf2lanes(_BRPBKDF2SHA512Lanes, uint64_t, BRSHA512, sha512, be64)
+
+// pbkdf2 of count passwords, pws[i] of pwLens[i] bytes, all with the same salt, written to dks dkLen bytes apart
+// several passwords are derived at once in vector lanes for hmac-sha256 and hmac-sha512, when the cpu supports it
+void BRPBKDF2Batch(void *dks, size_t dkLen, void (*hash)(void *, const void *, size_t), size_t hashLen,
+                   const void *const pws[], const size_t pwLens[], const void *salt, size_t saltLen, unsigned rounds,
+                   size_t count)
+{
+    size_t i = 0;
+
+    assert(dks != NULL || dkLen == 0 || count == 0);
+    assert(hash != NULL);
+    assert(hashLen > 0 && (hashLen % 4) == 0);
+    assert(pws != NULL || count == 0);
+    assert(pwLens != NULL || count == 0);
+    assert(salt != NULL || saltLen == 0);
+    assert(rounds > 0);
+    pthread_once(&_sha256_once, _sha256_init);
+
+    if (hash == BRSHA256 && hashLen == 32) {
+#if SHA256_LANES
+        if (_sha256_lanes) {
+            i = count - count % _sha256_lanesCount;
+            _BRPBKDF2SHA256Lanes(dks, dkLen, pws, pwLens, salt, saltLen, rounds, i, _sha256_lanes, _sha256_lanesCount);
+        }
+#endif
+        _BRPBKDF2SHA256Lanes((uint8_t *)dks + i*dkLen, dkLen, &pws[i], &pwLens[i], salt, saltLen, rounds, count - i,
+                             _BRSHA256CompressHost, 1);
+    }
+    else if (hash == BRSHA512 && hashLen == 64) {
+#if SHA256_X86
+        pthread_once(&_sha512_once, _sha512_init);
+
+        if (_sha512_backends & SHA512_BACKEND_AVX2) {
+            i = count - count % 4;
+            _BRPBKDF2SHA512Lanes(dks, dkLen, pws, pwLens, salt, saltLen, rounds, i, _BRSHA512CompressAVX2, 4);
+        }
+#endif
+        _BRPBKDF2SHA512Lanes((uint8_t *)dks + i*dkLen, dkLen, &pws[i], &pwLens[i], salt, saltLen, rounds, count - i,
+                             _BRSHA512CompressHost, 1);
+    }
+    else {
+        for (; i < count; i++) {
+            BRPBKDF2((uint8_t *)dks + i*dkLen, dkLen, hash, hashLen, pws[i], pwLens[i], salt, saltLen, rounds);
+        }
+    }
+}
+
+#if ! (SHA256_X86 && defined(__SSE2__)) // portable scrypt mix, the SSE2 one below replaces it on x86
 // salsa20/8 stream cipher: http://cr.yp.to/snuffle.html
 static void _salsa20_8(uint32_t b[16])
 {
@@ -1177,50 +2112,174 @@ static void _blockmix_salsa8(uint64_t *dest, const uint64_t *src, uint64_t *b, u
     }
 }
 
-// scrypt key derivation: http://www.tarsnap.com/scrypt.html
-void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
-              unsigned n, unsigned r, unsigned p)
+// scrypt romix of the 128*r byte block b in place, using 128*r*n bytes of scratch
+static void _romix_salsa8(uint32_t *b, void *scratch, unsigned n, unsigned r)
 {
-    uint64_t x[16*r], y[16*r], z[8], *v = malloc(128*r*n), m;
-    uint32_t b[32*r*p];
-    
-    assert(v != NULL);
-    assert(dk != NULL || dkLen == 0);
-    assert(pw != NULL || pwLen == 0);
-    assert(salt != NULL || saltLen == 0);
-    assert(n > 0);
-    assert(r > 0);
-    assert(p > 0);
+    uint64_t x[16*r], y[16*r], z[8], *v = scratch, m;
+
+    for (unsigned j = 0; j < 32*r; j++) ((uint32_t *)x)[j] = le32(b[j]);
     
-    BRPBKDF2(b, sizeof(b), BRSHA256, 256/8, pw, pwLen, salt, saltLen, 1);
+    for (unsigned j = 0; j < n; j += 2) {
+        memcpy(&v[j*(16*r)], x, 128*r);
+        _blockmix_salsa8(y, x, z, r);
+        memcpy(&v[(j + 1)*(16*r)], y, 128*r);
+        _blockmix_salsa8(x, y, z, r);
+    }
     
-    for (int i = 0; i < p; i++) {
-        for (unsigned j = 0; j < 32*r; j++) ((uint32_t *)x)[j] = le32(b[i*32*r + j]);
-        
-        for (unsigned j = 0; j < n; j += 2) {
-            memcpy(&v[j*(16*r)], x, 128*r);
-            _blockmix_salsa8(y, x, z, r);
-            memcpy(&v[(j + 1)*(16*r)], y, 128*r);
-            _blockmix_salsa8(x, y, z, r);
-        }
-        
-        for (unsigned j = 0; j < n; j += 2) {
-            m = le64(x[(2*r - 1)*8]) & (n - 1);
-            for (unsigned k = 0; k < 16*r; k++) x[k] ^= v[m*(16*r) + k];
-            _blockmix_salsa8(y, x, z, r);
-            m = le64(y[(2*r - 1)*8]) & (n - 1);
-            for (unsigned k = 0; k < 16*r; k++) y[k] ^= v[m*(16*r) + k];
-            _blockmix_salsa8(x, y, z, r);
-        }
-        
-        for (unsigned j = 0; j < 32*r; j++) b[i*32*r + j] = le32(((uint32_t *)x)[j]);
+    for (unsigned j = 0; j < n; j += 2) {
+        m = le64(x[(2*r - 1)*8]) & (n - 1);
+        for (unsigned k = 0; k < 16*r; k++) x[k] ^= v[m*(16*r) + k];
+        _blockmix_salsa8(y, x, z, r);
+        m = le64(y[(2*r - 1)*8]) & (n - 1);
+        for (unsigned k = 0; k < 16*r; k++) y[k] ^= v[m*(16*r) + k];
+        _blockmix_salsa8(x, y, z, r);
     }
     
-    BRPBKDF2(dk, dkLen, BRSHA256, 256/8, pw, pwLen, b, sizeof(b), 1);
-    mem_clean(b, sizeof(b));
+    for (unsigned j = 0; j < 32*r; j++) b[j] = le32(((uint32_t *)x)[j]);
     mem_clean(x, sizeof(x));
     mem_clean(y, sizeof(y));
     mem_clean(z, sizeof(z));
-    mem_clean(v, 128*r*n);
-    free(v);
+}
+#else
+#define rol32x4(a, b) _mm_or_si128(_mm_slli_epi32((a), (b)), _mm_srli_epi32((a), 32 - (b)))
+
+// salsa20/8 of a block held as its diagonals, x0 = (b0, b5, b10, b15), x1 = (b4, b9, b14, b3), x2 = (b8, b13, b2, b7),
+// x3 = (b12, b1, b6, b11), so that each quarter of the column and row rounds works on whole vectors
+#define salsa20_8x4(x0, x1, x2, x3) do {\
+    __m128i t0 = x0, t1 = x1, t2 = x2, t3 = x3;\
+\
+    for (unsigned i = 0; i < 8; i += 2) {\
+        x1 = _mm_xor_si128(x1, rol32x4(_mm_add_epi32(x0, x3), 7)); /* operate on columns */\
+        x2 = _mm_xor_si128(x2, rol32x4(_mm_add_epi32(x1, x0), 9));\
+        x3 = _mm_xor_si128(x3, rol32x4(_mm_add_epi32(x2, x1), 13));\
+        x0 = _mm_xor_si128(x0, rol32x4(_mm_add_epi32(x3, x2), 18));\
+        x1 = _mm_shuffle_epi32(x1, 0x93), x2 = _mm_shuffle_epi32(x2, 0x4e), x3 = _mm_shuffle_epi32(x3, 0x39);\
+        x3 = _mm_xor_si128(x3, rol32x4(_mm_add_epi32(x0, x1), 7)); /* operate on rows */\
+        x2 = _mm_xor_si128(x2, rol32x4(_mm_add_epi32(x3, x0), 9));\
+        x1 = _mm_xor_si128(x1, rol32x4(_mm_add_epi32(x2, x3), 13));\
+        x0 = _mm_xor_si128(x0, rol32x4(_mm_add_epi32(x1, x2), 18));\
+        x1 = _mm_shuffle_epi32(x1, 0x39), x2 = _mm_shuffle_epi32(x2, 0x4e), x3 = _mm_shuffle_epi32(x3, 0x93);\
+    }\
+\
+    x0 = _mm_add_epi32(x0, t0), x1 = _mm_add_epi32(x1, t1), x2 = _mm_add_epi32(x2, t2), x3 = _mm_add_epi32(x3, t3);\
+} while (0)
+
+// as _blockmix_salsa8(), on 64 byte blocks held as their diagonals in four vectors each
+static void _blockmix_salsa8_sse2(__m128i *dest, const __m128i *src, unsigned r)
+{
+    __m128i x0 = src[(2*r - 1)*4], x1 = src[(2*r - 1)*4 + 1], x2 = src[(2*r - 1)*4 + 2], x3 = src[(2*r - 1)*4 + 3];
+
+    for (unsigned i = 0; i < 2*r; i++) {
+        x0 = _mm_xor_si128(x0, src[i*4]), x1 = _mm_xor_si128(x1, src[i*4 + 1]);
+        x2 = _mm_xor_si128(x2, src[i*4 + 2]), x3 = _mm_xor_si128(x3, src[i*4 + 3]);
+        salsa20_8x4(x0, x1, x2, x3);
+        dest[(i/2 + (i % 2)*r)*4] = x0, dest[(i/2 + (i % 2)*r)*4 + 1] = x1; // even blocks first, then odd
+        dest[(i/2 + (i % 2)*r)*4 + 2] = x2, dest[(i/2 + (i % 2)*r)*4 + 3] = x3;
+    }
+}
+
+// as _romix_salsa8(), with the blocks rearranged into diagonals on the way in and back on the way out - word 0 keeps
+// its place, so the index taken from the last block is unchanged
+static void _romix_salsa8_sse2(uint32_t *b, void *scratch, unsigned n, unsigned r)
+{
+    __m128i x[8*r], y[8*r], *v = scratch;
+    uint32_t m;
+
+    for (unsigned j = 0; j < 32*r; j++) ((uint32_t *)x)[j] = le32(b[(j & ~15) + (j*5 & 15)]);
+
+    for (unsigned j = 0; j < n; j += 2) {
+        memcpy(&v[j*(8*r)], x, 128*r);
+        _blockmix_salsa8_sse2(y, x, r);
+        memcpy(&v[(j + 1)*(8*r)], y, 128*r);
+        _blockmix_salsa8_sse2(x, y, r);
+    }
+
+    for (unsigned j = 0; j < n; j += 2) {
+        m = ((uint32_t *)x)[(2*r - 1)*16] & (n - 1);
+        for (unsigned k = 0; k < 8*r; k++) x[k] = _mm_xor_si128(x[k], v[m*(8*r) + k]);
+        _blockmix_salsa8_sse2(y, x, r);
+        m = ((uint32_t *)y)[(2*r - 1)*16] & (n - 1);
+        for (unsigned k = 0; k < 8*r; k++) y[k] = _mm_xor_si128(y[k], v[m*(8*r) + k]);
+        _blockmix_salsa8_sse2(x, y, r);
+    }
+
+    for (unsigned j = 0; j < 32*r; j++) b[(j & ~15) + (j*5 & 15)] = le32(((uint32_t *)x)[j]);
+    mem_clean(x, sizeof(x));
+    mem_clean(y, sizeof(y));
+}
+#endif
+
+typedef struct {
+    uint32_t *b; // the 128*r byte blocks to mix, p for each password
+    unsigned n, r;
+    size_t first, last; // the blocks this thread mixes
+} _BRScryptWork;
+
+static void *_BRScryptWorker(void *info)
+{
+    _BRScryptWork *work = info;
+    void *v = (work->first < work->last) ? malloc(128*work->r*work->n) : NULL; // reused for each block
+
+    assert(v != NULL || work->first == work->last);
+
+    for (size_t i = work->first; i < work->last; i++) {
+#if SHA256_X86 && defined(__SSE2__)
+        _romix_salsa8_sse2(&work->b[i*32*work->r], v, work->n, work->r);
+#else
+        _romix_salsa8(&work->b[i*32*work->r], v, work->n, work->r);
+#endif
+    }
+
+    if (v) mem_clean(v, 128*work->r*work->n), free(v);
+    return NULL;
+}
+
+// scrypt key derivation: http://www.tarsnap.com/scrypt.html
+void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
+              unsigned n, unsigned r, unsigned p)
+{
+    BRScryptBatch(dk, dkLen, &pw, &pwLen, &salt, &saltLen, n, r, p, 1, 1);
+}
+
+// scrypt of count passwords, pws[i] of pwLens[i] bytes with salts[i] of saltLens[i] bytes, written to dks dkLen bytes
+// apart - the count*p independent mixes run on up to threadCount threads, including the caller's, each of which uses
+// 128*r*n bytes of scratch for all the mixes it runs
+void BRScryptBatch(void *dks, size_t dkLen, const void *const pws[], const size_t pwLens[], const void *const salts[],
+                   const size_t saltLens[], unsigned n, unsigned r, unsigned p, size_t count, size_t threadCount)
+{
+    size_t i, blocks = count*p;
+    uint32_t *b = malloc(blocks*128*r + 1);
+
+    assert(b != NULL);
+    assert(dks != NULL || dkLen == 0 || count == 0);
+    assert(pws != NULL || count == 0);
+    assert(pwLens != NULL || count == 0);
+    assert(salts != NULL || count == 0);
+    assert(saltLens != NULL || count == 0);
+    assert(n > 1 && (n & (n - 1)) == 0);
+    assert(r > 0);
+    assert(p > 0);
+    if (threadCount > blocks) threadCount = blocks;
+    if (threadCount < 1) threadCount = 1;
+
+    _BRScryptWork work[threadCount];
+
+    for (i = 0; i < count; i++) {
+        assert(pws[i] != NULL || pwLens[i] == 0);
+        assert(salts[i] != NULL || saltLens[i] == 0);
+        BRPBKDF2(&b[i*32*r*p], 128*r*p, BRSHA256, 256/8, pws[i], pwLens[i], salts[i], saltLens[i], 1);
+    }
+
+    for (i = 0; i < threadCount; i++) {
+        work[i] = (_BRScryptWork) { b, n, r, blocks*i/threadCount, blocks*(i + 1)/threadCount };
+    }
+
+    run_parallel_brd(_BRScryptWorker, work, sizeof(*work), threadCount);
+
+    for (i = 0; i < count; i++) {
+        BRPBKDF2((uint8_t *)dks + i*dkLen, dkLen, BRSHA256, 256/8, pws[i], pwLens[i], &b[i*32*r*p], 128*r*p, 1);
+    }
+
+    mem_clean(b, blocks*128*r);
+    free(b);
 }
@@ -44,10 +44,67 @@ void BRSHA224(void *md28, const void *data, size_t dataLen);
 // double-sha-256 = sha-256(sha-256(x))
 void BRSHA256_2(void *md32, const void *data, size_t dataLen);
 
+// double-sha-256 of count messages of dataLen bytes each, stride bytes apart in data, written to md32s 32 bytes apart
+// several messages are hashed at once in vector lanes when the cpu supports it
+void BRSHA256_2Batch(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count);
+
+// accelerated sha-256 backends, selected at runtime from those the cpu supports
+#define SHA256_BACKEND_SHANI 0x01 // x86 sha extensions
+#define SHA256_BACKEND_SSE4  0x02 // x86 sse4.1, four messages at a time in BRSHA256_2Batch()
+#define SHA256_BACKEND_AVX2  0x04 // x86 avx2, eight messages at a time in BRSHA256_2Batch()
+#define SHA256_BACKEND_NEON  0x08 // arm neon, four messages at a time in BRSHA256_2Batch()
+
+// returns the sha-256 backends supported by the cpu, as a mask of SHA256_BACKEND_* flags
+int BRSHA256Backends(void);
+
+// limits sha-256 to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRSHA256SetBackends(int backends);
+
+// hash state for incremental sha-256 hashing
+typedef struct {
+    uint32_t h[8];
+    uint32_t x[16]; // the partial block not yet compressed
+    uint64_t len; // bytes hashed
+} BRSHA256State;
+
+void BRSHA256Init(BRSHA256State *ctx);
+
+void BRSHA256Update(BRSHA256State *ctx, const void *data, size_t dataLen);
+
+// writes the digest to md32 and wipes ctx - to get a digest of the data so far and keep going, finalize a copy of ctx
+void BRSHA256Final(BRSHA256State *ctx, void *md32);
+
 void BRSHA384(void *md48, const void *data, size_t dataLen);
 
 void BRSHA512(void *md64, const void *data, size_t dataLen);
 
+// hash state for incremental sha-512 hashing
+typedef struct {
+    uint64_t h[8];
+    uint64_t x[16]; // the partial block not yet compressed
+    uint64_t len; // bytes hashed
+} BRSHA512State;
+
+void BRSHA512Init(BRSHA512State *ctx);
+
+void BRSHA512Update(BRSHA512State *ctx, const void *data, size_t dataLen);
+
+// writes the digest to md64 and wipes ctx - to get a digest of the data so far and keep going, finalize a copy of ctx
+void BRSHA512Final(BRSHA512State *ctx, void *md64);
+
+// accelerated sha-512 backends, selected at runtime from those the cpu supports
+#define SHA512_BACKEND_AVX2 0x01 // x86 avx2, four passwords at a time in BRPBKDF2Batch() with sha-512
+
+// returns the sha-512 backends supported by the cpu, as a mask of SHA512_BACKEND_* flags
+int BRSHA512Backends(void);
+
+// limits sha-512 to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRSHA512SetBackends(int backends);
+
 // ripemd-160: http://homes.esat.kuleuven.be/~bosselae/ripemd160.html
 void BRRMD160(void *md20, const void *data, size_t dataLen);
 
@@ -60,6 +117,40 @@ void BRSHA3_256(void *md32, const void *data, size_t dataLen);
 // keccak-256: https://keccak.team/files/Keccak-submission-3.pdf
 void BRKeccak256(void *md32, const void *data, size_t dataLen);
 
+// keccak-256 of count messages of dataLen bytes each, stride bytes apart in data, written to md32s 32 bytes apart
+// four messages are hashed at once in vector lanes when the avx2 backend is in use
+void BRKeccak256Batch(void *md32s, const void *data, size_t dataLen, size_t stride, size_t count);
+
+// accelerated keccak backends, selected at runtime from those the cpu supports
+#define KECCAK_BACKEND_AVX2 0x01 // x86 avx2, four messages at a time in BRKeccak256Batch()
+
+// returns the keccak backends supported by the cpu, as a mask of KECCAK_BACKEND_* flags
+int BRKeccakBackends(void);
+
+// limits keccak to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be hashing
+int BRKeccakSetBackends(int backends);
+
+// sponge state for incremental keccak and sha3 hashing
+typedef struct {
+    uint64_t s[25];
+    size_t rate; // bytes absorbed per permutation, 200 - 2*mdLen
+    size_t offset; // bytes absorbed into the current block
+    uint8_t pad; // domain separation padding, 0x01 for keccak, 0x06 for sha3
+} BRKeccakState;
+
+// starts an incremental keccak hash with an mdLen byte digest (32 for keccak-256, as used by ethereum)
+void BRKeccakInit(BRKeccakState *ctx, size_t mdLen);
+
+// starts an incremental sha3 hash with an mdLen byte digest
+void BRSHA3Init(BRKeccakState *ctx, size_t mdLen);
+
+void BRKeccakUpdate(BRKeccakState *ctx, const void *data, size_t dataLen);
+
+// writes the digest to md and wipes ctx - to get a digest of the data so far and keep going, finalize a copy of ctx
+void BRKeccakFinal(BRKeccakState *ctx, void *md);
+
 // md5 - for non-cryptographic use only
 void BRMD5(void *md16, const void *data, size_t dataLen);
 
@@ -72,6 +163,22 @@ uint64_t BRSip64(const void *key16, const void *data, size_t dataLen);
 void BRHMAC(void *mac, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key, size_t keyLen,
             const void *data, size_t dataLen);
 
+// keyed hmac state, holding the inner and outer hash states after the key xor ipad and key xor opad blocks
+typedef struct {
+    union { BRSHA256State sha256; BRSHA512State sha512; } inner, outer;
+    size_t hashLen;
+} BRHMACState;
+
+// starts an incremental hmac - hash must be BRSHA256 or BRSHA512
+// to mac several messages under one key, init once and update and finalize a copy of ctx for each
+void BRHMACInit(BRHMACState *ctx, void (*hash)(void *, const void *, size_t), size_t hashLen, const void *key,
+                size_t keyLen);
+
+void BRHMACUpdate(BRHMACState *ctx, const void *data, size_t dataLen);
+
+// writes the mac and wipes ctx
+void BRHMACFinal(BRHMACState *ctx, void *mac);
+
 // hmac-drbg with no prediction resistance or additional input
 // K and V must point to buffers of size hashLen, and ps (personalization string) may be NULL
 // to generate additional drbg output, use K and V from the previous call, and set seed, nonce and ps to NULL
@@ -100,14 +207,55 @@ void BRAESECBDecrypt(void *buf16, const void *key, size_t keyLen);
 // aes-ctr stream cipher encrypt/decrypt
 void BRAESCTR(void *out, const void *key, size_t keyLen, const void *iv16, const void *data, size_t dataLen);
 void BRAESCTR_OFFSET(void *out, size_t outLen, const void *key, size_t keyLen, void *iv16, const void *data, size_t dataLen);
+
+// aes key schedule, expanded once for ciphering many blocks under the same key - wipe with mem_clean() when done
+typedef struct {
+    uint32_t ek[60]; // encryption round keys, in byte order
+    uint32_t dk[60]; // decryption round keys, for the equivalent inverse cipher
+    unsigned rounds;
+} BRAESContext;
+
+void BRAESContextInit(BRAESContext *ctx, const void *key, size_t keyLen);
+
+// aes-ecb of bufLen bytes in place, a multiple of 16
+void BRAESContextECBEncrypt(const BRAESContext *ctx, void *buf, size_t bufLen);
+
+void BRAESContextECBDecrypt(const BRAESContext *ctx, void *buf, size_t bufLen);
+
+// aes-ctr stream cipher encrypt/decrypt, with the big-endian counter in iv16 advanced past each block used, so that
+// calls with lengths that are multiples of 16 continue the same keystream
+void BRAESContextCTR(const BRAESContext *ctx, void *out, void *iv16, const void *data, size_t dataLen);
+
+// accelerated aes backends, selected at runtime from those the cpu supports
+#define AES_BACKEND_NI 0x01 // x86 aes-ni
+
+// returns the aes backends supported by the cpu, as a mask of AES_BACKEND_* flags
+int BRAESBackends(void);
+
+// limits aes to the given backends, those the cpu doesn't support are ignored, and 0 selects the portable
+// implementation - returns the backends now in use
+// this is meant for tests and benchmarks, and must not be called while other threads may be ciphering
+int BRAESSetBackends(int backends);
     
 void BRPBKDF2(void *dk, size_t dkLen, void (*hash)(void *, const void *, size_t), size_t hashLen,
               const void *pw, size_t pwLen, const void *salt, size_t saltLen, unsigned rounds);
 
+// pbkdf2 of count passwords, pws[i] of pwLens[i] bytes, all with the same salt, written to dks dkLen bytes apart
+// several passwords are derived at once in vector lanes for hmac-sha256 and hmac-sha512, when the cpu supports it
+void BRPBKDF2Batch(void *dks, size_t dkLen, void (*hash)(void *, const void *, size_t), size_t hashLen,
+                   const void *const pws[], const size_t pwLens[], const void *salt, size_t saltLen, unsigned rounds,
+                   size_t count);
+
 // scrypt key derivation: http://www.tarsnap.com/scrypt.html
 void BRScrypt(void *dk, size_t dkLen, const void *pw, size_t pwLen, const void *salt, size_t saltLen,
               unsigned n, unsigned r, unsigned p);
 
+// scrypt of count passwords, pws[i] of pwLens[i] bytes with salts[i] of saltLens[i] bytes, written to dks dkLen bytes
+// apart - the count*p independent mixes run on up to threadCount threads, including the caller's, each of which uses
+// 128*r*n bytes of scratch for all the mixes it runs
+void BRScryptBatch(void *dks, size_t dkLen, const void *const pws[], const size_t pwLens[], const void *const salts[],
+                   const size_t saltLens[], unsigned n, unsigned r, unsigned p, size_t count, size_t threadCount);
+
 // zeros out memory in a way that can't be optimized out by the compiler
 inline static void mem_clean(void *ptr, size_t len)
 {
@@ -45,20 +45,64 @@ typedef int sqlite3_status_code;
 #define FILE_SERVICE_SDB_ENTITY_TABLE     \
 "CREATE TABLE IF NOT EXISTS Entity(     \n\
   Type      CHAR(64)    NOT NULL,       \n\
-  Hash      CHAR(64)    NOT NULL,       \n\
-  Data      TEXT        NOT NULL,       \n\
+  Hash      BLOB        NOT NULL,       \n\
+  Data      BLOB        NOT NULL,       \n\
+  Sort      INTEGER,                    \n\
   PRIMARY KEY (Type, Hash));"
 
+#define FILE_SERVICE_SDB_ENTITY_SORT_INDEX     \
+"CREATE INDEX IF NOT EXISTS EntitySort ON Entity (Type, Sort);"
+
+// The 'Entity' table format is saved as the database's `user_version`.  Both `Hash` and `Data` were
+// once hex-encoded TEXT; they are now BLOBs, half the size and with no encode/decode on save/load.
+typedef enum {
+    SDB_FORMAT_HEX,         // user_version 0: Hash as CHAR(64), Data as hex-encoded TEXT
+    SDB_FORMAT_BLOB,        // user_version 1: Hash as a 32 byte BLOB, Data as a BLOB
+    SDB_FORMAT_SORT         // user_version 2: adds Sort, NULL until the entity is saved w/ a sort key
+} BRFileServiceSDBFormatVersion;
+
+static BRFileServiceSDBFormatVersion currentSDBFormatVersion = SDB_FORMAT_SORT;
+
+// Map an unsigned sort key onto SQLite's signed INTEGER, preserving the order.
+#define FILE_SERVICE_SDB_SORT_KEY(key)      ((sqlite3_int64) ((key) ^ UINT64_C(0x8000000000000000)))
+
+#define FILE_SERVICE_SDB_QUERY_FORMAT     \
+"PRAGMA user_version;"
+
+#define FILE_SERVICE_SDB_UPDATE_FORMAT     \
+"PRAGMA user_version = %d;"
+
+#define FILE_SERVICE_SDB_QUERY_HEX_TABLE     \
+"SELECT count(*) FROM sqlite_master WHERE type = 'table' AND name = 'Entity';"
+
+#define FILE_SERVICE_SDB_RENAME_HEX_TABLE     \
+"ALTER TABLE Entity RENAME TO EntityHex;"
+
+#define FILE_SERVICE_SDB_QUERY_ALL_HEX_ENTITY     \
+"SELECT Type, Hash, Data FROM EntityHex;"
+
+#define FILE_SERVICE_SDB_DROP_HEX_TABLE     \
+"DROP TABLE EntityHex;"
+
+#define FILE_SERVICE_SDB_ADD_SORT_COLUMN     \
+"ALTER TABLE Entity ADD COLUMN Sort INTEGER;"
+
 typedef char FileServiceSQL[1024];
 
 #define FILE_SERVICE_SDB_INSERT_ENTITY    \
-"INSERT OR REPLACE INTO Entity (Type, Hash, Data) VALUES (?, ?, ?);"
+"INSERT OR REPLACE INTO Entity (Type, Hash, Data, Sort) VALUES (?, ?, ?, ?);"
 
 #define FILE_SERVICE_SDB_QUERY_ENTITY     \
 "SELECT Data FROM Entity WHERE Type = ? AND Hash = ?;"
 
 #define FILE_SERVICE_SDB_QUERY_ALL_ENTITY     \
-"SELECT Hash, Data FROM Entity WHERE Type = ?;"
+"SELECT Hash, Data, Sort FROM Entity WHERE Type = ?;"
+
+#define FILE_SERVICE_SDB_QUERY_ALL_ENTITY_SORTED     \
+"SELECT Hash, Data, Sort FROM Entity WHERE Type = ? ORDER BY Sort, rowid;"
+
+#define FILE_SERVICE_SDB_QUERY_UNSORTED_ENTITY     \
+"SELECT EXISTS (SELECT 1 FROM Entity WHERE Type = ? AND Sort IS NULL);"
 
 #define FILE_SERVICE_SDB_UPDATE_ENTITY     \
 "UPDATE Entity SET Data = ? WHERE Type = ? AND Hash = ?;"
@@ -80,9 +124,7 @@ static int needSQLiteCompileOptions = 1;
 // Convert a char into uint8_t (decode)
 #define decodeChar(c)           ((uint8_t) _hexu(c))
 
-// Convert a uint8_t into a char (encode)
-#define encodeChar(u)           ((char)    _hexc(u))
-
+// Only needed to migrate SDB_FORMAT_HEX databases
 static void
 hexDecode (uint8_t *target, size_t targetLen, const char *source, size_t sourceLen) {
     //
@@ -94,17 +136,6 @@ hexDecode (uint8_t *target, size_t targetLen, const char *source, size_t sourceL
     }
 }
 
-static void
-hexEncode (char *target, size_t targetLen, const uint8_t *source, size_t sourceLen) {
-    assert (targetLen == 2 * sourceLen  + 1);
-
-    for (int i = 0; i < sourceLen; i++) {
-        target[2*i + 0] = encodeChar (source[i] >> 4);
-        target[2*i + 1] = encodeChar (source[i]);
-    }
-    target[2*sourceLen] = '\0';
-}
-
 /** Forward Declarations */
 static int
 fileServiceFailedSDB (BRFileService fs,
@@ -145,6 +176,8 @@ typedef struct {
     char *type;
     BRFileServiceVersion currentVersion;
     BRArrayOf(BRFileServiceEntityHandler) handlers;
+    BRFileServiceContext sortKeyContext;
+    BRFileServiceSortKey sortKey;
 } BRFileServiceEntityType;
 
 static void
@@ -189,6 +222,7 @@ struct BRFileServiceRecord {
     sqlite3_stmt *sdbInsertStmt;
     sqlite3_stmt *sdbSelectStmt;
     sqlite3_stmt *sdbSelectAllStmt;
+    sqlite3_stmt *sdbSelectAllSortedStmt;
     sqlite3_stmt *sdbUpdateStmt;
     sqlite3_stmt *sdbDeleteStmt;
     sqlite3_stmt *sdbDeleteAllTypeStmt;
@@ -224,6 +258,134 @@ fileServiceCreateFilePath (const char *basePath,
     return sdbPath;
 }
 
+#if !defined(NEUTER_FILE_SERVICE)
+static sqlite3_status_code
+fileServiceQueryInt (BRFileService fs, const char *sql, int *value) {
+    sqlite3_stmt *stmt;
+    sqlite3_status_code status = sqlite3_prepare_v2 (fs->sdb, sql, -1, &stmt, NULL);
+    if (SQLITE_OK != status) return status;
+
+    status = sqlite3_step (stmt);
+    if (SQLITE_ROW == status) {
+        *value = sqlite3_column_int (stmt, 0);
+        status = SQLITE_OK;
+    }
+
+    sqlite3_finalize (stmt);
+    return status;
+}
+
+static sqlite3_status_code
+fileServiceMigrateHexEntities (BRFileService fs) {
+    sqlite3_stmt *selectStmt;
+    sqlite3_stmt *insertStmt;
+    sqlite3_status_code status;
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_ALL_HEX_ENTITY, -1, &selectStmt, NULL);
+    if (SQLITE_OK != status) return status;
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_INSERT_ENTITY, -1, &insertStmt, NULL);
+    if (SQLITE_OK != status) { sqlite3_finalize (selectStmt); return status; }
+
+    uint8_t *dataBytes = NULL;
+    size_t   dataBytesCount = 0;
+
+    while (SQLITE_ROW == (status = sqlite3_step (selectStmt))) {
+        const char *type = (const char *) sqlite3_column_text (selectStmt, 0);
+        const char *hash = (const char *) sqlite3_column_text (selectStmt, 1);
+        const char *data = (const char *) sqlite3_column_text (selectStmt, 2);
+
+        // Skip anything that could never have loaded.
+        size_t dataCount = (NULL == data ? 0 : strlen (data));
+        if (NULL == type || NULL == hash || 2 * sizeof (UInt256) != strlen (hash) ||
+            0 == dataCount || 0 != dataCount % 2)
+            continue;
+
+        UInt256 identifier;
+        hexDecode (identifier.u8, sizeof (identifier.u8), hash, strlen (hash));
+
+        if (dataCount/2 > dataBytesCount) {
+            dataBytesCount = dataCount/2;
+            dataBytes = realloc (dataBytes, dataBytesCount);
+        }
+        hexDecode (dataBytes, dataCount/2, data, dataCount);
+
+        sqlite3_reset (insertStmt);
+        sqlite3_clear_bindings (insertStmt);
+
+        if (SQLITE_OK != (status = sqlite3_bind_text (insertStmt, 1, type, -1, SQLITE_STATIC))                             ||
+            SQLITE_OK != (status = sqlite3_bind_blob (insertStmt, 2, identifier.u8, sizeof (identifier.u8), SQLITE_STATIC)) ||
+            SQLITE_OK != (status = sqlite3_bind_blob (insertStmt, 3, dataBytes, (int) (dataCount/2), SQLITE_STATIC))       ||
+            SQLITE_DONE != (status = sqlite3_step (insertStmt)))
+            break;
+    }
+
+    if (NULL != dataBytes) free (dataBytes);
+    sqlite3_finalize (insertStmt);
+    sqlite3_finalize (selectStmt);
+
+    return (SQLITE_DONE == status ? SQLITE_OK : status);
+}
+
+///
+/// Bring the 'Entity' table to the `currentSDBFormatVersion`.  An existing table is converted in
+/// place, in one DB transaction; if that fails the table is left untouched.  A new database is
+/// simply marked as current; the 'Entity' table is then created in the current format.
+///
+static sqlite3_status_code
+fileServiceMigrateSDB (BRFileService fs) {
+    FileServiceSQL sql;
+    sqlite3_status_code status;
+
+    int format = SDB_FORMAT_HEX;
+    status = fileServiceQueryInt (fs, FILE_SERVICE_SDB_QUERY_FORMAT, &format);
+    if (SQLITE_OK != status) return status;
+
+    if (format >= currentSDBFormatVersion) return SQLITE_OK;
+
+    int hasTable = 0;
+    status = fileServiceQueryInt (fs, FILE_SERVICE_SDB_QUERY_HEX_TABLE, &hasTable);
+    if (SQLITE_OK != status) return status;
+
+    sprintf (sql, FILE_SERVICE_SDB_UPDATE_FORMAT, currentSDBFormatVersion);
+
+    if (!hasTable)
+        return sqlite3_exec (fs->sdb, sql, NULL, NULL, NULL);
+
+    status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
+    if (SQLITE_OK != status) return status;
+
+    if (SDB_FORMAT_HEX == format) {
+        // Recreate the table; it gets the `Sort` column directly
+        if (SQLITE_OK != (status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_RENAME_HEX_TABLE, NULL, NULL, NULL)) ||
+            SQLITE_OK != (status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_ENTITY_TABLE,     NULL, NULL, NULL)) ||
+            SQLITE_OK != (status = fileServiceMigrateHexEntities (fs))                                          ||
+            SQLITE_OK != (status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_DROP_HEX_TABLE,   NULL, NULL, NULL))) {
+            sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+            return status;
+        }
+    }
+    else if (SDB_FORMAT_BLOB == format) {
+        if (SQLITE_OK != (status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_ADD_SORT_COLUMN, NULL, NULL, NULL))) {
+            sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+            return status;
+        }
+    }
+
+    if (SQLITE_OK != (status = sqlite3_exec (fs->sdb, sql,      NULL, NULL, NULL)) ||
+        SQLITE_OK != (status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL))) {
+        sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+        return status;
+    }
+
+    // Return the space held by the hex-encoded rows.
+    if (SDB_FORMAT_HEX == format)
+        sqlite3_exec (fs->sdb, "VACUUM", NULL, NULL, NULL);
+
+    return SQLITE_OK;
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
 extern BRFileService
 fileServiceCreate (const char *basePath,
                    const char *currency,
@@ -281,6 +443,14 @@ fileServiceCreate (const char *basePath,
     // Allow an absurdly long timeout for DB creation
     sqlite3_busy_timeout (fs->sdb, 10 * 1000); // 10 seconds
 
+    // Migrate the SQLite 'Entity' Table, if needed
+    status = fileServiceMigrateSDB (fs);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
     // Create the SQLite 'Entity' Table
     sqlite3_stmt *sdbCreateTableStmt;
     status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_ENTITY_TABLE, -1, &sdbCreateTableStmt, NULL);
@@ -297,6 +467,14 @@ fileServiceCreate (const char *basePath,
         });
     sqlite3_finalize(sdbCreateTableStmt);
 
+    // Create the SQLite 'Entity' index for sorted loads
+    status = sqlite3_exec (fs->sdb, FILE_SERVICE_SDB_ENTITY_SORT_INDEX, NULL, NULL, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
     // Create the SQLITE 'Insert into Entity' Statement
     status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_INSERT_ENTITY, -1, &fs->sdbInsertStmt, NULL);
     if (SQLITE_OK != status)
@@ -321,6 +499,14 @@ fileServiceCreate (const char *basePath,
             { .sdb = { status }}
         });
 
+    // Create the SQLITE "Select Entity, Sorted' Statement
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_ALL_ENTITY_SORTED, -1, &fs->sdbSelectAllSortedStmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
+            FILE_SERVICE_SDB,
+            { .sdb = { status }}
+        });
+
     status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_UPDATE_ENTITY, -1, &fs->sdbUpdateStmt, NULL);
     if (SQLITE_OK != status)
         return fileServiceCreateReturnError (fs, 1, (BRFileServiceError) {
@@ -383,6 +569,7 @@ _fileServiceCloseInternal (BRFileService fs) {
     _fileServiceFinalizeStmt (fs, &fs->sdbInsertStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbSelectStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbSelectAllStmt);
+    _fileServiceFinalizeStmt (fs, &fs->sdbSelectAllSortedStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbUpdateStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbDeleteStmt);
     _fileServiceFinalizeStmt (fs, &fs->sdbDeleteAllTypeStmt);
@@ -456,6 +643,8 @@ fileServiceAddType (const BRFileService fs,
     BRFileServiceEntityType entityType = {
         strdup (type),
         version,
+        NULL,
+        NULL,
         NULL
     };
     array_new (entityType.handlers, FILE_SERVICE_INITIAL_HANDLER_COUNT);
@@ -559,21 +748,45 @@ fileServiceFailedEntity(BRFileService fs,
 /// MARK: - Save
 
 static int
-_fileServiceSave (BRFileService fs,
-                  const char *type,  /* block, peers, transactions, logs, ... */
-                  const void *entity,
-                  int needLock) {     /* BRMerkleBlock*, BRTransaction, BREthereumTransaction, ... */
+fileServiceClearForType (BRFileService fs,
+                         BRFileServiceEntityType *entityType,
+                         int needLock);
 
-    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
-    if (NULL == entityType) { fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type"); return 0; };
+///
+/// An entity as stored: the identifier, the optional sort key and the header-prefixed bytes.
+///
+typedef struct {
+    UInt256 identifier;
+    int hasSortKey;
+    uint64_t sortKey;
+    uint8_t *bytes;
+    size_t bytesCount;
+} BRFileServiceEntityRecord;
+
+static void
+fileServiceEntityRecordsRelease (BRArrayOf(BRFileServiceEntityRecord) records) {
+    if (NULL == records) return;
+    for (size_t index = 0; index < array_count(records); index++)
+        free (records[index].bytes);
+    array_free (records);
+}
 
+static int
+fileServiceEntityRecordCreate (BRFileService fs,
+                               BRFileServiceEntityType *entityType,
+                               const void *entity,      /* BRMerkleBlock*, BRTransaction, ... */
+                               BRFileServiceEntityRecord *record) {
     BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
     if (NULL == handler) { fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type handler"); return 0; };
 
-#if !defined(NEUTER_FILE_SERVICE)
-    // Get then hex-encode the identifer
-    UInt256 identifier = handler->identifier (handler->context, fs, entity);
-    const char *hash = u256hex(identifier);
+    // Get the identifer; saved as a 32 byte BLOB
+    record->identifier = handler->identifier (handler->context, fs, entity);
+
+    // Get the sort key, if the type has one
+    record->hasSortKey = (NULL != entityType->sortKey);
+    record->sortKey    = (record->hasSortKey
+                          ? entityType->sortKey (entityType->sortKeyContext, fs, entity)
+                          : 0);
 
     // Get the entity bytes
     uint32_t entityBytesCount;
@@ -599,40 +812,41 @@ _fileServiceSave (BRFileService fs,
     memcpy (&bytes[offset], entityBytes, entityBytesCount);
     free (entityBytes);
 
-    // Nex encode bytes
-    size_t dataCount = 2 * bytesCount + 1;
-    char *data = malloc (dataCount);
-    hexEncode (data, dataCount, bytes, bytesCount);
-    free (bytes);
+    record->bytes      = bytes;
+    record->bytesCount = bytesCount;
 
+    return 1;
+}
+
+#if !defined(NEUTER_FILE_SERVICE)
+// Insert `record`; called while locked.  The record's bytes remain owned by the caller.
+static int
+_fileServiceSaveRecord (BRFileService fs,
+                        const char *type,
+                        const BRFileServiceEntityRecord *record) {
     // Fill out the SQL statement
     sqlite3_status_code status;
 
-    if (needLock)
-        pthread_mutex_lock (&fs->lock);
-
-    if (fs->sdbClosed)
-        return fileServiceFailedImpl (fs, needLock, NULL, NULL, "closed");
-
     sqlite3_reset (fs->sdbInsertStmt);
     sqlite3_clear_bindings(fs->sdbInsertStmt);
 
     status = sqlite3_bind_text (fs->sdbInsertStmt, 1, type, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
-    }
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 0, status);
 
-    status = sqlite3_bind_text (fs->sdbInsertStmt, 2, hash, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
-    }
+    status = sqlite3_bind_blob (fs->sdbInsertStmt, 2, record->identifier.u8, sizeof (record->identifier.u8), SQLITE_STATIC);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 0, status);
 
-    status = sqlite3_bind_text (fs->sdbInsertStmt, 3, data, -1, SQLITE_STATIC);
-    if (SQLITE_OK != status) {
-        free (data);
-        return fileServiceFailedSDB (fs, needLock, status);
+    status = sqlite3_bind_blob (fs->sdbInsertStmt, 3, record->bytes, (int) record->bytesCount, SQLITE_STATIC);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 0, status);
+
+    // Without a sort key, `Sort` is left as NULL.
+    if (record->hasSortKey) {
+        status = sqlite3_bind_int64 (fs->sdbInsertStmt, 4, FILE_SERVICE_SDB_SORT_KEY (record->sortKey));
+        if (SQLITE_OK != status)
+            return fileServiceFailedSDB (fs, 0, status);
     }
 
     status = sqlite3_step (fs->sdbInsertStmt);
@@ -641,21 +855,85 @@ _fileServiceSave (BRFileService fs,
         while (retries-- > 0 && status != SQLITE_DONE && status != SQLITE_BUSY)
             status = sqlite3_step (fs->sdbInsertStmt);
         if (0 == retries) {
-            free (data);
-            return fileServiceFailedSDB (fs, needLock, status);
+            sqlite3_reset (fs->sdbInsertStmt);
+            return fileServiceFailedSDB (fs, 0, status);
         }
     }
 
     // Ensure the 'implicit DB transaction' is committed.
     sqlite3_reset (fs->sdbInsertStmt);
 
+    return 1;
+}
+
+// Insert `records` in a single DB transaction, optionally clearing all of `clearEntityType` first.
+// Without an explicit transaction SQLite commits, and thus syncs to disk, after every insert.  On
+// a failure the transaction is rolled back.  Called while locked.
+static int
+_fileServiceSaveRecords (BRFileService fs,
+                         const char *type,
+                         const BRFileServiceEntityRecord *records,
+                         size_t recordsCount,
+                         BRFileServiceEntityType *clearEntityType) {
+    sqlite3_status_code status;
+
+    status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 0, status);
+
+    if (NULL != clearEntityType && 0 == fileServiceClearForType (fs, clearEntityType, 0)) {
+        sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+        return 0;
+    }
+
+    for (size_t index = 0; index < recordsCount; index++)
+        if (0 == _fileServiceSaveRecord (fs, type, &records[index])) {
+            sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+            return 0;
+        }
+
+    status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
+    if (SQLITE_OK != status) {
+        sqlite3_exec (fs->sdb, "ROLLBACK", NULL, NULL, NULL);
+        return fileServiceFailedSDB (fs, 0, status);
+    }
+
+    return 1;
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+static int
+_fileServiceSave (BRFileService fs,
+                  const char *type,  /* block, peers, transactions, logs, ... */
+                  const void *entity,
+                  int needLock) {     /* BRMerkleBlock*, BRTransaction, BREthereumTransaction, ... */
+
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) { fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type"); return 0; };
+
+#if !defined(NEUTER_FILE_SERVICE)
+    BRFileServiceEntityRecord record;
+    if (0 == fileServiceEntityRecordCreate (fs, entityType, entity, &record)) return 0;
+
+    if (needLock)
+        pthread_mutex_lock (&fs->lock);
+
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, needLock, record.bytes, NULL, "closed");
+
+    int success = _fileServiceSaveRecord (fs, type, &record);
+
     if (needLock)
         pthread_mutex_unlock (&fs->lock);
 
-    free (data);
-#endif // !defined(NEUTER_FILE_SERVICE)
+    free (record.bytes);
+    return success;
+#else
+    BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
+    if (NULL == handler) { fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type handler"); return 0; };
 
     return 1;
+#endif // !defined(NEUTER_FILE_SERVICE)
 }
 
 extern int
@@ -665,30 +943,89 @@ fileServiceSave (BRFileService fs,
     return _fileServiceSave (fs, type, entity, 1);
 }
 
-/// MARK: - Load
+// Save `entities` in a single DB transaction, optionally clearing all of `clearEntityType` first.
+// Called while locked.
+static int
+_fileServiceSaveAll (BRFileService fs,
+                     BRFileServiceEntityType *entityType,
+                     const void **entities,
+                     size_t entitiesCount,
+                     BRFileServiceEntityType *clearEntityType) {
+#if !defined(NEUTER_FILE_SERVICE)
+    BRArrayOf(BRFileServiceEntityRecord) records;
+    array_new (records, (0 == entitiesCount ? 1 : entitiesCount));
+
+    for (size_t index = 0; index < entitiesCount; index++) {
+        BRFileServiceEntityRecord record;
+        if (0 == fileServiceEntityRecordCreate (fs, entityType, entities[index], &record)) {
+            fileServiceEntityRecordsRelease (records);
+            return 0;
+        }
+        array_add (records, record);
+    }
+
+    int success = _fileServiceSaveRecords (fs, entityType->type, records, array_count(records), clearEntityType);
+
+    fileServiceEntityRecordsRelease (records);
+    return success;
+#else
+    return 1;
+#endif // !defined(NEUTER_FILE_SERVICE)
+}
 
 extern int
-fileServiceLoad (BRFileService fs,
-                 BRSet *results,
-                 const char *type,
-                 int updateVersion) {
+fileServiceSaveBatch (BRFileService fs,
+                      const char *type,
+                      const void **entities,
+                      size_t entitiesCount) {
     BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
-    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+    if (NULL == entityType)
+        return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
 
-    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
-    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  0, NULL, NULL, "missed type handler");
+    if (0 == entitiesCount) return 1;
 
 #if !defined(NEUTER_FILE_SERVICE)
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    int success = _fileServiceSaveAll (fs, entityType, entities, entitiesCount, NULL);
+
+    pthread_mutex_unlock (&fs->lock);
+    return success;
+#else
+    return 1;
+#endif // !defined(NEUTER_FILE_SERVICE)
+}
+
+/// MARK: - Load
+
+#if !defined(NEUTER_FILE_SERVICE)
+///
+/// Load each `entityType` entity found by `stmt`, which is bound here with the type.  Every entity
+/// is passed to `loadHandler`, while locked.  If `loadHandler` stops the load, that is a failure
+/// when `stopReason` is not NULL.  Entities that need an update are rewritten before being handed
+/// off and then saved in one DB transaction at the end.
+///
+static int
+fileServiceLoadEntities (BRFileService fs,
+                         BRFileServiceEntityType *entityType,
+                         sqlite3_stmt *stmt,
+                         int updateVersion,
+                         BRFileServiceContext context,
+                         BRFileServiceLoadCallback loadHandler,
+                         const char *stopReason) {
+    const char *type = entityType->type;
     sqlite3_status_code status;
 
     pthread_mutex_lock (&fs->lock);
     if (fs->sdbClosed)
         return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
 
-    sqlite3_reset (fs->sdbSelectAllStmt);
-    sqlite3_clear_bindings (fs->sdbSelectAllStmt);
+    sqlite3_reset (stmt);
+    sqlite3_clear_bindings (stmt);
 
-    status = sqlite3_bind_text (fs->sdbSelectAllStmt, 1, type, -1, SQLITE_STATIC);
+    status = sqlite3_bind_text (stmt, 1, type, -1, SQLITE_STATIC);
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
@@ -700,29 +1037,32 @@ fileServiceLoad (BRFileService fs,
     // to dereferencing uninitialized memory.  We accept this minimal, extraneous function call.
     memset(dataBytes, 0, dataBytesCount);
 
-    BRArrayOf(void*) entitiesToSave = NULL;
+    BRArrayOf(BRFileServiceEntityRecord) recordsToSave = NULL;
 
-    while (SQLITE_ROW == sqlite3_step(fs->sdbSelectAllStmt)) {
-        const char *hash = (const char *) sqlite3_column_text (fs->sdbSelectAllStmt, 0);
-        const char *data = (const char *) sqlite3_column_text (fs->sdbSelectAllStmt, 1);
+    const char *implFailure   = NULL;
+    const char *entityFailure = NULL;
 
-        if (NULL == hash || NULL == data)
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed query `hash` or `data`");
+    while (SQLITE_ROW == sqlite3_step(stmt)) {
+        const uint8_t *hash = sqlite3_column_blob (stmt, 0);
+        const uint8_t *data = sqlite3_column_blob (stmt, 1);
 
-        assert (64 == strlen (hash));
-        
-        // Ensure `dataBytes` is large enough for hex-decoded `data`
-        size_t dataCount = strlen (data);
-        assert (0 == dataCount % 2);  // Surely 'even'
-        if ((dataCount/2) > dataBytesCount) {
+        if (NULL == hash || NULL == data) {
+            implFailure = "missed query `hash` or `data`";
+            break;
+        }
+
+        assert (sizeof (UInt256) == sqlite3_column_bytes (stmt, 0));
+
+        // Ensure `dataBytes` is large enough for `data`
+        size_t dataCount = (size_t) sqlite3_column_bytes (stmt, 1);
+        if (dataCount > dataBytesCount) {
             if (dataBytes != dataBytesBuffer) free (dataBytes);
-            dataBytesCount = dataCount/2;
+            dataBytesCount = dataCount;
             dataBytes = malloc (dataBytesCount);
         }
 
-        // Actually decode `data` into `dataBytes`
-        hexDecode (dataBytes, dataCount/2, data, dataCount);
+        // Copy `data` out; it is only valid until the next step.
+        memcpy (dataBytes, data, dataCount);
 
         size_t offset = 0;
         BRFileServiceVersion version;
@@ -746,8 +1086,8 @@ fileServiceLoad (BRFileService fs,
         // Assert entityBytesCount remain in dataBytes
         if (offset + entityBytesCount > dataBytesCount) {
             assert (0); // In DEBUG builds.
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed bytes count");
+            implFailure = "missed bytes count";
+            break;
         }
 
         entityBytes = &dataBytes[offset];
@@ -760,55 +1100,120 @@ fileServiceLoad (BRFileService fs,
 
         // Look up the entity handler
         BRFileServiceEntityHandler *handler = fileServiceEntityTypeLookupHandler(entityType, version);
-        if (NULL == handler)
-            return fileServiceFailedImpl (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                          "missed type handler");
+        if (NULL == handler) {
+            implFailure = "missed type handler";
+            break;
+        }
 
-        // Read the entity from buffer and add to results.
+        // Read the entity from buffer.
         void *entity = handler->reader (handler->context, fs, entityBytes, entityBytesCount);
-        if (NULL == entity)
-            return fileServiceFailedEntity (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                            type, "reader");
-
-        // Update results with the newly restored entity
-        void *oldEntity = BRSetAdd (results, entity);
-
-        // We should never have a `oldEntity` - there was an identifier clash.
-        if (NULL != oldEntity) {
-            assert (true);  // DEBUG builds
-            // TODO: Is this too harsh?
-            return fileServiceFailedEntity (fs, 1, (dataBytes == dataBytesBuffer ? NULL : dataBytes), NULL,
-                                            type, "duplicate set entry");
+        if (NULL == entity) {
+            entityFailure = "reader";
+            break;
         }
 
-        // If the read version is not the current version, update
+        // If the read version is not the current version, or if the entity was saved before its
+        // type had a sort key, update.  Do so now, while we surely own `entity`.
         if (updateVersion &&
             (version != entityType->currentVersion ||
-             headerVersion != currentHeaderFormatVersion)) {
-            if (NULL == entitiesToSave) array_new (entitiesToSave, 100);
-            array_add (entitiesToSave, entity);
+             headerVersion != currentHeaderFormatVersion ||
+             (NULL != entityType->sortKey && SQLITE_NULL == sqlite3_column_type (stmt, 2)))) {
+            BRFileServiceEntityRecord record;
+
+            // This could signal an error.  We'll continue and will try next time we load.
+            if (fileServiceEntityRecordCreate (fs, entityType, entity, &record)) {
+                if (NULL == recordsToSave) array_new (recordsToSave, 100);
+                array_add (recordsToSave, record);
+            }
+        }
+
+        // Hand off the newly restored entity
+        if (!loadHandler (context, fs, entity)) {
+            entityFailure = stopReason;
+            break;
         }
     }
 
     // Ensure the 'implicit DB transaction' is committed.
-    sqlite3_reset (fs->sdbSelectAllStmt);
-
-    // Save any entities for which we upgraded a version.
-    if (NULL != entitiesToSave) {
-        for (size_t index = 0; index < array_count(entitiesToSave); index++)
-            // This could signal an error.  Perhaps we should test the return result and
-            // if `0` skip out here?  We won't - we couldn't save the entity in the new format
-            // but we'll continue and will try next time we load it.
-            _fileServiceSave (fs, type, entitiesToSave[index], 0);
-        array_free (entitiesToSave);
+    sqlite3_reset (stmt);
+
+    if (NULL != implFailure || NULL != entityFailure) {
+        fileServiceEntityRecordsRelease (recordsToSave);
+        void *bufferToFree = (dataBytes == dataBytesBuffer ? NULL : dataBytes);
+
+        return (NULL != implFailure
+                ? fileServiceFailedImpl   (fs, 1, bufferToFree, NULL, implFailure)
+                : fileServiceFailedEntity (fs, 1, bufferToFree, NULL, type, entityFailure));
+    }
+
+    // Save any entities for which we upgraded a version; in one DB transaction.
+    if (NULL != recordsToSave) {
+        // This could signal an error.  Perhaps we should test the return result and if `0`
+        // skip out here?  We won't - we couldn't save the entities in the new format but
+        // we'll continue and will try next time we load them.
+        _fileServiceSaveRecords (fs, type, recordsToSave, array_count(recordsToSave), NULL);
+        fileServiceEntityRecordsRelease (recordsToSave);
     }
 
     pthread_mutex_unlock (&fs->lock);
 
     if (dataBytes != dataBytesBuffer) free (dataBytes);
+
+    return 1;
+}
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+static int
+fileServiceLoadAddToSet (BRFileServiceContext context,
+                         BRFileService fs,
+                         void *entity) {
+    BRSet *results = context;
+
+    // Update results with the newly restored entity.  We should never have a `oldEntity` -
+    // there was an identifier clash.
+    // TODO: Is failing too harsh?
+    return NULL == BRSetAdd (results, entity);
+}
+
+extern int
+fileServiceLoad (BRFileService fs,
+                 BRSet *results,
+                 const char *type,
+                 int updateVersion) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
+    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  0, NULL, NULL, "missed type handler");
+
+#if !defined(NEUTER_FILE_SERVICE)
+    return fileServiceLoadEntities (fs, entityType, fs->sdbSelectAllStmt, updateVersion,
+                                    results, fileServiceLoadAddToSet,
+                                    "duplicate set entry");
+#else
+    return 1;
 #endif // !defined(NEUTER_FILE_SERVICE)
+}
+
+extern int
+fileServiceLoadIterate (BRFileService fs,
+                        const char *type,
+                        int updateVersion,
+                        BRFileServiceContext context,
+                        BRFileServiceLoadCallback callback) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
 
+    BRFileServiceEntityHandler *entityHandlerCurrent = fileServiceEntityTypeLookupHandler(entityType, entityType->currentVersion);
+    if (NULL == entityHandlerCurrent) return fileServiceFailedImpl (fs,  0, NULL, NULL, "missed type handler");
+
+#if !defined(NEUTER_FILE_SERVICE)
+    return fileServiceLoadEntities (fs, entityType, fs->sdbSelectAllSortedStmt, updateVersion,
+                                    context, callback,
+                                    NULL);
+#else
     return 1;
+#endif // !defined(NEUTER_FILE_SERVICE)
 }
 
 /// MARK: - Remove, Clear
@@ -831,9 +1236,6 @@ fileServiceRemoveByIdentifier (BRFileService fs,
         return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
 
 #if !defined(NEUTER_FILE_SERVICE)
-    // Hex-Encode identifier
-    const char *hash = u256hex(identifier);
-
     sqlite3_status_code status;
 
     pthread_mutex_lock (&fs->lock);
@@ -847,7 +1249,7 @@ fileServiceRemoveByIdentifier (BRFileService fs,
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
-    status = sqlite3_bind_text (fs->sdbDeleteStmt, 2, hash, -1, SQLITE_STATIC);
+    status = sqlite3_bind_blob (fs->sdbDeleteStmt, 2, identifier.u8, sizeof (identifier.u8), SQLITE_STATIC);
     if (SQLITE_OK != status)
         return fileServiceFailedSDB (fs, 1, status);
 
@@ -934,27 +1336,13 @@ fileServiceReplace (BRFileService fs,
         return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
 
 #if !defined(NEUTER_FILE_SERVICE)
-    sqlite3_status_code status;
-
     pthread_mutex_lock (&fs->lock);
     if (fs->sdbClosed)
         return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
 
-    status = sqlite3_exec (fs->sdb, "BEGIN", NULL, NULL, NULL);
-    if (SQLITE_OK != status)
-        return fileServiceFailedSDB (fs, 1, status);
-
-    if (0 == fileServiceClearForType (fs, entityType, 0))
+    if (0 == _fileServiceSaveAll (fs, entityType, entities, entitiesCount, entityType))
         return fileServiceReplaceFailed (fs, 1);
 
-    for (size_t index = 0; index < entitiesCount; index++)
-        if (0 == _fileServiceSave (fs, type, entities[index], 0))
-            return fileServiceReplaceFailed (fs, 1);
-
-    status = sqlite3_exec (fs->sdb, "COMMIT", NULL, NULL, NULL);
-    if (SQLITE_OK != status)
-        return fileServiceFailedSDB (fs, 1, status);
-
     pthread_mutex_unlock (&fs->lock);
 #endif // !defined(NEUTER_FILE_SERVICE)
 
@@ -1060,6 +1448,46 @@ fileServiceHasType (BRFileService fs,
     return NULL != fileServiceLookupType (fs, type);
 }
 
+extern int
+fileServiceIsSorted (BRFileService fs,
+                     const char *type) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType)
+        return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    int hasUnsorted = 0;
+
+#if !defined(NEUTER_FILE_SERVICE)
+    sqlite3_stmt *stmt;
+    sqlite3_status_code status;
+
+    pthread_mutex_lock (&fs->lock);
+    if (fs->sdbClosed)
+        return fileServiceFailedImpl (fs, 1, NULL, NULL, "closed");
+
+    status = sqlite3_prepare_v2 (fs->sdb, FILE_SERVICE_SDB_QUERY_UNSORTED_ENTITY, -1, &stmt, NULL);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    status = sqlite3_bind_text (stmt, 1, type, -1, SQLITE_STATIC);
+    if (SQLITE_OK == status) {
+        status = sqlite3_step (stmt);
+        if (SQLITE_ROW == status) {
+            hasUnsorted = sqlite3_column_int (stmt, 0);
+            status = SQLITE_OK;
+        }
+    }
+
+    sqlite3_finalize (stmt);
+    if (SQLITE_OK != status)
+        return fileServiceFailedSDB (fs, 1, status);
+
+    pthread_mutex_unlock (&fs->lock);
+#endif // !defined(NEUTER_FILE_SERVICE)
+
+    return !hasUnsorted;
+}
+
 extern UInt256
 fileServiceGetIdentifier (BRFileService fs,
                           const char *type,
@@ -1131,6 +1559,20 @@ fileServiceDefineCurrentVersion (BRFileService fs,
     return 1;
 }
 
+extern int
+fileServiceDefineSortKey (BRFileService fs,
+                          const char *type,
+                          BRFileServiceContext context,
+                          BRFileServiceSortKey sortKey) {
+    BRFileServiceEntityType *entityType = fileServiceLookupType (fs, type);
+    if (NULL == entityType) return fileServiceFailedImpl (fs, 0, NULL, NULL, "missed type");
+
+    entityType->sortKeyContext = context;
+    entityType->sortKey        = sortKey;
+
+    return 1;
+}
+
 extern BRFileService
 fileServiceCreateFromTypeSpecifications(const char *basePath,
                                         const char *currency,
@@ -1165,6 +1607,13 @@ fileServiceCreateFromTypeSpecifications(const char *basePath,
                                                     specification->type,
                                                     specification->defaultVersion);
         if (!success) break;
+
+        if (NULL != specification->sortKey)
+            success &= fileServiceDefineSortKey (fileService,
+                                                 specification->type,
+                                                 context,
+                                                 specification->sortKey);
+        if (!success) break;
     }
 
     if (success) return fileService;
@@ -129,11 +129,55 @@ fileServiceLoad (BRFileService fs,
                  const char *type,   /* blocks, peers, transactions, logs, ... */
                  int updateVersion);
 
+/**
+ * A function type to handle one entity from `fileServiceLoadIterate()`.  You own the entity.  This
+ * is called with the file service locked; it must not call back into the file service.
+ *
+ * @return true (1) to continue loading, false (0) to stop.
+ */
+typedef int
+(*BRFileServiceLoadCallback) (BRFileServiceContext context,
+                              BRFileService fs,
+                              void *entity);
+
+/**
+ * Load all entities of `type`, one at a time, in order of their sort key (see
+ * `fileServiceDefineSortKey()`), without first collecting them into a set.  Entities saved without
+ * a sort key come first; with `updateVersion` they are saved with their sort key, as are entities
+ * with old versions.  A `callback` that stops the load is not a failure.
+ *
+ * @param fs The file service
+ * @param type The type to restore
+ * @param updateVersion If true (1) update old versions with newer ones.
+ * @param context An arbitrary value passed to `callback`
+ * @param callback The function to handle each entity
+ *
+ * @return true (1) if success, false (0) otherwise;
+ */
+extern int
+fileServiceLoadIterate (BRFileService fs,
+                        const char *type,   /* blocks, peers, transactions, logs, ... */
+                        int updateVersion,
+                        BRFileServiceContext context,
+                        BRFileServiceLoadCallback callback);
+
 extern int  // 1 -> success, 0 -> failure
 fileServiceSave (BRFileService fs,
                  const char *type,  /* block, peers, transactions, logs, ... */
                  const void *entity);     /* BRMerkleBlock*, BRTransaction, BREthereumTransaction, ... */
 
+/**
+ * Save `entities` of `type` in a single DB transaction - much faster than repeated calls to
+ * `fileServiceSave()`.  On failure none of `entities` are saved.
+ *
+ * @return true (1) if success, false (0) otherwise;
+ */
+extern int
+fileServiceSaveBatch (BRFileService fs,
+                      const char *type,
+                      const void **entities,
+                      size_t entitiesCount);
+
 extern int  // 1 -> success, 0 -> failure
 fileServiceRemove (BRFileService fs,
                    const char *type,
@@ -190,6 +234,15 @@ typedef uint8_t*
                         const void* entity,
                         uint32_t *bytesCount);
 
+/**
+ * A function type to produce a sort key, such as a block height, from an entity.  Entities are
+ * loaded by `fileServiceLoadIterate()` in increasing sort key order.
+ */
+typedef uint64_t
+(*BRFileServiceSortKey) (BRFileServiceContext context,
+                         BRFileService fs,
+                         const void* entity);
+
 /// TODO: There is a limitation on `type`.
 
 /**
@@ -220,6 +273,17 @@ fileServiceDefineCurrentVersion (BRFileService fs,
                                  const char *type,
                                  BRFileServiceVersion version);
 
+/**
+ * Define the sort key for an already defined `type`.  The sort key applies to all versions.
+ *
+ * @return true (1) if success, false (0) otherwise
+ */
+extern int
+fileServiceDefineSortKey (BRFileService fs,
+                          const char *type,
+                          BRFileServiceContext context,
+                          BRFileServiceSortKey sortKey);
+
 // Version limit can increase with maximum number of version, historically.
 #define FILE_SERVICE_TYPE_SPECIFICATION_NUMBER_OF_VERSION_LIMIT   (5)
 
@@ -233,6 +297,7 @@ typedef struct {
         BRFileServiceReader reader;
         BRFileServiceWriter writer;
     } versions [FILE_SERVICE_TYPE_SPECIFICATION_NUMBER_OF_VERSION_LIMIT];
+    BRFileServiceSortKey sortKey;   // optional
 } BRFileServiceTypeSpecification;
 
 extern BRFileService
@@ -272,4 +337,15 @@ extern bool
 fileServiceHasType (BRFileService fs,
                     const char *type);
 
+/**
+ * Check if every entity of `type` was saved with a sort key, whereby `fileServiceLoadIterate()`
+ * loads all of them in sort key order.  Entities saved before their type had a sort key come
+ * first, in no particular order, until a load with `updateVersion` saves them with their key.
+ *
+ * @return true (1) if sorted, false (0) if not or on failure.
+ */
+extern int
+fileServiceIsSorted (BRFileService fs,
+                     const char *type);
+
 #endif /* BRFileService_h */
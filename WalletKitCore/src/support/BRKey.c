@@ -25,11 +25,13 @@
 #include "BRKey.h"
 #include "BRBase.h"
 #include "BRBase58.h"
+#include "BROSCompat.h"
 #include <stdio.h>
 #include <string.h>
 #include <assert.h>
 #include <unistd.h>             // getpid()
 #include <pthread.h>
+#include <stdlib.h>
 
 #if __BIG_ENDIAN__ || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__) ||\
     __ARMEB__ || __THUMBEB__ || __AARCH64EB__ || __MIPSEB__
@@ -126,6 +128,30 @@ int BRSecp256k1PointAdd(BRECPoint *p, const UInt256 *i)
             secp256k1_ec_pubkey_serialize(_ctx, (unsigned char *)p, &pLen, &pubkey, SECP256K1_EC_COMPRESSED));
 }
 
+// multiplies secp256k1 generator by each of the count 256bit big endian ints i[] and adds the result to ec-point p,
+// storing the sums in out[]; p is decoded once for all of them
+// returns the number of leading sums stored before a failure, or count on success
+size_t BRSecp256k1PointAddBatch(BRECPoint out[], const BRECPoint *p, const UInt256 i[], size_t count)
+{
+    secp256k1_pubkey base, pubkey;
+    size_t n, pLen;
+
+    assert(out != NULL || count == 0);
+    assert(p != NULL);
+    assert(i != NULL || count == 0);
+    pthread_once(&_ctx_once, _ctx_init);
+    if (! secp256k1_ec_pubkey_parse(_ctx, &base, (const unsigned char *)p, sizeof(*p))) return 0;
+
+    for (n = 0; n < count; n++) {
+        pubkey = base;
+        pLen = sizeof(out[n]);
+        if (! secp256k1_ec_pubkey_tweak_add(_ctx, &pubkey, (const unsigned char *)&i[n]) ||
+            ! secp256k1_ec_pubkey_serialize(_ctx, (unsigned char *)&out[n], &pLen, &pubkey, SECP256K1_EC_COMPRESSED)) break;
+    }
+
+    return n;
+}
+
 // multiplies secp256k1 ec-point p by 256bit big endian int i and stores the result in p
 // returns true on success
 int BRSecp256k1PointMul(BRECPoint *p, const UInt256 *i)
@@ -464,6 +490,109 @@ int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen)
     return r;
 }
 
+typedef struct {
+    const UInt256 *mds;
+    secp256k1_pubkey *pks;
+    void *sigs; // secp256k1_ecdsa_signature to verify, secp256k1_ecdsa_recoverable_signature to recover
+    int *results;
+    size_t count;
+    size_t first, stride; // the items for a worker are first, first + stride, first + 2*stride...
+} _BRKeyBatchWork;
+
+static void *_BRKeyVerifyWorker(void *info)
+{
+    _BRKeyBatchWork *work = info;
+    const secp256k1_ecdsa_signature *sigs = work->sigs;
+
+    for (size_t i = work->first; i < work->count; i += work->stride) {
+        // success is 1, all other values are fail
+        if (work->results[i]) work->results[i] = (secp256k1_ecdsa_verify(_ctx, &sigs[i], work->mds[i].u8, &work->pks[i]) == 1);
+    }
+
+    return NULL;
+}
+
+static void *_BRKeyRecoverWorker(void *info)
+{
+    _BRKeyBatchWork *work = info;
+    const secp256k1_ecdsa_recoverable_signature *sigs = work->sigs;
+
+    for (size_t i = work->first; i < work->count; i += work->stride) {
+        if (work->results[i]) work->results[i] = secp256k1_ecdsa_recover(_ctx, &work->pks[i], &sigs[i], work->mds[i].u8);
+    }
+
+    return NULL;
+}
+
+// runs worker over batch on up to threadCount threads, including the caller's
+static void _BRKeyBatchRun(void *(*worker)(void *), _BRKeyBatchWork batch, size_t threadCount)
+{
+    size_t i;
+
+    if (threadCount > batch.count) threadCount = batch.count;
+    if (threadCount < 1) threadCount = 1;
+
+    _BRKeyBatchWork work[threadCount];
+
+    for (i = 0; i < threadCount; i++) {
+        work[i] = batch;
+        work[i].first = i;
+        work[i].stride = threadCount;
+    }
+
+    run_parallel_brd(worker, work, sizeof(*work), threadCount);
+}
+
+// sets results[i] to true if the DER-encoded signature sigs[i] for mds[i] is verified to have been made by keys[i]
+// unlike BRKeyVerify(), high-S signatures are normalized before verification, as bitcoin consensus allows them
+// verification runs on up to threadCount threads, including the caller's
+// returns the number of signatures verified
+size_t BRKeyVerifyBatch(BRKey *keys[], const UInt256 mds[], const void *sigs[], const size_t sigLens[], size_t count,
+                        int results[], size_t threadCount)
+{
+    pthread_once(&_ctx_once, _ctx_init);
+
+    secp256k1_pubkey *pks = (count > 0) ? malloc(count*sizeof(*pks)) : NULL;
+    secp256k1_ecdsa_signature *ss = (count > 0) ? malloc(count*sizeof(*ss)) : NULL;
+    const BRKey *prevKey = NULL;
+    int pkValid = 0;
+    size_t i, len, r = 0;
+
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(sigs != NULL || count == 0);
+    assert(sigLens != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    assert(pks != NULL || count == 0);
+    assert(ss != NULL || count == 0);
+
+    // parse everything up front; BRKeyPubKey() may derive and cache a key's pubKey, so this isn't done on the workers
+    for (i = 0; i < count; i++) {
+        assert(keys[i] != NULL);
+        assert(sigs[i] != NULL || sigLens[i] == 0);
+
+        if (keys[i] != prevKey) { // consecutive inputs are often signed by the same key, so parse its pubKey once
+            len = BRKeyPubKey(keys[i], NULL, 0);
+            pkValid = (len > 0 && secp256k1_ec_pubkey_parse(_ctx, &pks[i], keys[i]->pubKey, len));
+            prevKey = keys[i];
+        }
+        else if (pkValid) pks[i] = pks[i - 1];
+
+        results[i] = (pkValid && sigLens[i] > 0 && secp256k1_ecdsa_signature_parse_der(_ctx, &ss[i], sigs[i], sigLens[i]));
+        if (results[i]) secp256k1_ecdsa_signature_normalize(_ctx, &ss[i], &ss[i]);
+    }
+
+    _BRKeyBatchRun(_BRKeyVerifyWorker, (_BRKeyBatchWork) { mds, pks, ss, results, count, 0, 1 }, threadCount);
+
+    for (i = 0; i < count; i++) {
+        if (results[i]) r++;
+    }
+
+    if (ss) free(ss);
+    if (pks) free(pks);
+    return r;
+}
+
 // wipes key material from key
 void BRKeyClean(BRKey *key)
 {
@@ -577,6 +706,74 @@ int BRKeyRecoverPubKeyEthereum(BRKey *key, UInt256 md, const void *compactSig, s
     return r;
 }
 
+// ethereum is true for the BRKeyRecoverPubKeyEthereum() compactSig encoding, false for the BRKeyRecoverPubKey() one
+static size_t _BRKeyRecoverPubKeyBatch(BRKey keys[], const UInt256 mds[], const void *compactSigs[], size_t count,
+                                       int results[], size_t threadCount, int ethereum)
+{
+    pthread_once(&_ctx_once, _ctx_init);
+
+    secp256k1_pubkey *pks = (count > 0) ? malloc(count*sizeof(*pks)) : NULL;
+    secp256k1_ecdsa_recoverable_signature *ss = (count > 0) ? malloc(count*sizeof(*ss)) : NULL;
+    uint8_t pubKey[65];
+    size_t i, len, r = 0;
+    int recid, compressed;
+
+    assert(keys != NULL || count == 0);
+    assert(mds != NULL || count == 0);
+    assert(compactSigs != NULL || count == 0);
+    assert(results != NULL || count == 0);
+    assert(pks != NULL || count == 0);
+    assert(ss != NULL || count == 0);
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *sig = compactSigs[i];
+
+        assert(sig != NULL);
+        recid = (ethereum) ? sig[64] : (sig[0] - 27) % 4;
+        results[i] = (recid >= 0 && recid < 4 &&
+                      secp256k1_ecdsa_recoverable_signature_parse_compact(_ctx, &ss[i], (ethereum) ? sig : sig + 1, recid));
+    }
+
+    _BRKeyBatchRun(_BRKeyRecoverWorker, (_BRKeyBatchWork) { mds, pks, ss, results, count, 0, 1 }, threadCount);
+
+    for (i = 0; i < count; i++) {
+        const uint8_t *sig = compactSigs[i];
+
+        compressed = (! ethereum && sig[0] - 27 >= 4);
+        len = sizeof(pubKey);
+
+        if (results[i]) {
+            results[i] = (secp256k1_ec_pubkey_serialize(_ctx, pubKey, &len, &pks[i],
+                                                        (compressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED)) &&
+                          BRKeySetPubKey(&keys[i], pubKey, len));
+        }
+
+        if (results[i]) r++;
+    }
+
+    if (ss) free(ss);
+    if (pks) free(pks);
+    return r;
+}
+
+// like BRKeyRecoverPubKey() for each of the 65 byte compactSigs[i] and mds[i], setting keys[i] and results[i]
+// recovery runs on up to threadCount threads, including the caller's
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyBatch(BRKey keys[], const UInt256 mds[], const void *compactSigs[], size_t count,
+                               int results[], size_t threadCount)
+{
+    return _BRKeyRecoverPubKeyBatch(keys, mds, compactSigs, count, results, threadCount, 0);
+}
+
+// like BRKeyRecoverPubKeyEthereum() for each of the 65 byte compactSigs[i] and mds[i], setting keys[i] and results[i]
+// recovery runs on up to threadCount threads, including the caller's
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyEthereumBatch(BRKey keys[], const UInt256 mds[], const void *compactSigs[], size_t count,
+                                       int results[], size_t threadCount)
+{
+    return _BRKeyRecoverPubKeyBatch(keys, mds, compactSigs, count, results, threadCount, 1);
+}
+
 int BRKeySetCompressed (BRKey *key, int compressed) {
     compressed = (compressed ? 1 : 0); // as 1 or 0
 
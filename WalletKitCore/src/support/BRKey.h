@@ -59,6 +59,11 @@ int BRSecp256k1PointGen(BRECPoint *p, const UInt256 *i);
 // returns true on success
 int BRSecp256k1PointAdd(BRECPoint *p, const UInt256 *i);
 
+// multiplies secp256k1 generator by each of the count 256bit big endian ints i[] and adds the result to ec-point p,
+// storing the sums in out[]; p is decoded once for all of them
+// returns the number of leading sums stored before a failure, or count on success
+size_t BRSecp256k1PointAddBatch(BRECPoint out[], const BRECPoint *p, const UInt256 i[], size_t count);
+
 // multiplies secp256k1 ec-point p by 256bit big endian int i and stores the result in p
 // returns true on success
 int BRSecp256k1PointMul(BRECPoint *p, const UInt256 *i);
@@ -123,6 +128,13 @@ size_t BRKeySign(const BRKey *key, void *sig, size_t sigLen, UInt256 md);
 // returns true if the DER-encoded signature for md is verified to have been made by key
 int BRKeyVerify(BRKey *key, UInt256 md, const void *sig, size_t sigLen);
 
+// sets results[i] to true if the DER-encoded signature sigs[i] for mds[i] is verified to have been made by keys[i]
+// unlike BRKeyVerify(), high-S signatures are normalized before verification, as bitcoin consensus allows them
+// verification runs on up to threadCount threads, including the caller's
+// returns the number of signatures verified
+size_t BRKeyVerifyBatch(BRKey *keys[], const UInt256 mds[], const void *sigs[], const size_t sigLens[], size_t count,
+                        int results[], size_t threadCount);
+
 // wipes key material from key
 void BRKeyClean(BRKey *key);
 
@@ -139,6 +151,18 @@ void BRKeyECDH(const BRKey *privKey, uint8_t *out32, BRKey *pubKey);
 size_t BRKeyCompactSignEthereum(const BRKey *key, void *compactSig, size_t sigLen, UInt256 md);
 int BRKeyRecoverPubKeyEthereum(BRKey *key, UInt256 md, const void *compactSig, size_t sigLen);
 
+// like BRKeyRecoverPubKey() for each of the 65 byte compactSigs[i] and mds[i], setting keys[i] and results[i]
+// recovery runs on up to threadCount threads, including the caller's
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyBatch(BRKey keys[], const UInt256 mds[], const void *compactSigs[], size_t count,
+                               int results[], size_t threadCount);
+
+// like BRKeyRecoverPubKeyEthereum() for each of the 65 byte compactSigs[i] and mds[i], setting keys[i] and results[i]
+// recovery runs on up to threadCount threads, including the caller's
+// returns the number of pubKeys recovered
+size_t BRKeyRecoverPubKeyEthereumBatch(BRKey keys[], const UInt256 mds[], const void *compactSigs[], size_t count,
+                                       int results[], size_t threadCount);
+
 // Set the compressed flag in `key`; this will clear the `pubKey` to allow regeneration
 // Returns true (1) if the compress flag changed; false (0) otherwise
 int BRKeySetCompressed (BRKey *key, int compressed);
@@ -26,6 +26,7 @@
 #include "BROSCompat.h"
 #include "time.h"
 #include "sys/time.h"
+#include <unistd.h>         // sysconf()
 
 #if defined (__APPLE__)
 #include <Security/Security.h>
@@ -117,3 +118,52 @@ mergesort_brd (void *__base, size_t __nel, size_t __width,
 #  error Undefined mergesort_brd()
 #endif
 }
+
+static size_t _processorCount = 1;
+static pthread_once_t _processorCountOnce = PTHREAD_ONCE_INIT;
+
+static void
+_processorCountInit (void) {
+    long count = sysconf (_SC_NPROCESSORS_ONLN);
+    if (count > 1) _processorCount = (size_t) count;
+}
+
+extern size_t
+processor_count_brd (void) {
+    pthread_once (&_processorCountOnce, _processorCountInit);
+    return _processorCount;
+}
+
+extern size_t
+thread_count_brd (size_t limit) {
+    size_t count = processor_count_brd ();
+    if (count > limit) count = limit;
+    return (count > 0 ? count : 1);
+}
+
+#define RUN_PARALLEL_STACK_SIZE     (512 * 1024)
+
+extern void
+run_parallel_brd (ThreadRoutine routine, void *contexts, size_t contextSize, size_t count) {
+    if (0 == count) return;
+
+    pthread_t threads[count];
+    int started[count];
+    pthread_attr_t attr;
+
+    pthread_attr_init (&attr);
+    pthread_attr_setstacksize (&attr, RUN_PARALLEL_STACK_SIZE);
+
+    started[0] = 0;
+    for (size_t i = 1; i < count; i++)
+        started[i] = (0 == pthread_create (&threads[i], &attr, routine, (uint8_t *) contexts + i * contextSize));
+
+    pthread_attr_destroy (&attr);
+
+    routine (contexts);
+
+    for (size_t i = 1; i < count; i++) {
+        if (started[i]) pthread_join (threads[i], NULL);
+        else routine ((uint8_t *) contexts + i * contextSize);
+    }
+}
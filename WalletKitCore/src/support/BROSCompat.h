@@ -77,6 +77,17 @@ extern int
 mergesort_brd (void *__base, size_t __nel, size_t __width,
                int (*__compar)(const void *, const void *));
 
+extern size_t
+processor_count_brd (void);             // online processors, at least 1
+
+extern size_t
+thread_count_brd (size_t limit);        // online processors up to limit, at least 1
+
+// Runs routine on each of count contexts, contextSize bytes apart, one thread each with the caller's thread running
+// the first; a context whose thread fails to start is run on the caller's thread.  Returns once all have finished.
+extern void
+run_parallel_brd (ThreadRoutine routine, void *contexts, size_t contextSize, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
@@ -10,6 +10,7 @@
 
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stddef.h>
 #include <memory.h>
 #include <assert.h>
 #include <pthread.h>
@@ -37,8 +38,6 @@ rlpDecodeStringEmptyCheck (BRRlpCoder coder, BRRlpItem item);
 static void
 encodeLengthIntoBytes (uint64_t length, uint8_t baseline, uint8_t *bytes9, uint8_t *bytes9Count);
 
-#define CODER_DEFAULT_ITEMS     (2000)
-
 /**
  * An RLP Encoding is comprised of two types: an ITEM and a LIST (of ITEM).
  *
@@ -51,31 +50,59 @@ typedef enum {
 #define ITEM_DEFAULT_BYTES_COUNT  1024
 #define ITEM_DEFAULT_ITEMS_COUNT    15
 
+// A compact item holds enough inline bytes for an encoded address or hash; anything larger, and
+// every item list, is allocated from the coder's arena.
+#define ITEM_COMPACT_BYTES_COUNT    40
+
 struct  BRRlpItemRecord {
     BRRlpItemType type;
 
     // The encoding
     size_t bytesCount;
     uint8_t *bytes;
-    uint8_t  bytesArray [ITEM_DEFAULT_BYTES_COUNT];
+
+    // If true, `bytes` are a view into memory not owned by the item
+    int bytesShared;
 
     // If CODER_LIST, then reference the component items.
     size_t itemsCount;
     BRRlpItem *items;
-    BRRlpItem  itemsArray [ITEM_DEFAULT_ITEMS_COUNT];
 
     // double linked-list of free/busy items.
     BRRlpItem next, prev;
+
+    // The inline storage must come last.  A compact item is allocated with only
+    // ITEM_COMPACT_BYTES_COUNT of `bytesArray` and without any `itemsArray`.
+    uint8_t  bytesArray [ITEM_DEFAULT_BYTES_COUNT];
+    BRRlpItem  itemsArray [ITEM_DEFAULT_ITEMS_COUNT];
 };
 
+#define ITEM_COMPACT_HEADER_SIZE    (offsetof (struct BRRlpItemRecord, bytesArray))
+#define ITEM_COMPACT_SIZE           (ITEM_COMPACT_HEADER_SIZE + ITEM_COMPACT_BYTES_COUNT)
+
 static void
 itemReleaseMemory (BRRlpItem item) {
-    if (item->bytesArray != item->bytes && NULL != item->bytes) free (item->bytes);
+    if (item->bytesArray != item->bytes && NULL != item->bytes && !item->bytesShared) free (item->bytes);
     if (item->itemsArray != item->items && NULL != item->items) free (item->items);
 
     memset (item, 0, sizeof (struct BRRlpItemRecord));
 }
 
+/**
+ * An arena chunk.  Memory is handed out from `bytes` by bumping `used`; it is never returned
+ * individually - the whole arena is reset at once.
+ */
+typedef struct BRRlpArenaChunkRecord {
+    struct BRRlpArenaChunkRecord *next;
+    size_t size;
+    size_t used;
+    uint8_t bytes[];
+} *BRRlpArenaChunk;
+
+#define ARENA_CHUNK_SIZE        (64 * 1024)
+#define ARENA_ALIGNMENT         (sizeof (void*))
+#define ARENA_ALIGN(size)       (((size) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1))
+
 /**
  *
  */
@@ -111,10 +138,29 @@ struct BRRlpCoderRecord {
      * are only used in one thread.  However, that use my not be generally true - so lock/unlock.
      */
     pthread_mutex_t lock;
+
+    /**
+     * A boolean to indicate a compact coder.  A compact coder allocates items, and their bytes
+     * and sub-items, from `arena`; it does not lock and does not use `free` nor `busy`.
+     */
+    int compact;
+
+    /**
+     * For a compact coder, the number of acquired but not yet released items.  When the count
+     * returns to zero, typically once the item from a decode is released, the arena is reset.
+     */
+    size_t busyCount;
+
+    /**
+     * For a compact coder, the arena chunks linked on `next`.  The `arenaChunk` is the one being
+     * filled; those before it are full and those after it are unused.
+     */
+    BRRlpArenaChunk arena;
+    BRRlpArenaChunk arenaChunk;
 };
 
-extern BRRlpCoder
-rlpCoderCreate (void) {
+static BRRlpCoder
+rlpCoderCreateInternal (int compact) {
     BRRlpCoder coder = malloc (sizeof (struct BRRlpCoderRecord));
     coder->failed = 0;
     coder->free = NULL;
@@ -122,9 +168,83 @@ rlpCoderCreate (void) {
 
     pthread_mutex_init_brd (&coder->lock, PTHREAD_MUTEX_NORMAL);
 
+    coder->compact = compact;
+    coder->busyCount = 0;
+    coder->arena = NULL;
+    coder->arenaChunk = NULL;
+
     return coder;
 }
 
+extern BRRlpCoder
+rlpCoderCreate (void) {
+    return rlpCoderCreateInternal (0);
+}
+
+extern BRRlpCoder
+rlpCoderCreateCompact (void) {
+    return rlpCoderCreateInternal (1);
+}
+
+/// MARK: - Arena
+
+static void *
+rlpCoderArenaAlloc (BRRlpCoder coder, size_t size) {
+    size = ARENA_ALIGN (size);
+
+    BRRlpArenaChunk chunk = coder->arenaChunk;
+
+    if (NULL == chunk || chunk->size - chunk->used < size) {
+        // Chunks after `arenaChunk` are unused, left over from a prior reset.  Move to the next
+        // one if it fits; otherwise allocate a chunk - an oversized request gets one of its own.
+        if (NULL != chunk && NULL != chunk->next && chunk->next->size >= size)
+            chunk = chunk->next;
+        else {
+            size_t chunkSize = (size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE);
+            BRRlpArenaChunk next = malloc (sizeof (struct BRRlpArenaChunkRecord) + chunkSize);
+            next->size = chunkSize;
+            next->used = 0;
+
+            if (NULL == chunk) { next->next = NULL;        coder->arena = next; }
+            else               { next->next = chunk->next; chunk->next  = next; }
+            chunk = next;
+        }
+        coder->arenaChunk = chunk;
+    }
+
+    void *memory = &chunk->bytes[chunk->used];
+    chunk->used += size;
+    return memory;
+}
+
+static void
+rlpCoderArenaReset (BRRlpCoder coder) {
+    // Keep the standard-sized chunks for reuse; free the oversized ones.
+    BRRlpArenaChunk *link = &coder->arena;
+    while (NULL != *link) {
+        BRRlpArenaChunk chunk = *link;
+        if (chunk->size > ARENA_CHUNK_SIZE) {
+            *link = chunk->next;
+            free (chunk);
+        }
+        else {
+            chunk->used = 0;
+            link = &chunk->next;
+        }
+    }
+    coder->arenaChunk = coder->arena;
+}
+
+static void
+rlpCoderArenaRelease (BRRlpCoder coder) {
+    while (NULL != coder->arena) {
+        BRRlpArenaChunk next = coder->arena->next;
+        free (coder->arena);
+        coder->arena = next;
+    }
+    coder->arenaChunk = NULL;
+}
+
 static void
 _rlpCoderReclaimInternal (BRRlpCoder coder) {
     BRRlpItem item = coder->free;
@@ -139,6 +259,11 @@ _rlpCoderReclaimInternal (BRRlpCoder coder) {
 
 extern void
 rlpCoderReclaim (BRRlpCoder coder) {
+    if (coder->compact) {
+        if (0 == coder->busyCount) rlpCoderArenaRelease (coder);
+        return;
+    }
+
     pthread_mutex_lock(&coder->lock);
     _rlpCoderReclaimInternal (coder);
     pthread_mutex_unlock(&coder->lock);
@@ -149,8 +274,9 @@ rlpCoderRelease (BRRlpCoder coder) {
     pthread_mutex_lock(&coder->lock);
 
     // Every single Item must be returned!
-    assert (NULL == coder->busy);
+    assert (NULL == coder->busy && 0 == coder->busyCount);
     _rlpCoderReclaimInternal (coder);
+    rlpCoderArenaRelease (coder);
 
     pthread_mutex_unlock(&coder->lock);
     pthread_mutex_destroy(&coder->lock);
@@ -182,8 +308,19 @@ _rlpCoderAcquireItemInternal (BRRlpCoder coder) {
     return item;
 }
 
+static BRRlpItem
+_rlpCoderAcquireItemCompact (BRRlpCoder coder) {
+    BRRlpItem item = rlpCoderArenaAlloc (coder, ITEM_COMPACT_SIZE);
+    memset (item, 0, ITEM_COMPACT_HEADER_SIZE);
+
+    coder->busyCount += 1;
+    return item;
+}
+
 static BRRlpItem
 rlpCoderAcquireItem (BRRlpCoder coder) {
+    if (coder->compact) return _rlpCoderAcquireItemCompact (coder);
+
     pthread_mutex_lock(&coder->lock);
     BRRlpItem item = _rlpCoderAcquireItemInternal (coder);
     pthread_mutex_unlock(&coder->lock);
@@ -227,8 +364,24 @@ _rlpCoderReleaseItemInternal (BRRlpCoder coder, BRRlpItem item) {
     _rlpCoderReturnItemInternal (coder, prev, item, next);
 }
 
+static void
+_rlpCoderReleaseItemCompact (BRRlpCoder coder, BRRlpItem item) {
+    for (size_t index = 0; index < item->itemsCount; index++)
+        _rlpCoderReleaseItemCompact (coder, item->items[index]);
+
+    // The item's memory is the arena's; just count it as released.
+    assert (coder->busyCount > 0);
+    coder->busyCount -= 1;
+}
+
 static void
 rlpCoderReleaseItem (BRRlpCoder coder, BRRlpItem item) {
+    if (coder->compact) {
+        _rlpCoderReleaseItemCompact (coder, item);
+        if (0 == coder->busyCount) rlpCoderArenaReset (coder);
+        return;
+    }
+
     pthread_mutex_lock(&coder->lock);
     _rlpCoderReleaseItemInternal (coder, item);
     pthread_mutex_unlock(&coder->lock);
@@ -250,9 +403,14 @@ static uint8_t *
 itemEnsureBytes (BRRlpCoder coder, BRRlpItem item, size_t bytesCount) {
     assert (NULL == item->bytes);
     item->bytesCount = bytesCount;
-    item->bytes = (item->bytesCount > ITEM_DEFAULT_BYTES_COUNT
-                   ? malloc (item->bytesCount)
-                   : item->bytesArray);
+    if (coder->compact)
+        item->bytes = (item->bytesCount > ITEM_COMPACT_BYTES_COUNT
+                       ? rlpCoderArenaAlloc (coder, item->bytesCount)
+                       : item->bytesArray);
+    else
+        item->bytes = (item->bytesCount > ITEM_DEFAULT_BYTES_COUNT
+                       ? malloc (item->bytesCount)
+                       : item->bytesArray);
     return item->bytes;
 }
 
@@ -260,9 +418,14 @@ static BRRlpItem
 itemFillList (BRRlpCoder coder, BRRlpItem item, BRRlpItem *items, size_t itemsCount) {
     item->type = CODER_LIST;
     item->itemsCount = itemsCount;
-    item->items = (item->itemsCount > ITEM_DEFAULT_ITEMS_COUNT
-                   ? calloc (item->itemsCount, sizeof (BRRlpItem))
-                   : item->itemsArray);
+    if (coder->compact)
+        item->items = (0 == item->itemsCount
+                       ? NULL
+                       : rlpCoderArenaAlloc (coder, item->itemsCount * sizeof (BRRlpItem)));
+    else
+        item->items = (item->itemsCount > ITEM_DEFAULT_ITEMS_COUNT
+                       ? calloc (item->itemsCount, sizeof (BRRlpItem))
+                       : item->itemsArray);
     for (int i = 0; i < itemsCount; i++)
         item->items[i] = items[i];
     return item;
@@ -896,15 +1059,28 @@ rlpGetItem_FillData (BRRlpCoder coder, uint8_t *bytes) {
 
 /**
  * Convet the bytes in `data` into an `item`.  If `data` represents a RLP list, then `item` will
- * represent a list.
+ * represent a list.  If `shared`, then `data` is owned elsewhere - by the caller, for a view, or
+ * by an enclosing item - and `item` simply references it.
  */
-extern BRRlpItem
-rlpDataGetItem (BRRlpCoder coder, BRRlpData data) {
+static BRRlpItem
+rlpDataGetItemInternal (BRRlpCoder coder, BRRlpData data, int shared) {
     assert (0 != data.bytesCount);
 
     BRRlpItem result = rlpCoderAcquireItem (coder);
-    uint8_t *encodedBytes = itemEnsureBytes (coder, result, data.bytesCount);
-    memcpy (encodedBytes, data.bytes, data.bytesCount);
+    uint8_t *encodedBytes;
+
+    if (shared) {
+        result->bytesCount  = data.bytesCount;
+        result->bytes       = encodedBytes = data.bytes;
+        result->bytesShared = 1;
+    }
+    else {
+        encodedBytes = itemEnsureBytes (coder, result, data.bytesCount);
+        memcpy (encodedBytes, data.bytes, data.bytesCount);
+    }
+
+    // Walk our own bytes so that, for a view or a compact coder, sub-items can share them.
+    data.bytes = encodedBytes;
 
     uint8_t prefix = data.bytes[0];
 
@@ -940,7 +1116,7 @@ rlpDataGetItem (BRRlpCoder coder, BRRlpData data) {
         while (bytes < bytesLimit) {
             // Get the `data` for this sub-item and then recurse
             BRRlpData d = rlpGetItem_FillData(coder, bytes);
-            items[itemsIndex++] = rlpDataGetItem (coder, d);
+            items[itemsIndex++] = rlpDataGetItemInternal (coder, d, shared || coder->compact);
 
             // Move to the next sub-item
             bytes += d.bytesCount;
@@ -964,6 +1140,16 @@ rlpDataGetItem (BRRlpCoder coder, BRRlpData data) {
     return result;
 }
 
+extern BRRlpItem
+rlpDataGetItem (BRRlpCoder coder, BRRlpData data) {
+    return rlpDataGetItemInternal (coder, data, 0);
+}
+
+extern BRRlpItem
+rlpDataGetItemView (BRRlpCoder coder, BRRlpData data) {
+    return rlpDataGetItemInternal (coder, data, 1);
+}
+
 //
 // Show
 //
@@ -27,6 +27,16 @@ typedef struct BRRlpCoderRecord *BRRlpCoder;
 extern BRRlpCoder
 rlpCoderCreate (void);
 
+/**
+ * Create a compact coder.  A compact coder allocates items, with a small inline buffer, from a
+ * bump-pointer arena; decoded sub-items reference the bytes of their enclosing item rather than
+ * copying them.  The arena is reset once every item has been released - typically after each
+ * decode - so one must not hold items across unrelated encodes/decodes.  A compact coder does not
+ * lock and must only be used in one thread.
+ */
+extern BRRlpCoder
+rlpCoderCreateCompact (void);
+
 extern void
 rlpCoderRelease (BRRlpCoder coder);
 
@@ -75,6 +85,15 @@ rlpItemRelease (BRRlpCoder coder, BRRlpItem item);
 extern BRRlpItem
 rlpDataGetItem (BRRlpCoder coder, BRRlpData data);
 
+/**
+ * Convert the bytes in `data` into an `item`, as rlpDataGetItem(), but without copying `data`.
+ * The returned item, and all its subitems, are a read-only view into `data` - thus `data` must
+ * not be modified nor released until `item` is released.  The 'SharedDontRelease' functions
+ * return bytes within `data`.
+ */
+extern BRRlpItem
+rlpDataGetItemView (BRRlpCoder coder, BRRlpData data);
+
 /**
  * Return the RLP data associated with `item`.  You own this data and must call
  * rlpDataRelese().
@@ -59,7 +59,7 @@ public class CryptoLibraryIT {
 
     @Test
     public void testBitcoin() {
-        assertEquals(1, TestCryptoLibrary.INSTANCE.BRRunTests());
+        assertEquals(1, TestCryptoLibrary.INSTANCE.BRRunTests(coreDataDir.getAbsolutePath()));
     }
 
     @Test
@@ -505,7 +505,7 @@ public class CryptoLibraryIT {
     public interface TestCryptoLibrary extends Library {
         TestCryptoLibrary INSTANCE = Native.load(CryptoLibrary.LIBRARY_NAME, TestCryptoLibrary.class);
 
-        int BRRunTests();
+        int BRRunTests(String storagePath);
         int BRRunSupTests();
         int BRRunTestsSync (String paperKey, int isBTC, int isMainnet);
         int BRRunTestWalletManagerSync (String paperKey, String storagePath, int isBTC, int isMainnet);